@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+
+namespace DX
+{
+	namespace Detail
+	{
+		inline std::atomic<long long>& HeapAllocationTotal()
+		{
+			static std::atomic<long long> total(0);
+			return total;
+		}
+
+		inline bool& HeapAllocationsCounted()
+		{
+			static bool counted = false;
+			return counted;
+		}
+	}
+
+	// For builds without the debug CRT: a replacement operator new calls CountHeapAllocation for
+	// every allocation, and calls EnableHeapAllocationCount once so the counters report them.
+	inline void CountHeapAllocation()		{ Detail::HeapAllocationTotal()++; }
+	inline void EnableHeapAllocationCount()	{ Detail::HeapAllocationsCounted() = true; }
+
+	// Counts the heap allocations made, by any thread, while it is alive. MSVC debug builds count
+	// through the CRT allocation hook; elsewhere Count() is -1 unless the program replaced
+	// operator new as described above. Only one counter should be alive at a time.
+	class HeapAllocationCounter
+	{
+	public:
+		HeapAllocationCounter() : m_start(Detail::HeapAllocationTotal().load())
+		{
+#if defined(_MSC_VER) && defined(_DEBUG)
+			m_previousHook = _CrtSetAllocHook(Hook);
+#endif
+		}
+
+		~HeapAllocationCounter()
+		{
+#if defined(_MSC_VER) && defined(_DEBUG)
+			_CrtSetAllocHook(m_previousHook);
+#endif
+		}
+
+		HeapAllocationCounter(const HeapAllocationCounter&) = delete;
+		HeapAllocationCounter& operator=(const HeapAllocationCounter&) = delete;
+
+		long long Count() const
+		{
+#if !(defined(_MSC_VER) && defined(_DEBUG))
+			if (!Detail::HeapAllocationsCounted())
+				return -1;
+#endif
+			return Detail::HeapAllocationTotal().load() - m_start;
+		}
+
+	private:
+#if defined(_MSC_VER) && defined(_DEBUG)
+		static int __cdecl Hook(int allocType, void*, size_t, int, long, const unsigned char*, int)
+		{
+			if (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)
+				CountHeapAllocation();
+			return TRUE;
+		}
+
+		_CRT_ALLOC_HOOK m_previousHook;
+#endif
+		long long m_start;
+	};
+}
+
+// Define DX_REPLACE_GLOBAL_NEW in exactly one source file of a program, before including this
+// header, to replace the global operator new and delete, aligned ones included, with versions
+// that call CountHeapAllocation. The program still calls EnableHeapAllocationCount. With the
+// debug CRT the hook already counts them, so the replacements only allocate.
+#ifdef DX_REPLACE_GLOBAL_NEW
+#include <stdlib.h>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#define DX_NOINLINE __declspec(noinline)
+#else
+#define DX_NOINLINE __attribute__((noinline))
+#endif
+
+namespace DX
+{
+	namespace Detail
+	{
+		inline void CountReplacedAllocation()
+		{
+#if !(defined(_MSC_VER) && defined(_DEBUG))
+			CountHeapAllocation();
+#endif
+		}
+
+		// Not inlined, so the compiler doesn't see new's pointers handed to free and warn.
+		DX_NOINLINE inline void* AllocateCounted(size_t size, size_t alignment)
+		{
+			CountReplacedAllocation();
+			size = size ? size : 1;
+			void* memory;
+#if defined(_MSC_VER)
+			memory = alignment ? _aligned_malloc(size, alignment) : malloc(size);
+#else
+			memory = alignment ? aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : malloc(size);
+#endif
+			if (!memory)
+				throw std::bad_alloc();
+			return memory;
+		}
+
+		DX_NOINLINE inline void FreeCounted(void* memory, bool aligned) noexcept
+		{
+#if defined(_MSC_VER)
+			if (aligned)
+			{
+				_aligned_free(memory);
+				return;
+			}
+#else
+			(void)aligned;
+#endif
+			free(memory);
+		}
+	}
+}
+
+void* operator new(size_t size)												{ return DX::Detail::AllocateCounted(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment)					{ return DX::Detail::AllocateCounted(size, size_t(alignment)); }
+void operator delete(void* memory) noexcept									{ DX::Detail::FreeCounted(memory, false); }
+void operator delete(void* memory, size_t) noexcept							{ DX::Detail::FreeCounted(memory, false); }
+void operator delete(void* memory, std::align_val_t) noexcept				{ DX::Detail::FreeCounted(memory, true); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept		{ DX::Detail::FreeCounted(memory, true); }
+#endif
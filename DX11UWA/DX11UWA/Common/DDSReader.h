@@ -0,0 +1,194 @@
+//--------------------------------------------------------------------------------------
+// File: DDSReader.h
+//
+// Device independent half of DDSTextureLoader: validates a DDS file held in memory and
+// describes where every subresource lives inside it, without copying any texel data.
+//
+// Nothing here needs Direct3D, so it also builds for tools and tests off Windows. There
+// <dxgiformat.h> comes from the DirectX-Headers package.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <dxgiformat.h>
+
+//--------------------------------------------------------------------------------------
+// Macros
+//--------------------------------------------------------------------------------------
+#ifndef MAKEFOURCC
+    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#pragma pack(push,1)
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    fourCC;
+    uint32_t    RGBBitCount;
+    uint32_t    RBitMask;
+    uint32_t    GBitMask;
+    uint32_t    BBitMask;
+    uint32_t    ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_RGBA        0x00000041  // DDPF_RGB | DDPF_ALPHAPIXELS
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_LUMINANCEA  0x00020001  // DDPF_LUMINANCE | DDPF_ALPHAPIXELS
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+#define DDS_PAL8        0x00000020  // DDPF_PALETTEINDEXED8
+
+#define DDS_HEADER_FLAGS_TEXTURE        0x00001007  // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+#define DDS_HEADER_FLAGS_MIPMAP         0x00020000  // DDSD_MIPMAPCOUNT
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+#define DDS_HEADER_FLAGS_PITCH          0x00000008  // DDSD_PITCH
+#define DDS_HEADER_FLAGS_LINEARSIZE     0x00080000  // DDSD_LINEARSIZE
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_SURFACE_FLAGS_TEXTURE 0x00001000 // DDSCAPS_TEXTURE
+#define DDS_SURFACE_FLAGS_MIPMAP  0x00400008 // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+#define DDS_SURFACE_FLAGS_CUBEMAP 0x00000008 // DDSCAPS_COMPLEX
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+#define DDS_FLAGS_VOLUME 0x00200000 // DDSCAPS2_VOLUME
+
+typedef struct
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t        caps;
+    uint32_t        caps2;
+    uint32_t        caps3;
+    uint32_t        caps4;
+    uint32_t        reserved2;
+} DDS_HEADER;
+
+typedef struct
+{
+    DXGI_FORMAT     dxgiFormat;
+    uint32_t        resourceDimension;
+    uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+    uint32_t        arraySize;
+    uint32_t        reserved;
+} DDS_HEADER_DXT10;
+
+#pragma pack(pop)
+
+// Same values as D3D11_RESOURCE_DIMENSION, so the Direct3D side can cast them across.
+enum DDS_DIMENSION
+{
+    DDS_DIMENSION_UNKNOWN   = 0,
+    DDS_DIMENSION_TEXTURE1D = 2,
+    DDS_DIMENSION_TEXTURE2D = 3,
+    DDS_DIMENSION_TEXTURE3D = 4,
+};
+
+// Why a file was turned down. DDSTextureLoader maps these back onto the HRESULTs it
+// has always returned.
+enum DDS_RESULT
+{
+    DDS_OK = 0,
+    DDS_BAD_HEADER,         // too short, wrong magic number or header sizes (E_FAIL)
+    DDS_INVALID_DATA,       // header fields contradict each other (ERROR_INVALID_DATA)
+    DDS_NOT_SUPPORTED,      // valid, but a format or size this loader doesn't take (ERROR_NOT_SUPPORTED)
+    DDS_TRUNCATED,          // the surfaces run past the end of the data (ERROR_HANDLE_EOF)
+};
+
+// What the headers say about the texture, after validation. cube maps have arraySize
+// counting faces, i.e. 6 per cube. bitData points into the buffer given to ReadDDSHeader.
+struct DDS_TEXTURE
+{
+    const DDS_HEADER*   header;
+    DDS_DIMENSION       dimension;
+    DXGI_FORMAT         format;
+    size_t              width;
+    size_t              height;
+    size_t              depth;
+    size_t              mipCount;
+    size_t              arraySize;
+    bool                isCubeMap;
+    const uint8_t*      bitData;
+    size_t              bitSize;
+};
+
+// One mip of one array slice. data points into the DDS buffer; rowPitch and slicePitch
+// are in bytes and rowCount counts rows of blocks for block compressed formats.
+struct DDS_SUBRESOURCE
+{
+    const uint8_t*  data;
+    size_t          width;
+    size_t          height;
+    size_t          depth;
+    size_t          rowPitch;
+    size_t          slicePitch;
+    size_t          rowCount;
+};
+
+// Bits per pixel of a format, or 0 for formats the loader doesn't handle.
+size_t DDSBitsPerPixel( DXGI_FORMAT fmt );
+
+// Bytes in one width x height surface of fmt, the bytes in a row and the number of rows.
+// Block compressed formats count rows of 4x4 blocks.
+void DDSSurfaceInfo( size_t width,
+                     size_t height,
+                     DXGI_FORMAT fmt,
+                     size_t* outNumBytes,
+                     size_t* outRowBytes,
+                     size_t* outNumRows );
+
+// Checks the magic number, headers and size limits of the DDS file in ddsData and fills
+// in texture. The buffer must outlive everything that points into it.
+DDS_RESULT ReadDDSHeader( const uint8_t* ddsData,
+                          size_t ddsDataSize,
+                          DDS_TEXTURE& texture );
+
+// Fills subresources, which needs room for mipCount * arraySize entries, in the order
+// Direct3D expects initial data: all mips of slice 0, then slice 1 and so on. Mips larger
+// than maxsize in any dimension are skipped (0 keeps them all) and counted in skipMip, so
+// (mipCount - skipMip) * arraySize entries are written.
+DDS_RESULT GetDDSSubresources( const DDS_TEXTURE& texture,
+                               size_t maxsize,
+                               DDS_SUBRESOURCE* subresources,
+                               size_t& skipMip );
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <string>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace DX
+{
+#ifdef _WIN32
+	inline std::wstring Utf8ToWide(const char* text)
+	{
+		int length = MultiByteToWideChar(CP_UTF8, 0, text, -1, nullptr, 0);
+		if (length <= 1)
+			return std::wstring();
+
+		std::wstring wide(length - 1, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, text, -1, &wide[0], length);
+		return wide;
+	}
+
+	inline std::string WideToUtf8(const wchar_t* text)
+	{
+		int length = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
+		if (length <= 1)
+			return std::string();
+
+		std::string narrow(length - 1, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, text, -1, &narrow[0], length, nullptr, nullptr);
+		return narrow;
+	}
+#endif
+
+	// Size and last write time of a file, used to tell whether data derived from it is stale.
+	// The time is in an unspecified platform unit and is only meant to be compared for equality.
+	inline bool GetFileStamp(const char* path, uint64_t& size, uint64_t& modified)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFile2(Utf8ToWide(path).c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, OPEN_EXISTING, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		FILE_BASIC_INFO basic;
+		FILE_STANDARD_INFO standard;
+		bool ok = GetFileInformationByHandleEx(file, FileBasicInfo, &basic, sizeof(basic)) &&
+			GetFileInformationByHandleEx(file, FileStandardInfo, &standard, sizeof(standard));
+		CloseHandle(file);
+
+		if (!ok)
+			return false;
+
+		size = uint64_t(standard.EndOfFile.QuadPart);
+		modified = uint64_t(basic.LastWriteTime.QuadPart);
+		return true;
+#else
+		struct stat info;
+		if (::stat(path, &info) != 0)
+			return false;
+
+		size = uint64_t(info.st_size);
+		modified = uint64_t(info.st_mtim.tv_sec) * 1000000000ull + uint64_t(info.st_mtim.tv_nsec);
+		return true;
+#endif
+	}
+
+	// Read-only view of a whole file mapped into the address space.
+	// The bytes stay valid until close() is called or the object is destroyed.
+	class MappedFile
+	{
+	public:
+		MappedFile() :
+			m_data(nullptr),
+			m_size(0),
+			m_open(false)
+#ifdef _WIN32
+			, m_file(INVALID_HANDLE_VALUE),
+			m_mapping(nullptr)
+#else
+			, m_fd(-1)
+#endif
+		{
+		}
+
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8_t* data() const		{ return m_data; }
+		size_t size() const				{ return m_size; }
+		bool isOpen() const				{ return m_open; }
+
+#ifdef _WIN32
+		bool open(const char* path)
+		{
+			// CreateFile2 only takes wide paths.
+			return open(Utf8ToWide(path).c_str());
+		}
+
+		bool open(const wchar_t* path)
+		{
+			close();
+
+			m_file = CreateFile2(path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER fileSize = { 0 };
+			if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart > SIZE_MAX)
+			{
+				close();
+				return false;
+			}
+
+			m_size = size_t(fileSize.QuadPart);
+			m_open = true;
+
+			// Zero length files can't be mapped, but they are still valid files.
+			if (m_size == 0)
+				return true;
+
+			m_mapping = CreateFileMappingFromApp(m_file, nullptr, PAGE_READONLY, 0, nullptr);
+			if (!m_mapping)
+			{
+				close();
+				return false;
+			}
+
+			m_data = static_cast<const uint8_t*>(MapViewOfFileFromApp(m_mapping, FILE_MAP_READ, 0, 0));
+			if (!m_data)
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void close()
+		{
+			if (m_data)
+				UnmapViewOfFile(m_data);
+			if (m_mapping)
+				CloseHandle(m_mapping);
+			if (m_file != INVALID_HANDLE_VALUE)
+				CloseHandle(m_file);
+
+			m_data = nullptr;
+			m_mapping = nullptr;
+			m_file = INVALID_HANDLE_VALUE;
+			m_size = 0;
+			m_open = false;
+		}
+#else
+		bool open(const char* path)
+		{
+			close();
+
+			m_fd = ::open(path, O_RDONLY);
+			if (m_fd < 0)
+				return false;
+
+			struct stat info;
+			if (fstat(m_fd, &info) != 0)
+			{
+				close();
+				return false;
+			}
+
+			m_size = size_t(info.st_size);
+			m_open = true;
+
+			if (m_size == 0)
+				return true;
+
+			void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+			if (view == MAP_FAILED)
+			{
+				close();
+				return false;
+			}
+
+			m_data = static_cast<const uint8_t*>(view);
+			return true;
+		}
+
+		void close()
+		{
+			if (m_data)
+				munmap(const_cast<uint8_t*>(m_data), m_size);
+			if (m_fd >= 0)
+				::close(m_fd);
+
+			m_data = nullptr;
+			m_fd = -1;
+			m_size = 0;
+			m_open = false;
+		}
+#endif
+
+	private:
+		const uint8_t*	m_data;
+		size_t			m_size;
+		bool			m_open;
+
+#ifdef _WIN32
+		HANDLE			m_file;
+		HANDLE			m_mapping;
+#else
+		int				m_fd;
+#endif
+	};
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#ifdef _WIN32
+#include <ppl.h>
+#else
+#include <vector>
+#endif
+
+namespace DX
+{
+	// Number of worker threads to use when the caller does not ask for a specific count.
+	inline unsigned int DefaultThreadCount()
+	{
+		unsigned int count = std::thread::hardware_concurrency();
+		return count ? count : 1;
+	}
+
+	// Calls body(i) for every i in [0, count) using up to threadCount threads, including the
+	// calling thread. Items are handed out one at a time, so uneven work still balances.
+	// Returns once every item has been processed. On Windows the workers run on the
+	// Concurrency Runtime's thread pool; elsewhere each call starts and joins its own threads.
+	template <typename Body>
+	void ParallelFor(size_t count, unsigned int threadCount, const Body& body)
+	{
+		if (threadCount <= 1 || count <= 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+				body(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				body(i);
+		};
+
+		size_t workers = threadCount < count ? threadCount : count;
+#ifdef _WIN32
+		concurrency::parallel_for(size_t(0), workers, [&](size_t)
+		{
+			worker();
+		});
+#else
+		std::vector<std::thread> threads;
+		for (size_t t = 1; t < workers; ++t)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (auto& thread : threads)
+			thread.join();
+#endif
+	}
+}
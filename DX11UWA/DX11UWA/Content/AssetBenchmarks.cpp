@@ -0,0 +1,704 @@
+#include "pch.h"
+#include <chrono>
+#include <filesystem>
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "AssetBenchmarks.h"
+#include "ModelLoader.h"
+#include "MeshOptimizer.h"
+#include "MipGenerator.h"
+#include "SceneAnimation.h"
+#include "TextureCooker.h"
+#include "TextureStreaming.h"
+// The tool counts every allocation so the results have real allocations_per_op without the
+// debug CRT.
+#ifdef ASSET_BENCHMARKS_MAIN
+#define DX_REPLACE_GLOBAL_NEW
+#endif
+#include "../Common/AllocationCounter.h"
+#include "../Common/DDSReader.h"
+#include "../Common/MappedFile.h"
+#include "../Common/ParallelFor.h"
+#if defined(__cplusplus_winrt)
+#include "../Common/StepTimer.h"
+#endif
+
+using namespace std;
+using namespace DirectX;
+
+typedef chrono::high_resolution_clock Clock;
+
+// Writes the results array one entry at a time, remembering whether a comma is due.
+struct BENCHMARKWRITER
+{
+	FILE * json;
+	bool first;
+
+	void begin()
+	{
+		fprintf(json, "{\n  \"suite\": \"assets\",\n  \"results\": [");
+		first = true;
+	}
+
+	void end()
+	{
+		fprintf(json, "\n  ]\n}\n");
+	}
+
+	// ns_per_op is always written; a negative megabytesPerSecond or allocation count is left out
+	// or written as null. extra, if given, is more "key": value pairs for the entry.
+	void result(const char * name, const char * input, unsigned int iterations, double nsPerOp, double megabytesPerSecond, long long allocations, const char * extra = nullptr)
+	{
+		string escaped;
+		for (const char * p = input; p && *p; ++p)
+		{
+			if (*p == '"' || *p == '\\')
+				escaped += '\\';
+			escaped += *p;
+		}
+
+		fprintf(json, "%s\n    { \"name\": \"%s\"", first ? "" : ",", name);
+		if (input)
+			fprintf(json, ", \"input\": \"%s\"", escaped.c_str());
+		fprintf(json, ", \"iterations\": %u, \"ns_per_op\": %.1f", iterations, nsPerOp);
+		if (megabytesPerSecond >= 0.0)
+			fprintf(json, ", \"mb_per_s\": %.2f", megabytesPerSecond);
+		if (allocations >= 0)
+			fprintf(json, ", \"allocations_per_op\": %lld", allocations / (long long)iterations);
+		else
+			fprintf(json, ", \"allocations_per_op\": null");
+		if (extra)
+			fprintf(json, ", %s", extra);
+		fprintf(json, " }");
+		first = false;
+
+		printf("%-20s %-28s %12.1f ns/op", name, input ? input : "", nsPerOp);
+		if (megabytesPerSecond >= 0.0)
+			printf(" %9.2f MB/s", megabytesPerSecond);
+		if (allocations >= 0)
+			printf(" %6lld allocs/op", allocations / (long long)iterations);
+		if (extra)
+			printf("\n    %s", extra);
+		printf("\n");
+	}
+};
+
+static double nanosecondsSince(Clock::time_point start, unsigned int iterations)
+{
+	return chrono::duration<double, nano>(Clock::now() - start).count() / iterations;
+}
+
+static bool isDDS(const char * path)
+{
+	const char * extension = strrchr(path, '.');
+	return extension && (strcmp(extension, ".dds") == 0 || strcmp(extension, ".DDS") == 0);
+}
+
+// Header validation and the subresource table, the CPU side of CreateDDSTextureFromFile.
+// The file is mapped once; nothing is copied, so this is per texture overhead, not bandwidth.
+static bool benchmarkDDS(BENCHMARKWRITER & writer, const char * path, unsigned int iterations)
+{
+	DX::MappedFile file;
+	DDS_TEXTURE texture;
+	if (!file.open(path) || ReadDDSHeader(file.data(), file.size(), texture) != DDS_OK)
+	{
+		printf("%s: failed to load\n", path);
+		return false;
+	}
+
+	vector<DDS_SUBRESOURCE> subresources(texture.mipCount * texture.arraySize);
+	size_t skipMip = 0;
+	DDS_RESULT result = DDS_OK;
+	long long allocations;
+	auto start = Clock::now();
+	{
+		DX::HeapAllocationCounter counter;
+		for (unsigned int n = 0; n < iterations && result == DDS_OK; ++n)
+		{
+			result = ReadDDSHeader(file.data(), file.size(), texture);
+			if (result == DDS_OK)
+				result = GetDDSSubresources(texture, 0, subresources.data(), skipMip);
+		}
+		allocations = counter.Count();
+	}
+	if (result != DDS_OK)
+	{
+		printf("%s: failed to load\n", path);
+		return false;
+	}
+	writer.result("dds_parse", path, iterations, nanosecondsSince(start, iterations), -1.0, allocations);
+	return true;
+}
+
+// Encoding the top mip of an uncompressed texture to each BC format on one thread, with the
+// PSNR of the decoded result. Block compressed and other inputs are skipped.
+static bool benchmarkBlockCompression(BENCHMARKWRITER & writer, const char * path, unsigned int iterations)
+{
+	static const DXGI_FORMAT formats[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC7_UNORM };
+	static const char * names[] = { "bc1_encode", "bc3_encode", "bc7_encode" };
+
+	DX::MappedFile file;
+	DDS_TEXTURE texture;
+	vector<RGBASURFACE> surfaces;
+	if (!file.open(path) || ReadDDSHeader(file.data(), file.size(), texture) != DDS_OK)
+		return false;
+	if (DDSBitsPerPixel(texture.format) != 32 || !ReadRGBASurfaces(texture, surfaces))
+		return true;
+
+	const RGBASURFACE &surface = surfaces[0];
+	size_t pitch = surface.width * 4;
+	vector<uint8_t> blocks, decoded(surface.texels.size());
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+	{
+		size_t bytes = 0, blockPitch = 0;
+		DDSSurfaceInfo(surface.width, surface.height, formats[f], &bytes, &blockPitch, nullptr);
+		blocks.resize(bytes);
+
+		long long allocations;
+		auto start = Clock::now();
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < iterations; ++n)
+				EncodeBCSurface(formats[f], blocks.data(), blockPitch, surface.texels.data(), surface.width, surface.height, pitch, 1);
+			allocations = counter.Count();
+		}
+		double ns = nanosecondsSince(start, iterations);
+
+		DecodeBCSurface(formats[f], DXGI_FORMAT_R8G8B8A8_UNORM, decoded.data(), pitch, blocks.data(), blockPitch, surface.width, surface.height, 1);
+		SURFACEERROR error;
+		memset(&error, 0, sizeof(error));
+		AddSurfaceError(error, surface.texels.data(), pitch, decoded.data(), pitch, surface.width, surface.height);
+
+		char extra[160];
+		snprintf(extra, sizeof(extra), "\"megapixels_per_s\": %.2f, \"rgb_psnr_db\": %.2f, \"alpha_psnr_db\": %.2f",
+			double(surface.width * surface.height) * 1e3 / ns, SurfacePSNR(error, 0, 3), SurfacePSNR(error, 3, 1));
+		writer.result(names[f], path, iterations, ns, surface.texels.size() / (1024.0 * 1024.0) * 1e9 / ns, allocations, extra);
+	}
+	return true;
+}
+
+// Writes a GRID_SIZE x GRID_SIZE patch of v/vt/vn quads, about 13 MB, to the temp folder.
+static bool writeGridObj(const string &path)
+{
+	static const unsigned int GRID_SIZE = 300;
+	FILE * file = fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	for (unsigned int row = 0; row <= GRID_SIZE; ++row)
+	{
+		for (unsigned int column = 0; column <= GRID_SIZE; ++column)
+		{
+			float height = 5.0f * sinf(column * 0.05f) * cosf(row * 0.07f);
+			fprintf(file, "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n", float(column), height, float(row),
+				float(column) / GRID_SIZE, float(row) / GRID_SIZE, 0.0f, 1.0f, 0.0f);
+		}
+	}
+	for (unsigned int row = 0; row < GRID_SIZE; ++row)
+	{
+		for (unsigned int column = 0; column < GRID_SIZE; ++column)
+		{
+			unsigned int a = row * (GRID_SIZE + 1) + column + 1, b = a + 1, c = a + GRID_SIZE + 1, d = c + 1;
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, d, d, d, b, b, b);
+		}
+	}
+	return fclose(file) == 0;
+}
+
+static bool benchmarkParseScaling(BENCHMARKWRITER & writer, unsigned int iterations)
+{
+	static const unsigned int threadCounts[] = { 1, 2, 4, 8, 16 };
+
+	error_code error;
+	string path = (filesystem::temp_directory_path(error) / "asset_benchmarks_grid.obj").string();
+	if (error || !writeGridObj(path))
+	{
+		printf("%s: could not be written\n", path.c_str());
+		return false;
+	}
+
+	bool ok = true;
+	double singleNs = 0.0;
+	for (unsigned int threads : threadCounts)
+	{
+		ModelLoader loader;
+		loader.setThreadCount(threads);
+		vector<VERTEX> verts;
+		vector<unsigned int> indices;
+		if (!loader.loadModel(path.c_str(), verts, indices))
+		{
+			printf("%s: failed to load\n", path.c_str());
+			ok = false;
+			break;
+		}
+		double megabytes = loader.getStats().fileBytes / (1024.0 * 1024.0);
+
+		long long allocations;
+		auto start = Clock::now();
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < iterations; ++n)
+			{
+				verts.clear();
+				indices.clear();
+				loader.loadModel(path.c_str(), verts, indices);
+			}
+			allocations = counter.Count();
+		}
+		double ns = nanosecondsSince(start, iterations);
+		if (threads == 1)
+			singleNs = ns;
+
+		char input[32], extra[64];
+		snprintf(input, sizeof(input), "%.0f MB grid", megabytes);
+		snprintf(extra, sizeof(extra), "\"threads\": %u, \"speedup\": %.2f", threads, singleNs / ns);
+		writer.result("obj_parse_threads", input, iterations, ns, megabytes * 1e9 / ns, allocations, extra);
+	}
+
+	filesystem::remove(path, error);
+	return ok;
+}
+
+bool RunAssetBenchmarks(const char * const * paths, size_t pathCount, unsigned int iterations, FILE * json)
+{
+	if (iterations == 0)
+		iterations = 1;
+
+	BENCHMARKWRITER writer = { json, true };
+	writer.begin();
+	bool ok = true;
+
+	for (size_t i = 0; i < pathCount; ++i)
+	{
+		if (isDDS(paths[i]))
+		{
+			ok = benchmarkDDS(writer, paths[i], iterations) && ok;
+			ok = benchmarkBlockCompression(writer, paths[i], iterations) && ok;
+			continue;
+		}
+
+		ModelLoader loader;
+		loader.setThreadCount(1);
+		vector<VERTEX> verts;
+		vector<unsigned int> indices;
+
+		// One untimed load warms the file cache and the loader's scratch arrays.
+		if (!loader.loadModel(paths[i], verts, indices))
+		{
+			printf("%s: failed to load\n", paths[i]);
+			ok = false;
+			continue;
+		}
+		double megabytes = loader.getStats().fileBytes / (1024.0 * 1024.0);
+
+		double weldSeconds = 0.0;
+		long long allocations;
+		auto start = Clock::now();
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < iterations; ++n)
+			{
+				verts.clear();
+				indices.clear();
+				loader.loadModel(paths[i], verts, indices);
+				weldSeconds += loader.getStats().weldSeconds;
+			}
+			allocations = counter.Count();
+		}
+		double parseNs = nanosecondsSince(start, iterations);
+		writer.result("obj_parse", paths[i], iterations, parseNs, megabytes * 1e9 / parseNs, allocations);
+		writer.result("vertex_weld", paths[i], iterations, weldSeconds * 1e9 / iterations, -1.0, -1);
+
+		MESHARENA probe(nullptr, 0);
+		ARENAMESH mesh;
+		loader.loadModelArena(paths[i], probe, mesh);
+		vector<char> memory(loader.getStats().arenaBytes);
+		MESHARENA arena(memory.data(), memory.size());
+
+		start = Clock::now();
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < iterations; ++n)
+			{
+				arena.reset();
+				loader.loadModelArena(paths[i], arena, mesh);
+			}
+			allocations = counter.Count();
+		}
+		double arenaNs = nanosecondsSince(start, iterations);
+		writer.result("obj_parse_arena", paths[i], iterations, arenaNs, megabytes * 1e9 / arenaNs, allocations);
+
+		// The loadMesh passes run on a cache miss, without the cache, and what they achieved.
+		unsigned int processIterations = min(iterations, 5u);
+		loader.setProcessing(MESHPROCESS_VERTEXCACHE | MESHPROCESS_OVERDRAW | MESHPROCESS_QUANTIZE | MESHPROCESS_LOD | MESHPROCESS_MESHLETS);
+		MESHDATA processed;
+		start = Clock::now();
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < processIterations; ++n)
+				loader.processModel(paths[i], processed);
+			allocations = counter.Count();
+		}
+		double processNs = nanosecondsSince(start, processIterations);
+		const LOADERSTATS &stats = loader.getStats();
+		char extra[768];
+		snprintf(extra, sizeof(extra), "\"acmr_before\": %.3f, \"acmr_after\": %.3f, \"atvr_before\": %.3f, \"atvr_after\": %.3f, "
+			"\"overdraw_before\": %.3f, \"overdraw_after\": %.3f, \"position_error\": %g, \"uv_error\": %g, \"normal_error_deg\": %.3f",
+			stats.acmrBefore, stats.acmrAfter, stats.atvrBefore, stats.atvrAfter, stats.overdrawBefore, stats.overdrawAfter,
+			stats.positionError, stats.uvError, stats.normalError);
+		string lodTriangles, lodErrors;
+		for (unsigned int level = 0; level < processed.lodCount; ++level)
+		{
+			char number[32];
+			snprintf(number, sizeof(number), "%s%u", level ? ", " : "", processed.lods[level].indexCount / 3);
+			lodTriangles += number;
+			snprintf(number, sizeof(number), "%s%g", level ? ", " : "", processed.lods[level].error);
+			lodErrors += number;
+		}
+		size_t used = strlen(extra);
+		snprintf(extra + used, sizeof(extra) - used, ", \"lod_triangles\": [%s], \"lod_errors\": [%s], \"meshlets\": %u, \"triangles_per_meshlet\": %.1f, "
+			"\"subsets\": %u, \"copied_vertices\": %u, \"submeshes\": %u, \"materials\": %u",
+			lodTriangles.c_str(), lodErrors.c_str(), processed.meshletCount,
+			processed.meshletCount ? double(processed.lods[0].indexCount / 3) / processed.meshletCount : 0.0,
+			processed.subsetCount, stats.copiedVertexCount, processed.submeshCount, processed.materialCount);
+		writer.result("mesh_process", paths[i], processIterations, processNs, megabytes * 1e9 / processNs, allocations, extra);
+	}
+
+	// loadModel on 1 to 16 threads, on a generated OBJ of several MB so the threads have enough
+	// to split. The shipped meshes are too small to show how parsing scales.
+	ok = benchmarkParseScaling(writer, iterations) && ok;
+
+	// GenerateNormals on a rolling height field of about a million triangles, the size the
+	// kernel is meant to handle well under a second.
+	{
+		static const unsigned int GRID_SIZE = 708;
+		size_t positionCount = (GRID_SIZE + 1) * (GRID_SIZE + 1);
+		vector<float> x(positionCount), y(positionCount), z(positionCount);
+		for (unsigned int row = 0; row <= GRID_SIZE; ++row)
+		{
+			for (unsigned int column = 0; column <= GRID_SIZE; ++column)
+			{
+				size_t p = row * (GRID_SIZE + 1) + column;
+				x[p] = float(column);
+				y[p] = 5.0f * sinf(column * 0.05f) * cosf(row * 0.07f);
+				z[p] = float(row);
+			}
+		}
+
+		vector<unsigned int> cornerPositions;
+		cornerPositions.reserve(GRID_SIZE * GRID_SIZE * 6);
+		for (unsigned int row = 0; row < GRID_SIZE; ++row)
+		{
+			for (unsigned int column = 0; column < GRID_SIZE; ++column)
+			{
+				unsigned int a = row * (GRID_SIZE + 1) + column, b = a + 1, c = a + GRID_SIZE + 1, d = c + 1;
+				unsigned int quad[6] = { a, c, b, b, c, d };
+				cornerPositions.insert(cornerPositions.end(), quad, quad + 6);
+			}
+		}
+
+		vector<XMFLOAT3> normals(cornerPositions.size());
+		vector<unsigned int> shared(cornerPositions.size());
+		long long allocations;
+		auto start = Clock::now();
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < iterations; ++n)
+			{
+				GenerateNormals(normals.data(), shared.data(), cornerPositions.data(), cornerPositions.size(),
+					x.data(), y.data(), z.data(), positionCount, XMConvertToRadians(ModelLoader::DEFAULT_CREASE_ANGLE));
+			}
+			allocations = counter.Count();
+		}
+		writer.result("normal_generation", "1M triangle grid", iterations, nanosecondsSince(start, iterations), -1.0, allocations);
+	}
+
+	// DecodeBCSurface on a 1024x1024 surface of random blocks of each BC format, to RGBA8 and to
+	// RGBA16F, on one thread and then BC7 again on every core. BC6H and BC7 blocks get their mode
+	// bits set so every mode shows up equally often, not just the ones with short mode fields.
+	{
+		static const size_t SIZE = 1024, BLOCKS = (SIZE / 4) * (SIZE / 4);
+		static const DXGI_FORMAT formats[] =
+		{
+			DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC2_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC4_UNORM,
+			DXGI_FORMAT_BC5_SNORM, DXGI_FORMAT_BC6H_UF16, DXGI_FORMAT_BC7_UNORM,
+		};
+		static const char * names[] = { "bc1", "bc2", "bc3", "bc4", "bc5", "bc6h", "bc7" };
+		// BC6H mode fields of its 14 modes: 2 bits for the first two, 5 for the others.
+		static const uint8_t bc6hModes[14] = { 0x00, 0x01, 0x02, 0x06, 0x0a, 0x0e, 0x12, 0x16, 0x1a, 0x1e, 0x03, 0x07, 0x0b, 0x0f };
+
+		vector<uint8_t> blocks(BLOCKS * 16), texels(SIZE * SIZE * 8);
+		for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+		{
+			size_t blockBytes = 0, blockPitch = 0;
+			DDSSurfaceInfo(SIZE, SIZE, formats[f], &blockBytes, &blockPitch, nullptr);
+			uint32_t random = 0x9e3779b9u;
+			for (size_t i = 0; i < blockBytes; ++i)
+			{
+				random ^= random << 13;
+				random ^= random >> 17;
+				random ^= random << 5;
+				blocks[i] = uint8_t(random);
+			}
+			for (size_t b = 0; b < BLOCKS && formats[f] == DXGI_FORMAT_BC7_UNORM; ++b)
+			{
+				unsigned int mode = unsigned(b % 8);
+				blocks[b * 16] = uint8_t((blocks[b * 16] & ~((2u << mode) - 1)) | (1u << mode));
+			}
+			for (size_t b = 0; b < BLOCKS && formats[f] == DXGI_FORMAT_BC6H_UF16; ++b)
+			{
+				uint8_t mode = bc6hModes[b % 14];
+				uint8_t mask = mode < 2 ? 0x03 : 0x1f;
+				blocks[b * 16] = uint8_t((blocks[b * 16] & ~mask) | mode);
+			}
+
+			for (unsigned int half = 0; half < 2; ++half)
+			{
+				DXGI_FORMAT output = half ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM;
+				size_t pitch = SIZE * (half ? 8 : 4);
+				unsigned int threadCounts[2] = { 1, DX::DefaultThreadCount() };
+				for (unsigned int t = 0; t < (formats[f] == DXGI_FORMAT_BC7_UNORM && !half ? 2u : 1u); ++t)
+				{
+					long long allocations;
+					auto start = Clock::now();
+					{
+						DX::HeapAllocationCounter counter;
+						for (unsigned int n = 0; n < iterations; ++n)
+							DecodeBCSurface(formats[f], output, texels.data(), pitch, blocks.data(), blockPitch, SIZE, SIZE, threadCounts[t]);
+						allocations = t == 0 ? counter.Count() : -1;
+					}
+					double ns = nanosecondsSince(start, iterations);
+
+					char name[48], extra[96];
+					snprintf(name, sizeof(name), "%s_decode_%s%s", names[f], half ? "rgba16f" : "rgba8", t ? "_threads" : "");
+					snprintf(extra, sizeof(extra), "\"megapixels_per_s\": %.1f, \"threads\": %u", double(SIZE * SIZE) * 1e3 / ns, threadCounts[t]);
+					writer.result(name, "1024x1024 random blocks", iterations, ns, -1.0, allocations, extra);
+				}
+			}
+		}
+	}
+
+	// GenerateMips on a 4096x4096 sRGB texture, a full chain of 13 mips with each filter on every
+	// core, box again on one thread and Kaiser again keeping the alpha test coverage. The texture
+	// is noisy color with a cutout alpha, so coverage has something to keep. Mip chains this big
+	// take a while, so this runs at most 3 iterations.
+	{
+		static const size_t SIZE = 4096;
+		static const struct { const char * name; MIPFILTER filter; float alphaReference; bool oneThread; } cases[] =
+		{
+			{ "mip_generation_box", MIP_FILTER_BOX, 0.0f, false },
+			{ "mip_generation_box_1_thread", MIP_FILTER_BOX, 0.0f, true },
+			{ "mip_generation_kaiser", MIP_FILTER_KAISER, 0.0f, false },
+			{ "mip_generation_lanczos", MIP_FILTER_LANCZOS, 0.0f, false },
+			{ "mip_generation_kaiser_coverage", MIP_FILTER_KAISER, 1.0f, false },
+		};
+
+		vector<RGBASURFACE> mips(1);
+		mips[0].width = mips[0].height = SIZE;
+		mips[0].format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		mips[0].texels.resize(SIZE * SIZE * 4);
+		uint32_t random = 0x9e3779b9u;
+		for (size_t y = 0; y < SIZE; ++y)
+		{
+			for (size_t x = 0; x < SIZE; ++x)
+			{
+				random ^= random << 13;
+				random ^= random >> 17;
+				random ^= random << 5;
+				uint8_t * texel = &mips[0].texels[(y * SIZE + x) * 4];
+				texel[0] = uint8_t(x * 255 / SIZE) ^ uint8_t(random & 0x1f);
+				texel[1] = uint8_t(y * 255 / SIZE) ^ uint8_t((random >> 8) & 0x1f);
+				texel[2] = uint8_t(random >> 16);
+				texel[3] = ((x / 37 + y / 23) % 3) ? 255 : uint8_t(random >> 24) & 0x7f;
+			}
+		}
+
+		size_t mipCount = MipCount(SIZE, SIZE);
+		unsigned int mipIterations = min(iterations, 3u);
+		for (const auto &test : cases)
+		{
+			MIPOPTIONS options = { test.filter, true, true, test.alphaReference };
+			unsigned int threadCount = test.oneThread ? 1 : DX::DefaultThreadCount();
+			long long allocations;
+			auto start = Clock::now();
+			{
+				DX::HeapAllocationCounter counter;
+				for (unsigned int n = 0; n < mipIterations; ++n)
+				{
+					mips.resize(1);
+					GenerateMips(mips, mipCount, options, threadCount);
+				}
+				allocations = counter.Count();
+			}
+			double ns = nanosecondsSince(start, mipIterations);
+
+			char extra[96];
+			snprintf(extra, sizeof(extra), "\"megapixels_per_s\": %.1f, \"mips\": %zu, \"threads\": %u", double(SIZE * SIZE) * 1e3 / ns, mips.size(), threadCount);
+			writer.result(test.name, "4096x4096 sRGB noise", mipIterations, ns, mips[0].texels.size() / (1024.0 * 1024.0) * 1e9 / ns, allocations, extra);
+		}
+	}
+
+	// TextureStreamer flying over a field of objects that each have their own 2048x2048 BC1
+	// texture, about 170 MB at full resolution, against a 4 MB budget that the low parts of the
+	// path want more than. An iteration is one trip along the path; the results say how well
+	// the budget held and what was streamed.
+	{
+		static const unsigned int GRID_SIZE = 8, FRAMES_PER_ITERATION = 1200;
+		static const float SPACING = 12.0f;
+		static const size_t BUDGET = 4 * 1024 * 1024;
+
+		DDS_TEXTURE dds;
+		memset(&dds, 0, sizeof(dds));
+		dds.dimension = DDS_DIMENSION_TEXTURE2D;
+		dds.format = DXGI_FORMAT_BC1_UNORM;
+		dds.width = dds.height = 2048;
+		dds.depth = dds.arraySize = 1;
+		dds.mipCount = 12;
+
+		TextureStreamer streamer(BUDGET, TextureStreamer::DEFAULT_BYTES_PER_UPDATE);
+		vector<STREAMUSE> uses;
+		for (unsigned int row = 0; row < GRID_SIZE; ++row)
+		{
+			for (unsigned int column = 0; column < GRID_SIZE; ++column)
+			{
+				STREAMUSE use = { streamer.addTexture(dds, 64), XMFLOAT3(column * SPACING, 0.0f, row * SPACING), 5.0f, 4.0f };
+				uses.push_back(use);
+			}
+		}
+
+		float fovY = 70.0f * XM_PI / 180.0f;
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(fovY, 16.0f / 9.0f, 0.01f, 100.0f);
+		STREAMVIEW view;
+		view.pixelsPerUnit = 1080.0f / (2.0f * tanf(fovY * 0.5f));
+
+		// The camera loops around the field, dipping low over it and climbing away again.
+		unsigned int frames = iterations * FRAMES_PER_ITERATION, overBudget = 0;
+		size_t streamed = 0, peakStreamed = 0, peakResident = 0, missingMips = 0;
+		float middle = (GRID_SIZE - 1) * SPACING * 0.5f;
+		double updateSeconds = 0.0;
+		long long allocations;
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < frames; ++n)
+			{
+				float angle = XM_2PI * (n % FRAMES_PER_ITERATION) / FRAMES_PER_ITERATION;
+				float reach = middle * (0.6f + 0.5f * sinf(angle * 3.0f));
+				view.eye = XMFLOAT3(middle + reach * cosf(angle), 1.5f + 6.0f * (0.5f + 0.5f * cosf(angle * 2.0f)), middle + reach * sinf(angle));
+				XMVECTOR eye = XMLoadFloat3(&view.eye);
+				XMMATRIX camera = XMMatrixLookAtLH(eye, XMVectorSet(middle + reach * cosf(angle + 0.6f), 0.0f, middle + reach * sinf(angle + 0.6f), 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+				XMFLOAT4X4 viewProjection;
+				XMStoreFloat4x4(&viewProjection, camera * projection);
+				ComputeFrustum(view.frustum, viewProjection);
+
+				STREAMSTATS stats;
+				auto start = Clock::now();
+				streamer.update(view, uses.data(), uses.size(), &stats);
+				updateSeconds += chrono::duration<double>(Clock::now() - start).count();
+
+				streamed += stats.loadedBytes;
+				peakStreamed = max(peakStreamed, stats.loadedBytes);
+				peakResident = max(peakResident, stats.residentBytes);
+				missingMips += stats.missingMips;
+				overBudget += stats.overBudget ? 1 : 0;
+			}
+			allocations = counter.Count();
+		}
+
+		char extra[256];
+		snprintf(extra, sizeof(extra), "\"budget_mb\": %.1f, \"peak_resident_mb\": %.2f, \"frames_over_budget\": %u, "
+			"\"streamed_mb_per_frame\": %.3f, \"peak_streamed_mb\": %.2f, \"missing_mips_per_frame\": %.2f",
+			BUDGET / 1048576.0, peakResident / 1048576.0, overBudget, streamed / 1048576.0 / frames, peakStreamed / 1048576.0, double(missingMips) / frames);
+		writer.result("texture_streaming", "64 textures, 4 MB budget", frames, updateSeconds * 1e9 / frames, -1.0, allocations, extra);
+	}
+
+	// Update's transform and light math, many times per iteration since one frame is tiny.
+	{
+		static const unsigned int FRAMES_PER_ITERATION = 1000;
+		unsigned int frames = iterations * FRAMES_PER_ITERATION;
+
+		DX11UWA::ModelViewProjectionConstantBuffer scene, tree, waterTower, skyBox;
+		DX11UWA::ModelViewProjectionConstantBufferInstanced instances;
+		DX11UWA::LightProperties lights;
+		LIGHTANIMATION animation;
+		memset(&lights, 0, sizeof(lights));
+		XMStoreFloat4x4(&scene.model, XMMatrixIdentity());
+		XMStoreFloat4x4(&scene.view, XMMatrixTranspose(XMMatrixLookAtLH(XMVectorSet(5.0f, 10.0f, -12.0f, 0.0f), XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f))));
+		XMStoreFloat4x4(&scene.projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(70.0f * XM_PI / 180.0f, 16.0f / 9.0f, 0.01f, 100.0f)));
+		XMFLOAT4X4 camera;
+		XMStoreFloat4x4(&camera, XMMatrixTranslation(5.0f, 10.0f, -12.0f));
+
+		long long allocations;
+		auto start = Clock::now();
+		{
+			DX::HeapAllocationCounter counter;
+			for (unsigned int n = 0; n < frames; ++n)
+			{
+				UpdateModelTransforms(scene, camera, tree, waterTower, skyBox, instances);
+				AnimateLights(animation, camera, lights);
+			}
+			allocations = counter.Count();
+		}
+		double frameNs = nanosecondsSince(start, frames);
+		// Keep the results alive so the loop isn't optimized away.
+		volatile float sink = lights.Lights[1].Position.x + tree.model._14 + skyBox.model._24;
+		(void)sink;
+		writer.result("scene_update", nullptr, frames, frameNs, -1.0, allocations);
+	}
+
+#if defined(__cplusplus_winrt)
+	// StepTimer::Tick, the other per frame cost that isn't rendering. Only builds in the app.
+	{
+		unsigned int ticks = iterations * 1000;
+		DX::StepTimer timer;
+		auto start = Clock::now();
+		for (unsigned int n = 0; n < ticks; ++n)
+			timer.Tick([]() {});
+		writer.result("step_timer_tick", nullptr, ticks, nanosecondsSince(start, ticks), -1.0, -1);
+	}
+#endif
+
+	writer.end();
+	return ok;
+}
+
+#ifdef ASSET_BENCHMARKS_MAIN
+// AssetBenchmarks [-n iterations] [-o results.json] [file.obj | file.dds ...]
+// Run from the app folder to use the shipped meshes when no files are given.
+int main(int argc, char ** argv)
+{
+	static const char * defaultPaths[] =
+	{
+		"Assets/Alientree.obj", "Assets/WaterTower.obj", "Assets/SkyboxCube.obj", "Assets/FloorPlane.obj",
+		"Assets/grass_seamless.dds"
+	};
+
+	unsigned int iterations = 20;
+	const char * output = "asset_benchmarks.json";
+	vector<const char *> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else
+			paths.push_back(argv[i]);
+	}
+	if (paths.empty())
+		paths.assign(defaultPaths, defaultPaths + sizeof(defaultPaths) / sizeof(defaultPaths[0]));
+
+	FILE * json = fopen(output, "w");
+	if (!json)
+	{
+		printf("Could not write %s\n", output);
+		return 1;
+	}
+
+	DX::EnableHeapAllocationCount();
+	bool ok = RunAssetBenchmarks(paths.data(), paths.size(), iterations, json);
+	fclose(json);
+	return ok ? 0 : 1;
+}
+#endif
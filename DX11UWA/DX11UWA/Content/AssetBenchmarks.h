@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Microbenchmarks for the parts of the app that don't need a device: OBJ parsing (vector and
+// arena paths, and on 1 to 16 threads for a generated mesh), vertex welding, the loadMesh
+// processing passes, normal generation, DDS header parsing and BC1/BC3/BC7 encoding of
+// uncompressed ones (paths ending in .dds), decoding every BC format, mip generation for a
+// 4096x4096 texture, texture streaming decisions along a simulated camera path and the per
+// frame scene math of Sample3DSceneRenderer::Update.
+// A summary line per result goes to stdout and the full results to json as one object:
+//
+//   { "suite": "assets", "results": [ { "name": "obj_parse", "input": "Assets/WaterTower.obj",
+//     "iterations": 20, "ns_per_op": 612345.0, "mb_per_s": 301.2, "allocations_per_op": 85 }, ... ] }
+//
+// allocations_per_op is null where heap allocations can't be counted, see AllocationCounter.h.
+// Returns false if any file failed to load.
+//
+// The suite also builds as its own program, AssetBenchmarks.cpp with ASSET_BENCHMARKS_MAIN
+// defined, on Windows or Linux: see the CMakeLists.txt at the top of the repository.
+bool RunAssetBenchmarks(const char * const * paths, size_t pathCount, unsigned int iterations, FILE * json);
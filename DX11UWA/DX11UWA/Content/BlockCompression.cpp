@@ -0,0 +1,1633 @@
+#include "pch.h"
+#include "BlockCompression.h"
+#include "../Common/ParallelFor.h"
+#include <algorithm>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Blocks per surface below which EncodeBCSurface and DecodeBCSurface don't bother with threads.
+static const size_t BLOCK_THREAD_THRESHOLD = 1024;
+
+// Texels of a BC7 two subset partition that belong to subset 1, one bit per texel.
+static const uint16_t BC7_PARTITIONS2[64] =
+{
+	0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+	0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+	0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+	0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+	0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+	0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+	0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+	0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+};
+
+// Subset of every texel of a three subset partition, two bits per texel.
+static const uint32_t BC7_PARTITIONS3[64] =
+{
+	0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+	0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+	0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+	0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+	0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+	0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+	0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+	0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+};
+
+// Anchor texels, whose index is stored with one bit less, of subset 1 of the two subset
+// partitions and of subsets 1 and 2 of the three subset ones. Subset 0's is always texel 0.
+static const uint8_t BC7_ANCHORS2[64] =
+{
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+static const uint8_t BC7_ANCHORS3[2][64] =
+{
+	{
+		 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+		 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+		 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+		 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+	},
+	{
+		15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+		15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+		15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+		15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+	},
+};
+
+// Interpolation weights out of 64 for 2, 3 and 4 bit BC7 indices.
+static const unsigned int BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+static const unsigned int BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const unsigned int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const unsigned int * bc7Weights(unsigned int indexBits)
+{
+	return indexBits == 2 ? BC7_WEIGHTS2 : indexBits == 3 ? BC7_WEIGHTS3 : BC7_WEIGHTS4;
+}
+
+static inline unsigned int bc7Interpolate(unsigned int end0, unsigned int end1, unsigned int weight)
+{
+	return ((64 - weight) * end0 + weight * end1 + 32) >> 6;
+}
+
+// What each BC7 mode stores, in the order the fields follow the mode bits.
+struct BC7MODE
+{
+	unsigned int subsets;
+	unsigned int partitionBits;
+	unsigned int rotationBits;
+	unsigned int indexSelectionBits;
+	unsigned int colorBits;
+	unsigned int alphaBits;			// 0: alpha is 255
+	unsigned int endPBits;			// a p-bit per end
+	unsigned int sharedPBits;		// a p-bit per subset
+	unsigned int indexBits;
+	unsigned int secondaryIndexBits;
+};
+
+static const BC7MODE BC7_MODES[8] =
+{
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// Fields packed from bit 0 of the block up, the order BC7 stores them in.
+struct BITWRITER
+{
+	uint64_t bits[2];
+	unsigned int position;
+
+	void write(unsigned int value, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; ++i, ++position)
+			bits[position >> 6] |= uint64_t((value >> i) & 1) << (position & 63);
+	}
+
+	void store(uint8_t block[16]) const
+	{
+		for (unsigned int i = 0; i < 16; ++i)
+			block[i] = uint8_t(bits[i >> 3] >> ((i & 7) * 8));
+	}
+};
+
+// Reads fields of up to 32 bits out of the two halves of the block at once.
+struct BITREADER
+{
+	uint64_t bits[2];
+	unsigned int position;
+
+	explicit BITREADER(const uint8_t block[16]) : position(0)
+	{
+		bits[0] = bits[1] = 0;
+		for (unsigned int i = 0; i < 16; ++i)
+			bits[i >> 3] |= uint64_t(block[i]) << ((i & 7) * 8);
+	}
+
+	unsigned int read(unsigned int count)
+	{
+		if (count == 0)
+			return 0;
+
+		unsigned int shift = position & 63;
+		uint64_t value = bits[position >> 6] >> shift;
+		if (shift + count > 64 && position < 64)
+			value |= bits[1] << (64 - shift);
+		position += count;
+		return unsigned(value & ((uint64_t(1) << count) - 1));
+	}
+};
+
+// Widens a bits wide value to 8 bits by repeating its top bits, like the hardware does.
+static inline unsigned int expandBits(unsigned int value, unsigned int bits)
+{
+	return bits >= 8 ? value : (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+static inline unsigned int quantizeBits(float value, unsigned int bits)
+{
+	float top = float((1u << bits) - 1);
+	return unsigned(min(max(value * top / 255.0f + 0.5f, 0.0f), top));
+}
+
+// A block as floats 0..255, per texel for the line fitting and as four vectors per channel for
+// the palette searches: channel[c][q] holds channel c of texels 4q..4q+3.
+struct BLOCK
+{
+	XMVECTOR channel[4][4];
+	float texels[16][4];
+};
+
+static void loadBlock(BLOCK &block, const uint8_t texels[64])
+{
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		for (unsigned int c = 0; c < 4; ++c)
+			block.texels[t][c] = float(texels[t * 4 + c]);
+	}
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		for (unsigned int q = 0; q < 4; ++q)
+			block.channel[c][q] = XMVectorSet(block.texels[q * 4][c], block.texels[q * 4 + 1][c], block.texels[q * 4 + 2][c], block.texels[q * 4 + 3][c]);
+	}
+}
+
+// Picks the nearest of count palette entries for every texel in mask, comparing channelCount
+// channels from firstChannel, four texels at a time. Returns the summed squared error.
+static float fitPalette(const BLOCK &block, unsigned int mask, const float (*palette)[4], unsigned int count, unsigned int firstChannel, unsigned int channelCount, uint8_t indices[16])
+{
+	float total = 0.0f;
+	for (unsigned int q = 0; q < 4; ++q)
+	{
+		unsigned int lanes = (mask >> (q * 4)) & 0xf;
+		if (!lanes)
+			continue;
+
+		XMVECTOR best = XMVectorReplicate(FLT_MAX);
+		XMVECTOR bestIndex = XMVectorZero();
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			XMVECTOR error = XMVectorZero();
+			for (unsigned int c = firstChannel; c < firstChannel + channelCount; ++c)
+			{
+				XMVECTOR difference = XMVectorSubtract(block.channel[c][q], XMVectorReplicate(palette[i][c]));
+				error = XMVectorMultiplyAdd(difference, difference, error);
+			}
+			XMVECTOR closer = XMVectorLess(error, best);
+			best = XMVectorSelect(best, error, closer);
+			bestIndex = XMVectorSelect(bestIndex, XMVectorReplicate(float(i)), closer);
+		}
+
+		float error[4], index[4];
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(error), best);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(index), bestIndex);
+		for (unsigned int l = 0; l < 4; ++l)
+		{
+			if (lanes & (1u << l))
+			{
+				indices[q * 4 + l] = uint8_t(index[l]);
+				total += error[l];
+			}
+		}
+	}
+	return total;
+}
+
+// The line through the texels in mask along which they spread the most, over channelCount
+// channels from firstChannel, cut off where the furthest texels project onto it. The direction
+// comes from power iteration on the covariance; a single color gives two equal ends.
+static void fitLine(const BLOCK &block, unsigned int mask, unsigned int firstChannel, unsigned int channelCount, float ends[2][4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float count = 0.0f;
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		if (!(mask & (1u << t)))
+			continue;
+		for (unsigned int c = 0; c < channelCount; ++c)
+			mean[c] += block.texels[t][firstChannel + c];
+		count += 1.0f;
+	}
+	for (unsigned int c = 0; c < channelCount; ++c)
+	{
+		mean[c] = count > 0.0f ? mean[c] / count : 0.0f;
+		ends[0][firstChannel + c] = ends[1][firstChannel + c] = mean[c];
+	}
+	if (count == 0.0f)
+		return;
+
+	float covariance[4][4] = {};
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		if (!(mask & (1u << t)))
+			continue;
+		for (unsigned int i = 0; i < channelCount; ++i)
+		{
+			float di = block.texels[t][firstChannel + i] - mean[i];
+			for (unsigned int j = i; j < channelCount; ++j)
+				covariance[i][j] += di * (block.texels[t][firstChannel + j] - mean[j]);
+		}
+	}
+	unsigned int widest = 0;
+	for (unsigned int i = 0; i < channelCount; ++i)
+	{
+		for (unsigned int j = 0; j < i; ++j)
+			covariance[i][j] = covariance[j][i];
+		if (covariance[i][i] > covariance[widest][widest])
+			widest = i;
+	}
+	if (covariance[widest][widest] <= 0.0f)
+		return;
+
+	float axis[4];
+	for (unsigned int i = 0; i < 4; ++i)
+		axis[i] = i < channelCount ? covariance[widest][i] : 0.0f;
+	for (unsigned int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float largest = 0.0f;
+		for (unsigned int i = 0; i < channelCount; ++i)
+		{
+			for (unsigned int j = 0; j < channelCount; ++j)
+				next[i] += covariance[i][j] * axis[j];
+			largest = max(largest, fabsf(next[i]));
+		}
+		if (largest == 0.0f)
+			break;
+		for (unsigned int i = 0; i < channelCount; ++i)
+			axis[i] = next[i] / largest;
+	}
+
+	float length = 0.0f;
+	for (unsigned int i = 0; i < channelCount; ++i)
+		length += axis[i] * axis[i];
+	length = sqrtf(length);
+	if (length == 0.0f)
+		return;
+
+	float low = FLT_MAX, high = -FLT_MAX;
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		if (!(mask & (1u << t)))
+			continue;
+		float along = 0.0f;
+		for (unsigned int i = 0; i < channelCount; ++i)
+			along += (block.texels[t][firstChannel + i] - mean[i]) * axis[i];
+		low = min(low, along);
+		high = max(high, along);
+	}
+	for (unsigned int i = 0; i < channelCount; ++i)
+	{
+		float unit = axis[i] / (length * length);
+		ends[0][firstChannel + i] = min(max(mean[i] + unit * low, 0.0f), 255.0f);
+		ends[1][firstChannel + i] = min(max(mean[i] + unit * high, 0.0f), 255.0f);
+	}
+}
+
+// Least squares ends for the texels in mask given their indices, where index i sits weights[i]
+// of the way from end 0 to end 1. False if the indices don't pin down both ends.
+static bool refineLine(const BLOCK &block, unsigned int mask, const uint8_t indices[16], const float * weights, unsigned int firstChannel, unsigned int channelCount, float ends[2][4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		if (!(mask & (1u << t)))
+			continue;
+		float b = weights[indices[t]], a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (unsigned int c = 0; c < channelCount; ++c)
+		{
+			ax[c] += a * block.texels[t][firstChannel + c];
+			bx[c] += b * block.texels[t][firstChannel + c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+
+	for (unsigned int c = 0; c < channelCount; ++c)
+	{
+		ends[0][firstChannel + c] = min(max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+		ends[1][firstChannel + c] = min(max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// BC1 and BC3
+//--------------------------------------------------------------------------------------
+
+static inline unsigned int pack565(const float color[4])
+{
+	return (quantizeBits(color[0], 5) << 11) | (quantizeBits(color[1], 6) << 5) | quantizeBits(color[2], 5);
+}
+
+// The four colors a BC1 block can pick from, the way DecodeBC1Block builds them. Three color
+// blocks have transparent black last.
+static void bc1Palette(unsigned int color0, unsigned int color1, bool fourColors, uint8_t palette[4][4])
+{
+	unsigned int ends[2] = { color0, color1 };
+	for (unsigned int e = 0; e < 2; ++e)
+	{
+		palette[e][0] = uint8_t(expandBits(ends[e] >> 11, 5));
+		palette[e][1] = uint8_t(expandBits((ends[e] >> 5) & 0x3f, 6));
+		palette[e][2] = uint8_t(expandBits(ends[e] & 0x1f, 5));
+		palette[e][3] = 255;
+	}
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		unsigned int c0 = palette[0][c], c1 = palette[1][c];
+		palette[2][c] = uint8_t(fourColors ? (2 * c0 + c1 + 1) / 3 : (c0 + c1 + 1) / 2);
+		palette[3][c] = uint8_t(fourColors ? (c0 + 2 * c1 + 1) / 3 : 0);
+	}
+	palette[2][3] = 255;
+	palette[3][3] = fourColors ? 255 : 0;
+}
+
+// Ends and indices for the texels in mask, refining the fitted line from the indices a few times.
+static float encodeBC1Colors(const BLOCK &block, unsigned int mask, bool fourColors, unsigned int &color0, unsigned int &color1, uint8_t indices[16])
+{
+	static const float FOUR_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	static const float THREE_WEIGHTS[3] = { 0.0f, 1.0f, 0.5f };
+
+	float ends[2][4];
+	fitLine(block, mask, 0, 3, ends);
+
+	float best = FLT_MAX;
+	for (unsigned int iteration = 0; iteration < 3; ++iteration)
+	{
+		unsigned int c0 = pack565(ends[0]), c1 = pack565(ends[1]);
+		uint8_t colors[4][4];
+		bc1Palette(c0, c1, fourColors, colors);
+		float palette[4][4];
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			for (unsigned int c = 0; c < 4; ++c)
+				palette[i][c] = float(colors[i][c]);
+		}
+
+		uint8_t trial[16];
+		float error = fitPalette(block, mask, palette, fourColors ? 4 : 3, 0, 3, trial);
+		if (error < best)
+		{
+			best = error;
+			color0 = c0;
+			color1 = c1;
+			memcpy(indices, trial, 16);
+		}
+		if (error == 0.0f || !refineLine(block, mask, trial, fourColors ? FOUR_WEIGHTS : THREE_WEIGHTS, 0, 3, ends))
+			break;
+	}
+	return best;
+}
+
+// Puts the ends in the order that selects the palette the indices were fit to: color0 > color1
+// for four colors, color0 <= color1 for three.
+static void orderBC1(unsigned int &color0, unsigned int &color1, uint8_t indices[16], bool fourColors)
+{
+	if (fourColors)
+	{
+		// Equal ends can only mean three colors, and every one but transparent is the end color.
+		if (color0 == color1)
+			memset(indices, 0, 16);
+		else if (color0 < color1)
+		{
+			swap(color0, color1);
+			for (unsigned int t = 0; t < 16; ++t)
+				indices[t] ^= 1;
+		}
+	}
+	else if (color0 > color1)
+	{
+		swap(color0, color1);
+		for (unsigned int t = 0; t < 16; ++t)
+		{
+			if (indices[t] < 2)
+				indices[t] ^= 1;
+		}
+	}
+}
+
+static void packBC1(uint8_t block[8], unsigned int color0, unsigned int color1, const uint8_t indices[16])
+{
+	uint32_t bits = 0;
+	for (unsigned int t = 0; t < 16; ++t)
+		bits |= uint32_t(indices[t]) << (t * 2);
+
+	block[0] = uint8_t(color0);
+	block[1] = uint8_t(color0 >> 8);
+	block[2] = uint8_t(color1);
+	block[3] = uint8_t(color1 >> 8);
+	for (unsigned int i = 0; i < 4; ++i)
+		block[4 + i] = uint8_t(bits >> (i * 8));
+}
+
+void EncodeBC1Block(uint8_t block[8], const uint8_t texels[64])
+{
+	BLOCK source;
+	loadBlock(source, texels);
+
+	unsigned int opaque = 0;
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		if (texels[t * 4 + 3] >= 128)
+			opaque |= 1u << t;
+	}
+
+	unsigned int color0 = 0, color1 = 0;
+	uint8_t indices[16];
+	memset(indices, 3, sizeof(indices));
+	if (opaque == 0xffff)
+	{
+		// Three colors with a midpoint sometimes beat four, as long as nothing picks black.
+		encodeBC1Colors(source, opaque, true, color0, color1, indices);
+		float fourError = 0.0f;
+		{
+			uint8_t colors[4][4];
+			bc1Palette(color0, color1, true, colors);
+			for (unsigned int t = 0; t < 16; ++t)
+			{
+				for (unsigned int c = 0; c < 3; ++c)
+				{
+					float difference = source.texels[t][c] - colors[indices[t]][c];
+					fourError += difference * difference;
+				}
+			}
+		}
+
+		unsigned int three0, three1;
+		uint8_t threeIndices[16];
+		if (encodeBC1Colors(source, opaque, false, three0, three1, threeIndices) < fourError)
+		{
+			orderBC1(three0, three1, threeIndices, false);
+			packBC1(block, three0, three1, threeIndices);
+			return;
+		}
+		orderBC1(color0, color1, indices, true);
+	}
+	else if (opaque)
+	{
+		uint8_t colorIndices[16];
+		encodeBC1Colors(source, opaque, false, color0, color1, colorIndices);
+		orderBC1(color0, color1, colorIndices, false);
+		for (unsigned int t = 0; t < 16; ++t)
+		{
+			if (opaque & (1u << t))
+				indices[t] = colorIndices[t];
+		}
+	}
+	packBC1(block, color0, color1, indices);
+}
+
+// The eight alphas a BC4 style block can pick from. Ends in decreasing order interpolate six
+// more; otherwise there are four in between plus 0 and 255, for blocks mixing cut out texels.
+static void alphaPalette(unsigned int alpha0, unsigned int alpha1, uint8_t palette[8])
+{
+	palette[0] = uint8_t(alpha0);
+	palette[1] = uint8_t(alpha1);
+	if (alpha0 > alpha1)
+	{
+		for (unsigned int i = 2; i < 8; ++i)
+			palette[i] = uint8_t(((8 - i) * alpha0 + (i - 1) * alpha1 + 3) / 7);
+	}
+	else
+	{
+		for (unsigned int i = 2; i < 6; ++i)
+			palette[i] = uint8_t(((6 - i) * alpha0 + (i - 1) * alpha1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static float fitAlpha(const BLOCK &block, unsigned int alpha0, unsigned int alpha1, uint8_t indices[16])
+{
+	uint8_t alphas[8];
+	alphaPalette(alpha0, alpha1, alphas);
+	float palette[8][4];
+	for (unsigned int i = 0; i < 8; ++i)
+		palette[i][3] = float(alphas[i]);
+	return fitPalette(block, 0xffff, palette, 8, 3, 1, indices);
+}
+
+// Tries eight steps between the lowest and highest alpha, refined once from the indices, and six
+// steps between the lowest and highest that aren't 0 or 255.
+static void encodeAlpha(const BLOCK &block, uint8_t out[8])
+{
+	static const float EIGHT_WEIGHTS[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+	float low = 255.0f, high = 0.0f, innerLow = 255.0f, innerHigh = 0.0f;
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		float alpha = block.texels[t][3];
+		low = min(low, alpha);
+		high = max(high, alpha);
+		if (alpha > 0.0f && alpha < 255.0f)
+		{
+			innerLow = min(innerLow, alpha);
+			innerHigh = max(innerHigh, alpha);
+		}
+	}
+
+	unsigned int alpha0 = unsigned(high), alpha1 = unsigned(low);
+	uint8_t indices[16];
+	float best = fitAlpha(block, alpha0, alpha1, indices);
+
+	if (best > 0.0f && alpha0 > alpha1)
+	{
+		float ends[2][4];
+		uint8_t trial[16];
+		if (refineLine(block, 0xffff, indices, EIGHT_WEIGHTS, 3, 1, ends))
+		{
+			unsigned int end0 = unsigned(ends[0][3] + 0.5f), end1 = unsigned(ends[1][3] + 0.5f);
+			float error = end0 > end1 ? fitAlpha(block, end0, end1, trial) : FLT_MAX;
+			if (error < best)
+			{
+				best = error;
+				alpha0 = end0;
+				alpha1 = end1;
+				memcpy(indices, trial, 16);
+			}
+		}
+	}
+
+	if (best > 0.0f)
+	{
+		uint8_t trial[16];
+		unsigned int end0 = innerLow <= innerHigh ? unsigned(innerLow) : 0, end1 = innerLow <= innerHigh ? unsigned(innerHigh) : 0;
+		float error = fitAlpha(block, end0, end1, trial);
+		if (error < best)
+		{
+			alpha0 = end0;
+			alpha1 = end1;
+			memcpy(indices, trial, 16);
+		}
+	}
+
+	uint64_t bits = 0;
+	for (unsigned int t = 0; t < 16; ++t)
+		bits |= uint64_t(indices[t]) << (t * 3);
+	out[0] = uint8_t(alpha0);
+	out[1] = uint8_t(alpha1);
+	for (unsigned int i = 0; i < 6; ++i)
+		out[2 + i] = uint8_t(bits >> (i * 8));
+}
+
+void EncodeBC3Block(uint8_t block[16], const uint8_t texels[64])
+{
+	BLOCK source;
+	loadBlock(source, texels);
+	encodeAlpha(source, block);
+
+	// BC3 colors always decode as four colors, whatever the order of the ends.
+	unsigned int color0 = 0, color1 = 0;
+	uint8_t indices[16];
+	encodeBC1Colors(source, 0xffff, true, color0, color1, indices);
+	orderBC1(color0, color1, indices, true);
+	packBC1(block + 8, color0, color1, indices);
+}
+
+void DecodeBC1Block(uint8_t texels[64], const uint8_t block[8])
+{
+	unsigned int color0 = block[0] | (block[1] << 8), color1 = block[2] | (block[3] << 8);
+	uint8_t palette[4][4];
+	bc1Palette(color0, color1, color0 > color1, palette);
+
+	uint32_t bits = uint32_t(block[4]) | (uint32_t(block[5]) << 8) | (uint32_t(block[6]) << 16) | (uint32_t(block[7]) << 24);
+	for (unsigned int t = 0; t < 16; ++t)
+		memcpy(texels + t * 4, palette[(bits >> (t * 2)) & 3], 4);
+}
+
+void DecodeBC3Block(uint8_t texels[64], const uint8_t block[16])
+{
+	unsigned int color0 = block[8] | (block[9] << 8), color1 = block[10] | (block[11] << 8);
+	uint8_t palette[4][4];
+	bc1Palette(color0, color1, true, palette);
+	uint8_t alphas[8];
+	alphaPalette(block[0], block[1], alphas);
+
+	uint32_t colorBits = uint32_t(block[12]) | (uint32_t(block[13]) << 8) | (uint32_t(block[14]) << 16) | (uint32_t(block[15]) << 24);
+	uint64_t alphaBits = 0;
+	for (unsigned int i = 0; i < 6; ++i)
+		alphaBits |= uint64_t(block[2 + i]) << (i * 8);
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		memcpy(texels + t * 4, palette[(colorBits >> (t * 2)) & 3], 3);
+		texels[t * 4 + 3] = alphas[(alphaBits >> (t * 3)) & 7];
+	}
+}
+
+void DecodeBC2Block(uint8_t texels[64], const uint8_t block[16])
+{
+	unsigned int color0 = block[8] | (block[9] << 8), color1 = block[10] | (block[11] << 8);
+	uint8_t palette[4][4];
+	bc1Palette(color0, color1, true, palette);
+
+	uint32_t colorBits = uint32_t(block[12]) | (uint32_t(block[13]) << 8) | (uint32_t(block[14]) << 16) | (uint32_t(block[15]) << 24);
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		memcpy(texels + t * 4, palette[(colorBits >> (t * 2)) & 3], 3);
+		unsigned int alpha = (block[t / 2] >> ((t & 1) * 4)) & 0xf;
+		texels[t * 4 + 3] = uint8_t(alpha * 17);
+	}
+}
+
+// One BC4 channel as floats, interpolated the way the hardware does rather than rounded to 8 bits.
+// SNORM ends are -127..127; -128 reads as -127.
+static void decodeBC4Channel(float values[16], const uint8_t block[8], bool snorm)
+{
+	float palette[8];
+	if (snorm)
+	{
+		palette[0] = max(int(int8_t(block[0])), -127) / 127.0f;
+		palette[1] = max(int(int8_t(block[1])), -127) / 127.0f;
+	}
+	else
+	{
+		palette[0] = block[0] / 255.0f;
+		palette[1] = block[1] / 255.0f;
+	}
+
+	if (palette[0] > palette[1])
+	{
+		for (unsigned int i = 2; i < 8; ++i)
+			palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7.0f;
+	}
+	else
+	{
+		for (unsigned int i = 2; i < 6; ++i)
+			palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5.0f;
+		palette[6] = snorm ? -1.0f : 0.0f;
+		palette[7] = 1.0f;
+	}
+
+	uint64_t bits = 0;
+	for (unsigned int i = 0; i < 6; ++i)
+		bits |= uint64_t(block[2 + i]) << (i * 8);
+	for (unsigned int t = 0; t < 16; ++t)
+		values[t] = palette[(bits >> (t * 3)) & 7];
+}
+
+void DecodeBC4Block(float texels[64], const uint8_t block[8], bool snorm)
+{
+	float red[16];
+	decodeBC4Channel(red, block, snorm);
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		texels[t * 4] = red[t];
+		texels[t * 4 + 1] = 0.0f;
+		texels[t * 4 + 2] = 0.0f;
+		texels[t * 4 + 3] = 1.0f;
+	}
+}
+
+void DecodeBC5Block(float texels[64], const uint8_t block[16], bool snorm)
+{
+	float red[16], green[16];
+	decodeBC4Channel(red, block, snorm);
+	decodeBC4Channel(green, block + 8, snorm);
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		texels[t * 4] = red[t];
+		texels[t * 4 + 1] = green[t];
+		texels[t * 4 + 2] = 0.0f;
+		texels[t * 4 + 3] = 1.0f;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// BC7
+//--------------------------------------------------------------------------------------
+
+// A subset's ends as stored: colorBits wide values without their p-bits.
+struct BC7ENDS
+{
+	unsigned int value[2][4];
+	unsigned int pBit[2];
+};
+
+// Ends and indices for the texels in mask in a mode with colorBits per channel and a p-bit per end
+// or, with sharedPBit, one for both. Every p-bit choice is tried on the fitted line, which is then
+// refined from the indices. Channels past channelCount are left at 255. When every alpha in mask
+// is 255 the alpha ends are kept at 255, the only choice that stores it exactly: alpha tested
+// texels must not drop below 255 to save a little color error.
+static float encodeBC7Subset(const BLOCK &block, unsigned int mask, unsigned int channelCount, unsigned int colorBits, bool sharedPBit, unsigned int indexBits, BC7ENDS &ends, uint8_t indices[16])
+{
+	const unsigned int * weights = bc7Weights(indexBits);
+	unsigned int indexCount = 1u << indexBits;
+	float unitWeights[16];
+	for (unsigned int i = 0; i < indexCount; ++i)
+		unitWeights[i] = weights[i] / 64.0f;
+
+	float line[2][4];
+	fitLine(block, mask, 0, channelCount, line);
+
+	bool opaque = channelCount == 4;
+	for (unsigned int t = 0; t < 16 && opaque; ++t)
+		opaque = !(mask & (1u << t)) || block.texels[t][3] == 255.0f;
+
+	float best = FLT_MAX;
+	for (unsigned int iteration = 0; iteration < 2; ++iteration)
+	{
+		for (unsigned int pBits = 0; pBits < (sharedPBit ? 2u : 4u); ++pBits)
+		{
+			BC7ENDS trialEnds = {};
+			trialEnds.pBit[0] = pBits & 1;
+			trialEnds.pBit[1] = sharedPBit ? pBits & 1 : pBits >> 1;
+			if (opaque && !(trialEnds.pBit[0] && trialEnds.pBit[1]))
+				continue;
+
+			float palette[16][4];
+			unsigned int expanded[2][4];
+			for (unsigned int e = 0; e < 2; ++e)
+			{
+				for (unsigned int c = 0; c < 4; ++c)
+				{
+					// The stored value is the top colorBits of a colorBits + 1 bit one ending in the p-bit.
+					unsigned int top = (1u << colorBits) - 1;
+					float wide = c < channelCount ? line[e][c] * ((2u << colorBits) - 1) / 255.0f : 255.0f;
+					float value = (wide - trialEnds.pBit[e]) * 0.5f + 0.5f;
+					trialEnds.value[e][c] = opaque && c == 3 ? top : unsigned(min(max(value, 0.0f), float(top)));
+					expanded[e][c] = c < channelCount ? expandBits((trialEnds.value[e][c] << 1) | trialEnds.pBit[e], colorBits + 1) : 255;
+				}
+			}
+			for (unsigned int i = 0; i < indexCount; ++i)
+			{
+				for (unsigned int c = 0; c < 4; ++c)
+					palette[i][c] = float(bc7Interpolate(expanded[0][c], expanded[1][c], weights[i]));
+			}
+
+			uint8_t trial[16];
+			float error = fitPalette(block, mask, palette, indexCount, 0, channelCount, trial);
+			if (error < best)
+			{
+				best = error;
+				ends = trialEnds;
+				for (unsigned int t = 0; t < 16; ++t)
+				{
+					if (mask & (1u << t))
+						indices[t] = trial[t];
+				}
+			}
+		}
+		if (best == 0.0f || !refineLine(block, mask, indices, unitWeights, 0, channelCount, line))
+			break;
+	}
+	return best;
+}
+
+// Swaps a subset's ends, and flips its indices to match, when its anchor texel's index would need
+// the top bit, which isn't stored.
+static void anchorBC7Subset(BC7ENDS &ends, unsigned int mask, unsigned int anchor, unsigned int indexBits, uint8_t indices[16])
+{
+	unsigned int top = (1u << indexBits) - 1;
+	if (!(indices[anchor] >> (indexBits - 1)))
+		return;
+
+	for (unsigned int c = 0; c < 4; ++c)
+		swap(ends.value[0][c], ends.value[1][c]);
+	swap(ends.pBit[0], ends.pBit[1]);
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		if (mask & (1u << t))
+			indices[t] = uint8_t(top - indices[t]);
+	}
+}
+
+// Mode 6: one subset, 7 bit RGBA ends with a p-bit each and 4 bit indices.
+static float encodeBC7Mode6(const BLOCK &block, uint8_t out[16])
+{
+	BC7ENDS ends = {};
+	uint8_t indices[16];
+	float error = encodeBC7Subset(block, 0xffff, 4, 7, false, 4, ends, indices);
+	anchorBC7Subset(ends, 0xffff, 0, 4, indices);
+
+	BITWRITER bits = { { 0, 0 }, 0 };
+	bits.write(1u << 6, 7);
+	for (unsigned int c = 0; c < 4; ++c)
+	{
+		bits.write(ends.value[0][c], 7);
+		bits.write(ends.value[1][c], 7);
+	}
+	bits.write(ends.pBit[0], 1);
+	bits.write(ends.pBit[1], 1);
+	for (unsigned int t = 0; t < 16; ++t)
+		bits.write(indices[t], t == 0 ? 3 : 4);
+	bits.store(out);
+	return error;
+}
+
+// Mode 1: two subsets, 6 bit RGB ends with a p-bit per subset and 3 bit indices.
+static float encodeBC7Mode1(const BLOCK &block, unsigned int partition, uint8_t out[16])
+{
+	unsigned int masks[2] = { ~unsigned(BC7_PARTITIONS2[partition]) & 0xffff, BC7_PARTITIONS2[partition] };
+	unsigned int anchors[2] = { 0, BC7_ANCHORS2[partition] };
+	BC7ENDS ends[2] = {};
+	uint8_t indices[16];
+	float error = 0.0f;
+	for (unsigned int s = 0; s < 2; ++s)
+	{
+		error += encodeBC7Subset(block, masks[s], 3, 6, true, 3, ends[s], indices);
+		anchorBC7Subset(ends[s], masks[s], anchors[s], 3, indices);
+	}
+
+	BITWRITER bits = { { 0, 0 }, 0 };
+	bits.write(1u << 1, 2);
+	bits.write(partition, 6);
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		for (unsigned int s = 0; s < 2; ++s)
+		{
+			bits.write(ends[s].value[0][c], 6);
+			bits.write(ends[s].value[1][c], 6);
+		}
+	}
+	bits.write(ends[0].pBit[0], 1);
+	bits.write(ends[1].pBit[0], 1);
+	for (unsigned int t = 0; t < 16; ++t)
+		bits.write(indices[t], t == anchors[0] || t == anchors[1] ? 2 : 3);
+	bits.store(out);
+	return error;
+}
+
+// Sums of RGB, their squares and products over a set of texels: enough for the covariance.
+struct COLORSUMS
+{
+	float count;
+	float sum[3];
+	float products[6];	// rr, gg, bb, rg, rb, gb
+};
+
+// Squared distance of the texels from the line through them, the least error any ends fit to the
+// subset can have before quantization.
+static float lineResidual(const COLORSUMS &sums)
+{
+	if (sums.count < 2.0f)
+		return 0.0f;
+
+	float mean[3] = { sums.sum[0] / sums.count, sums.sum[1] / sums.count, sums.sum[2] / sums.count };
+	float covariance[3][3];
+	covariance[0][0] = sums.products[0] - mean[0] * sums.sum[0];
+	covariance[1][1] = sums.products[1] - mean[1] * sums.sum[1];
+	covariance[2][2] = sums.products[2] - mean[2] * sums.sum[2];
+	covariance[0][1] = covariance[1][0] = sums.products[3] - mean[0] * sums.sum[1];
+	covariance[0][2] = covariance[2][0] = sums.products[4] - mean[0] * sums.sum[2];
+	covariance[1][2] = covariance[2][1] = sums.products[5] - mean[1] * sums.sum[2];
+
+	float trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	float eigenvalue = 0.0f;
+	for (unsigned int iteration = 0; iteration < 4; ++iteration)
+	{
+		float next[3];
+		for (unsigned int i = 0; i < 3; ++i)
+			next[i] = covariance[i][0] * axis[0] + covariance[i][1] * axis[1] + covariance[i][2] * axis[2];
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length == 0.0f)
+			return 0.0f;
+		for (unsigned int i = 0; i < 3; ++i)
+			axis[i] = next[i] / length;
+		eigenvalue = length;
+	}
+	return max(trace - eigenvalue, 0.0f);
+}
+
+// The two subset partition whose subsets each lie closest to a line.
+static unsigned int pickBC7Partition(const BLOCK &block)
+{
+	COLORSUMS texels[16], total;
+	memset(&total, 0, sizeof(total));
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		const float * rgb = block.texels[t];
+		COLORSUMS &texel = texels[t];
+		texel.count = 1.0f;
+		for (unsigned int c = 0; c < 3; ++c)
+			texel.sum[c] = rgb[c];
+		texel.products[0] = rgb[0] * rgb[0];
+		texel.products[1] = rgb[1] * rgb[1];
+		texel.products[2] = rgb[2] * rgb[2];
+		texel.products[3] = rgb[0] * rgb[1];
+		texel.products[4] = rgb[0] * rgb[2];
+		texel.products[5] = rgb[1] * rgb[2];
+
+		total.count += 1.0f;
+		for (unsigned int c = 0; c < 3; ++c)
+			total.sum[c] += texel.sum[c];
+		for (unsigned int p = 0; p < 6; ++p)
+			total.products[p] += texel.products[p];
+	}
+
+	unsigned int best = 0;
+	float bestResidual = FLT_MAX;
+	for (unsigned int partition = 0; partition < 64; ++partition)
+	{
+		COLORSUMS one;
+		memset(&one, 0, sizeof(one));
+		for (unsigned int t = 0; t < 16; ++t)
+		{
+			if (!(BC7_PARTITIONS2[partition] & (1u << t)))
+				continue;
+			one.count += 1.0f;
+			for (unsigned int c = 0; c < 3; ++c)
+				one.sum[c] += texels[t].sum[c];
+			for (unsigned int p = 0; p < 6; ++p)
+				one.products[p] += texels[t].products[p];
+		}
+
+		COLORSUMS zero = total;
+		zero.count -= one.count;
+		for (unsigned int c = 0; c < 3; ++c)
+			zero.sum[c] -= one.sum[c];
+		for (unsigned int p = 0; p < 6; ++p)
+			zero.products[p] -= one.products[p];
+
+		float residual = lineResidual(zero) + lineResidual(one);
+		if (residual < bestResidual)
+		{
+			bestResidual = residual;
+			best = partition;
+		}
+	}
+	return best;
+}
+
+void EncodeBC7Block(uint8_t block[16], const uint8_t texels[64])
+{
+	BLOCK source;
+	loadBlock(source, texels);
+
+	float error = encodeBC7Mode6(source, block);
+
+	bool opaque = true;
+	for (unsigned int t = 0; t < 16 && opaque; ++t)
+		opaque = texels[t * 4 + 3] == 255;
+	if (opaque && error > 0.0f)
+	{
+		uint8_t twoSubsets[16];
+		if (encodeBC7Mode1(source, pickBC7Partition(source), twoSubsets) < error)
+			memcpy(block, twoSubsets, 16);
+	}
+}
+
+void DecodeBC7Block(uint8_t texels[64], const uint8_t block[16])
+{
+	BITREADER bits(block);
+	unsigned int modeIndex = 0;
+	while (modeIndex < 8 && !bits.read(1))
+		++modeIndex;
+	if (modeIndex == 8)
+	{
+		memset(texels, 0, 64);
+		return;
+	}
+
+	const BC7MODE &mode = BC7_MODES[modeIndex];
+	unsigned int partition = bits.read(mode.partitionBits);
+	unsigned int rotation = bits.read(mode.rotationBits);
+	unsigned int indexSelection = bits.read(mode.indexSelectionBits);
+
+	// Ends of subset s are ends[2s] and ends[2s + 1].
+	unsigned int ends[6][4];
+	unsigned int endCount = mode.subsets * 2;
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		for (unsigned int e = 0; e < endCount; ++e)
+			ends[e][c] = bits.read(mode.colorBits);
+	}
+	for (unsigned int e = 0; e < endCount; ++e)
+		ends[e][3] = mode.alphaBits ? bits.read(mode.alphaBits) : 255;
+
+	unsigned int colorBits = mode.colorBits, alphaBits = mode.alphaBits;
+	if (mode.endPBits || mode.sharedPBits)
+	{
+		unsigned int pBits[6];
+		for (unsigned int e = 0; e < endCount; ++e)
+			pBits[e] = mode.endPBits || (e & 1) == 0 ? bits.read(1) : pBits[e - 1];
+		for (unsigned int e = 0; e < endCount; ++e)
+		{
+			for (unsigned int c = 0; c < (alphaBits ? 4u : 3u); ++c)
+				ends[e][c] = (ends[e][c] << 1) | pBits[e];
+		}
+		++colorBits;
+		if (alphaBits)
+			++alphaBits;
+	}
+	for (unsigned int e = 0; e < endCount; ++e)
+	{
+		for (unsigned int c = 0; c < 3; ++c)
+			ends[e][c] = expandBits(ends[e][c], colorBits);
+		if (alphaBits)
+			ends[e][3] = expandBits(ends[e][3], alphaBits);
+	}
+
+	unsigned int subsets[16];
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		if (mode.subsets == 2)
+			subsets[t] = (BC7_PARTITIONS2[partition] >> t) & 1;
+		else if (mode.subsets == 3)
+			subsets[t] = (BC7_PARTITIONS3[partition] >> (t * 2)) & 3;
+		else
+			subsets[t] = 0;
+	}
+
+	unsigned int primary[16], secondary[16];
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		bool anchor = t == 0 ||
+			(mode.subsets == 2 && t == BC7_ANCHORS2[partition]) ||
+			(mode.subsets == 3 && (t == BC7_ANCHORS3[0][partition] || t == BC7_ANCHORS3[1][partition]));
+		primary[t] = bits.read(anchor ? mode.indexBits - 1 : mode.indexBits);
+	}
+	for (unsigned int t = 0; t < 16 && mode.secondaryIndexBits; ++t)
+		secondary[t] = bits.read(t == 0 ? mode.secondaryIndexBits - 1 : mode.secondaryIndexBits);
+
+	// With two sets of indices, the index selection bit says which one colors use.
+	const unsigned int * colorIndices = primary, * alphaIndices = primary;
+	unsigned int colorIndexBits = mode.indexBits, alphaIndexBits = mode.indexBits;
+	if (mode.secondaryIndexBits)
+	{
+		alphaIndices = secondary;
+		alphaIndexBits = mode.secondaryIndexBits;
+		if (indexSelection)
+		{
+			swap(colorIndices, alphaIndices);
+			swap(colorIndexBits, alphaIndexBits);
+		}
+	}
+	const unsigned int * colorWeights = bc7Weights(colorIndexBits), * alphaWeights = bc7Weights(alphaIndexBits);
+
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		const unsigned int * end0 = ends[subsets[t] * 2], * end1 = ends[subsets[t] * 2 + 1];
+		uint8_t * texel = texels + t * 4;
+		for (unsigned int c = 0; c < 3; ++c)
+			texel[c] = uint8_t(bc7Interpolate(end0[c], end1[c], colorWeights[colorIndices[t]]));
+		texel[3] = uint8_t(bc7Interpolate(end0[3], end1[3], alphaWeights[alphaIndices[t]]));
+		if (rotation)
+			swap(texel[3], texel[rotation - 1]);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// BC6H
+//--------------------------------------------------------------------------------------
+
+// Mode number, from the 2 or 5 mode bits read as an integer, of each of the 14 modes; 0xff is
+// reserved. Values 0 and 1 are the two modes with 2 mode bits.
+static const uint8_t BC6H_MODE_NUMBERS[32] =
+{
+	0, 1, 2, 10, 0xff, 0xff, 3, 11, 0xff, 0xff, 4, 12, 0xff, 0xff, 5, 13,
+	0xff, 0xff, 6, 0xff, 0xff, 0xff, 7, 0xff, 0xff, 0xff, 8, 0xff, 0xff, 0xff, 9, 0xff,
+};
+
+struct BC6HMODE
+{
+	unsigned int regions;
+	bool transformed;			// ends after the first are stored as deltas from it
+	unsigned int endpointBits;
+	unsigned int deltaBits[3];	// bits of the other ends, per channel
+};
+
+static const BC6HMODE BC6H_MODES[14] =
+{
+	{ 2, true, 10, { 5, 5, 5 } },
+	{ 2, true, 7, { 6, 6, 6 } },
+	{ 2, true, 11, { 5, 4, 4 } },
+	{ 2, true, 11, { 4, 5, 4 } },
+	{ 2, true, 11, { 4, 4, 5 } },
+	{ 2, true, 9, { 5, 5, 5 } },
+	{ 2, true, 8, { 6, 5, 5 } },
+	{ 2, true, 8, { 5, 6, 5 } },
+	{ 2, true, 8, { 5, 5, 6 } },
+	{ 2, false, 6, { 6, 6, 6 } },
+	{ 1, false, 10, { 10, 10, 10 } },
+	{ 1, true, 11, { 9, 9, 9 } },
+	{ 1, true, 12, { 8, 8, 8 } },
+	{ 1, true, 16, { 4, 4, 4 } },
+};
+
+// Where the bits of the ends sit after the mode bits: runs of bits of one channel of one end,
+// stored from bit first to bit last, which counts down where the format stores a field
+// reversed. Ends 0 and 1 belong to region 0, 2 and 3 to region 1. End 4 closes the list.
+struct BC6HRUN
+{
+	uint8_t end;
+	uint8_t channel;
+	uint8_t first;
+	uint8_t last;
+};
+
+static const BC6HRUN BC6H_LAYOUTS[14][24] =
+{
+	{
+		{ 2, 1, 4, 4 }, { 2, 2, 4, 4 }, { 3, 2, 4, 4 }, { 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 },
+		{ 1, 0, 0, 4 }, { 3, 1, 4, 4 }, { 2, 1, 0, 3 }, { 1, 1, 0, 4 }, { 3, 2, 0, 0 }, { 3, 1, 0, 3 },
+		{ 1, 2, 0, 4 }, { 3, 2, 1, 1 }, { 2, 2, 0, 3 }, { 2, 0, 0, 4 }, { 3, 2, 2, 2 }, { 3, 0, 0, 4 },
+		{ 3, 2, 3, 3 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 2, 1, 5, 5 }, { 3, 1, 4, 4 }, { 3, 1, 5, 5 }, { 0, 0, 0, 6 }, { 3, 2, 0, 0 }, { 3, 2, 1, 1 },
+		{ 2, 2, 4, 4 }, { 0, 1, 0, 6 }, { 2, 2, 5, 5 }, { 3, 2, 2, 2 }, { 2, 1, 4, 4 }, { 0, 2, 0, 6 },
+		{ 3, 2, 3, 3 }, { 3, 2, 5, 5 }, { 3, 2, 4, 4 }, { 1, 0, 0, 5 }, { 2, 1, 0, 3 }, { 1, 1, 0, 5 },
+		{ 3, 1, 0, 3 }, { 1, 2, 0, 5 }, { 2, 2, 0, 3 }, { 2, 0, 0, 5 }, { 3, 0, 0, 5 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 }, { 1, 0, 0, 4 }, { 0, 0, 10, 10 }, { 2, 1, 0, 3 },
+		{ 1, 1, 0, 3 }, { 0, 1, 10, 10 }, { 3, 2, 0, 0 }, { 3, 1, 0, 3 }, { 1, 2, 0, 3 }, { 0, 2, 10, 10 },
+		{ 3, 2, 1, 1 }, { 2, 2, 0, 3 }, { 2, 0, 0, 4 }, { 3, 2, 2, 2 }, { 3, 0, 0, 4 }, { 3, 2, 3, 3 },
+		{ 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 }, { 1, 0, 0, 3 }, { 0, 0, 10, 10 }, { 3, 1, 4, 4 },
+		{ 2, 1, 0, 3 }, { 1, 1, 0, 4 }, { 0, 1, 10, 10 }, { 3, 1, 0, 3 }, { 1, 2, 0, 3 }, { 0, 2, 10, 10 },
+		{ 3, 2, 1, 1 }, { 2, 2, 0, 3 }, { 2, 0, 0, 3 }, { 3, 2, 0, 0 }, { 3, 2, 2, 2 }, { 3, 0, 0, 3 },
+		{ 2, 1, 4, 4 }, { 3, 2, 3, 3 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 }, { 1, 0, 0, 3 }, { 0, 0, 10, 10 }, { 2, 2, 4, 4 },
+		{ 2, 1, 0, 3 }, { 1, 1, 0, 3 }, { 0, 1, 10, 10 }, { 3, 2, 0, 0 }, { 3, 1, 0, 3 }, { 1, 2, 0, 4 },
+		{ 0, 2, 10, 10 }, { 2, 2, 0, 3 }, { 2, 0, 0, 3 }, { 3, 2, 1, 1 }, { 3, 2, 2, 2 }, { 3, 0, 0, 3 },
+		{ 3, 2, 4, 4 }, { 3, 2, 3, 3 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 8 }, { 2, 2, 4, 4 }, { 0, 1, 0, 8 }, { 2, 1, 4, 4 }, { 0, 2, 0, 8 }, { 3, 2, 4, 4 },
+		{ 1, 0, 0, 4 }, { 3, 1, 4, 4 }, { 2, 1, 0, 3 }, { 1, 1, 0, 4 }, { 3, 2, 0, 0 }, { 3, 1, 0, 3 },
+		{ 1, 2, 0, 4 }, { 3, 2, 1, 1 }, { 2, 2, 0, 3 }, { 2, 0, 0, 4 }, { 3, 2, 2, 2 }, { 3, 0, 0, 4 },
+		{ 3, 2, 3, 3 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 7 }, { 3, 1, 4, 4 }, { 2, 2, 4, 4 }, { 0, 1, 0, 7 }, { 3, 2, 2, 2 }, { 2, 1, 4, 4 },
+		{ 0, 2, 0, 7 }, { 3, 2, 3, 3 }, { 3, 2, 4, 4 }, { 1, 0, 0, 5 }, { 2, 1, 0, 3 }, { 1, 1, 0, 4 },
+		{ 3, 2, 0, 0 }, { 3, 1, 0, 3 }, { 1, 2, 0, 4 }, { 3, 2, 1, 1 }, { 2, 2, 0, 3 }, { 2, 0, 0, 5 },
+		{ 3, 0, 0, 5 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 7 }, { 3, 2, 0, 0 }, { 2, 2, 4, 4 }, { 0, 1, 0, 7 }, { 2, 1, 5, 5 }, { 2, 1, 4, 4 },
+		{ 0, 2, 0, 7 }, { 3, 1, 5, 5 }, { 3, 2, 4, 4 }, { 1, 0, 0, 4 }, { 3, 1, 4, 4 }, { 2, 1, 0, 3 },
+		{ 1, 1, 0, 5 }, { 3, 1, 0, 3 }, { 1, 2, 0, 4 }, { 3, 2, 1, 1 }, { 2, 2, 0, 3 }, { 2, 0, 0, 4 },
+		{ 3, 2, 2, 2 }, { 3, 0, 0, 4 }, { 3, 2, 3, 3 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 7 }, { 3, 2, 1, 1 }, { 2, 2, 4, 4 }, { 0, 1, 0, 7 }, { 2, 2, 5, 5 }, { 2, 1, 4, 4 },
+		{ 0, 2, 0, 7 }, { 3, 2, 5, 5 }, { 3, 2, 4, 4 }, { 1, 0, 0, 4 }, { 3, 1, 4, 4 }, { 2, 1, 0, 3 },
+		{ 1, 1, 0, 4 }, { 3, 2, 0, 0 }, { 3, 1, 0, 3 }, { 1, 2, 0, 5 }, { 2, 2, 0, 3 }, { 2, 0, 0, 4 },
+		{ 3, 2, 2, 2 }, { 3, 0, 0, 4 }, { 3, 2, 3, 3 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 5 }, { 3, 1, 4, 4 }, { 3, 2, 0, 0 }, { 3, 2, 1, 1 }, { 2, 2, 4, 4 }, { 0, 1, 0, 5 },
+		{ 2, 1, 5, 5 }, { 2, 2, 5, 5 }, { 3, 2, 2, 2 }, { 2, 1, 4, 4 }, { 0, 2, 0, 5 }, { 3, 1, 5, 5 },
+		{ 3, 2, 3, 3 }, { 3, 2, 5, 5 }, { 3, 2, 4, 4 }, { 1, 0, 0, 5 }, { 2, 1, 0, 3 }, { 1, 1, 0, 5 },
+		{ 3, 1, 0, 3 }, { 1, 2, 0, 5 }, { 2, 2, 0, 3 }, { 2, 0, 0, 5 }, { 3, 0, 0, 5 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 }, { 1, 0, 0, 9 }, { 1, 1, 0, 9 }, { 1, 2, 0, 9 },
+		{ 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 }, { 1, 0, 0, 8 }, { 0, 0, 10, 10 }, { 1, 1, 0, 8 },
+		{ 0, 1, 10, 10 }, { 1, 2, 0, 8 }, { 0, 2, 10, 10 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 }, { 1, 0, 0, 7 }, { 0, 0, 11, 10 }, { 1, 1, 0, 7 },
+		{ 0, 1, 11, 10 }, { 1, 2, 0, 7 }, { 0, 2, 11, 10 }, { 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 9 }, { 0, 1, 0, 9 }, { 0, 2, 0, 9 }, { 1, 0, 0, 3 }, { 0, 0, 15, 10 }, { 1, 1, 0, 3 },
+		{ 0, 1, 15, 10 }, { 1, 2, 0, 3 }, { 0, 2, 15, 10 }, { 4, 0, 0, 0 },
+	},
+};
+
+static inline int signExtend(int value, unsigned int bits)
+{
+	int shift = 32 - int(bits);
+	return int(unsigned(value) << shift) >> shift;
+}
+
+// Widens an endpointBits wide end to 16 bits, or 15 plus sign, spreading the range evenly.
+static int bc6hUnquantize(int value, unsigned int bits, bool isSigned)
+{
+	if (isSigned)
+	{
+		if (bits >= 16)
+			return value;
+		bool negative = value < 0;
+		int magnitude = negative ? -value : value;
+		int wide;
+		if (magnitude == 0)
+			wide = 0;
+		else if (magnitude >= (1 << (bits - 1)) - 1)
+			wide = 0x7fff;
+		else
+			wide = ((magnitude << 15) + 0x4000) >> (bits - 1);
+		return negative ? -wide : wide;
+	}
+
+	if (bits >= 15 || value == 0)
+		return value;
+	if (value == (1 << bits) - 1)
+		return 0xffff;
+	return ((value << 16) + 0x8000) >> bits;
+}
+
+// Scales an interpolated value to the largest finite half and puts the sign where halves keep it.
+static uint16_t bc6hFinish(int value, bool isSigned)
+{
+	if (!isSigned)
+		return uint16_t((value * 31) >> 6);
+	if (value < 0)
+		return uint16_t(0x8000 | (((-value) * 31) >> 5));
+	return uint16_t((value * 31) >> 5);
+}
+
+void DecodeBC6HBlock(uint16_t texels[64], const uint8_t block[16], bool isSigned)
+{
+	static const uint16_t HALF_ONE = 0x3c00;
+
+	BITREADER bits(block);
+	unsigned int modeBits = bits.read(2);
+	if (modeBits > 1)
+		modeBits |= bits.read(3) << 2;
+	unsigned int modeNumber = BC6H_MODE_NUMBERS[modeBits];
+	if (modeNumber == 0xff)
+	{
+		for (unsigned int t = 0; t < 16; ++t)
+		{
+			texels[t * 4] = texels[t * 4 + 1] = texels[t * 4 + 2] = 0;
+			texels[t * 4 + 3] = HALF_ONE;
+		}
+		return;
+	}
+
+	const BC6HMODE &mode = BC6H_MODES[modeNumber];
+	int ends[4][3] = {};
+	for (const BC6HRUN * run = BC6H_LAYOUTS[modeNumber]; run->end < 4; ++run)
+	{
+		if (run->last >= run->first)
+		{
+			ends[run->end][run->channel] |= int(bits.read(run->last - run->first + 1)) << run->first;
+			continue;
+		}
+		for (int bit = run->first; bit >= run->last; --bit)
+			ends[run->end][run->channel] |= int(bits.read(1)) << bit;
+	}
+	unsigned int partition = mode.regions == 2 ? bits.read(5) : 0;
+
+	unsigned int endCount = mode.regions * 2;
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		if (isSigned)
+			ends[0][c] = signExtend(ends[0][c], mode.endpointBits);
+		for (unsigned int e = 1; e < endCount; ++e)
+		{
+			if (isSigned || mode.transformed)
+				ends[e][c] = signExtend(ends[e][c], mode.deltaBits[c]);
+			if (mode.transformed)
+			{
+				ends[e][c] = (ends[0][c] + ends[e][c]) & ((1 << mode.endpointBits) - 1);
+				if (isSigned)
+					ends[e][c] = signExtend(ends[e][c], mode.endpointBits);
+			}
+		}
+		for (unsigned int e = 0; e < endCount; ++e)
+			ends[e][c] = bc6hUnquantize(ends[e][c], mode.endpointBits, isSigned);
+	}
+
+	unsigned int indexBits = mode.regions == 2 ? 3 : 4;
+	const unsigned int * weights = bc7Weights(indexBits);
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		unsigned int region = mode.regions == 2 ? (BC7_PARTITIONS2[partition] >> t) & 1 : 0;
+		bool anchor = t == 0 || (mode.regions == 2 && t == BC7_ANCHORS2[partition]);
+		unsigned int weight = weights[bits.read(anchor ? indexBits - 1 : indexBits)];
+		const int * end0 = ends[region * 2], * end1 = ends[region * 2 + 1];
+		for (unsigned int c = 0; c < 3; ++c)
+			texels[t * 4 + c] = bc6hFinish((end0[c] * int(64 - weight) + end1[c] * int(weight) + 32) >> 6, isSigned);
+		texels[t * 4 + 3] = HALF_ONE;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Surfaces
+//--------------------------------------------------------------------------------------
+
+typedef void (*BLOCKENCODER)(uint8_t * block, const uint8_t * texels);
+typedef void (*BLOCKDECODER)(uint8_t * texels, const uint8_t * block);
+
+enum BCKIND
+{
+	BC_NONE,
+	BC_1,
+	BC_2,
+	BC_3,
+	BC_4,
+	BC_5,
+	BC_6H,
+	BC_7,
+};
+
+// Which BC format this is, whether it's signed and whether it's sRGB. Typeless formats read as
+// UNORM (UF16 for BC6H).
+static BCKIND bcKind(DXGI_FORMAT format, bool &isSigned, bool &srgb)
+{
+	isSigned = format == DXGI_FORMAT_BC4_SNORM || format == DXGI_FORMAT_BC5_SNORM || format == DXGI_FORMAT_BC6H_SF16;
+	srgb = format == DXGI_FORMAT_BC1_UNORM_SRGB || format == DXGI_FORMAT_BC2_UNORM_SRGB || format == DXGI_FORMAT_BC3_UNORM_SRGB || format == DXGI_FORMAT_BC7_UNORM_SRGB;
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		return BC_1;
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+		return BC_2;
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		return BC_3;
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return BC_4;
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+		return BC_5;
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+		return BC_6H;
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return BC_7;
+	default:
+		return BC_NONE;
+	}
+}
+
+bool IsBCFormat(DXGI_FORMAT format)
+{
+	bool isSigned, srgb;
+	return bcKind(format, isSigned, srgb) != BC_NONE;
+}
+
+bool IsBCEncodeFormat(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static size_t blockBytes(BCKIND kind)
+{
+	return kind == BC_1 || kind == BC_4 ? 8 : 16;
+}
+
+static unsigned int surfaceThreads(size_t blocks, unsigned int threadCount)
+{
+	if (threadCount)
+		return threadCount;
+	return blocks < BLOCK_THREAD_THRESHOLD ? 1 : DX::DefaultThreadCount();
+}
+
+// Half floats of the 256 UNORM8 values, read as UNORM or as sRGB and made linear.
+struct HALFTABLE
+{
+	HALF unorm[256];
+	HALF srgb[256];
+
+	HALFTABLE()
+	{
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			float value = i / 255.0f;
+			unorm[i] = XMConvertFloatToHalf(value);
+			srgb[i] = XMConvertFloatToHalf(value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f));
+		}
+	}
+};
+
+static const HALFTABLE & halfTable()
+{
+	static const HALFTABLE table;
+	return table;
+}
+
+void ConvertRGBA8ToRGBA16F(uint16_t * halves, const uint8_t * texels, size_t texelCount, bool srgb)
+{
+	const HALFTABLE &table = halfTable();
+	const HALF * color = srgb ? table.srgb : table.unorm;
+	for (size_t t = 0; t < texelCount; ++t, texels += 4, halves += 4)
+	{
+		halves[0] = color[texels[0]];
+		halves[1] = color[texels[1]];
+		halves[2] = color[texels[2]];
+		halves[3] = table.unorm[texels[3]];
+	}
+}
+
+// Rounds 16 RGBA float texels to UNORM8, a texel per vector. biased maps -1..1 onto 0..1 first.
+static void storeUnorm8(uint8_t texels[64], const float values[64], bool biased)
+{
+	XMVECTOR half = XMVectorReplicate(0.5f);
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		XMVECTOR texel = XMLoadFloat4(reinterpret_cast<const XMFLOAT4 *>(values + t * 4));
+		if (biased)
+			texel = XMVectorMultiplyAdd(texel, half, half);
+		XMStoreUByteN4(reinterpret_cast<XMUBYTEN4 *>(texels + t * 4), texel);
+	}
+}
+
+// One block in the output format: 64 bytes of RGBA8 or 64 halves of RGBA16F.
+static void decodeBlock(BCKIND kind, bool isSigned, bool srgb, bool toHalf, const uint8_t * block, void * out)
+{
+	if (kind == BC_4 || kind == BC_5)
+	{
+		float values[64];
+		if (kind == BC_4)
+			DecodeBC4Block(values, block, isSigned);
+		else
+			DecodeBC5Block(values, block, isSigned);
+		if (toHalf)
+			XMConvertFloatToHalfStream(static_cast<HALF *>(out), sizeof(HALF), values, sizeof(float), 64);
+		else
+			storeUnorm8(static_cast<uint8_t *>(out), values, isSigned);
+		return;
+	}
+
+	if (kind == BC_6H)
+	{
+		if (toHalf)
+		{
+			DecodeBC6HBlock(static_cast<uint16_t *>(out), block, isSigned);
+			return;
+		}
+		HALF halves[64];
+		float values[64];
+		DecodeBC6HBlock(halves, block, isSigned);
+		XMConvertHalfToFloatStream(values, sizeof(float), halves, sizeof(HALF), 64);
+		storeUnorm8(static_cast<uint8_t *>(out), values, false);
+		return;
+	}
+
+	BLOCKDECODER decode = DecodeBC7Block;
+	if (kind == BC_1)
+		decode = DecodeBC1Block;
+	else if (kind == BC_2)
+		decode = DecodeBC2Block;
+	else if (kind == BC_3)
+		decode = DecodeBC3Block;
+
+	if (!toHalf)
+	{
+		decode(static_cast<uint8_t *>(out), block);
+		return;
+	}
+	uint8_t texels[64];
+	decode(texels, block);
+	ConvertRGBA8ToRGBA16F(static_cast<uint16_t *>(out), texels, 16, srgb);
+}
+
+bool EncodeBCSurface(DXGI_FORMAT format, uint8_t * blocks, size_t blockPitch, const uint8_t * texels, size_t width, size_t height, size_t pitch, unsigned int threadCount)
+{
+	if (!IsBCEncodeFormat(format) || width == 0 || height == 0)
+		return false;
+
+	bool isSigned, srgb;
+	BCKIND kind = bcKind(format, isSigned, srgb);
+	BLOCKENCODER encode = EncodeBC7Block;
+	if (kind == BC_1)
+		encode = EncodeBC1Block;
+	else if (kind == BC_3)
+		encode = EncodeBC3Block;
+
+	size_t bytes = blockBytes(kind);
+	size_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	DX::ParallelFor(blocksHigh, surfaceThreads(blocksWide * blocksHigh, threadCount), [&](size_t row)
+	{
+		uint8_t block[64];
+		for (size_t column = 0; column < blocksWide; ++column)
+		{
+			for (size_t y = 0; y < 4; ++y)
+			{
+				const uint8_t * line = texels + min(row * 4 + y, height - 1) * pitch;
+				for (size_t x = 0; x < 4; ++x)
+					memcpy(block + (y * 4 + x) * 4, line + min(column * 4 + x, width - 1) * 4, 4);
+			}
+			encode(blocks + row * blockPitch + column * bytes, block);
+		}
+	});
+	return true;
+}
+
+bool DecodeBCSurface(DXGI_FORMAT format, DXGI_FORMAT outputFormat, void * texels, size_t pitch, const uint8_t * blocks, size_t blockPitch, size_t width, size_t height, unsigned int threadCount)
+{
+	bool isSigned, srgb;
+	BCKIND kind = bcKind(format, isSigned, srgb);
+	bool toHalf = outputFormat == DXGI_FORMAT_R16G16B16A16_FLOAT;
+	if (kind == BC_NONE || (!toHalf && outputFormat != DXGI_FORMAT_R8G8B8A8_UNORM) || width == 0 || height == 0)
+		return false;
+
+	// Built before the threads start, so none of them waits on the others for it.
+	if (toHalf)
+		halfTable();
+
+	size_t bytes = blockBytes(kind), texelBytes = toHalf ? 8 : 4;
+	size_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	uint8_t * out = static_cast<uint8_t *>(texels);
+	DX::ParallelFor(blocksHigh, surfaceThreads(blocksWide * blocksHigh, threadCount), [&](size_t row)
+	{
+		uint16_t decoded[64];
+		const uint8_t * decodedBytes = reinterpret_cast<const uint8_t *>(decoded);
+		for (size_t column = 0; column < blocksWide; ++column)
+		{
+			decodeBlock(kind, isSigned, srgb, toHalf, blocks + row * blockPitch + column * bytes, decoded);
+			size_t columns = min<size_t>(4, width - column * 4);
+			for (size_t y = 0; y < 4 && row * 4 + y < height; ++y)
+				memcpy(out + (row * 4 + y) * pitch + column * 4 * texelBytes, decodedBytes + y * 4 * texelBytes, columns * texelBytes);
+		}
+	});
+	return true;
+}
+
+void AddSurfaceError(SURFACEERROR &error, const uint8_t * a, size_t pitchA, const uint8_t * b, size_t pitchB, size_t width, size_t height)
+{
+	for (size_t y = 0; y < height; ++y)
+	{
+		const uint8_t * rowA = a + y * pitchA, * rowB = b + y * pitchB;
+		uint64_t squared[4] = { 0, 0, 0, 0 };
+		for (size_t x = 0; x < width * 4; ++x)
+		{
+			int difference = int(rowA[x]) - int(rowB[x]);
+			squared[x & 3] += uint64_t(difference * difference);
+		}
+		for (unsigned int c = 0; c < 4; ++c)
+			error.squared[c] += double(squared[c]);
+	}
+	error.texels += double(width) * double(height);
+}
+
+double SurfacePSNR(const SURFACEERROR &error, unsigned int firstChannel, unsigned int channelCount)
+{
+	double squared = 0.0;
+	for (unsigned int c = firstChannel; c < firstChannel + channelCount && c < 4; ++c)
+		squared += error.squared[c];
+	if (squared == 0.0 || error.texels == 0.0)
+		return PSNR_IDENTICAL;
+
+	double mean = squared / (error.texels * channelCount);
+	return 10.0 * log10(255.0 * 255.0 / mean);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../Common/DDSReader.h"
+
+// Block compression on the CPU, for cooking textures and for checking them. Like MeshOptimizer
+// nothing here needs a device, so it runs on a build box without a GPU. A block is 4x4 texels,
+// passed as 16 RGBA texels in rows; BC1 and BC4 blocks are 8 bytes, the others 16.
+//
+// The encoders work on a block at a time with DirectXMath vectors holding four texels of one
+// channel, which is SSE2 on x86 and x64 and NEON on ARM. Every format DDSTextureLoader takes
+// can be decoded.
+
+// BC1 makes the texels with alpha below 128 transparent, if there are any.
+void EncodeBC1Block(uint8_t block[8], const uint8_t texels[64]);
+// BC1 colors with the alpha of BC4.
+void EncodeBC3Block(uint8_t block[16], const uint8_t texels[64]);
+// Picks between mode 6 (one RGBA line, 16 steps) and, for opaque blocks, mode 1 (two RGB lines
+// split by the best of the 64 partitions).
+void EncodeBC7Block(uint8_t block[16], const uint8_t texels[64]);
+
+void DecodeBC1Block(uint8_t texels[64], const uint8_t block[8]);
+void DecodeBC2Block(uint8_t texels[64], const uint8_t block[16]);
+void DecodeBC3Block(uint8_t texels[64], const uint8_t block[16]);
+// Every mode, so blocks from other encoders decode too. Reserved modes come out transparent black.
+void DecodeBC7Block(uint8_t texels[64], const uint8_t block[16]);
+// One and two channel blocks, as floats 0..1 or, for snorm, -1..1 in red (and green); blue is 0
+// and alpha 1, the way the GPU samples them.
+void DecodeBC4Block(float texels[64], const uint8_t block[8], bool snorm);
+void DecodeBC5Block(float texels[64], const uint8_t block[16], bool snorm);
+// To half floats with alpha 1. Reserved modes come out black.
+void DecodeBC6HBlock(uint16_t texels[64], const uint8_t block[16], bool isSigned);
+
+// True for every BC format, including typeless ones, which decode as UNORM (UF16 for BC6H).
+bool IsBCFormat(DXGI_FORMAT format);
+// True for the formats with an encoder above, UNORM or UNORM_SRGB. The sRGB ones are encoded
+// from the same bytes; the conversion happens when the GPU samples them.
+bool IsBCEncodeFormat(DXGI_FORMAT format);
+
+// Compresses a width x height RGBA8 surface, rows pitch bytes apart, into rows of blocks
+// blockPitch bytes apart. Blocks hanging over the right or bottom edge repeat the edge texels.
+// Rows of blocks are spread over threadCount threads; 0 picks from the surface size.
+bool EncodeBCSurface(DXGI_FORMAT format, uint8_t * blocks, size_t blockPitch, const uint8_t * texels, size_t width, size_t height, size_t pitch, unsigned int threadCount = 0);
+
+// Decodes any BC surface to R8G8B8A8_UNORM or R16G16B16A16_FLOAT. RGBA8 keeps the stored bytes,
+// so sRGB stays sRGB, SNORM is biased to v * 0.5 + 0.5 and BC6H is clamped to 0..1. RGBA16F
+// holds what the GPU would sample: sRGB made linear, SNORM and BC6H as they are.
+bool DecodeBCSurface(DXGI_FORMAT format, DXGI_FORMAT outputFormat, void * texels, size_t pitch, const uint8_t * blocks, size_t blockPitch, size_t width, size_t height, unsigned int threadCount = 0);
+
+// RGBA8 texels to half floats, making the color channels linear if srgb.
+void ConvertRGBA8ToRGBA16F(uint16_t * halves, const uint8_t * texels, size_t texelCount, bool srgb);
+
+// Squared differences per channel between pairs of RGBA8 surfaces, summed over as many surfaces
+// as are added, for a PSNR over a whole mip chain.
+struct SURFACEERROR
+{
+	double squared[4];
+	double texels;
+};
+
+void AddSurfaceError(SURFACEERROR &error, const uint8_t * a, size_t pitchA, const uint8_t * b, size_t pitchB, size_t width, size_t height);
+
+// PSNR in dB over channelCount channels starting at firstChannel, e.g. 0, 3 for RGB and 3, 1 for
+// alpha. Identical surfaces give PSNR_IDENTICAL.
+static const double PSNR_IDENTICAL = 999.0;
+double SurfacePSNR(const SURFACEERROR &error, unsigned int firstChannel, unsigned int channelCount);
@@ -6,12 +6,20 @@ cbuffer ModelViewProjectionConstantBuffer : register(b0)
 	matrix projection;
 };
 
-// Per-vertex data used as input to the vertex shader.
+// Turns the quantized attributes back into object space. Matches VERTEXDECODE in ModelLoader.h.
+cbuffer VertexDecodeConstantBuffer : register(b1)
+{
+	float4 positionScale;
+	float4 positionOffset;
+	float4 uvScaleOffset;
+};
+
+// Per-vertex data used as input to the vertex shader (PACKEDVERTEX, 16 bytes).
 struct VertexShaderInput
 {
-	float3 pos : POSITION;
-	float3 uv : UV;
-	float3 normal : NORMAL;
+	float4 pos : POSITION;		// R16G16B16A16_UNORM inside the mesh bounds
+	float2 uv : UV;				// R16G16_UNORM inside the mesh's UV range
+	float2 normal : NORMAL;		// R16G16_SNORM octahedral
 };
 
 // Per-pixel color data passed through the pixel shader.
@@ -23,11 +31,20 @@ struct PixelShaderInput
     float3 world_pos : WORLDPOS;
 };
 
+// Octahedral normal decode, the inverse of encodeOctahedral in MeshOptimizer.cpp.
+float3 decodeOctahedral(float2 e)
+{
+	float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
 // Simple shader to do vertex processing on the GPU.
 PixelShaderInput main(VertexShaderInput input)
 {
 	PixelShaderInput output;
-	float4 pos = float4(input.pos, 1.0f);
+	float4 pos = float4(input.pos.xyz * positionScale.xyz + positionOffset.xyz, 1.0f);
 
 	//Grab the local space position in the vertex shader and add it to the pixel shader input.
 
@@ -39,9 +56,9 @@ PixelShaderInput main(VertexShaderInput input)
 	output.pos = pos;
 	
 	// Pass the color through without modification.
-	output.uv = input.uv;
+	output.uv = float3(input.uv * uvScaleOffset.xy + uvScaleOffset.zw, 0.0f);
 
-    output.normal = input.normal;
+    output.normal = decodeOctahedral(input.normal);
 
 	return output;
 }
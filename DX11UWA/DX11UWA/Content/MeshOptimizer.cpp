@@ -0,0 +1,1537 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include "../Common/ParallelFor.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+VCACHESTATS AnalyzeVertexCache(const unsigned int * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VCACHESTATS result = { 0.0f, 0.0f };
+	if (indexCount < 3 || vertexCount == 0)
+		return result;
+
+	// A vertex is in the FIFO if it was pushed less than cacheSize pushes ago.
+	vector<size_t> pushedAt(vertexCount, 0);
+	size_t pushes = 0;
+	size_t usedVertices = 0;
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		unsigned int v = indices[i];
+		if (pushedAt[v] == 0)
+			usedVertices++;
+
+		if (pushedAt[v] == 0 || pushes - pushedAt[v] >= cacheSize)
+			pushedAt[v] = ++pushes;
+	}
+
+	result.acmr = float(pushes) / float(indexCount / 3);
+	result.atvr = float(pushes) / float(usedVertices);
+	return result;
+}
+
+// Vertex to triangle adjacency in compressed form: the triangles using vertex v are
+// triangles[offsets[v]] .. triangles[offsets[v] + counts[v] - 1].
+struct TRIANGLEADJACENCY
+{
+	vector<unsigned int> counts;
+	vector<unsigned int> offsets;
+	vector<unsigned int> triangles;
+};
+
+static void buildAdjacency(TRIANGLEADJACENCY &adjacency, const unsigned int * indices, size_t indexCount, size_t vertexCount)
+{
+	adjacency.counts.assign(vertexCount, 0);
+	adjacency.offsets.resize(vertexCount);
+	adjacency.triangles.resize(indexCount);
+
+	for (size_t i = 0; i < indexCount; ++i)
+		adjacency.counts[indices[i]]++;
+
+	unsigned int offset = 0;
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		adjacency.offsets[v] = offset;
+		offset += adjacency.counts[v];
+	}
+
+	// Fill using the offsets as cursors, then put them back.
+	for (size_t i = 0; i < indexCount; ++i)
+		adjacency.triangles[adjacency.offsets[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacency.offsets[v] -= adjacency.counts[v];
+}
+
+void OptimizeVertexCache(unsigned int * destination, const unsigned int * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	TRIANGLEADJACENCY adjacency;
+	buildAdjacency(adjacency, indices, indexCount, vertexCount);
+
+	// Triangles not yet emitted that use each vertex.
+	vector<unsigned int> live(adjacency.counts);
+	// Time stamp of each vertex's last entry into the simulated cache.
+	vector<unsigned int> cacheTime(vertexCount, 0);
+	vector<bool> emitted(triangleCount, false);
+	// Recently referenced vertices to fall back on when the fan runs dry.
+	vector<unsigned int> deadEnd;
+	deadEnd.reserve(indexCount);
+	vector<unsigned int> candidates;
+	candidates.reserve(64);
+
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0;
+	size_t written = 0;
+	long long fanning = 0;
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		unsigned int v = static_cast<unsigned int>(fanning);
+		const unsigned int * fan = &adjacency.triangles[0] + adjacency.offsets[v];
+		for (unsigned int t = 0; t < adjacency.counts[v]; ++t)
+		{
+			unsigned int triangle = fan[t];
+			if (emitted[triangle])
+				continue;
+
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				unsigned int w = indices[triangle * 3 + corner];
+				destination[written++] = w;
+				deadEnd.push_back(w);
+				candidates.push_back(w);
+				live[w]--;
+
+				if (time - cacheTime[w] > cacheSize)
+					cacheTime[w] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// Pick the candidate that will still be in the cache after its remaining triangles
+		// are emitted, preferring the one that entered the cache earliest.
+		long long next = -1;
+		long long bestPriority = -1;
+		for (unsigned int w : candidates)
+		{
+			if (live[w] == 0)
+				continue;
+
+			long long priority = 0;
+			if (time - cacheTime[w] + 2 * live[w] <= cacheSize)
+				priority = time - cacheTime[w];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = w;
+			}
+		}
+
+		if (next == -1)
+		{
+			// Dead end: try recently used vertices first, then walk forward through the mesh.
+			while (!deadEnd.empty())
+			{
+				unsigned int w = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[w] > 0)
+				{
+					next = w;
+					break;
+				}
+			}
+
+			while (next == -1 && cursor < vertexCount)
+			{
+				if (live[cursor] > 0)
+					next = static_cast<long long>(cursor);
+				else
+					cursor++;
+			}
+		}
+
+		fanning = next;
+	}
+}
+
+size_t OptimizeVertexFetch(VERTEX * destination, unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount)
+{
+	static const unsigned int UNUSED = 0xffffffff;
+	vector<unsigned int> remap(vertexCount, UNUSED);
+	unsigned int next = 0;
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		unsigned int &target = remap[indices[i]];
+		if (target == UNUSED)
+		{
+			target = next++;
+			destination[target] = vertices[indices[i]];
+		}
+		indices[i] = target;
+	}
+
+	return next;
+}
+
+// Resolution of the square target each overdraw view is rasterized into.
+static const int OVERDRAW_GRID = 256;
+
+// Rasterizes one triangle whose vertices are already in grid space (x, y in pixels, z depth)
+// with a less-than depth test. Both windings are drawn since the leaves are two sided.
+static void rasterizeTriangle(const XMFLOAT3 &a, const XMFLOAT3 &b, const XMFLOAT3 &c, vector<float> &depth, vector<unsigned char> &touched, OVERDRAWSTATS &result)
+{
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (fabsf(area) < 1e-12f)
+		return;
+
+	int minX = max(0, int(floorf(min(a.x, min(b.x, c.x)))));
+	int maxX = min(OVERDRAW_GRID - 1, int(ceilf(max(a.x, max(b.x, c.x)))));
+	int minY = max(0, int(floorf(min(a.y, min(b.y, c.y)))));
+	int maxY = min(OVERDRAW_GRID - 1, int(ceilf(max(a.y, max(b.y, c.y)))));
+
+	float invArea = 1.0f / area;
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float py = y + 0.5f;
+		for (int x = minX; x <= maxX; ++x)
+		{
+			float px = x + 0.5f;
+
+			// Barycentric weights; all three share the sign of the area inside the triangle.
+			float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) * invArea;
+			float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) * invArea;
+			float w2 = 1.0f - w0 - w1;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			float z = w0 * a.z + w1 * b.z + w2 * c.z;
+			size_t pixel = size_t(y) * OVERDRAW_GRID + x;
+
+			if (!touched[pixel])
+			{
+				touched[pixel] = 1;
+				result.pixelsCovered++;
+			}
+
+			if (z < depth[pixel])
+			{
+				depth[pixel] = z;
+				result.pixelsShaded++;
+			}
+		}
+	}
+}
+
+OVERDRAWSTATS AnalyzeOverdraw(const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount, unsigned int viewCount)
+{
+	OVERDRAWSTATS result = { 0, 0, 0.0f };
+	if (indexCount < 3 || vertexCount == 0 || viewCount == 0)
+		return result;
+
+	// Bounding sphere (box center and the farthest vertex from it) so every view frames the mesh.
+	XMFLOAT3 lo = vertices[0].position, hi = vertices[0].position;
+	for (size_t i = 1; i < vertexCount; ++i)
+	{
+		const XMFLOAT3 &p = vertices[i].position;
+		lo = XMFLOAT3(min(lo.x, p.x), min(lo.y, p.y), min(lo.z, p.z));
+		hi = XMFLOAT3(max(hi.x, p.x), max(hi.y, p.y), max(hi.z, p.z));
+	}
+	XMFLOAT3 center((lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f);
+	float radius = 0.0f;
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		const XMFLOAT3 &p = vertices[i].position;
+		float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+		radius = max(radius, sqrtf(dx * dx + dy * dy + dz * dz));
+	}
+	if (radius <= 0.0f)
+		return result;
+
+	vector<float> depth(OVERDRAW_GRID * OVERDRAW_GRID);
+	vector<unsigned char> touched(OVERDRAW_GRID * OVERDRAW_GRID);
+	vector<XMFLOAT3> projected(vertexCount);
+	float scale = (OVERDRAW_GRID * 0.5f) / radius;
+
+	for (unsigned int view = 0; view < viewCount; ++view)
+	{
+		// Fibonacci sphere directions give an even spread for any view count.
+		float z = 1.0f - 2.0f * (view + 0.5f) / viewCount;
+		float r = sqrtf(max(0.0f, 1.0f - z * z));
+		float phi = view * 2.39996323f;
+		XMFLOAT3 forward(r * cosf(phi), r * sinf(phi), z);
+
+		// Any vector not parallel to forward gives a basis for the image plane.
+		XMFLOAT3 helper = fabsf(forward.y) < 0.99f ? XMFLOAT3(0.0f, 1.0f, 0.0f) : XMFLOAT3(1.0f, 0.0f, 0.0f);
+		XMFLOAT3 right(helper.y * forward.z - helper.z * forward.y, helper.z * forward.x - helper.x * forward.z, helper.x * forward.y - helper.y * forward.x);
+		float length = sqrtf(right.x * right.x + right.y * right.y + right.z * right.z);
+		right = XMFLOAT3(right.x / length, right.y / length, right.z / length);
+		XMFLOAT3 up(forward.y * right.z - forward.z * right.y, forward.z * right.x - forward.x * right.z, forward.x * right.y - forward.y * right.x);
+
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			const XMFLOAT3 &p = vertices[i].position;
+			float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+			projected[i] = XMFLOAT3(
+				(dx * right.x + dy * right.y + dz * right.z) * scale + OVERDRAW_GRID * 0.5f,
+				(dx * up.x + dy * up.y + dz * up.z) * scale + OVERDRAW_GRID * 0.5f,
+				dx * forward.x + dy * forward.y + dz * forward.z);
+		}
+
+		fill(depth.begin(), depth.end(), FLT_MAX);
+		fill(touched.begin(), touched.end(), 0);
+
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+			rasterizeTriangle(projected[indices[i]], projected[indices[i + 1]], projected[indices[i + 2]], depth, touched, result);
+	}
+
+	result.overdraw = result.pixelsCovered ? float(result.pixelsShaded) / float(result.pixelsCovered) : 0.0f;
+	return result;
+}
+
+// Vertex cache misses a triangle causes in a simulated FIFO. pushedAt and pushes carry the
+// cache state from one call to the next.
+static unsigned int triangleMisses(const unsigned int * triangle, vector<size_t> &pushedAt, size_t &pushes, unsigned int cacheSize)
+{
+	unsigned int misses = 0;
+	for (int corner = 0; corner < 3; ++corner)
+	{
+		size_t &stamp = pushedAt[triangle[corner]];
+		if (stamp == 0 || pushes - stamp >= cacheSize)
+		{
+			stamp = ++pushes;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+void OptimizeOverdraw(unsigned int * destination, const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount, float threshold, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Hard boundaries: triangles where the cache is already cold (all three vertices miss).
+	// Starting a cluster there costs nothing in cache efficiency.
+	vector<size_t> hard;
+	{
+		vector<size_t> pushedAt(vertexCount, 0);
+		size_t pushes = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			if (triangleMisses(indices + t * 3, pushedAt, pushes, cacheSize) == 3)
+				hard.push_back(t);
+		}
+		if (hard.empty() || hard[0] != 0)
+			hard.insert(hard.begin(), 0);
+	}
+
+	// Soft boundaries: inside each hard cluster, cut again wherever the piece so far, replayed
+	// from a cold cache, is within the threshold of the whole hard cluster's ACMR.
+	vector<size_t> clusters;
+	{
+		vector<size_t> pushedAt(vertexCount, 0);
+		size_t pushes = 0;
+
+		for (size_t h = 0; h < hard.size(); ++h)
+		{
+			size_t start = hard[h];
+			size_t end = h + 1 < hard.size() ? hard[h + 1] : triangleCount;
+
+			unsigned int clusterMisses = 0;
+			pushes += cacheSize + 1; // flush
+			for (size_t t = start; t < end; ++t)
+				clusterMisses += triangleMisses(indices + t * 3, pushedAt, pushes, cacheSize);
+			float clusterAcmr = float(clusterMisses) / float(end - start);
+
+			size_t pieceStart = start;
+			unsigned int pieceMisses = 0;
+			pushes += cacheSize + 1; // flush
+			clusters.push_back(start);
+
+			for (size_t t = start; t < end; ++t)
+			{
+				pieceMisses += triangleMisses(indices + t * 3, pushedAt, pushes, cacheSize);
+				float pieceAcmr = float(pieceMisses) / float(t + 1 - pieceStart);
+
+				if (t + 1 < end && pieceAcmr <= clusterAcmr * threshold)
+				{
+					pieceStart = t + 1;
+					pieceMisses = 0;
+					pushes += cacheSize + 1;
+					clusters.push_back(pieceStart);
+				}
+			}
+		}
+	}
+
+	// Area weighted centroid of the whole mesh.
+	vector<XMFLOAT3> faceNormals(triangleCount);
+	vector<XMFLOAT3> faceCenters(triangleCount);
+	vector<float> faceAreas(triangleCount);
+	XMFLOAT3 meshCenter(0.0f, 0.0f, 0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const XMFLOAT3 &a = vertices[indices[t * 3 + 0]].position;
+		const XMFLOAT3 &b = vertices[indices[t * 3 + 1]].position;
+		const XMFLOAT3 &c = vertices[indices[t * 3 + 2]].position;
+
+		XMFLOAT3 e1(b.x - a.x, b.y - a.y, b.z - a.z);
+		XMFLOAT3 e2(c.x - a.x, c.y - a.y, c.z - a.z);
+		XMFLOAT3 n(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+		float area = 0.5f * sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+		faceNormals[t] = n;	// length is twice the area, which is the weight we want
+		faceCenters[t] = XMFLOAT3((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f);
+		faceAreas[t] = area;
+
+		meshCenter.x += faceCenters[t].x * area;
+		meshCenter.y += faceCenters[t].y * area;
+		meshCenter.z += faceCenters[t].z * area;
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCenter = XMFLOAT3(meshCenter.x / meshArea, meshCenter.y / meshArea, meshCenter.z / meshArea);
+
+	// Clusters sitting far out along the way they face are the ones most likely to be in front.
+	struct CLUSTERSORT
+	{
+		float key;
+		size_t cluster;
+	};
+	vector<CLUSTERSORT> order(clusters.size());
+
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		size_t start = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		XMFLOAT3 center(0.0f, 0.0f, 0.0f), normal(0.0f, 0.0f, 0.0f);
+		float area = 0.0f;
+		for (size_t t = start; t < end; ++t)
+		{
+			center.x += faceCenters[t].x * faceAreas[t];
+			center.y += faceCenters[t].y * faceAreas[t];
+			center.z += faceCenters[t].z * faceAreas[t];
+			normal.x += faceNormals[t].x;
+			normal.y += faceNormals[t].y;
+			normal.z += faceNormals[t].z;
+			area += faceAreas[t];
+		}
+
+		float key = 0.0f;
+		float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		if (area > 0.0f && length > 0.0f)
+		{
+			center = XMFLOAT3(center.x / area - meshCenter.x, center.y / area - meshCenter.y, center.z / area - meshCenter.z);
+			key = (center.x * normal.x + center.y * normal.y + center.z * normal.z) / length;
+		}
+
+		order[c].key = key;
+		order[c].cluster = c;
+	}
+
+	stable_sort(order.begin(), order.end(), [](const CLUSTERSORT &a, const CLUSTERSORT &b) { return a.key > b.key; });
+
+	size_t written = 0;
+	for (const CLUSTERSORT &entry : order)
+	{
+		size_t start = clusters[entry.cluster];
+		size_t end = entry.cluster + 1 < clusters.size() ? clusters[entry.cluster + 1] : triangleCount;
+		for (size_t i = start * 3; i < end * 3; ++i)
+			destination[written++] = indices[i];
+	}
+}
+
+VERTEXDECODE ComputeVertexDecode(const VERTEX * vertices, size_t vertexCount)
+{
+	XMFLOAT3 positionMin(FLT_MAX, FLT_MAX, FLT_MAX), positionMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	XMFLOAT2 uvMin(FLT_MAX, FLT_MAX), uvMax(-FLT_MAX, -FLT_MAX);
+
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		const VERTEX &v = vertices[i];
+		positionMin = XMFLOAT3(min(positionMin.x, v.position.x), min(positionMin.y, v.position.y), min(positionMin.z, v.position.z));
+		positionMax = XMFLOAT3(max(positionMax.x, v.position.x), max(positionMax.y, v.position.y), max(positionMax.z, v.position.z));
+		uvMin = XMFLOAT2(min(uvMin.x, v.UV.x), min(uvMin.y, v.UV.y));
+		uvMax = XMFLOAT2(max(uvMax.x, v.UV.x), max(uvMax.y, v.UV.y));
+	}
+
+	VERTEXDECODE decode;
+	if (vertexCount == 0)
+	{
+		decode.positionScale = decode.positionOffset = decode.uvScaleOffset = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+		return decode;
+	}
+
+	// A flat axis gets scale 0, so every vertex decodes to the offset exactly.
+	decode.positionScale = XMFLOAT4(positionMax.x - positionMin.x, positionMax.y - positionMin.y, positionMax.z - positionMin.z, 0.0f);
+	decode.positionOffset = XMFLOAT4(positionMin.x, positionMin.y, positionMin.z, 1.0f);
+	decode.uvScaleOffset = XMFLOAT4(uvMax.x - uvMin.x, uvMax.y - uvMin.y, uvMin.x, uvMin.y);
+	return decode;
+}
+
+static uint16_t quantizeUnorm(float value, float offset, float scale)
+{
+	if (scale <= 0.0f)
+		return 0;
+
+	float t = (value - offset) / scale;
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	return static_cast<uint16_t>(t * 65535.0f + 0.5f);
+}
+
+static int16_t quantizeSnorm(float value)
+{
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return static_cast<int16_t>(value >= 0.0f ? value * 32767.0f + 0.5f : value * 32767.0f - 0.5f);
+}
+
+// Octahedral normal encoding (Cigolle et al. 2014): project onto the octahedron
+// |x| + |y| + |z| = 1 and fold the lower half over the diagonals.
+static void encodeOctahedral(const XMFLOAT3 &n, int16_t out[2])
+{
+	float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (length == 0.0f)
+	{
+		out[0] = out[1] = 0;
+		return;
+	}
+
+	float x = n.x / length, y = n.y / length;
+	if (n.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	out[0] = quantizeSnorm(x);
+	out[1] = quantizeSnorm(y);
+}
+
+// Same math as decodeOctahedral in LoadedVertexShader.hlsl.
+static XMFLOAT3 decodeOctahedral(const int16_t in[2])
+{
+	// SNORM maps -32768 and -32767 both to -1.
+	float x = max(in[0] / 32767.0f, -1.0f), y = max(in[1] / 32767.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = sqrtf(x * x + y * y + z * z);
+	return XMFLOAT3(x / length, y / length, z / length);
+}
+
+QUANTIZEERROR QuantizeVertices(PACKEDVERTEX * destination, const VERTEX * vertices, size_t vertexCount, const VERTEXDECODE &decode)
+{
+	QUANTIZEERROR error = { 0.0f, 0.0f, 0.0f };
+	const float positionScale[3] = { decode.positionScale.x, decode.positionScale.y, decode.positionScale.z };
+	const float positionOffset[3] = { decode.positionOffset.x, decode.positionOffset.y, decode.positionOffset.z };
+	const float uvScale[2] = { decode.uvScaleOffset.x, decode.uvScaleOffset.y };
+	const float uvOffset[2] = { decode.uvScaleOffset.z, decode.uvScaleOffset.w };
+
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		const VERTEX &v = vertices[i];
+		PACKEDVERTEX &packed = destination[i];
+
+		const float position[3] = { v.position.x, v.position.y, v.position.z };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			packed.position[axis] = quantizeUnorm(position[axis], positionOffset[axis], positionScale[axis]);
+			float decoded = packed.position[axis] / 65535.0f * positionScale[axis] + positionOffset[axis];
+			error.position = max(error.position, fabsf(decoded - position[axis]));
+		}
+		packed.position[3] = 0;
+
+		const float uv[2] = { v.UV.x, v.UV.y };
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			packed.UV[axis] = quantizeUnorm(uv[axis], uvOffset[axis], uvScale[axis]);
+			float decoded = packed.UV[axis] / 65535.0f * uvScale[axis] + uvOffset[axis];
+			error.uv = max(error.uv, fabsf(decoded - uv[axis]));
+		}
+
+		encodeOctahedral(v.normal, packed.normal);
+		if (v.normal.x != 0.0f || v.normal.y != 0.0f || v.normal.z != 0.0f)
+		{
+			// atan2 of |cross| and dot stays accurate for the tiny angles involved, acos does not.
+			XMFLOAT3 d = decodeOctahedral(packed.normal);
+			const XMFLOAT3 &n = v.normal;
+			float cx = d.y * n.z - d.z * n.y, cy = d.z * n.x - d.x * n.z, cz = d.x * n.y - d.y * n.x;
+			float angle = atan2f(sqrtf(cx * cx + cy * cy + cz * cz), d.x * n.x + d.y * n.y + d.z * n.z);
+			error.normal = max(error.normal, angle * (180.0f / XM_PI));
+		}
+	}
+
+	return error;
+}
+
+// Sum of squared distances to a set of weighted planes, stored as the upper half of the
+// symmetric 4x4 matrix. Dividing by the total weight turns it into a squared distance.
+struct QUADRIC
+{
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+};
+
+static void addPlane(QUADRIC &q, double nx, double ny, double nz, double d, double weight)
+{
+	q.a00 += weight * nx * nx;
+	q.a01 += weight * nx * ny;
+	q.a02 += weight * nx * nz;
+	q.a11 += weight * ny * ny;
+	q.a12 += weight * ny * nz;
+	q.a22 += weight * nz * nz;
+	q.b0 += weight * nx * d;
+	q.b1 += weight * ny * d;
+	q.b2 += weight * nz * d;
+	q.c += weight * d * d;
+	q.weight += weight;
+}
+
+static void addQuadric(QUADRIC &q, const QUADRIC &r)
+{
+	q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02;
+	q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+	q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+	q.c += r.c;
+	q.weight += r.weight;
+}
+
+// Squared distance of p to the quadric's planes, averaged by weight.
+static double quadricError(const QUADRIC &q, const XMFLOAT3 &p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double e = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+		+ 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+		+ 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z)
+		+ q.c;
+	return q.weight > 0.0 ? fabs(e) / q.weight : 0.0;
+}
+
+static const unsigned int EMPTY_TARGET = 0xffffffff;
+
+// How a vertex may move during simplification.
+enum VERTEXKIND
+{
+	KIND_MANIFOLD,	// inside a surface, one vertex at this position
+	KIND_BORDER,	// on exactly one open edge loop
+	KIND_SEAM,		// inside a surface, several vertices at this position that differ in UV or normal
+	KIND_LOCKED,	// anything else: border corners, bowties, too many seams
+};
+
+// Seam vertices with more vertices than this at their position are locked.
+static const unsigned int MAX_WEDGES = 8;
+
+// canCollapse[from][to]. A vertex may only collapse onto one that keeps its own kind.
+static const unsigned char canCollapse[4][4] =
+{
+	{ 1, 1, 1, 1 },
+	{ 0, 1, 0, 1 },
+	{ 0, 0, 1, 1 },
+	{ 0, 0, 0, 0 },
+};
+
+// Extra weight of the planes that hold open borders in place.
+static const double BORDER_WEIGHT = 10.0;
+
+// Ratio between the largest and the goal error allowed in one pass, as in meshoptimizer.
+static const float PASS_ERROR_BOUND = 1.5f;
+
+static inline unsigned int nextCorner(size_t corner)
+{
+	return static_cast<unsigned int>(corner - corner % 3 + (corner + 1) % 3);
+}
+
+// True if some triangle has a directed edge from a vertex at a's position to one at b's.
+static bool hasPositionEdge(const TRIANGLEADJACENCY &adjacency, const unsigned int * indices, const vector<unsigned int> &remap, const vector<unsigned int> &wedge, unsigned int a, unsigned int b)
+{
+	unsigned int w = a;
+	do
+	{
+		const unsigned int * fan = &adjacency.triangles[0] + adjacency.offsets[w];
+		for (unsigned int t = 0; t < adjacency.counts[w]; ++t)
+		{
+			const unsigned int * triangle = indices + fan[t] * 3;
+			for (int corner = 0; corner < 3; ++corner)
+				if (triangle[corner] == w && remap[triangle[(corner + 1) % 3]] == remap[b])
+					return true;
+		}
+		w = wedge[w];
+	} while (w != a);
+	return false;
+}
+
+// For every vertex at v0's position, finds the vertex at v1's position that shares a triangle
+// with it, so each side of a UV or normal seam collapses onto the same side. Fails if a vertex
+// has no such neighbour, or more than one (a seam that ends between them).
+static bool matchWedges(const TRIANGLEADJACENCY &adjacency, const unsigned int * indices, const vector<unsigned int> &remap, const vector<unsigned int> &wedge, unsigned int v0, unsigned int v1, unsigned int targets[MAX_WEDGES])
+{
+	unsigned int count = 0;
+	unsigned int w = v0;
+	do
+	{
+		unsigned int target = EMPTY_TARGET;
+		const unsigned int * fan = &adjacency.triangles[0] + adjacency.offsets[w];
+		for (unsigned int t = 0; t < adjacency.counts[w]; ++t)
+		{
+			const unsigned int * triangle = indices + fan[t] * 3;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				if (remap[triangle[corner]] != remap[v1])
+					continue;
+				if (target != EMPTY_TARGET && target != triangle[corner])
+					return false;
+				target = triangle[corner];
+			}
+		}
+
+		if (target == EMPTY_TARGET)
+			return false;
+
+		targets[count++] = target;
+		w = wedge[w];
+	} while (w != v0);
+
+	return true;
+}
+
+// Groups vertices that share a position: remap points at the first vertex of each group
+// and wedge links every group into a ring.
+static void buildPositionGroups(vector<unsigned int> &remap, vector<unsigned int> &wedge, const VERTEX * vertices, size_t vertexCount)
+{
+	vector<unsigned int> byPosition(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		byPosition[v] = static_cast<unsigned int>(v);
+	sort(byPosition.begin(), byPosition.end(), [vertices](unsigned int a, unsigned int b)
+	{
+		const XMFLOAT3 &p = vertices[a].position, &q = vertices[b].position;
+		if (p.x != q.x) return p.x < q.x;
+		if (p.y != q.y) return p.y < q.y;
+		if (p.z != q.z) return p.z < q.z;
+		return a < b;
+	});
+
+	remap.resize(vertexCount);
+	wedge.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount;)
+	{
+		size_t j = i + 1;
+		const XMFLOAT3 &p = vertices[byPosition[i]].position;
+		while (j < vertexCount && vertices[byPosition[j]].position.x == p.x && vertices[byPosition[j]].position.y == p.y && vertices[byPosition[j]].position.z == p.z)
+			j++;
+		for (size_t k = i; k < j; ++k)
+		{
+			remap[byPosition[k]] = byPosition[i];
+			wedge[byPosition[k]] = byPosition[k + 1 < j ? k + 1 : i];
+		}
+		i = j;
+	}
+}
+
+static XMFLOAT3 triangleNormal(const XMFLOAT3 &a, const XMFLOAT3 &b, const XMFLOAT3 &c)
+{
+	float ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+	float vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+	return XMFLOAT3(uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx);
+}
+
+// True if moving v0 onto v1's position would turn any of v0's remaining triangles over.
+static bool collapseFlips(const TRIANGLEADJACENCY &adjacency, const unsigned int * indices, const VERTEX * vertices, unsigned int v0, unsigned int v1)
+{
+	const unsigned int * fan = &adjacency.triangles[0] + adjacency.offsets[v0];
+	for (unsigned int t = 0; t < adjacency.counts[v0]; ++t)
+	{
+		const unsigned int * triangle = indices + fan[t] * 3;
+		if (triangle[0] == v1 || triangle[1] == v1 || triangle[2] == v1)
+			continue;
+
+		XMFLOAT3 before[3], after[3];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			before[corner] = vertices[triangle[corner]].position;
+			after[corner] = triangle[corner] == v0 ? vertices[v1].position : before[corner];
+		}
+
+		XMFLOAT3 n0 = triangleNormal(before[0], before[1], before[2]);
+		XMFLOAT3 n1 = triangleNormal(after[0], after[1], after[2]);
+		if (n0.x * n1.x + n0.y * n1.y + n0.z * n1.z <= 0.0f)
+			return true;
+	}
+	return false;
+}
+
+struct EDGECOLLAPSE
+{
+	unsigned int v0, v1;
+	float error;
+};
+
+size_t SimplifyMesh(unsigned int * destination, const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount, size_t targetIndexCount, float &resultError)
+{
+	resultError = 0.0f;
+	if (destination != indices)
+		memmove(destination, indices, indexCount * sizeof(unsigned int));
+	if (indexCount < 3 || vertexCount == 0)
+		return indexCount;
+
+	vector<unsigned int> remap, wedge;
+	buildPositionGroups(remap, wedge, vertices, vertexCount);
+
+	TRIANGLEADJACENCY adjacency;
+	buildAdjacency(adjacency, destination, indexCount, vertexCount);
+
+	// Count the open edges around each position; a border has one leaving and one arriving.
+	vector<unsigned char> openOut(vertexCount, 0), openIn(vertexCount, 0);
+	for (size_t corner = 0; corner < indexCount; ++corner)
+	{
+		unsigned int a = destination[corner], b = destination[nextCorner(corner)];
+		if (!hasPositionEdge(adjacency, destination, remap, wedge, b, a))
+		{
+			openOut[remap[a]] = static_cast<unsigned char>(min(openOut[remap[a]] + 1, 255));
+			openIn[remap[b]] = static_cast<unsigned char>(min(openIn[remap[b]] + 1, 255));
+		}
+	}
+
+	vector<unsigned char> kind(vertexCount, KIND_LOCKED);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		unsigned int wedges = 1;
+		for (unsigned int w = wedge[v]; w != v; w = wedge[w])
+			wedges++;
+
+		unsigned int out = openOut[remap[v]], in = openIn[remap[v]];
+		if (wedges > MAX_WEDGES)
+			kind[v] = KIND_LOCKED;
+		else if (out == 1 && in == 1)
+			kind[v] = KIND_BORDER;
+		else if (out == 0 && in == 0)
+			kind[v] = wedges == 1 ? KIND_MANIFOLD : KIND_SEAM;
+	}
+
+	// Quadrics live on the first vertex of each position group.
+	vector<QUADRIC> quadrics(vertexCount);
+	memset(quadrics.data(), 0, vertexCount * sizeof(QUADRIC));
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const XMFLOAT3 &p0 = vertices[destination[i]].position;
+		const XMFLOAT3 &p1 = vertices[destination[i + 1]].position;
+		const XMFLOAT3 &p2 = vertices[destination[i + 2]].position;
+		XMFLOAT3 n = triangleNormal(p0, p1, p2);
+		double length = sqrt(double(n.x) * n.x + double(n.y) * n.y + double(n.z) * n.z);
+		if (length == 0.0)
+			continue;
+
+		double nx = n.x / length, ny = n.y / length, nz = n.z / length;
+		double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+		for (int corner = 0; corner < 3; ++corner)
+			addPlane(quadrics[remap[destination[i + corner]]], nx, ny, nz, d, length * 0.5);
+
+		// Open edges also get a plane standing on the edge, so borders keep their outline.
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			unsigned int a = destination[i + corner], b = destination[i + (corner + 1) % 3];
+			if (hasPositionEdge(adjacency, destination, remap, wedge, b, a))
+				continue;
+
+			const XMFLOAT3 &pa = vertices[a].position, &pb = vertices[b].position;
+			double ex = pb.x - pa.x, ey = pb.y - pa.y, ez = pb.z - pa.z;
+			double edgeLength = sqrt(ex * ex + ey * ey + ez * ez);
+			double bx = ey * nz - ez * ny, by = ez * nx - ex * nz, bz = ex * ny - ey * nx;
+			double bLength = sqrt(bx * bx + by * by + bz * bz);
+			if (bLength == 0.0)
+				continue;
+
+			bx /= bLength; by /= bLength; bz /= bLength;
+			double bd = -(bx * pa.x + by * pa.y + bz * pa.z);
+			addPlane(quadrics[remap[a]], bx, by, bz, bd, edgeLength * edgeLength * BORDER_WEIGHT);
+			addPlane(quadrics[remap[b]], bx, by, bz, bd, edgeLength * edgeLength * BORDER_WEIGHT);
+		}
+	}
+
+	vector<EDGECOLLAPSE> collapses;
+	vector<unsigned int> collapseRemap(vertexCount);
+	vector<unsigned char> touched(vertexCount);
+	float maxError = 0.0f;
+
+	while (indexCount > targetIndexCount)
+	{
+		// Cheapest legal direction of every edge.
+		collapses.clear();
+		for (size_t corner = 0; corner < indexCount; ++corner)
+		{
+			unsigned int a = destination[corner], b = destination[nextCorner(corner)];
+			EDGECOLLAPSE best = { 0, 0, FLT_MAX };
+
+			for (int direction = 0; direction < 2; ++direction)
+			{
+				unsigned int v0 = direction ? b : a, v1 = direction ? a : b;
+				if (remap[v0] == remap[v1] || !canCollapse[kind[v0]][kind[v1]])
+					continue;
+
+				if (kind[v0] == KIND_BORDER &&
+					hasPositionEdge(adjacency, destination, remap, wedge, v0, v1) && hasPositionEdge(adjacency, destination, remap, wedge, v1, v0))
+					continue;
+
+				unsigned int targets[MAX_WEDGES];
+				if (!matchWedges(adjacency, destination, remap, wedge, v0, v1, targets))
+					continue;
+
+				QUADRIC q = quadrics[remap[v0]];
+				addQuadric(q, quadrics[remap[v1]]);
+				float error = float(quadricError(q, vertices[v1].position));
+				if (error < best.error)
+				{
+					best.v0 = v0;
+					best.v1 = v1;
+					best.error = error;
+				}
+			}
+
+			if (best.error != FLT_MAX)
+				collapses.push_back(best);
+		}
+
+		if (collapses.empty())
+			break;
+
+		sort(collapses.begin(), collapses.end(), [](const EDGECOLLAPSE &x, const EDGECOLLAPSE &y) { return x.error < y.error; });
+
+		// Each collapse removes about two triangles. Take enough of the cheapest to reach the
+		// target, but nothing much worse than the last one needed.
+		size_t trianglesToRemove = (indexCount - targetIndexCount) / 3;
+		size_t goal = min(collapses.size() - 1, trianglesToRemove / 2);
+		float errorLimit = collapses[goal].error * PASS_ERROR_BOUND;
+
+		for (size_t v = 0; v < vertexCount; ++v)
+			collapseRemap[v] = static_cast<unsigned int>(v);
+		memset(touched.data(), 0, vertexCount);
+
+		size_t removed = 0;
+		size_t applied = 0;
+		for (const EDGECOLLAPSE &c : collapses)
+		{
+			if (removed >= trianglesToRemove || c.error > errorLimit)
+				break;
+
+			unsigned int v0 = c.v0, v1 = c.v1;
+			unsigned int targets[MAX_WEDGES];
+			if (!matchWedges(adjacency, destination, remap, wedge, v0, v1, targets))
+				continue;
+
+			bool blocked = false;
+			unsigned int w = v0;
+			for (unsigned int m = 0; !blocked; ++m)
+			{
+				blocked = touched[w] || touched[targets[m]] || collapseFlips(adjacency, destination, vertices, w, targets[m]);
+				w = wedge[w];
+				if (w == v0)
+					break;
+			}
+			if (blocked)
+				continue;
+
+			// Lock every vertex whose triangles change, so later collapses in this pass see
+			// the geometry they were costed against.
+			w = v0;
+			for (unsigned int m = 0; ; ++m)
+			{
+				const unsigned int * fan = &adjacency.triangles[0] + adjacency.offsets[w];
+				for (unsigned int t = 0; t < adjacency.counts[w]; ++t)
+				{
+					const unsigned int * triangle = destination + fan[t] * 3;
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+					if (triangle[0] == targets[m] || triangle[1] == targets[m] || triangle[2] == targets[m])
+						removed++;
+				}
+
+				collapseRemap[w] = targets[m];
+				w = wedge[w];
+				if (w == v0)
+					break;
+			}
+			addQuadric(quadrics[remap[v1]], quadrics[remap[v0]]);
+
+			maxError = max(maxError, c.error);
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		// Rewrite the triangles and drop the ones that collapsed to a line.
+		size_t written = 0;
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			unsigned int a = collapseRemap[destination[i]];
+			unsigned int b = collapseRemap[destination[i + 1]];
+			unsigned int c = collapseRemap[destination[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			destination[written++] = a;
+			destination[written++] = b;
+			destination[written++] = c;
+		}
+		indexCount = written;
+
+		buildAdjacency(adjacency, destination, indexCount, vertexCount);
+	}
+
+	resultError = sqrtf(maxError);
+	return indexCount;
+}
+
+// How much a triangle facing away from the meshlet's average normal counts against it,
+// in units of new vertices. Keeps normal cones narrow enough to cull.
+static const float MESHLET_CONE_WEIGHT = 0.5f;
+
+static void finishMeshlet(MESHLET &meshlet, const unsigned int * indices, const VERTEX * vertices, const vector<XMFLOAT3> &faceNormals)
+{
+	const unsigned int * begin = indices + meshlet.indexOffset;
+	const unsigned int * end = begin + meshlet.indexCount;
+
+	// Sphere around the center of the box.
+	XMFLOAT3 low(FLT_MAX, FLT_MAX, FLT_MAX), high(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const unsigned int * i = begin; i < end; ++i)
+	{
+		const XMFLOAT3 &p = vertices[*i].position;
+		low = XMFLOAT3(min(low.x, p.x), min(low.y, p.y), min(low.z, p.z));
+		high = XMFLOAT3(max(high.x, p.x), max(high.y, p.y), max(high.z, p.z));
+	}
+	meshlet.center = XMFLOAT3((low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f, (low.z + high.z) * 0.5f);
+
+	float radiusSquared = 0.0f;
+	for (const unsigned int * i = begin; i < end; ++i)
+	{
+		const XMFLOAT3 &p = vertices[*i].position;
+		float dx = p.x - meshlet.center.x, dy = p.y - meshlet.center.y, dz = p.z - meshlet.center.z;
+		radiusSquared = max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	meshlet.radius = sqrtf(radiusSquared);
+
+	// Cone around the average normal, wide enough for every triangle in the meshlet.
+	size_t firstTriangle = meshlet.indexOffset / 3, lastTriangle = firstTriangle + meshlet.indexCount / 3;
+	XMFLOAT3 axis(0.0f, 0.0f, 0.0f);
+	for (size_t t = firstTriangle; t < lastTriangle; ++t)
+	{
+		axis.x += faceNormals[t].x;
+		axis.y += faceNormals[t].y;
+		axis.z += faceNormals[t].z;
+	}
+
+	float length = sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+	meshlet.coneAxis = length > 0.0f ? XMFLOAT3(axis.x / length, axis.y / length, axis.z / length) : XMFLOAT3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+	if (length == 0.0f)
+		return;
+
+	float minDot = 1.0f;
+	for (size_t t = firstTriangle; t < lastTriangle; ++t)
+	{
+		const XMFLOAT3 &n = faceNormals[t];
+		if (n.x == 0.0f && n.y == 0.0f && n.z == 0.0f)
+			continue;
+		minDot = min(minDot, n.x * meshlet.coneAxis.x + n.y * meshlet.coneAxis.y + n.z * meshlet.coneAxis.z);
+	}
+
+	// Past about 84 degrees there is nowhere the whole meshlet faces away from.
+	if (minDot > 0.1f)
+		meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void BuildMeshlets(vector<MESHLET> &meshlets, unsigned int * destination, const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount)
+{
+	meshlets.clear();
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	TRIANGLEADJACENCY adjacency;
+	buildAdjacency(adjacency, indices, indexCount, vertexCount);
+
+	// Neighbours are found by position, so meshlets grow across UV and normal seams.
+	vector<unsigned int> remap, wedge;
+	buildPositionGroups(remap, wedge, vertices, vertexCount);
+
+	// Unit face normals in the input order, then again in the output order for the cones.
+	vector<XMFLOAT3> faceNormals(triangleCount), outputNormals(triangleCount);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const unsigned int * triangle = indices + t * 3;
+		XMFLOAT3 n = triangleNormal(vertices[triangle[0]].position, vertices[triangle[1]].position, vertices[triangle[2]].position);
+		float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		faceNormals[t] = length > 0.0f ? XMFLOAT3(n.x / length, n.y / length, n.z / length) : XMFLOAT3(0.0f, 0.0f, 0.0f);
+	}
+
+	vector<bool> emitted(triangleCount, false);
+	// Meshlet each vertex was last added to, so membership needs no clearing between meshlets.
+	vector<unsigned int> vertexMeshlet(vertexCount, EMPTY_TARGET);
+	vector<unsigned int> candidates;
+	size_t seed = 0;
+	size_t written = 0;
+
+	while (true)
+	{
+		while (seed < triangleCount && emitted[seed])
+			seed++;
+		if (seed == triangleCount)
+			break;
+
+		unsigned int id = static_cast<unsigned int>(meshlets.size());
+		MESHLET meshlet;
+		memset(&meshlet, 0, sizeof(meshlet));
+		meshlet.indexOffset = static_cast<unsigned int>(written);
+		XMFLOAT3 normalSum(0.0f, 0.0f, 0.0f);
+		candidates.clear();
+
+		size_t next = seed;
+		while (true)
+		{
+			// Emit the chosen triangle and open up the triangles around its new vertices.
+			const unsigned int * triangle = indices + next * 3;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				unsigned int v = triangle[corner];
+				destination[written++] = v;
+				if (vertexMeshlet[v] == id)
+					continue;
+
+				vertexMeshlet[v] = id;
+				meshlet.vertexCount++;
+				unsigned int w = v;
+				do
+				{
+					const unsigned int * fan = &adjacency.triangles[0] + adjacency.offsets[w];
+					candidates.insert(candidates.end(), fan, fan + adjacency.counts[w]);
+					w = wedge[w];
+				} while (w != v);
+			}
+			emitted[next] = true;
+			outputNormals[written / 3 - 1] = faceNormals[next];
+			normalSum = XMFLOAT3(normalSum.x + faceNormals[next].x, normalSum.y + faceNormals[next].y, normalSum.z + faceNormals[next].z);
+			meshlet.indexCount += 3;
+
+			if (meshlet.indexCount == MESHLET_MAX_TRIANGLES * 3)
+				break;
+
+			float axisLength = sqrtf(normalSum.x * normalSum.x + normalSum.y * normalSum.y + normalSum.z * normalSum.z);
+			XMFLOAT3 axis = axisLength > 0.0f ? XMFLOAT3(normalSum.x / axisLength, normalSum.y / axisLength, normalSum.z / axisLength) : normalSum;
+
+			// Pick the cheapest neighbour that still fits, dropping used ones as we go.
+			size_t best = triangleCount;
+			float bestScore = FLT_MAX;
+			size_t kept = 0;
+			for (size_t c = 0; c < candidates.size(); ++c)
+			{
+				unsigned int t = candidates[c];
+				if (emitted[t])
+					continue;
+				candidates[kept++] = t;
+
+				const unsigned int * other = indices + t * 3;
+				unsigned int extra = (vertexMeshlet[other[0]] != id) + (vertexMeshlet[other[1]] != id) + (vertexMeshlet[other[2]] != id);
+				if (meshlet.vertexCount + extra > MESHLET_MAX_VERTICES)
+					continue;
+
+				const XMFLOAT3 &n = faceNormals[t];
+				float score = extra + MESHLET_CONE_WEIGHT * (1.0f - (n.x * axis.x + n.y * axis.y + n.z * axis.z));
+				if (score < bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+			candidates.resize(kept);
+
+			if (best == triangleCount)
+				break;
+			next = best;
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	for (MESHLET &meshlet : meshlets)
+		finishMeshlet(meshlet, destination, vertices, outputNormals);
+}
+
+// Triangles per ParallelFor item in the face pass of GenerateNormals, and positions per item
+// in the gathering pass.
+static const size_t NORMAL_TRIANGLE_BLOCK = 4096;
+static const size_t NORMAL_POSITION_BLOCK = 2048;
+
+// Distinct normals GenerateNormals remembers per position when looking for corners that can
+// share one. Positions with more (the tip of a cone) just share less.
+static const unsigned int NORMAL_SHARE_LIMIT = 16;
+
+static inline XMVECTOR dot3(XMVECTOR ax, XMVECTOR ay, XMVECTOR az, XMVECTOR bx, XMVECTOR by, XMVECTOR bz)
+{
+	return XMVectorMultiplyAdd(az, bz, XMVectorMultiplyAdd(ay, by, XMVectorMultiply(ax, bx)));
+}
+
+// Angle between two edges of four triangles at once; 0 where either edge has no length.
+static inline XMVECTOR edgeAngle(XMVECTOR dot, XMVECTOR lengthA, XMVECTOR lengthB)
+{
+	XMVECTOR denominator = XMVectorMultiply(lengthA, lengthB);
+	XMVECTOR valid = XMVectorGreater(denominator, XMVectorZero());
+	XMVECTOR cosine = XMVectorClamp(XMVectorDivide(dot, XMVectorSelect(XMVectorSplatOne(), denominator, valid)), XMVectorNegate(XMVectorSplatOne()), XMVectorSplatOne());
+	return XMVectorSelect(XMVectorZero(), XMVectorACos(cosine), valid);
+}
+
+void GenerateNormals(XMFLOAT3 * cornerNormals, unsigned int * sharedCorners, const unsigned int * cornerPositions, size_t cornerCount, const float * x, const float * y, const float * z, size_t positionCount, float creaseAngle, unsigned int threadCount)
+{
+	size_t triangleCount = cornerCount / 3;
+	if (triangleCount == 0)
+		return;
+	if (threadCount == 0)
+		threadCount = triangleCount < NORMAL_TRIANGLE_BLOCK ? 1 : DX::DefaultThreadCount();
+
+	// Unit face normals and the angle at every corner, kept as separate arrays per component so
+	// the face pass can store four triangles with one vector each. Padded to a multiple of four.
+	size_t paddedCount = (triangleCount + 3) & ~size_t(3);
+	vector<float> faceX(paddedCount), faceY(paddedCount), faceZ(paddedCount);
+	vector<float> angles(paddedCount * 3);	// angle of corner k of triangle t at [k * paddedCount + t]
+
+	size_t triangleBlocks = (triangleCount + NORMAL_TRIANGLE_BLOCK - 1) / NORMAL_TRIANGLE_BLOCK;
+	DX::ParallelFor(triangleBlocks, threadCount, [&](size_t block)
+	{
+		size_t first = block * NORMAL_TRIANGLE_BLOCK;
+		size_t last = min(first + NORMAL_TRIANGLE_BLOCK, triangleCount);
+		for (size_t t = first; t < last; t += 4)
+		{
+			// Lanes past the last triangle repeat it; their results land in the padding.
+			const unsigned int * lane[4];
+			for (size_t l = 0; l < 4; ++l)
+				lane[l] = cornerPositions + min(t + l, triangleCount - 1) * 3;
+
+			XMVECTOR px[3], py[3], pz[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				px[k] = XMVectorSet(x[lane[0][k]], x[lane[1][k]], x[lane[2][k]], x[lane[3][k]]);
+				py[k] = XMVectorSet(y[lane[0][k]], y[lane[1][k]], y[lane[2][k]], y[lane[3][k]]);
+				pz[k] = XMVectorSet(z[lane[0][k]], z[lane[1][k]], z[lane[2][k]], z[lane[3][k]]);
+			}
+
+			XMVECTOR ax = XMVectorSubtract(px[1], px[0]), ay = XMVectorSubtract(py[1], py[0]), az = XMVectorSubtract(pz[1], pz[0]);
+			XMVECTOR bx = XMVectorSubtract(px[2], px[0]), by = XMVectorSubtract(py[2], py[0]), bz = XMVectorSubtract(pz[2], pz[0]);
+			XMVECTOR cx = XMVectorSubtract(px[2], px[1]), cy = XMVectorSubtract(py[2], py[1]), cz = XMVectorSubtract(pz[2], pz[1]);
+
+			XMVECTOR nx = XMVectorSubtract(XMVectorMultiply(ay, bz), XMVectorMultiply(az, by));
+			XMVECTOR ny = XMVectorSubtract(XMVectorMultiply(az, bx), XMVectorMultiply(ax, bz));
+			XMVECTOR nz = XMVectorSubtract(XMVectorMultiply(ax, by), XMVectorMultiply(ay, bx));
+			XMVECTOR length = XMVectorSqrt(dot3(nx, ny, nz, nx, ny, nz));
+			XMVECTOR degenerate = XMVectorLessOrEqual(length, XMVectorZero());
+			XMVECTOR scale = XMVectorSelect(XMVectorDivide(XMVectorSplatOne(), length), XMVectorZero(), degenerate);
+
+			XMVECTOR lengthA = XMVectorSqrt(dot3(ax, ay, az, ax, ay, az));
+			XMVECTOR lengthB = XMVectorSqrt(dot3(bx, by, bz, bx, by, bz));
+			XMVECTOR lengthC = XMVectorSqrt(dot3(cx, cy, cz, cx, cy, cz));
+			XMVECTOR dotAB = dot3(ax, ay, az, bx, by, bz);
+			XMVECTOR dotAC = dot3(ax, ay, az, cx, cy, cz);
+			XMVECTOR dotBC = dot3(bx, by, bz, cx, cy, cz);
+
+			// Degenerate triangles get no weight, so they don't bend their neighbours' normals.
+			XMVECTOR angle0 = XMVectorSelect(edgeAngle(dotAB, lengthA, lengthB), XMVectorZero(), degenerate);
+			XMVECTOR angle1 = XMVectorSelect(edgeAngle(XMVectorNegate(dotAC), lengthA, lengthC), XMVectorZero(), degenerate);
+			XMVECTOR angle2 = XMVectorSelect(edgeAngle(dotBC, lengthB, lengthC), XMVectorZero(), degenerate);
+
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(&faceX[t]), XMVectorMultiply(nx, scale));
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(&faceY[t]), XMVectorMultiply(ny, scale));
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(&faceZ[t]), XMVectorMultiply(nz, scale));
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(&angles[t]), angle0);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(&angles[paddedCount + t]), angle1);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4 *>(&angles[paddedCount * 2 + t]), angle2);
+		}
+	});
+
+	// The corners at each position, in corner order: corners[offsets[p]] .. corners[offsets[p + 1] - 1].
+	vector<unsigned int> offsets(positionCount + 1, 0);
+	vector<unsigned int> corners(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		offsets[cornerPositions[i] + 1]++;
+	for (size_t p = 0; p < positionCount; ++p)
+		offsets[p + 1] += offsets[p];
+	{
+		vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			corners[cursor[cornerPositions[i]]++] = static_cast<unsigned int>(i);
+	}
+
+	// Each corner sums the angle weighted normals of the triangles around its position that are
+	// within the crease angle of its own triangle. Corners ending up with the same normal are
+	// found while the position's corners are at hand.
+	float creaseCosine = cosf(creaseAngle);
+	size_t positionBlocks = (positionCount + NORMAL_POSITION_BLOCK - 1) / NORMAL_POSITION_BLOCK;
+	DX::ParallelFor(positionBlocks, threadCount, [&](size_t block)
+	{
+		size_t first = block * NORMAL_POSITION_BLOCK;
+		size_t last = min(first + NORMAL_POSITION_BLOCK, positionCount);
+		for (size_t p = first; p < last; ++p)
+		{
+			unsigned int begin = offsets[p], end = offsets[p + 1];
+			unsigned int distinct[NORMAL_SHARE_LIMIT];
+			unsigned int distinctCount = 0;
+
+			for (unsigned int i = begin; i < end; ++i)
+			{
+				unsigned int corner = corners[i];
+				size_t f = corner / 3;
+
+				float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+				for (int pass = 0; pass < 2 && sx == 0.0f && sy == 0.0f && sz == 0.0f; ++pass)
+				{
+					// The second pass ignores the crease, for corners of degenerate triangles.
+					for (unsigned int j = begin; j < end; ++j)
+					{
+						size_t g = corners[j] / 3;
+						float cosine = faceX[f] * faceX[g] + faceY[f] * faceY[g] + faceZ[f] * faceZ[g];
+						if (pass == 0 && cosine < creaseCosine)
+							continue;
+						float weight = angles[(corners[j] % 3) * paddedCount + g];
+						sx += faceX[g] * weight;
+						sy += faceY[g] * weight;
+						sz += faceZ[g] * weight;
+					}
+				}
+
+				float length = sqrtf(sx * sx + sy * sy + sz * sz);
+				cornerNormals[corner] = length > 0.0f ? XMFLOAT3(sx / length, sy / length, sz / length) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+				if (!sharedCorners)
+					continue;
+
+				const XMFLOAT3 &n = cornerNormals[corner];
+				sharedCorners[corner] = corner;
+				unsigned int d = 0;
+				for (; d < distinctCount; ++d)
+				{
+					const XMFLOAT3 &m = cornerNormals[distinct[d]];
+					if (m.x == n.x && m.y == n.y && m.z == n.z)
+					{
+						sharedCorners[corner] = distinct[d];
+						break;
+					}
+				}
+				if (d == distinctCount && distinctCount < NORMAL_SHARE_LIMIT)
+					distinct[distinctCount++] = corner;
+			}
+		}
+	});
+}
+
+// Twice the signed area of the 2D triangle a, b, c; positive when counter clockwise.
+static inline float turn(const float * x, const float * y, unsigned int a, unsigned int b, unsigned int c)
+{
+	return (x[b] - x[a]) * (y[c] - y[a]) - (y[b] - y[a]) * (x[c] - x[a]);
+}
+
+bool TriangulatePolygon(unsigned char * triangles, const XMFLOAT3 * points, unsigned int cornerCount)
+{
+	if (cornerCount < 4 || cornerCount > MAX_POLYGON_CORNERS)
+		return false;
+
+	// Newell's normal picks the plane: drop its largest axis, and flip the other two if needed
+	// so the polygon winds counter clockwise in 2D.
+	float nx = 0.0f, ny = 0.0f, nz = 0.0f;
+	for (unsigned int i = 0; i < cornerCount; ++i)
+	{
+		const XMFLOAT3 &a = points[i];
+		const XMFLOAT3 &b = points[(i + 1) % cornerCount];
+		nx += (a.y - b.y) * (a.z + b.z);
+		ny += (a.z - b.z) * (a.x + b.x);
+		nz += (a.x - b.x) * (a.y + b.y);
+	}
+
+	float ax = fabsf(nx), ay = fabsf(ny), az = fabsf(nz);
+	if (ax == 0.0f && ay == 0.0f && az == 0.0f)
+		return false;
+
+	float x[MAX_POLYGON_CORNERS], y[MAX_POLYGON_CORNERS];
+	for (unsigned int i = 0; i < cornerCount; ++i)
+	{
+		const XMFLOAT3 &p = points[i];
+		if (az >= ax && az >= ay)
+		{
+			x[i] = p.x;
+			y[i] = nz > 0.0f ? p.y : -p.y;
+		}
+		else if (ay >= ax)
+		{
+			x[i] = p.z;
+			y[i] = ny > 0.0f ? p.x : -p.x;
+		}
+		else
+		{
+			x[i] = p.y;
+			y[i] = nx > 0.0f ? p.z : -p.z;
+		}
+	}
+
+	bool convex = true;
+	for (unsigned int i = 0; i < cornerCount && convex; ++i)
+		convex = turn(x, y, (i + cornerCount - 1) % cornerCount, i, (i + 1) % cornerCount) >= 0.0f;
+	if (convex)
+		return false;
+
+	unsigned char next[MAX_POLYGON_CORNERS], previous[MAX_POLYGON_CORNERS];
+	for (unsigned int i = 0; i < cornerCount; ++i)
+	{
+		next[i] = static_cast<unsigned char>((i + 1) % cornerCount);
+		previous[i] = static_cast<unsigned char>((i + cornerCount - 1) % cornerCount);
+	}
+
+	unsigned int remaining = cornerCount;
+	unsigned int corner = 0;
+	unsigned int misses = 0;
+	while (remaining > 3 && misses < remaining)
+	{
+		unsigned int a = previous[corner], b = corner, c = next[corner];
+
+		// An ear is a convex corner whose triangle holds none of the other corners.
+		bool ear = turn(x, y, a, b, c) > 0.0f;
+		for (unsigned int v = next[c]; ear && v != a; v = next[v])
+		{
+			ear = turn(x, y, a, b, v) < 0.0f || turn(x, y, b, c, v) < 0.0f || turn(x, y, c, a, v) < 0.0f;
+		}
+
+		if (ear)
+		{
+			*triangles++ = static_cast<unsigned char>(a);
+			*triangles++ = static_cast<unsigned char>(b);
+			*triangles++ = static_cast<unsigned char>(c);
+			next[a] = static_cast<unsigned char>(c);
+			previous[c] = static_cast<unsigned char>(a);
+			remaining--;
+			misses = 0;
+			corner = c;
+		}
+		else
+		{
+			misses++;
+			corner = c;
+		}
+	}
+
+	// Whatever is left is a triangle, or a tangle with no ears that gets a fan.
+	for (; remaining > 2; remaining--)
+	{
+		*triangles++ = static_cast<unsigned char>(corner);
+		*triangles++ = next[corner];
+		*triangles++ = next[next[corner]];
+		next[corner] = next[next[corner]];
+	}
+	return true;
+}
+
+// Index of the position farthest from 'from'.
+static size_t farthestFrom(const XMFLOAT3 * positions, size_t count, XMVECTOR from)
+{
+	size_t farthest = 0;
+	float farthestDistance = -1.0f;
+	for (size_t i = 0; i < count; ++i)
+	{
+		float distance = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&positions[i]), from)));
+		if (distance > farthestDistance)
+		{
+			farthestDistance = distance;
+			farthest = i;
+		}
+	}
+	return farthest;
+}
+
+// Radius of the sphere around center that holds every position.
+static float radiusAround(const XMFLOAT3 * positions, size_t count, XMVECTOR center)
+{
+	XMVECTOR largest = XMVectorZero();
+	for (size_t i = 0; i < count; ++i)
+		largest = XMVectorMax(largest, XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&positions[i]), center)));
+	return sqrtf(XMVectorGetX(largest));
+}
+
+MESHBOUNDS ComputeBounds(const XMFLOAT3 * positions, size_t count)
+{
+	MESHBOUNDS bounds;
+	memset(&bounds, 0, sizeof(bounds));
+	if (count == 0)
+		return bounds;
+
+	// Four running minimums and maximums, so each step doesn't wait on the one before.
+	XMVECTOR low[4], high[4];
+	for (int k = 0; k < 4; ++k)
+		low[k] = high[k] = XMLoadFloat3(&positions[0]);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		for (int k = 0; k < 4; ++k)
+		{
+			XMVECTOR p = XMLoadFloat3(&positions[i + k]);
+			low[k] = XMVectorMin(low[k], p);
+			high[k] = XMVectorMax(high[k], p);
+		}
+	}
+	for (; i < count; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&positions[i]);
+		low[0] = XMVectorMin(low[0], p);
+		high[0] = XMVectorMax(high[0], p);
+	}
+
+	XMVECTOR boxMin = XMVectorMin(XMVectorMin(low[0], low[1]), XMVectorMin(low[2], low[3]));
+	XMVECTOR boxMax = XMVectorMax(XMVectorMax(high[0], high[1]), XMVectorMax(high[2], high[3]));
+	XMStoreFloat3(&bounds.boundsMin, boxMin);
+	XMStoreFloat3(&bounds.boundsMax, boxMax);
+
+	XMVECTOR boxCenter = XMVectorScale(XMVectorAdd(boxMin, boxMax), 0.5f);
+	float boxRadius = radiusAround(positions, count, boxCenter);
+
+	// Ritter: a sphere on two far apart points, grown just enough to take in each point that is
+	// still outside.
+	XMVECTOR a = XMLoadFloat3(&positions[farthestFrom(positions, count, XMLoadFloat3(&positions[0]))]);
+	XMVECTOR b = XMLoadFloat3(&positions[farthestFrom(positions, count, a)]);
+	XMVECTOR center = XMVectorScale(XMVectorAdd(a, b), 0.5f);
+	float radius = XMVectorGetX(XMVector3Length(XMVectorSubtract(b, a))) * 0.5f;
+	for (i = 0; i < count; ++i)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&positions[i]), center);
+		float distanceSquared = XMVectorGetX(XMVector3LengthSq(offset));
+		if (distanceSquared > radius * radius)
+		{
+			float distance = sqrtf(distanceSquared);
+			float grown = (radius + distance) * 0.5f;
+			center = XMVectorAdd(center, XMVectorScale(offset, (grown - radius) / distance));
+			radius = grown;
+		}
+	}
+	// Measured again, so rounding in the growing steps can't leave a point outside.
+	radius = radiusAround(positions, count, center);
+
+	if (boxRadius <= radius)
+	{
+		center = boxCenter;
+		radius = boxRadius;
+	}
+	XMStoreFloat3(&bounds.center, center);
+	bounds.radius = radius;
+	return bounds;
+}
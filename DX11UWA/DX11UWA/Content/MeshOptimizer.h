@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stddef.h>
+#include "ModelLoader.h"
+
+// Triangle and vertex reordering passes for meshes produced by ModelLoader.
+// Nothing in here touches Direct3D, so the passes can be run and checked off-line.
+
+// Post-transform cache behaviour of an index buffer, measured with a simulated FIFO cache.
+struct VCACHESTATS
+{
+	float acmr;	// average cache miss ratio: vertex shader runs per triangle (0.5 - 3.0, lower is better)
+	float atvr;	// average transform to vertex ratio: vertex shader runs per vertex (1.0 is ideal)
+};
+
+// Cache size the passes assume when the caller has no better number for the target GPU.
+static const unsigned int DEFAULT_VCACHE_SIZE = 16;
+
+VCACHESTATS AnalyzeVertexCache(const unsigned int * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = DEFAULT_VCACHE_SIZE);
+
+// Reorders triangles for post-transform cache locality using Tipsify (Sander, Nehab and
+// Barczak 2007). destination must hold indexCount indices and may not alias indices.
+void OptimizeVertexCache(unsigned int * destination, const unsigned int * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = DEFAULT_VCACHE_SIZE);
+
+// Renumbers vertices in the order the index buffer first uses them, so vertex fetches walk
+// memory forward. Rewrites indices in place and fills destination with the reordered
+// vertices (no aliasing). Unreferenced vertices are dropped; returns the new vertex count.
+size_t OptimizeVertexFetch(VERTEX * destination, unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount);
+
+// Overdraw of an index buffer measured on the CPU. The mesh is rasterized with a depth test
+// from viewCount directions spread over a sphere around it, and every depth test pass counts
+// as a pixel shader invocation.
+struct OVERDRAWSTATS
+{
+	unsigned int pixelsCovered;	// pixels touched at least once, summed over all views
+	unsigned int pixelsShaded;	// pixels that passed the depth test, summed over all views
+	float overdraw;				// shaded / covered (1.0 means every pixel was shaded once)
+};
+
+OVERDRAWSTATS AnalyzeOverdraw(const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount, unsigned int viewCount = 16);
+
+// Splits an index buffer that has already been through OptimizeVertexCache into clusters and
+// draws the clusters that face away from the mesh center first, so nearer surfaces tend to be
+// drawn before the ones they hide. Clusters are cut only where the cache can restart without
+// raising ACMR by more than 'threshold' (1.05 = at most 5% worse). destination may not alias indices.
+void OptimizeOverdraw(unsigned int * destination, const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount, float threshold = 1.05f, unsigned int cacheSize = DEFAULT_VCACHE_SIZE);
+
+// Largest difference between the original vertices and what the shader decodes from PACKEDVERTEX.
+struct QUANTIZEERROR
+{
+	float position;	// object space units
+	float uv;		// texture coordinate units
+	float normal;	// degrees
+};
+
+// Decode constants covering the position bounds and UV range of the vertices.
+VERTEXDECODE ComputeVertexDecode(const VERTEX * vertices, size_t vertexCount);
+
+// Packs vertices into the 16 byte format using the ranges in decode, then decodes them again
+// the way LoadedVertexShader does and reports the worst error of each attribute.
+QUANTIZEERROR QuantizeVertices(PACKEDVERTEX * destination, const VERTEX * vertices, size_t vertexCount, const VERTEXDECODE &decode);
+
+// Reduces an index buffer towards targetIndexCount with quadric error edge collapses
+// (Garland and Heckbert 1997). Vertices are never moved or added, so the result indexes the
+// same vertex buffer. Open borders only collapse along themselves, and UV/normal seams only
+// collapse when both sides of the seam can follow, so texture and lighting seams stay intact.
+// destination must hold indexCount indices and may be the same array as indices.
+// Returns the new index count and stores in resultError the largest distance, in object
+// units, between the simplified surface and the original.
+size_t SimplifyMesh(unsigned int * destination, const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount, size_t targetIndexCount, float &resultError);
+
+// Regroups triangles into meshlets of at most MESHLET_MAX_VERTICES vertices and
+// MESHLET_MAX_TRIANGLES triangles. Each meshlet grows from the first unused triangle in the
+// current order through triangles sharing its vertices, preferring ones that add the fewest
+// new vertices and face the same way, so bounds and normal cones stay tight. Existing
+// cache or overdraw order is roughly kept, since seeds are taken in that order.
+// destination receives the regrouped indices (no aliasing). meshlets is overwritten.
+void BuildMeshlets(vector<MESHLET> &meshlets, unsigned int * destination, const unsigned int * indices, size_t indexCount, const VERTEX * vertices, size_t vertexCount);
+
+// Smooth normals for a triangle list that came without any, one per corner, given the position
+// index of every corner and the positions as separate x, y and z arrays. A corner's normal is
+// the average of the normals of the triangles around its position, weighted by each
+// triangle's angle there (Thurmer and Wuthrich 1998), leaving out triangles that meet the
+// corner's own triangle at more than creaseAngle (radians), so sharp edges stay sharp.
+// Face normals are computed four triangles at a time with DirectXMath and both passes run on
+// threadCount threads (0 = automatic). If sharedCorners is given, it receives for every corner
+// the first corner at the same position with an identical normal (itself if there is none),
+// so a caller can emit one normal per group.
+void GenerateNormals(XMFLOAT3 * cornerNormals, unsigned int * sharedCorners, const unsigned int * cornerPositions, size_t cornerCount, const float * x, const float * y, const float * z, size_t positionCount, float creaseAngle, unsigned int threadCount = 0);
+
+// Largest polygon TriangulatePolygon handles; ModelLoader fans anything bigger.
+static const unsigned int MAX_POLYGON_CORNERS = 64;
+
+// Splits a polygon of cornerCount points (4 to MAX_POLYGON_CORNERS) into cornerCount - 2
+// triangles by ear clipping in the plane that best fits it, writing the corner numbers of each
+// triangle to triangles in the polygon's own winding. Returns false without writing anything
+// when the polygon is convex, so the fan from corner 0 is already right. Polygons that fold over
+// themselves get a fan for whatever part has no ear left.
+bool TriangulatePolygon(unsigned char * triangles, const XMFLOAT3 * points, unsigned int cornerCount);
+
+// Axis aligned box and bounding sphere of a set of positions, found with DirectXMath min/max and
+// distance passes. The sphere is the smaller of the box's circumscribing one (centred on the box
+// and reaching the farthest position) and Ritter's (1990), usually within a few percent of the
+// smallest possible.
+MESHBOUNDS ComputeBounds(const XMFLOAT3 * positions, size_t count);
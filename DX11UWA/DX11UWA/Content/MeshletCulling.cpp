@@ -0,0 +1,171 @@
+#include "pch.h"
+#include <chrono>
+#include "MeshletCulling.h"
+
+void ComputeFrustum(FRUSTUM &frustum, const XMFLOAT4X4 &worldViewProjection)
+{
+	// Frustum planes straight from the matrix (Gribb and Hartmann), pointing inwards.
+	const XMFLOAT4X4 &m = worldViewProjection;
+	frustum.planes[0] = XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);	// left
+	frustum.planes[1] = XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);	// right
+	frustum.planes[2] = XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);	// bottom
+	frustum.planes[3] = XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);	// top
+	frustum.planes[4] = XMFLOAT4(m._13, m._23, m._33, m._43);									// near, z >= 0 in Direct3D
+	frustum.planes[5] = XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);	// far
+	for (XMFLOAT4 &plane : frustum.planes)
+	{
+		float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f)
+		{
+			plane.x /= length;
+			plane.y /= length;
+			plane.z /= length;
+			plane.w /= length;
+		}
+	}
+}
+
+bool BoxOutsideFrustum(const FRUSTUM &frustum, const XMFLOAT3 &boundsMin, const XMFLOAT3 &boundsMax)
+{
+	for (const XMFLOAT4 &plane : frustum.planes)
+	{
+		// The corner furthest along the plane normal; if even that is behind, all of them are.
+		float x = plane.x >= 0.0f ? boundsMax.x : boundsMin.x;
+		float y = plane.y >= 0.0f ? boundsMax.y : boundsMin.y;
+		float z = plane.z >= 0.0f ? boundsMax.z : boundsMin.z;
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+			return true;
+	}
+	return false;
+}
+
+size_t CullMeshlets(DRAWRANGE * ranges, const MESHLET * meshlets, size_t meshletCount, const XMFLOAT4X4 &worldViewProjection, const XMFLOAT3 &cameraPosition, CULLSTATS * stats)
+{
+	FRUSTUM frustum;
+	ComputeFrustum(frustum, worldViewProjection);
+
+	CULLSTATS local = { 0, 0, 0, 0 };
+	size_t rangeCount = 0;
+
+	for (size_t i = 0; i < meshletCount; ++i)
+	{
+		const MESHLET &meshlet = meshlets[i];
+		const XMFLOAT3 &c = meshlet.center;
+		unsigned int triangles = meshlet.indexCount / 3;
+
+		bool outside = false;
+		for (const XMFLOAT4 &plane : frustum.planes)
+		{
+			if (plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w < -meshlet.radius)
+			{
+				outside = true;
+				break;
+			}
+		}
+		if (outside)
+		{
+			local.trianglesOutside += triangles;
+			continue;
+		}
+
+		// Back facing if every view ray into the bounding sphere sees the back of every
+		// triangle in the cone (meshoptimizer's cone test).
+		float dx = c.x - cameraPosition.x, dy = c.y - cameraPosition.y, dz = c.z - cameraPosition.z;
+		float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+		if (dx * meshlet.coneAxis.x + dy * meshlet.coneAxis.y + dz * meshlet.coneAxis.z > meshlet.coneCutoff * distance + meshlet.radius)
+		{
+			local.trianglesBackfacing += triangles;
+			continue;
+		}
+
+		local.meshletsVisible++;
+		local.trianglesVisible += triangles;
+
+		DRAWRANGE * last = rangeCount ? &ranges[rangeCount - 1] : nullptr;
+		if (last && last->indexOffset + last->indexCount == meshlet.indexOffset && last->baseVertex == meshlet.baseVertex)
+		{
+			last->indexCount += meshlet.indexCount;
+		}
+		else
+		{
+			ranges[rangeCount].indexOffset = meshlet.indexOffset;
+			ranges[rangeCount].indexCount = meshlet.indexCount;
+			ranges[rangeCount].baseVertex = meshlet.baseVertex;
+			rangeCount++;
+		}
+	}
+
+	if (stats)
+		*stats = local;
+	return rangeCount;
+}
+
+// Row vector look-at times left handed perspective, the same as
+// XMMatrixLookAtLH(eye, at, up) * XMMatrixPerspectiveFovLH(fovY, aspect, nearZ, farZ).
+static XMFLOAT4X4 benchmarkViewProjection(const XMFLOAT3 &eye, const XMFLOAT3 &at, float fovY, float aspect, float nearZ, float farZ)
+{
+	// Pick an up vector that is not parallel to the view direction.
+	XMVECTOR eyePosition = XMLoadFloat3(&eye), focus = XMLoadFloat3(&at);
+	float direction = XMVectorGetY(XMVector3Normalize(XMVectorSubtract(focus, eyePosition)));
+	XMVECTOR up = fabsf(direction) > 0.99f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixLookAtLH(eyePosition, focus, up) * XMMatrixPerspectiveFovLH(fovY, aspect, nearZ, farZ));
+	return result;
+}
+
+void BenchmarkMeshletCulling(const char * const * paths, size_t pathCount, unsigned int iterations)
+{
+	// Views per distance, spread over a sphere like the overdraw estimate.
+	static const unsigned int VIEW_COUNT = 32;
+	// Distances in bounding radii: the whole mesh on screen, then close enough to clip it.
+	static const float VIEW_DISTANCES[] = { 3.0f, 1.2f, 0.6f };
+
+	for (size_t p = 0; p < pathCount; ++p)
+	{
+		MESHDATA mesh;
+		ModelLoader loader;
+		loader.setProcessing(MESHPROCESS_VERTEXCACHE | MESHPROCESS_MESHLETS);
+		if (!loader.loadMesh(paths[p], mesh) || mesh.meshletCount == 0)
+			continue;
+
+		XMFLOAT3 center = mesh.bounds.center;
+		float radius = mesh.bounds.radius;
+
+		vector<DRAWRANGE> ranges(mesh.meshletCount);
+		unsigned int totalTriangles = mesh.lods[0].indexCount / 3;
+
+		for (float distance : VIEW_DISTANCES)
+		{
+			double seconds = 0.0;
+			double visibleTriangles = 0.0, backfacing = 0.0, outside = 0.0, drawCalls = 0.0;
+
+			for (unsigned int view = 0; view < VIEW_COUNT; ++view)
+			{
+				float y = 1.0f - 2.0f * (view + 0.5f) / VIEW_COUNT;
+				float ring = sqrtf(1.0f - y * y);
+				float angle = view * 2.399963f; // golden angle
+				XMFLOAT3 eye(center.x + cosf(angle) * ring * radius * distance, center.y + y * radius * distance, center.z + sinf(angle) * ring * radius * distance);
+				XMFLOAT4X4 viewProjection = benchmarkViewProjection(eye, center, 70.0f * XM_PI / 180.0f, 16.0f / 9.0f, 0.01f, 100.0f * radius);
+
+				CULLSTATS stats;
+				size_t rangeCount = 0;
+				auto start = chrono::high_resolution_clock::now();
+				for (unsigned int i = 0; i < iterations; ++i)
+					rangeCount = CullMeshlets(ranges.data(), mesh.meshlets, mesh.meshletCount, viewProjection, eye, &stats);
+				seconds += chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+				visibleTriangles += stats.trianglesVisible;
+				backfacing += stats.trianglesBackfacing;
+				outside += stats.trianglesOutside;
+				drawCalls += double(rangeCount);
+			}
+
+			double cullMicroseconds = seconds * 1e6 / (double(VIEW_COUNT) * iterations);
+			double total = double(totalTriangles) * VIEW_COUNT;
+			printf("%s at %.1f radii: %u meshlets, cull %.2f us, triangles drawn %.1f%% (back facing %.1f%%, outside %.1f%%), %.1f draws\n",
+				paths[p], distance, mesh.meshletCount, cullMicroseconds,
+				100.0 * visibleTriangles / total, 100.0 * backfacing / total, 100.0 * outside / total, drawCalls / VIEW_COUNT);
+		}
+	}
+}
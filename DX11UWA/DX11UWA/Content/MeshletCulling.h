@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include "ModelLoader.h"
+
+// CPU culling of the meshlets built by MESHPROCESS_MESHLETS. Like MeshOptimizer, nothing in
+// here touches Direct3D, so it can be timed and checked off-line.
+
+// A run of indices to hand to DrawIndexed.
+struct DRAWRANGE
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	unsigned int baseVertex;
+};
+
+// The six planes of a view frustum as (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside.
+struct FRUSTUM
+{
+	XMFLOAT4 planes[6];
+};
+
+// What one call to CullMeshlets threw away.
+struct CULLSTATS
+{
+	unsigned int meshletsVisible;
+	unsigned int trianglesVisible;
+	unsigned int trianglesBackfacing;	// dropped by the normal cone test
+	unsigned int trianglesOutside;		// dropped by the frustum test
+};
+
+// Extracts the normalized frustum planes from a row vector (DirectXMath, untransposed) object
+// to clip space matrix, so the planes come out in object space.
+void ComputeFrustum(FRUSTUM &frustum, const XMFLOAT4X4 &worldViewProjection);
+
+// True when the box lies entirely on the outside of one of the planes. Conservative: a box
+// near a frustum corner can be reported inside.
+bool BoxOutsideFrustum(const FRUSTUM &frustum, const XMFLOAT3 &boundsMin, const XMFLOAT3 &boundsMax);
+
+// Drops meshlets that are entirely outside the view frustum or facing away from the camera,
+// and writes the survivors to ranges, merging neighbours that share a base vertex. ranges must
+// have room for meshletCount entries. worldViewProjection is the row vector (DirectXMath,
+// untransposed) object to clip space matrix, cameraPosition is in object space. Returns the
+// range count.
+size_t CullMeshlets(DRAWRANGE * ranges, const MESHLET * meshlets, size_t meshletCount, const XMFLOAT4X4 &worldViewProjection, const XMFLOAT3 &cameraPosition, CULLSTATS * stats = nullptr);
+
+// Builds meshlets for every file and culls them from views all around the mesh: from where it
+// fills the screen, from where it spills over the edges and from inside its bounds. Prints the
+// cost per cull next to the share of triangles and draw calls it saves.
+void BenchmarkMeshletCulling(const char * const * paths, size_t pathCount, unsigned int iterations);
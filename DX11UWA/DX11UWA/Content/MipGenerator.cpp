@@ -0,0 +1,331 @@
+#include "pch.h"
+#include "MipGenerator.h"
+#include "../Common/ParallelFor.h"
+#include <algorithm>
+#include <functional>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Texels in mip 0 below which GenerateMips doesn't bother with threads.
+static const size_t MIP_THREAD_THRESHOLD = 64 * 1024;
+
+// Rows of the next mip filtered together. Each band runs the horizontal pass over the source rows
+// under it, so only a band's worth of half filtered rows is held at once.
+static const size_t BAND_ROWS = 32;
+
+// Steps of the linear to sRGB table, fine enough near black that every byte is reachable.
+static const size_t LINEAR_STEPS = 16384;
+
+// Filter widths either side of the center, in texels of the next mip.
+static const float KAISER_RADIUS = 3.0f;
+static const float KAISER_ALPHA = 4.0f;
+static const float LANCZOS_RADIUS = 3.0f;
+
+struct COLORTABLES
+{
+	float unorm[256];					// UNORM8 to 0..1
+	float linear[256];					// sRGB UNORM8 to linear 0..1
+	uint8_t srgb[LINEAR_STEPS];			// linear 0..1 to sRGB UNORM8
+
+	COLORTABLES()
+	{
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			float value = i / 255.0f;
+			unorm[i] = value;
+			linear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+		}
+		for (size_t i = 0; i < LINEAR_STEPS; ++i)
+		{
+			float value = float(i) / float(LINEAR_STEPS - 1);
+			float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+			srgb[i] = uint8_t(min(encoded, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const COLORTABLES & colorTables()
+{
+	static const COLORTABLES tables;
+	return tables;
+}
+
+static float sinc(float x)
+{
+	if (fabsf(x) < 1e-6f)
+		return 1.0f;
+	x *= XM_PI;
+	return sinf(x) / x;
+}
+
+// Modified Bessel function of the first kind, order 0, from its series.
+static float besselI0(float x)
+{
+	float sum = 1.0f, term = 1.0f, half = x * 0.5f;
+	for (unsigned int k = 1; k < 32 && term > sum * 1e-8f; ++k)
+	{
+		term *= (half / k) * (half / k);
+		sum += term;
+	}
+	return sum;
+}
+
+static float filterRadius(MIPFILTER filter)
+{
+	switch (filter)
+	{
+	case MIP_FILTER_KAISER:
+		return KAISER_RADIUS;
+	case MIP_FILTER_LANCZOS:
+		return LANCZOS_RADIUS;
+	default:
+		return 0.5f;
+	}
+}
+
+// The filter at distance t from the center, in texels of the next mip.
+static float filterWeight(MIPFILTER filter, float t)
+{
+	t = fabsf(t);
+	switch (filter)
+	{
+	case MIP_FILTER_KAISER:
+	{
+		if (t >= KAISER_RADIUS)
+			return 0.0f;
+		float r = t / KAISER_RADIUS;
+		return sinc(t) * besselI0(KAISER_ALPHA * sqrtf(1.0f - r * r)) / besselI0(KAISER_ALPHA);
+	}
+	case MIP_FILTER_LANCZOS:
+		return t < LANCZOS_RADIUS ? sinc(t) * sinc(t / LANCZOS_RADIUS) : 0.0f;
+	default:
+		// A texel the box edge runs through counts half.
+		return t < 0.5f ? 1.0f : t == 0.5f ? 0.5f : 0.0f;
+	}
+}
+
+static size_t edgeTexel(ptrdiff_t texel, size_t size, bool wrap)
+{
+	ptrdiff_t count = ptrdiff_t(size);
+	if (wrap)
+		return size_t((texel % count + count) % count);
+	return size_t(min(max(texel, ptrdiff_t(0)), count - 1));
+}
+
+// The source texels and weights making up each texel of the next mip along one axis. Every
+// texel gets the same number of taps, the widest any of them needs, padded with zero weights.
+struct TAPS
+{
+	size_t count;
+	vector<ptrdiff_t> first;	// first source texel of each, before wrapping or clamping
+	vector<size_t> sources;		// count per texel, wrapped or clamped
+	vector<float> weights;		// count per texel, adding up to 1
+};
+
+static void buildTaps(TAPS &taps, size_t sourceSize, size_t size, const MIPOPTIONS &options)
+{
+	float scale = float(sourceSize) / float(size);
+	float radius = filterRadius(options.filter) * scale;
+
+	taps.count = 0;
+	taps.first.resize(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		float center = (i + 0.5f) * scale;
+		ptrdiff_t first = ptrdiff_t(ceilf(center - radius - 0.5f));
+		ptrdiff_t last = ptrdiff_t(floorf(center + radius - 0.5f));
+		taps.first[i] = first;
+		taps.count = max(taps.count, size_t(last - first + 1));
+	}
+
+	taps.sources.resize(size * taps.count);
+	taps.weights.resize(size * taps.count);
+	for (size_t i = 0; i < size; ++i)
+	{
+		float center = (i + 0.5f) * scale, sum = 0.0f;
+		size_t * sources = &taps.sources[i * taps.count];
+		float * weights = &taps.weights[i * taps.count];
+		for (size_t k = 0; k < taps.count; ++k)
+		{
+			ptrdiff_t texel = taps.first[i] + ptrdiff_t(k);
+			sources[k] = edgeTexel(texel, sourceSize, options.wrap);
+			weights[k] = filterWeight(options.filter, (texel + 0.5f - center) / scale);
+			sum += weights[k];
+		}
+		for (size_t k = 0; k < taps.count; ++k)
+			weights[k] /= sum;
+	}
+}
+
+// Filters a sourceWidth x sourceHeight level down to width x height floats, horizontally then
+// vertically. The source is either floats or, for mip 0, RGBA8 texels made linear on the way in.
+static void filterLevel(XMFLOAT4 * texels, size_t width, size_t height, const XMFLOAT4 * source, const uint8_t * sourceTexels,
+	size_t sourceWidth, size_t sourceHeight, const MIPOPTIONS &options, unsigned int threadCount)
+{
+	TAPS columns, rows;
+	buildTaps(columns, sourceWidth, width, options);
+	buildTaps(rows, sourceHeight, height, options);
+
+	const COLORTABLES &tables = colorTables();
+	const float * color = options.srgb ? tables.linear : tables.unorm;
+
+	size_t bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+	DX::ParallelFor(bands, threadCount, [&](size_t band)
+	{
+		size_t firstRow = band * BAND_ROWS, endRow = min(firstRow + BAND_ROWS, height);
+		ptrdiff_t top = rows.first[firstRow];
+		size_t bandRows = size_t(rows.first[endRow - 1] - top) + rows.count;
+
+		vector<XMFLOAT4> filtered(bandRows * width), converted(source ? 0 : sourceWidth);
+		for (size_t r = 0; r < bandRows; ++r)
+		{
+			size_t y = edgeTexel(top + ptrdiff_t(r), sourceHeight, options.wrap);
+			const XMFLOAT4 * in = source ? source + y * sourceWidth : converted.data();
+			if (!source)
+			{
+				const uint8_t * bytes = sourceTexels + y * sourceWidth * 4;
+				for (size_t x = 0; x < sourceWidth; ++x, bytes += 4)
+					converted[x] = XMFLOAT4(color[bytes[0]], color[bytes[1]], color[bytes[2]], tables.unorm[bytes[3]]);
+			}
+
+			XMFLOAT4 * out = filtered.data() + r * width;
+			const size_t * tap = columns.sources.data();
+			const float * weight = columns.weights.data();
+			for (size_t x = 0; x < width; ++x)
+			{
+				XMVECTOR sum = XMVectorZero();
+				for (size_t k = 0; k < columns.count; ++k, ++tap, ++weight)
+					sum = XMVectorMultiplyAdd(XMLoadFloat4(&in[*tap]), XMVectorReplicate(*weight), sum);
+				XMStoreFloat4(&out[x], sum);
+			}
+		}
+
+		for (size_t y = firstRow; y < endRow; ++y)
+		{
+			const XMFLOAT4 * in = filtered.data() + size_t(rows.first[y] - top) * width;
+			const float * weight = &rows.weights[y * rows.count];
+			XMFLOAT4 * out = texels + y * width;
+			for (size_t x = 0; x < width; ++x)
+			{
+				XMVECTOR sum = XMVectorZero();
+				for (size_t k = 0; k < rows.count; ++k)
+					sum = XMVectorMultiplyAdd(XMLoadFloat4(&in[k * width + x]), XMVectorReplicate(weight[k]), sum);
+				XMStoreFloat4(&out[x], sum);
+			}
+		}
+	});
+}
+
+// The alpha scale that gives a level the share of texels at or above the reference byte that
+// mip 0 has, so alpha tested textures don't thin out in the distance.
+static float coverageScale(const XMFLOAT4 * texels, size_t texelCount, double coverage, unsigned int reference)
+{
+	size_t target = size_t(coverage * texelCount + 0.5);
+	vector<float> alphas(texelCount);
+	for (size_t i = 0; i < texelCount; ++i)
+		alphas[i] = texels[i].w;
+
+	// Alphas stored as at least reference are those that come out of the scale at least this.
+	float threshold = (reference - 0.25f) / 255.0f;
+	if (target == 0)
+	{
+		float largest = *max_element(alphas.begin(), alphas.end());
+		return largest > 0.0f ? min(1.0f, (reference - 0.75f) / 255.0f / largest) : 1.0f;
+	}
+	nth_element(alphas.begin(), alphas.begin() + (target - 1), alphas.end(), greater<float>());
+	float alpha = alphas[target - 1];
+	return alpha > 0.0f ? threshold / alpha : 1.0f;
+}
+
+static void storeLevel(RGBASURFACE &mip, const XMFLOAT4 * texels, float alphaScale, bool srgb, unsigned int threadCount)
+{
+	const COLORTABLES &tables = colorTables();
+	XMVECTOR scale = XMVectorSet(1.0f, 1.0f, 1.0f, alphaScale);
+	DX::ParallelFor(mip.height, threadCount, [&](size_t y)
+	{
+		const XMFLOAT4 * in = texels + y * mip.width;
+		uint8_t * out = mip.texels.data() + y * mip.width * 4;
+		for (size_t x = 0; x < mip.width; ++x, out += 4)
+		{
+			XMVECTOR texel = XMVectorMultiply(XMLoadFloat4(&in[x]), scale);
+			if (!srgb)
+			{
+				XMStoreUByteN4(reinterpret_cast<XMUBYTEN4 *>(out), texel);
+				continue;
+			}
+			XMFLOAT4 value;
+			XMStoreFloat4(&value, XMVectorSaturate(texel));
+			out[0] = tables.srgb[size_t(value.x * (LINEAR_STEPS - 1) + 0.5f)];
+			out[1] = tables.srgb[size_t(value.y * (LINEAR_STEPS - 1) + 0.5f)];
+			out[2] = tables.srgb[size_t(value.z * (LINEAR_STEPS - 1) + 0.5f)];
+			out[3] = uint8_t(value.w * 255.0f + 0.5f);
+		}
+	});
+}
+
+size_t MipCount(size_t width, size_t height)
+{
+	size_t count = 1;
+	for (size_t size = max(width, height); size > 1; size /= 2)
+		++count;
+	return count;
+}
+
+bool GenerateMips(vector<RGBASURFACE> &mips, size_t mipCount, const MIPOPTIONS &options, unsigned int threadCount)
+{
+	if (mips.empty() || mips[0].format != DXGI_FORMAT_R8G8B8A8_UNORM || mips[0].width == 0 || mips[0].height == 0)
+	{
+		printf("Can only generate mips from an RGBA8 mip 0\n");
+		return false;
+	}
+	const RGBASURFACE &top = mips[0];
+	if (mipCount == 0 || mipCount > MipCount(top.width, top.height))
+	{
+		printf("A %zux%zu texture can't have %zu mips\n", top.width, top.height, mipCount);
+		return false;
+	}
+
+	size_t topTexels = top.width * top.height;
+	if (threadCount == 0)
+		threadCount = topTexels < MIP_THREAD_THRESHOLD ? 1 : DX::DefaultThreadCount();
+
+	unsigned int reference = 0;
+	double coverage = 0.0;
+	if (options.alphaReference > 0.0f)
+	{
+		reference = max(1u, unsigned(ceilf(min(options.alphaReference, 1.0f) * 255.0f)));
+		size_t covered = 0;
+		for (size_t i = 0; i < topTexels; ++i)
+			covered += top.texels[i * 4 + 3] >= reference;
+		coverage = double(covered) / double(topTexels);
+	}
+
+	// The level above as floats, and the one being made.
+	vector<XMFLOAT4> source, level;
+	mips.resize(mipCount);
+	for (size_t i = 1; i < mipCount; ++i)
+	{
+		const RGBASURFACE &above = mips[i - 1];
+		RGBASURFACE &mip = mips[i];
+		mip.width = max<size_t>(above.width / 2, 1);
+		mip.height = max<size_t>(above.height / 2, 1);
+		mip.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		mip.texels.resize(mip.width * mip.height * 4);
+
+		level.resize(mip.width * mip.height);
+		filterLevel(level.data(), mip.width, mip.height, i == 1 ? nullptr : source.data(), above.texels.data(),
+			above.width, above.height, options, threadCount);
+
+		// Only the stored alpha is scaled; the next level is filtered from the unscaled one.
+		float alphaScale = reference ? coverageScale(level.data(), level.size(), coverage, reference) : 1.0f;
+		storeLevel(mip, level.data(), alphaScale, options.srgb, threadCount);
+		source.swap(level);
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "TextureCooker.h"
+
+using namespace std;
+
+// Builds mip chains on the CPU for textures that ship with only mip 0, either when cooking them
+// (CookTexture) or when loading them (ProgressiveTexture::load). Without mips a minified texture
+// aliases and every sample lands on a different cache line.
+
+enum MIPFILTER
+{
+	MIP_FILTER_BOX,			// the average of the texels under each texel of the next mip
+	MIP_FILTER_KAISER,		// Kaiser windowed sinc, 3 texels of the next mip wide; sharper than box
+	MIP_FILTER_LANCZOS,		// Lanczos 3; sharpest, rings the most around hard edges
+};
+
+struct MIPOPTIONS
+{
+	MIPFILTER filter;
+	bool srgb;				// the color is sRGB, so it is filtered as linear light and stored back as sRGB
+	bool wrap;				// the texture tiles, so filters wrap around its edges instead of clamping
+	float alphaReference;	// alpha test reference, or 0: each mip keeps the share of texels at or above it that mip 0 has
+};
+
+// Mips in a full chain down to 1x1.
+size_t MipCount(size_t width, size_t height);
+
+// Fills in mips 1 to mipCount - 1 from mips[0], an R8G8B8A8_UNORM surface, resizing mips to
+// mipCount. Each mip is filtered from the one above it while that is still float, so rounding
+// doesn't build up down the chain. Rows are spread over threadCount threads; 0 picks from the size.
+bool GenerateMips(vector<RGBASURFACE> &mips, size_t mipCount, const MIPOPTIONS &options, unsigned int threadCount = 0);
@@ -1,81 +1,2395 @@
 #include "pch.h"
+#ifdef _WIN32
 #include <windows.h>
+#else
+// Only the fscanf_s baseline uses this.
+#define fopen_s(file, path, mode) (*(file) = fopen(path, mode))
+#endif
+#include <chrono>
+#include <algorithm>
+#include <map>
 #include "ModelLoader.h"
+#include "ObjTokenizer.h"
+#include "MeshOptimizer.h"
+#include "../Common/MappedFile.h"
+#include "../Common/ParallelFor.h"
+#include "../Common/AllocationCounter.h"
+
+using namespace ObjTokenizer;
+
+//--------------------------------------------------------------------------------------
+// Cooked mesh cache (.meshbin)
+//
+// [MESHBIN_HEADER][pad][VERTEX or PACKEDVERTEX * vertexCount][pad][uint16 * indexCount]
+// [pad][MESHSUBSET * subsetCount][pad][MESHLET * meshletCount][pad][SUBMESH * submeshCount]
+// [pad][MATERIAL * materialCount]
+// The blobs are 16 byte aligned so they can be used in place from the mapping.
+//--------------------------------------------------------------------------------------
+#define MESHBIN_MAGIC 0x4e49424d // "MBIN"
+#define MESHBIN_VERSION 9
+
+struct MESHBIN_HEADER
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceSize;		// size of the OBJ the cache was built from
+	uint64_t sourceModified;	// last write time of that OBJ
+	uint32_t processing;		// MESHPROCESS flags the mesh was built with
+	float creaseAngle;			// crease angle for generated normals, in degrees
+	uint32_t lodCount;
+	uint32_t vertexStride;
+	uint32_t indexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t subsetStride;
+	uint32_t subsetCount;
+	uint32_t meshletStride;
+	uint32_t meshletCount;
+	uint32_t submeshStride;
+	uint32_t submeshCount;
+	uint32_t materialStride;
+	uint32_t materialCount;
+	uint64_t librarySize;		// combined size and write times of the MTL libraries
+	uint64_t libraryModified;
+	char libraries[MESH_PATH_LENGTH];	// their paths, one per line
+	MESHBOUNDS bounds;
+	VERTEXDECODE decode;		// only meaningful with MESHPROCESS_QUANTIZE
+	MESHLOD lods[MESH_MAX_LODS];
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t subsetOffset;
+	uint64_t meshletOffset;
+	uint64_t submeshOffset;
+	uint64_t materialOffset;
+};
+
+static string s_cacheDirectory;
+
+static inline uint64_t alignTo16(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t(15);
+}
+
+static inline size_t vertexStrideFor(unsigned int processing)
+{
+	return (processing & MESHPROCESS_QUANTIZE) ? sizeof(PACKEDVERTEX) : sizeof(VERTEX);
+}
+
+// Copies [begin, end) into a fixed size name, cutting it short if it does not fit.
+static void copyName(char * dest, size_t destSize, const char * begin, const char * end)
+{
+	size_t length = min(size_t(end - begin), destSize - 1);
+	memcpy(dest, begin, length);
+	dest[length] = '\0';
+}
+
+// Adds up the sizes and write times of the files in a list of paths, one per line, so a
+// change to any material library shows up as a different stamp. Missing files count as empty.
+static void stampLibraries(const char * list, uint64_t &size, uint64_t &modified)
+{
+	size = 0;
+	modified = 0;
+	for (const char * p = list; *p;)
+	{
+		const char * lineEnd = strchr(p, '\n');
+		string library = lineEnd ? string(p, lineEnd) : string(p);
+		uint64_t librarySize = 0, libraryModified = 0;
+		if (DX::GetFileStamp(library.c_str(), librarySize, libraryModified))
+		{
+			size += librarySize;
+			modified += libraryModified;
+		}
+		p = lineEnd ? lineEnd + 1 : p + library.size();
+	}
+}
+
+static FILE * openForWrite(const string &path)
+{
+	FILE * file = nullptr;
+#ifdef _WIN32
+	_wfopen_s(&file, DX::Utf8ToWide(path.c_str()).c_str(), L"wb");
+#else
+	file = fopen(path.c_str(), "wb");
+#endif
+	return file;
+}
+
+// Maps the cache and points the mesh at its blobs. Fails if the cache is missing,
+// from another version or was built from a different revision of the source.
+static bool openMeshCache(const string &cachePath, uint64_t sourceSize, uint64_t sourceModified, unsigned int processing, float creaseAngle, MESHDATA &out_mesh)
+{
+	DX::MappedFile &file = out_mesh.cacheFile;
+	if (!file.open(cachePath.c_str()))
+		return false;
+
+	if (file.size() < sizeof(MESHBIN_HEADER))
+	{
+		file.close();
+		return false;
+	}
+
+	const MESHBIN_HEADER * header = reinterpret_cast<const MESHBIN_HEADER *>(file.data());
+	size_t vertexStride = vertexStrideFor(processing);
+	uint64_t vertexBytes = uint64_t(header->vertexCount) * vertexStride;
+	uint64_t indexBytes = uint64_t(header->indexCount) * sizeof(uint16_t);
+	uint64_t subsetBytes = uint64_t(header->subsetCount) * sizeof(MESHSUBSET);
+	uint64_t meshletBytes = uint64_t(header->meshletCount) * sizeof(MESHLET);
+	uint64_t submeshBytes = uint64_t(header->submeshCount) * sizeof(SUBMESH);
+	uint64_t materialBytes = uint64_t(header->materialCount) * sizeof(MATERIAL);
+
+	if (header->magic != MESHBIN_MAGIC ||
+		header->version != MESHBIN_VERSION ||
+		header->sourceSize != sourceSize ||
+		header->sourceModified != sourceModified ||
+		header->processing != processing ||
+		header->creaseAngle != creaseAngle ||
+		header->vertexStride != vertexStride ||
+		header->indexStride != sizeof(uint16_t) ||
+		header->vertexOffset % 16 != 0 ||
+		header->indexOffset % 16 != 0 ||
+		header->vertexOffset + vertexBytes > file.size() ||
+		header->indexOffset + indexBytes > file.size() ||
+		header->subsetStride != sizeof(MESHSUBSET) ||
+		header->subsetOffset % 16 != 0 ||
+		header->subsetOffset + subsetBytes > file.size() ||
+		header->meshletStride != sizeof(MESHLET) ||
+		header->meshletOffset % 16 != 0 ||
+		header->meshletOffset + meshletBytes > file.size() ||
+		header->submeshStride != sizeof(SUBMESH) ||
+		header->submeshOffset % 16 != 0 ||
+		header->submeshOffset + submeshBytes > file.size() ||
+		header->materialStride != sizeof(MATERIAL) ||
+		header->materialOffset % 16 != 0 ||
+		header->materialOffset + materialBytes > file.size() ||
+		memchr(header->libraries, 0, sizeof(header->libraries)) == nullptr ||
+		header->submeshCount == 0 ||
+		header->lodCount == 0 || header->lodCount > MESH_MAX_LODS)
+	{
+		file.close();
+		return false;
+	}
+
+	for (unsigned int i = 0; i < header->lodCount; ++i)
+	{
+		if (uint64_t(header->lods[i].indexOffset) + header->lods[i].indexCount > header->indexCount ||
+			uint64_t(header->lods[i].subsetOffset) + header->lods[i].subsetCount > header->subsetCount)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	const MESHSUBSET * subsets = reinterpret_cast<const MESHSUBSET *>(file.data() + header->subsetOffset);
+	for (unsigned int i = 0; i < header->subsetCount; ++i)
+	{
+		if (uint64_t(subsets[i].indexOffset) + subsets[i].indexCount > header->indexCount ||
+			(subsets[i].indexCount && subsets[i].baseVertex >= header->vertexCount))
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	// CullMeshlets hands these ranges straight to DrawIndexed.
+	const MESHLET * meshlets = reinterpret_cast<const MESHLET *>(file.data() + header->meshletOffset);
+	for (unsigned int i = 0; i < header->meshletCount; ++i)
+	{
+		if (uint64_t(meshlets[i].indexOffset) + meshlets[i].indexCount > header->indexCount ||
+			(meshlets[i].indexCount && meshlets[i].baseVertex >= header->vertexCount))
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	// Names and paths are copied into strings, so each has to end inside its array.
+	const MATERIAL * materials = reinterpret_cast<const MATERIAL *>(file.data() + header->materialOffset);
+	for (unsigned int i = 0; i < header->materialCount; ++i)
+	{
+		if (memchr(materials[i].name, 0, sizeof(materials[i].name)) == nullptr ||
+			memchr(materials[i].diffuseMap, 0, sizeof(materials[i].diffuseMap)) == nullptr)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	const SUBMESH * submeshes = reinterpret_cast<const SUBMESH *>(file.data() + header->submeshOffset);
+	for (unsigned int i = 0; i < header->submeshCount; ++i)
+	{
+		bool ok = memchr(submeshes[i].name, 0, sizeof(submeshes[i].name)) != nullptr &&
+			(submeshes[i].material == NO_MATERIAL || submeshes[i].material < header->materialCount) &&
+			uint64_t(submeshes[i].meshletOffset) + submeshes[i].meshletCount <= header->meshletCount;
+		for (unsigned int level = 0; level < header->lodCount; ++level)
+		{
+			const MESHLOD &part = submeshes[i].lods[level];
+			ok = ok && uint64_t(part.indexOffset) + part.indexCount <= header->indexCount &&
+				uint64_t(part.subsetOffset) + part.subsetCount <= header->subsetCount;
+		}
+		if (!ok)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	// An edited MTL file changes the materials without touching the OBJ.
+	uint64_t librarySize, libraryModified;
+	stampLibraries(header->libraries, librarySize, libraryModified);
+	if (librarySize != header->librarySize || libraryModified != header->libraryModified)
+	{
+		file.close();
+		return false;
+	}
+
+	const uint8_t * vertexData = file.data() + header->vertexOffset;
+	out_mesh.vertices = (processing & MESHPROCESS_QUANTIZE) ? nullptr : reinterpret_cast<const VERTEX *>(vertexData);
+	out_mesh.packedVertices = (processing & MESHPROCESS_QUANTIZE) ? reinterpret_cast<const PACKEDVERTEX *>(vertexData) : nullptr;
+	out_mesh.indices = reinterpret_cast<const uint16_t *>(file.data() + header->indexOffset);
+	out_mesh.subsets = subsets;
+	out_mesh.meshlets = header->meshletCount ? meshlets : nullptr;
+	out_mesh.submeshes = submeshes;
+	out_mesh.materials = header->materialCount ? materials : nullptr;
+	out_mesh.vertexCount = header->vertexCount;
+	out_mesh.indexCount = header->indexCount;
+	out_mesh.subsetCount = header->subsetCount;
+	out_mesh.meshletCount = header->meshletCount;
+	out_mesh.submeshCount = header->submeshCount;
+	out_mesh.materialCount = header->materialCount;
+	out_mesh.bounds = header->bounds;
+	out_mesh.decode = header->decode;
+	out_mesh.lodCount = header->lodCount;
+	memcpy(out_mesh.lods, header->lods, sizeof(out_mesh.lods));
+	return true;
+}
+
+static bool writeMeshCache(const string &cachePath, uint64_t sourceSize, uint64_t sourceModified, unsigned int processing, float creaseAngle, const string &libraries, const MESHDATA &mesh)
+{
+	FILE * file = openForWrite(cachePath);
+	if (!file)
+		return false;
+
+	MESHBIN_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.version = MESHBIN_VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceModified = sourceModified;
+	header.processing = processing;
+	header.creaseAngle = creaseAngle;
+	size_t vertexStride = vertexStrideFor(processing);
+	const void * vertexData = (processing & MESHPROCESS_QUANTIZE) ? static_cast<const void *>(mesh.packedVertices) : static_cast<const void *>(mesh.vertices);
+	header.vertexStride = static_cast<uint32_t>(vertexStride);
+	header.indexStride = sizeof(uint16_t);
+	header.vertexCount = mesh.vertexCount;
+	header.indexCount = mesh.indexCount;
+	header.subsetStride = sizeof(MESHSUBSET);
+	header.subsetCount = mesh.subsetCount;
+	header.meshletStride = sizeof(MESHLET);
+	header.meshletCount = mesh.meshletCount;
+	header.submeshStride = sizeof(SUBMESH);
+	header.submeshCount = mesh.submeshCount;
+	header.materialStride = sizeof(MATERIAL);
+	header.materialCount = mesh.materialCount;
+	copyName(header.libraries, sizeof(header.libraries), libraries.c_str(), libraries.c_str() + libraries.size());
+	stampLibraries(header.libraries, header.librarySize, header.libraryModified);
+	header.bounds = mesh.bounds;
+	header.decode = mesh.decode;
+	header.lodCount = mesh.lodCount;
+	memcpy(header.lods, mesh.lods, sizeof(header.lods));
+	header.vertexOffset = alignTo16(sizeof(MESHBIN_HEADER));
+	header.indexOffset = alignTo16(header.vertexOffset + uint64_t(mesh.vertexCount) * vertexStride);
+	header.subsetOffset = alignTo16(header.indexOffset + uint64_t(mesh.indexCount) * sizeof(uint16_t));
+	header.meshletOffset = alignTo16(header.subsetOffset + uint64_t(mesh.subsetCount) * sizeof(MESHSUBSET));
+	header.submeshOffset = alignTo16(header.meshletOffset + uint64_t(mesh.meshletCount) * sizeof(MESHLET));
+	header.materialOffset = alignTo16(header.submeshOffset + uint64_t(mesh.submeshCount) * sizeof(SUBMESH));
+
+	// Pads up to each blob's offset, then writes it.
+	static const uint8_t padding[16] = { 0 };
+	uint64_t written = sizeof(header);
+	auto writeBlob = [&](uint64_t offset, const void * data, size_t stride, size_t count) -> bool
+	{
+		size_t pad = size_t(offset - written);
+		written = offset + uint64_t(stride) * count;
+		return fwrite(padding, 1, pad, file) == pad && (count == 0 || fwrite(data, stride, count, file) == count);
+	};
+
+	// The magic is written last, so a cache that was cut short never validates.
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && writeBlob(header.vertexOffset, vertexData, vertexStride, mesh.vertexCount);
+	ok = ok && writeBlob(header.indexOffset, mesh.indices, sizeof(uint16_t), mesh.indexCount);
+	ok = ok && writeBlob(header.subsetOffset, mesh.subsets, sizeof(MESHSUBSET), mesh.subsetCount);
+	ok = ok && writeBlob(header.meshletOffset, mesh.meshlets, sizeof(MESHLET), mesh.meshletCount);
+	ok = ok && writeBlob(header.submeshOffset, mesh.submeshes, sizeof(SUBMESH), mesh.submeshCount);
+	ok = ok && writeBlob(header.materialOffset, mesh.materials, sizeof(MATERIAL), mesh.materialCount);
+
+	header.magic = MESHBIN_MAGIC;
+	ok = ok && fflush(file) == 0 && fseek(file, 0, SEEK_SET) == 0;
+	ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+		remove(cachePath.c_str());
+	return ok;
+}
+
+void ModelLoader::setCacheDirectory(const string &directory)
+{
+	s_cacheDirectory = directory;
+}
+
+// FNV-1a, continuing from hash.
+static uint64_t hashBytes(const void * data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const uint8_t * bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+string ModelLoader::cachePathFor(const char * path, unsigned int processing, float creaseAngle)
+{
+	string source(path);
+	size_t slash = source.find_last_of("/\\");
+	size_t dot = source.find_last_of('.');
+	string stem = (dot != string::npos && (slash == string::npos || dot > slash)) ? source.substr(0, dot) : source;
+
+	// Files with the same name in different folders, or loaded with different processing, get
+	// caches of their own instead of rebuilding each other's.
+	uint64_t hash = hashBytes(source.data(), source.size());
+	hash = hashBytes(&processing, sizeof(processing), hash);
+	hash = hashBytes(&creaseAngle, sizeof(creaseAngle), hash);
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%016llx.meshbin", static_cast<unsigned long long>(hash));
+
+	if (s_cacheDirectory.empty())
+		return stem + suffix;
+
+	string name = slash == string::npos ? stem : stem.substr(slash + 1);
+	char last = s_cacheDirectory[s_cacheDirectory.size() - 1];
+	return s_cacheDirectory + ((last == '/' || last == '\\') ? "" : "/") + name + suffix;
+}
+
+void ModelLoader::reset()
+{
+	vertexIndices.clear();
+	uvIndices.clear();
+	normalIndices.clear();
+	temp_vertices.clear();
+	temp_uvs.clear();
+	temp_normals.clear();
+	objRecords.clear();
+	objPolygons.clear();
+	meshIndices.clear();
+	weldSlots.clear();
+	positionColumns.clear();
+	cornerScratch.clear();
+	sharedCorners.clear();
+	cornerNormals.clear();
+	weldMask = 0;
+	materialLibraries.clear();
+	threadCount = 0;
+	processing = 0;
+	creaseAngle = DEFAULT_CREASE_ANGLE;
+	memset(&stats, 0, sizeof(stats));
+	memset(&bounds, 0, sizeof(bounds));
+}
+
+size_t ModelLoader::scratchBytes() const
+{
+	size_t bytes = (vertexIndices.capacity() + uvIndices.capacity() + normalIndices.capacity() + meshIndices.capacity() +
+		cornerScratch.capacity() + sharedCorners.capacity()) * sizeof(unsigned int) +
+		(temp_vertices.capacity() + temp_uvs.capacity() + temp_normals.capacity() + cornerNormals.capacity()) * sizeof(XMFLOAT3) +
+		positionColumns.capacity() * sizeof(float) + objRecords.capacity() * sizeof(OBJRECORD) + objPolygons.capacity() * sizeof(OBJPOLYGON) +
+		weldSlots.capacity() * sizeof(WELDSLOT);
+	for (const OBJCHUNK &chunk : chunks)
+	{
+		bytes += (chunk.positions.capacity() + chunk.uvs.capacity() + chunk.normals.capacity()) * sizeof(XMFLOAT3) +
+			(chunk.positionIndices.capacity() + chunk.uvIndices.capacity() + chunk.normalIndices.capacity()) * sizeof(unsigned int) +
+			chunk.records.capacity() * sizeof(OBJRECORD) + chunk.polygons.capacity() * sizeof(OBJPOLYGON);
+	}
+	return bytes;
+}
+
+ModelLoaderPool::Handle ModelLoaderPool::acquire()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		if (!idle.empty())
+		{
+			unique_ptr<ModelLoader> loader = move(idle.back());
+			idle.pop_back();
+			return Handle(this, move(loader));
+		}
+	}
+	return Handle(this, unique_ptr<ModelLoader>(new ModelLoader()));
+}
+
+void ModelLoaderPool::release(unique_ptr<ModelLoader> loader)
+{
+	loader->reset();
+	lock_guard<mutex> guard(lock);
+	idle.push_back(move(loader));
+}
+
+size_t ModelLoaderPool::idleCount() const
+{
+	lock_guard<mutex> guard(lock);
+	return idle.size();
+}
+
+// Leaves a mesh empty with its cache unmapped, so a failed load can't be drawn from.
+static void clearMesh(MESHDATA &mesh)
+{
+	mesh.cacheFile.close();
+	mesh.vertexStorage.clear();
+	mesh.packedStorage.clear();
+	mesh.indexStorage.clear();
+	mesh.subsetStorage.clear();
+	mesh.meshletStorage.clear();
+	mesh.submeshStorage.clear();
+	mesh.materialStorage.clear();
+	mesh.vertices = nullptr;
+	mesh.packedVertices = nullptr;
+	mesh.indices = nullptr;
+	mesh.subsets = nullptr;
+	mesh.meshlets = nullptr;
+	mesh.submeshes = nullptr;
+	mesh.materials = nullptr;
+	mesh.vertexCount = 0;
+	mesh.indexCount = 0;
+	mesh.subsetCount = 0;
+	mesh.meshletCount = 0;
+	mesh.submeshCount = 0;
+	mesh.materialCount = 0;
+	mesh.lodCount = 0;
+	memset(&mesh.bounds, 0, sizeof(mesh.bounds));
+	memset(&mesh.decode, 0, sizeof(mesh.decode));
+	memset(mesh.lods, 0, sizeof(mesh.lods));
+}
+
+bool ModelLoader::loadMesh(const char * path, MESHDATA &out_mesh)
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	uint64_t sourceSize = 0, sourceModified = 0;
+	if (!DX::GetFileStamp(path, sourceSize, sourceModified))
+	{
+		printf("Failed to open the file !\n");
+		clearMesh(out_mesh);
+		return false;
+	}
+
+	string cachePath = cachePathFor(path, processing, creaseAngle);
+	if (openMeshCache(cachePath, sourceSize, sourceModified, processing, creaseAngle, out_mesh))
+	{
+		memset(&stats, 0, sizeof(stats));
+		stats.fileBytes = out_mesh.cacheFile.size();
+		stats.triangleCount = out_mesh.indexCount / 3;
+		stats.cornerCount = out_mesh.indexCount;
+		stats.uniqueVertexCount = out_mesh.vertexCount;
+		stats.fromCache = true;
+		bounds = out_mesh.bounds;
+		stats.parseSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		return true;
+	}
+
+	if (!processModel(path, out_mesh))
+		return false;
+
+	// A read-only install folder just means we parse again next time.
+	if (!writeMeshCache(cachePath, sourceSize, sourceModified, processing, creaseAngle, materialLibraries, out_mesh))
+		printf("Could not write mesh cache %s\n", cachePath.c_str());
+
+	return true;
+}
+
+bool ModelLoader::processModel(const char * path, MESHDATA &out_mesh)
+{
+	clearMesh(out_mesh);
+	vector<unsigned int> &indices = meshIndices;
+	indices.clear();
+	if (!loadModel(path, out_mesh.vertexStorage, indices))
+	{
+		clearMesh(out_mesh);
+		return false;
+	}
+
+	buildSubmeshes(path, out_mesh, indices);
+	processMesh(out_mesh, indices);
+	splitMesh(out_mesh, indices);
+
+	out_mesh.vertices = out_mesh.vertexStorage.data();
+	out_mesh.indices = out_mesh.indexStorage.data();
+	out_mesh.subsets = out_mesh.subsetStorage.data();
+	out_mesh.meshlets = out_mesh.meshletStorage.empty() ? nullptr : out_mesh.meshletStorage.data();
+	out_mesh.submeshes = out_mesh.submeshStorage.data();
+	out_mesh.materials = out_mesh.materialStorage.empty() ? nullptr : out_mesh.materialStorage.data();
+	out_mesh.vertexCount = static_cast<unsigned int>(out_mesh.vertexStorage.size());
+	out_mesh.indexCount = static_cast<unsigned int>(out_mesh.indexStorage.size());
+	out_mesh.subsetCount = static_cast<unsigned int>(out_mesh.subsetStorage.size());
+	out_mesh.meshletCount = static_cast<unsigned int>(out_mesh.meshletStorage.size());
+	out_mesh.submeshCount = static_cast<unsigned int>(out_mesh.submeshStorage.size());
+	out_mesh.materialCount = static_cast<unsigned int>(out_mesh.materialStorage.size());
+
+	out_mesh.bounds = bounds;
+
+	if (processing & MESHPROCESS_QUANTIZE)
+		quantizeMesh(out_mesh);
+
+	return true;
+}
+
+// The folder part of a path including its last slash, or an empty string.
+static string folderOf(const char * path)
+{
+	string text(path);
+	size_t slash = text.find_last_of("/\\");
+	return slash == string::npos ? string() : text.substr(0, slash + 1);
+}
+
+// A material with the MTL defaults, used for newmtl and for usemtl names no library defines.
+static MATERIAL defaultMaterial(const char * nameBegin, const char * nameEnd)
+{
+	MATERIAL material;
+	memset(&material, 0, sizeof(material));
+	copyName(material.name, sizeof(material.name), nameBegin, nameEnd);
+	material.ambient = XMFLOAT3(0.2f, 0.2f, 0.2f);
+	material.diffuse = XMFLOAT3(0.8f, 0.8f, 0.8f);
+	material.opacity = 1.0f;
+	return material;
+}
+
+// Reads "r g b", or a single value used for all three.
+static void parseColor(const char * p, const char * end, XMFLOAT3 &color)
+{
+	float r, g, b;
+	p = parseFloat(p, end, r);
+	if (!p)
+		return;
+	const char * q = parseFloat(p, end, g);
+	q = q ? parseFloat(q, end, b) : nullptr;
+	color = q ? XMFLOAT3(r, g, b) : XMFLOAT3(r, r, r);
+}
+
+bool LoadMaterialLibrary(const char * path, vector<MATERIAL> &materials)
+{
+	DX::MappedFile file;
+	if (!file.open(path))
+		return false;
+
+	string folder = folderOf(path);
+	const char * p = reinterpret_cast<const char *>(file.data());
+	const char * end = p + file.size();
+	bool inMaterial = false;
+
+	// MTL files are read leniently: a statement that does not parse keeps the default.
+	while (p < end)
+	{
+		p = skipBlanks(p, end);
+		if (p >= end)
+			break;
+
+		const char * nameEnd;
+		if (isKeyword(p, end, "newmtl"))
+		{
+			const char * name = parseName(p + 6, end, nameEnd);
+			materials.push_back(defaultMaterial(name, nameEnd));
+			inMaterial = true;
+		}
+		else if (inMaterial)
+		{
+			MATERIAL &material = materials.back();
+			float value;
+			if (isKeyword(p, end, "Ka"))
+				parseColor(p + 2, end, material.ambient);
+			else if (isKeyword(p, end, "Kd"))
+				parseColor(p + 2, end, material.diffuse);
+			else if (isKeyword(p, end, "Ks"))
+				parseColor(p + 2, end, material.specular);
+			else if (isKeyword(p, end, "Ns") && parseFloat(p + 2, end, value))
+				material.specularPower = value;
+			else if (isKeyword(p, end, "d") && parseFloat(p + 1, end, value))
+				material.opacity = value;
+			else if (isKeyword(p, end, "Tr") && parseFloat(p + 2, end, value))
+				material.opacity = 1.0f - value;
+			else if (isKeyword(p, end, "map_Kd"))
+			{
+				// The file name is the last word, after options such as -s or -clamp.
+				const char * name = parseName(p + 6, end, nameEnd);
+				for (const char * q = name; q < nameEnd; ++q)
+				{
+					if (isBlank(*q))
+						name = q + 1;
+				}
+				string map = folder + string(name, nameEnd);
+				copyName(material.diffuseMap, sizeof(material.diffuseMap), map.c_str(), map.c_str() + map.size());
+			}
+		}
+
+		p = skipLine(p, end);
+	}
+
+	return true;
+}
+
+// Loads the OBJ's material libraries, then sorts the triangles by group and material so each
+// submesh is one range of indices. Triangles keep their file order inside a submesh, and a
+// group that comes back later in the file joins the submesh it started.
+void ModelLoader::buildSubmeshes(const char * path, MESHDATA &mesh, vector<unsigned int> &indices)
+{
+	vector<MATERIAL> &materials = mesh.materialStorage;
+	vector<SUBMESH> &submeshes = mesh.submeshStorage;
+	materials.clear();
+	submeshes.clear();
+	materialLibraries.clear();
+
+	// mtllib may name several files.
+	string folder = folderOf(path);
+	for (const OBJRECORD &record : objRecords)
+	{
+		if (record.kind != OBJRECORD::LIBRARY)
+			continue;
+
+		const char * p = record.name.c_str(), * end = p + record.name.size();
+		while (p < end)
+		{
+			const char * nameEnd = p;
+			while (nameEnd < end && !isBlank(*nameEnd))
+				++nameEnd;
+
+			string library = folder + string(p, nameEnd);
+			if (!LoadMaterialLibrary(library.c_str(), materials))
+				printf("%s: could not read material library %s\n", path, library.c_str());
+			materialLibraries += library + "\n";
+			p = skipBlanks(nameEnd, end);
+		}
+	}
+
+	auto findMaterial = [&](const string &name) -> unsigned int
+	{
+		MATERIAL wanted = defaultMaterial(name.c_str(), name.c_str() + name.size());
+		for (size_t i = 0; i < materials.size(); ++i)
+		{
+			if (strcmp(materials[i].name, wanted.name) == 0)
+				return static_cast<unsigned int>(i);
+		}
+		printf("%s: material %s is not in any library\n", path, wanted.name);
+		materials.push_back(wanted);
+		return static_cast<unsigned int>(materials.size() - 1);
+	};
+
+	size_t triangleCount = indices.size() / 3;
+	vector<unsigned int> triangleSubmesh(triangleCount);
+	map<pair<string, unsigned int>, unsigned int> lookup;
+	string group;
+	unsigned int material = NO_MATERIAL, current = 0;
+	size_t next = 0;
+
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		bool changed = t == 0;
+		for (; next < objRecords.size() && objRecords[next].corner <= t * 3; ++next)
+		{
+			const OBJRECORD &record = objRecords[next];
+			if (record.kind == OBJRECORD::GROUP)
+				group = record.name;
+			else if (record.kind == OBJRECORD::MATERIAL)
+				material = findMaterial(record.name);
+			changed = true;
+		}
+
+		if (changed)
+		{
+			auto found = lookup.find(make_pair(group, material));
+			if (found == lookup.end())
+			{
+				SUBMESH submesh;
+				memset(&submesh, 0, sizeof(submesh));
+				copyName(submesh.name, sizeof(submesh.name), group.c_str(), group.c_str() + group.size());
+				submesh.material = material;
+				current = static_cast<unsigned int>(submeshes.size());
+				submeshes.push_back(submesh);
+				lookup[make_pair(group, material)] = current;
+			}
+			else
+			{
+				current = found->second;
+			}
+		}
+
+		triangleSubmesh[t] = current;
+	}
+
+	if (submeshes.empty())
+	{
+		SUBMESH submesh;
+		memset(&submesh, 0, sizeof(submesh));
+		submesh.material = NO_MATERIAL;
+		submeshes.push_back(submesh);
+	}
+
+	// Counting sort of the triangles by submesh.
+	for (size_t t = 0; t < triangleCount; ++t)
+		submeshes[triangleSubmesh[t]].lods[0].indexCount += 3;
+
+	unsigned int offset = 0;
+	for (SUBMESH &submesh : submeshes)
+	{
+		submesh.lods[0].indexOffset = offset;
+		offset += submesh.lods[0].indexCount;
+	}
+
+	vector<unsigned int> sorted(indices.size());
+	vector<unsigned int> cursor(submeshes.size());
+	for (size_t i = 0; i < submeshes.size(); ++i)
+		cursor[i] = submeshes[i].lods[0].indexOffset;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		unsigned int &write = cursor[triangleSubmesh[t]];
+		sorted[write++] = indices[t * 3 + 0];
+		sorted[write++] = indices[t * 3 + 1];
+		sorted[write++] = indices[t * 3 + 2];
+	}
+	indices.swap(sorted);
+
+	const vector<VERTEX> &verts = mesh.vertexStorage;
+	for (SUBMESH &submesh : submeshes)
+	{
+		const MESHLOD &range = submesh.lods[0];
+		if (range.indexCount == 0)
+			continue;
+
+		submesh.boundsMin = submesh.boundsMax = verts[indices[range.indexOffset]].position;
+		for (size_t i = range.indexOffset; i < size_t(range.indexOffset) + range.indexCount; ++i)
+		{
+			const XMFLOAT3 &p = verts[indices[i]].position;
+			submesh.boundsMin = XMFLOAT3(min(submesh.boundsMin.x, p.x), min(submesh.boundsMin.y, p.y), min(submesh.boundsMin.z, p.z));
+			submesh.boundsMax = XMFLOAT3(max(submesh.boundsMax.x, p.x), max(submesh.boundsMax.y, p.y), max(submesh.boundsMax.z, p.z));
+		}
+	}
+}
+
+// Runs the passes selected with setProcessing on the mesh's vertices and its 32 bit indices.
+// Triangles only move inside their submesh, so every submesh keeps its range.
+void ModelLoader::processMesh(MESHDATA &mesh, vector<unsigned int> &indices)
+{
+	vector<VERTEX> &verts = mesh.vertexStorage;
+	vector<SUBMESH> &submeshes = mesh.submeshStorage;
+
+	bool reorder = (processing & (MESHPROCESS_VERTEXCACHE | MESHPROCESS_OVERDRAW)) && !indices.empty();
+	VCACHESTATS before = { 0.0f, 0.0f };
+
+	if (reorder)
+	{
+		before = AnalyzeVertexCache(indices.data(), indices.size(), verts.size());
+
+		vector<unsigned int> reordered(indices.size());
+		for (const SUBMESH &submesh : submeshes)
+		{
+			const MESHLOD &range = submesh.lods[0];
+			OptimizeVertexCache(reordered.data() + range.indexOffset, indices.data() + range.indexOffset, range.indexCount, verts.size());
+		}
+		indices.swap(reordered);
+
+		if (processing & MESHPROCESS_OVERDRAW)
+		{
+			// After the swap, 'reordered' still holds the file order, which is the baseline.
+			OVERDRAWSTATS overdrawBefore = AnalyzeOverdraw(reordered.data(), reordered.size(), verts.data(), verts.size());
+
+			for (const SUBMESH &submesh : submeshes)
+			{
+				const MESHLOD &range = submesh.lods[0];
+				OptimizeOverdraw(reordered.data() + range.indexOffset, indices.data() + range.indexOffset, range.indexCount, verts.data(), verts.size());
+			}
+			indices.swap(reordered);
+
+			OVERDRAWSTATS overdrawAfter = AnalyzeOverdraw(indices.data(), indices.size(), verts.data(), verts.size());
+			stats.overdrawBefore = overdrawBefore.overdraw;
+			stats.overdrawAfter = overdrawAfter.overdraw;
+		}
+	}
+
+	if ((processing & MESHPROCESS_MESHLETS) && !indices.empty())
+	{
+		vector<unsigned int> clustered(indices.size());
+		vector<MESHLET> meshlets;
+		for (SUBMESH &submesh : submeshes)
+		{
+			const MESHLOD &range = submesh.lods[0];
+			BuildMeshlets(meshlets, clustered.data() + range.indexOffset, indices.data() + range.indexOffset, range.indexCount, verts.data(), verts.size());
+
+			submesh.meshletOffset = static_cast<unsigned int>(mesh.meshletStorage.size());
+			submesh.meshletCount = static_cast<unsigned int>(meshlets.size());
+			for (MESHLET &meshlet : meshlets)
+			{
+				meshlet.indexOffset += range.indexOffset;
+				mesh.meshletStorage.push_back(meshlet);
+			}
+		}
+		indices.swap(clustered);
+	}
+
+	mesh.lodCount = 1;
+	mesh.lods[0].indexOffset = 0;
+	mesh.lods[0].indexCount = static_cast<unsigned int>(indices.size());
+	mesh.lods[0].error = 0.0f;
+
+	if ((processing & MESHPROCESS_LOD) && !indices.empty())
+		buildLods(mesh, indices, reorder);
+
+	if (reorder)
+	{
+		// One fetch order for every level; the coarser ones use a subset of the vertices.
+		vector<VERTEX> fetchOrder(verts.size());
+		fetchOrder.resize(OptimizeVertexFetch(fetchOrder.data(), indices.data(), indices.size(), verts.data(), verts.size()));
+		verts.swap(fetchOrder);
+
+		VCACHESTATS after = AnalyzeVertexCache(indices.data(), mesh.lods[0].indexCount, verts.size());
+		stats.acmrBefore = before.acmr;
+		stats.atvrBefore = before.atvr;
+		stats.acmrAfter = after.acmr;
+		stats.atvrAfter = after.atvr;
+	}
+}
+
+// Share of the full mesh's triangles each simplified level aims for.
+static const float LOD_RATIOS[MESH_MAX_LODS - 1] = { 0.5f, 0.25f, 0.125f };
+
+// Appends simplified copies of the full mesh to its index buffer. Each level is simplified
+// from the full mesh, not the previous level, so its error is measured against the original.
+// Submeshes are simplified one by one, so the edges between groups and materials stay where
+// they are, and a level's error is the largest of theirs. A level that would not cut at least
+// a quarter of the previous one's triangles ends the chain.
+void ModelLoader::buildLods(MESHDATA &mesh, vector<unsigned int> &indices, bool optimizeCache)
+{
+	vector<VERTEX> &verts = mesh.vertexStorage;
+	vector<SUBMESH> &submeshes = mesh.submeshStorage;
+
+	vector<unsigned int> simplified, reordered, level;
+	vector<MESHLOD> parts(submeshes.size());
+	for (float ratio : LOD_RATIOS)
+	{
+		level.clear();
+		float levelError = 0.0f;
+
+		for (size_t s = 0; s < submeshes.size(); ++s)
+		{
+			const MESHLOD &full = submeshes[s].lods[0];
+			size_t target = size_t(full.indexCount * ratio) / 3 * 3;
+			float error = 0.0f;
+			simplified.resize(full.indexCount);
+			size_t count = SimplifyMesh(simplified.data(), indices.data() + full.indexOffset, full.indexCount, verts.data(), verts.size(), target, error);
+
+			const unsigned int * partIndices = simplified.data();
+			if (optimizeCache)
+			{
+				reordered.resize(count);
+				OptimizeVertexCache(reordered.data(), simplified.data(), count, verts.size());
+				partIndices = reordered.data();
+			}
+
+			memset(&parts[s], 0, sizeof(parts[s]));
+			parts[s].indexOffset = static_cast<unsigned int>(indices.size() + level.size());
+			parts[s].indexCount = static_cast<unsigned int>(count);
+			parts[s].error = error;
+			level.insert(level.end(), partIndices, partIndices + count);
+			levelError = max(levelError, error);
+		}
+
+		const MESHLOD &previous = mesh.lods[mesh.lodCount - 1];
+		if (level.empty() || level.size() * 4 > size_t(previous.indexCount) * 3)
+			break;
+
+		MESHLOD &lod = mesh.lods[mesh.lodCount];
+		lod.indexOffset = static_cast<unsigned int>(indices.size());
+		lod.indexCount = static_cast<unsigned int>(level.size());
+		lod.error = levelError;
+		for (size_t s = 0; s < submeshes.size(); ++s)
+			submeshes[s].lods[mesh.lodCount] = parts[s];
+		indices.insert(indices.end(), level.begin(), level.end());
+		mesh.lodCount++;
+	}
+}
+
+// Largest vertex span one subset's 16 bit indices can reach.
+static const unsigned int SUBSET_MAX_VERTICES = 0x10000;
+
+// Below this many triangles per subset, the extra draw calls cost more than copying vertices.
+static const unsigned int SUBSET_MIN_TRIANGLES = 1024;
+
+// Scratch state shared by the splitIndexRange calls of one mesh.
+struct SPLITSTATE
+{
+	vector<unsigned int> stamp;	// stamp[v] == stampValue marks vertices used by the subset being built
+	vector<unsigned int> slot;	// where a copied vertex went, relative to the subset's base
+	vector<unsigned int> used;	// the subset's vertices in first use order
+	unsigned int stampValue;
+	size_t meshletIndex;		// next meshlet of the full mesh to place
+};
+
+// Cuts indices [begin, end) into subsets, writing 16 bit indices and appending to subsetStorage.
+// With byMeshlet the range is taken a meshlet at a time so no meshlet is cut in two.
+// By default a subset grows while its vertices fit in a SUBSET_MAX_VERTICES wide window, so it
+// can count from the lowest of them without copying anything. When compact is set it grows
+// while it uses at most SUBSET_MAX_VERTICES distinct vertices instead, and vertices that do not
+// sit in one window are copied, in first use order, to the end of the vertex buffer.
+static void splitIndexRange(MESHDATA &mesh, const vector<unsigned int> &indices, size_t begin, size_t end, bool byMeshlet, bool compact, SPLITSTATE &state)
+{
+	vector<VERTEX> &verts = mesh.vertexStorage;
+	vector<MESHLET> &meshlets = mesh.meshletStorage;
+	size_t cursor = begin;
+
+	while (cursor < end)
+	{
+		MESHSUBSET subset;
+		subset.indexOffset = static_cast<unsigned int>(cursor);
+		size_t firstMeshlet = state.meshletIndex;
+		unsigned int lowest = 0xffffffff, highest = 0;
+		state.stampValue++;
+		state.used.clear();
+
+		while (cursor < end)
+		{
+			size_t unitEnd = byMeshlet ? cursor + meshlets[state.meshletIndex].indexCount : cursor + 3;
+			size_t usedBefore = state.used.size();
+			unsigned int unitLowest = lowest, unitHighest = highest;
+			for (size_t i = cursor; i < unitEnd; ++i)
+			{
+				unsigned int v = indices[i];
+				unitLowest = min(unitLowest, v);
+				unitHighest = max(unitHighest, v);
+				if (state.stamp[v] != state.stampValue)
+				{
+					state.stamp[v] = state.stampValue;
+					state.used.push_back(v);
+				}
+			}
+
+			bool full = compact ? state.used.size() > SUBSET_MAX_VERTICES : unitHighest - unitLowest >= SUBSET_MAX_VERTICES;
+			if (full && cursor > subset.indexOffset)
+			{
+				for (size_t i = usedBefore; i < state.used.size(); ++i)
+					state.stamp[state.used[i]] = 0;
+				state.used.resize(usedBefore);
+				break;
+			}
+
+			lowest = unitLowest;
+			highest = unitHighest;
+			cursor = unitEnd;
+			if (byMeshlet)
+				state.meshletIndex++;
+			if (full)
+				break;	// a single triangle or meshlet that needs copying on its own
+		}
+
+		subset.indexCount = static_cast<unsigned int>(cursor - subset.indexOffset);
+
+		if (highest - lowest < SUBSET_MAX_VERTICES)
+		{
+			subset.baseVertex = lowest;
+			for (size_t i = subset.indexOffset; i < cursor; ++i)
+				mesh.indexStorage[i] = static_cast<uint16_t>(indices[i] - lowest);
+		}
+		else
+		{
+			subset.baseVertex = static_cast<unsigned int>(verts.size());
+			verts.reserve(verts.size() + state.used.size());
+			for (size_t i = 0; i < state.used.size(); ++i)
+			{
+				state.slot[state.used[i]] = static_cast<unsigned int>(i);
+				verts.push_back(verts[state.used[i]]);
+			}
+			for (size_t i = subset.indexOffset; i < cursor; ++i)
+				mesh.indexStorage[i] = static_cast<uint16_t>(state.slot[indices[i]]);
+		}
+
+		for (size_t i = firstMeshlet; i < state.meshletIndex; ++i)
+			meshlets[i].baseVertex = subset.baseVertex;
+
+		mesh.subsetStorage.push_back(subset);
+	}
+}
+
+// Turns the 32 bit indices into 16 bit ones and records the subsets that draw each level.
+// Vertices are stored in first use order, so a level usually splits into a few windows with
+// nothing copied, and a mesh with at most SUBSET_MAX_VERTICES vertices gets one subset per
+// level and submesh. Ranges whose order jumps around too much for that (coarse levels of an
+// overdraw sorted mesh, say) are split by distinct vertex count instead, copying what they need.
+void ModelLoader::splitMesh(MESHDATA &mesh, const vector<unsigned int> &indices)
+{
+	vector<VERTEX> &verts = mesh.vertexStorage;
+	size_t originalVertexCount = verts.size();
+
+	mesh.indexStorage.resize(indices.size());
+	mesh.subsetStorage.clear();
+
+	SPLITSTATE state;
+	state.stamp.assign(originalVertexCount, 0);
+	state.slot.resize(originalVertexCount);
+	state.stampValue = 0;
+	state.meshletIndex = 0;
+
+	// Levels are split submesh by submesh, so each submesh level is a run of subsets and
+	// each mesh level is the runs of its submeshes back to back.
+	for (unsigned int level = 0; level < mesh.lodCount; ++level)
+	{
+		MESHLOD &lod = mesh.lods[level];
+		lod.subsetOffset = static_cast<unsigned int>(mesh.subsetStorage.size());
+		bool byMeshlet = level == 0 && !mesh.meshletStorage.empty();
+
+		for (SUBMESH &submesh : mesh.submeshStorage)
+		{
+			MESHLOD &part = submesh.lods[level];
+			size_t begin = part.indexOffset, end = size_t(part.indexOffset) + part.indexCount;
+
+			part.subsetOffset = static_cast<unsigned int>(mesh.subsetStorage.size());
+			size_t vertexCount = verts.size(), meshletIndex = state.meshletIndex;
+			splitIndexRange(mesh, indices, begin, end, byMeshlet, false, state);
+
+			size_t subsetCount = mesh.subsetStorage.size() - part.subsetOffset;
+			if (subsetCount > 1 && part.indexCount / 3 / subsetCount < SUBSET_MIN_TRIANGLES)
+			{
+				mesh.subsetStorage.resize(part.subsetOffset);
+				verts.resize(vertexCount);
+				state.meshletIndex = meshletIndex;
+				splitIndexRange(mesh, indices, begin, end, byMeshlet, true, state);
+			}
+
+			part.subsetCount = static_cast<unsigned int>(mesh.subsetStorage.size()) - part.subsetOffset;
+		}
+
+		lod.subsetCount = static_cast<unsigned int>(mesh.subsetStorage.size()) - lod.subsetOffset;
+	}
+
+	stats.copiedVertexCount = static_cast<unsigned int>(verts.size() - originalVertexCount);
+}
+
+unsigned int SelectMeshLod(const MESHLOD * lods, unsigned int lodCount, float maxError)
+{
+	unsigned int selected = 0;
+	for (unsigned int i = 1; i < lodCount; ++i)
+	{
+		if (lods[i].error <= maxError)
+			selected = i;
+	}
+	return selected;
+}
+
+// Replaces the float vertices with PACKEDVERTEX and reports how far they moved.
+void ModelLoader::quantizeMesh(MESHDATA &mesh)
+{
+	mesh.decode = ComputeVertexDecode(mesh.vertices, mesh.vertexCount);
+	mesh.packedStorage.resize(mesh.vertexCount);
+	QUANTIZEERROR error = QuantizeVertices(mesh.packedStorage.data(), mesh.vertices, mesh.vertexCount, mesh.decode);
+
+	stats.positionError = error.position;
+	stats.uvError = error.uv;
+	stats.normalError = error.normal;
+
+	mesh.packedVertices = mesh.packedStorage.data();
+	mesh.vertices = nullptr;
+	vector<VERTEX>().swap(mesh.vertexStorage);
+}
 
 bool ModelLoader::loadModel(const char * path, vector<VERTEX> &out_verts, vector<unsigned int> &out_indices)
 {
-	FILE * file;
-	fopen_s(&file, path, "r");
+	auto start = chrono::high_resolution_clock::now();
+
+	DX::MappedFile file;
+	if (!file.open(path))
+	{
+		printf("Failed to open the file !\n");
+		return false;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&bounds, 0, sizeof(bounds));
+	stats.fileBytes = file.size();
+
+	const char * begin = reinterpret_cast<const char *>(file.data());
+	if (!parseObj(begin, begin + file.size()))
+		return false;
+
+	bounds = ComputeBounds(temp_vertices.data(), temp_vertices.size());
+
+	auto normalStart = chrono::high_resolution_clock::now();
+	generateNormals();
+	stats.normalSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - normalStart).count();
+
+	auto weldStart = chrono::high_resolution_clock::now();
+	weldVertices(out_verts, out_indices);
+	stats.weldSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - weldStart).count();
+
+	stats.positionCount = static_cast<unsigned int>(temp_vertices.size());
+	stats.uvCount = static_cast<unsigned int>(temp_uvs.size());
+	stats.normalCount = static_cast<unsigned int>(temp_normals.size() - stats.generatedNormalCount);
+	stats.triangleCount = static_cast<unsigned int>(vertexIndices.size() / 3);
+	stats.cornerCount = static_cast<unsigned int>(vertexIndices.size());
+	stats.parseSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	return true;
+}
+
+const float ModelLoader::DEFAULT_CREASE_ANGLE = 60.0f;
+
+// Files smaller than this are parsed on the calling thread when the thread count is automatic.
+static const size_t PARALLEL_MIN_BYTES = 4 * 1024 * 1024;
+
+// Stands in for vector in parseRange when the sizes are known up front: push_back writes into
+// memory taken from a MESHARENA and never allocates. A miscount past capacity is still counted,
+// but not written, so the caller can tell.
+template <typename T>
+struct FIXEDARRAY
+{
+	T * data;
+	size_t count;
+	size_t capacity;
+
+	void push_back(const T &value)
+	{
+		if (count < capacity)
+			data[count] = value;
+		count++;
+	}
+	size_t size() const { return count; }
+	bool overflowed() const { return count > capacity; }
+};
+
+// Stands in for the record list when g, o, usemtl and mtllib lines aren't wanted.
+struct NORECORDS
+{
+};
+
+static inline void addRecord(vector<OBJRECORD> &records, unsigned int kind, size_t corner, const char * name, const char * nameEnd)
+{
+	OBJRECORD record;
+	record.kind = kind;
+	record.corner = corner;
+	record.name.assign(name, nameEnd);
+	records.push_back(record);
+}
+
+static inline void addRecord(NORECORDS &, unsigned int, size_t, const char *, const char *)
+{
+}
+
+// Negative face indices count back from the last v, vt or vn read so far. A chunk of a
+// parallel parse only knows its own lines, so it stores such an index as its position
+// relative to the chunk's first element (maybe before it) in the low 31 bits, marked with
+// RELATIVE_INDEX, and parseParallel adds the chunk's offset.
+static const unsigned int RELATIVE_INDEX = 0x80000000;
+
+static inline bool resolveIndex(int index, size_t count, unsigned int relativeMark, unsigned int &out)
+{
+	if (index >= 0)
+	{
+		out = static_cast<unsigned int>(index);
+		return true;
+	}
+
+	int64_t resolved = int64_t(count) + index + 1;
+	if (relativeMark)
+	{
+		out = (static_cast<unsigned int>(max<int64_t>(resolved, -0x40000000)) & ~RELATIVE_INDEX) | relativeMark;
+		return true;
+	}
+
+	if (resolved < 1)
+		return false;
+	out = static_cast<unsigned int>(resolved);
+	return true;
+}
+
+// The one based index a chunk's index stands for once the chunk starts at 'offset'.
+// Relative indices reaching before the first line become an index validation rejects.
+static inline unsigned int offsetIndex(unsigned int index, size_t offset)
+{
+	if (!(index & RELATIVE_INDEX))
+		return index;
+
+	int64_t resolved = int64_t(offset) + (int32_t(index << 1) >> 1);
+	return resolved >= 1 ? static_cast<unsigned int>(resolved) : 0xffffffff;
+}
+
+template <typename INDICES>
+static inline void addCorner(INDICES &positionIndices, INDICES &uvIndices, INDICES &normalIndices, const unsigned int * corner)
+{
+	positionIndices.push_back(corner[0]);
+	uvIndices.push_back(corner[1]);
+	normalIndices.push_back(corner[2]);
+}
+
+// Parses every v/vt/vn/f record in [p, end) and appends them to the given arrays.
+// Face indices are stored as written, or resolved if they are relative (see resolveIndex),
+// and checked once the whole file is known. Faces with more than three corners are fanned
+// and listed in polygons. g, o, usemtl and mtllib lines go to records, numbered by the
+// corners parsed before them. The arrays are vectors, or FIXEDARRAYs sized by countObj.
+template <typename ATTRIBUTES, typename INDICES, typename POLYGONS, typename RECORDS>
+static bool parseRange(const char * p, const char * end,
+	ATTRIBUTES &positions, ATTRIBUTES &uvs, ATTRIBUTES &normals,
+	INDICES &positionIndices, INDICES &uvIndices, INDICES &normalIndices,
+	POLYGONS &polygons, RECORDS &records, unsigned int relativeMark)
+{
+	while (p < end)
+	{
+		p = skipBlanks(p, end);
+		if (p >= end)
+			break;
+
+		if (isKeyword(p, end, "v"))  // if its a vertex
+		{
+			XMFLOAT3 vertex;
+			const char * q = parseFloat(p + 1, end, vertex.x);
+			q = q ? parseFloat(q, end, vertex.y) : nullptr;
+			q = q ? parseFloat(q, end, vertex.z) : nullptr;
+			if (!q)
+			{
+				printf("Malformed vertex in OBJ file\n");
+				return false;
+			}
+			positions.push_back(vertex);
+		}
+		else if (isKeyword(p, end, "vt")) // if it is a UV
+		{
+			XMFLOAT3 uv = { 0.0f, 0.0f, 0.0f };
+			const char * q = parseFloat(p + 2, end, uv.x);
+			q = q ? parseFloat(q, end, uv.y) : nullptr;
+			if (!q)
+			{
+				printf("Malformed texture coordinate in OBJ file\n");
+				return false;
+			}
+			uv.y = 1 - uv.y;
+			uvs.push_back(uv);
+		}
+		else if (isKeyword(p, end, "vn")) // if it is a normal
+		{
+			XMFLOAT3 normal;
+			const char * q = parseFloat(p + 2, end, normal.x);
+			q = q ? parseFloat(q, end, normal.y) : nullptr;
+			q = q ? parseFloat(q, end, normal.z) : nullptr;
+			if (!q)
+			{
+				printf("Malformed normal in OBJ file\n");
+				return false;
+			}
+			normals.push_back(normal);
+		}
+		else if (isKeyword(p, end, "f"))
+		{
+			// Corners may leave out vt or vn; parseCorner gives 0 for them, which no OBJ index
+			// uses. Each corner past the second closes a triangle with the first and the last.
+			const char * q = p + 1;
+			size_t firstCorner = positionIndices.size();
+			unsigned int cornerCount = 0;
+			unsigned int first[3] = {}, previous[3] = {};
+			for (;;)
+			{
+				q = skipBlanks(q, end);
+				if (q >= end || isLineEnd(*q) || *q == '#')
+					break;
+
+				int vertexIndex, uvIndex, normalIndex;
+				unsigned int parts = 0;
+				unsigned int corner[3];
+				q = parseCorner(q, end, vertexIndex, uvIndex, normalIndex, parts);
+				if (!q ||
+					!resolveIndex(vertexIndex, positions.size(), relativeMark, corner[0]) ||
+					!resolveIndex(uvIndex, uvs.size(), relativeMark, corner[1]) ||
+					!resolveIndex(normalIndex, normals.size(), relativeMark, corner[2]))
+				{
+					q = nullptr;
+					break;
+				}
+
+				if (cornerCount == 0)
+					memcpy(first, corner, sizeof(first));
+				else if (cornerCount >= 2)
+				{
+					addCorner(positionIndices, uvIndices, normalIndices, first);
+					addCorner(positionIndices, uvIndices, normalIndices, previous);
+					addCorner(positionIndices, uvIndices, normalIndices, corner);
+				}
+				memcpy(previous, corner, sizeof(previous));
+				cornerCount++;
+			}
+
+			if (!q || cornerCount < 3)
+			{
+				printf("File can't be read by our simple parser : ( Try exporting with other options\n");
+				return false;
+			}
+
+			if (cornerCount > 3)
+			{
+				OBJPOLYGON polygon = { firstCorner, cornerCount };
+				polygons.push_back(polygon);
+			}
+		}
+
+		else if (isKeyword(p, end, "g") || isKeyword(p, end, "o") || isKeyword(p, end, "usemtl") || isKeyword(p, end, "mtllib"))
+		{
+			unsigned int kind = *p == 'u' ? OBJRECORD::MATERIAL : *p == 'm' ? OBJRECORD::LIBRARY : OBJRECORD::GROUP;
+			const char * nameEnd;
+			const char * name = parseName(p + (*p == 'g' || *p == 'o' ? 1 : 6), end, nameEnd);
+			addRecord(records, kind, positionIndices.size(), name, nameEnd);
+		}
+
+		// Comments, smoothing groups and anything unknown are skipped.
+		p = skipLine(p, end);
+	}
+
+	return true;
+}
+
+// Polygons per ParallelFor item in triangulatePolygons.
+static const size_t POLYGON_BLOCK = 1024;
+
+// Splits the concave polygons the parser fanned out again by ear clipping, in place, since
+// both give cornerCount - 2 triangles. Convex ones keep their fan, as do polygons too large
+// for TriangulatePolygon. Every index must already have been checked.
+static void triangulatePolygons(const OBJPOLYGON * polygons, size_t polygonCount, const XMFLOAT3 * positions,
+	unsigned int * positionIndices, unsigned int * uvIndices, unsigned int * normalIndices, unsigned int threads)
+{
+	size_t blocks = (polygonCount + POLYGON_BLOCK - 1) / POLYGON_BLOCK;
+	DX::ParallelFor(blocks, polygonCount < POLYGON_BLOCK * 4 ? 1 : threads, [&](size_t block)
+	{
+		size_t last = min((block + 1) * POLYGON_BLOCK, polygonCount);
+		for (size_t i = block * POLYGON_BLOCK; i < last; ++i)
+		{
+			size_t base = polygons[i].corner;
+			unsigned int cornerCount = polygons[i].cornerCount;
+			if (cornerCount > MAX_POLYGON_CORNERS)
+				continue;
+
+			// Corner k of the polygon in the fan: the first corner of triangle 0, then the
+			// middle corner of each triangle, then the last corner of the last triangle.
+			unsigned int corners[MAX_POLYGON_CORNERS][3];
+			XMFLOAT3 points[MAX_POLYGON_CORNERS];
+			for (unsigned int k = 0; k < cornerCount; ++k)
+			{
+				size_t slot = k == 0 ? base : k < cornerCount - 1 ? base + 3 * (k - 1) + 1 : base + 3 * (k - 2) + 2;
+				corners[k][0] = positionIndices[slot];
+				corners[k][1] = uvIndices[slot];
+				corners[k][2] = normalIndices[slot];
+				points[k] = positions[corners[k][0] - 1];
+			}
+
+			unsigned char triangles[(MAX_POLYGON_CORNERS - 2) * 3];
+			if (!TriangulatePolygon(triangles, points, cornerCount))
+				continue;
+
+			for (unsigned int t = 0; t < (cornerCount - 2) * 3; ++t)
+			{
+				const unsigned int * corner = corners[triangles[t]];
+				positionIndices[base + t] = corner[0];
+				uvIndices[base + t] = corner[1];
+				normalIndices[base + t] = corner[2];
+			}
+		}
+	});
+}
+
+bool ModelLoader::parseObj(const char * begin, const char * end)
+{
+	temp_vertices.clear();
+	temp_uvs.clear();
+	temp_normals.clear();
+	vertexIndices.clear();
+	uvIndices.clear();
+	normalIndices.clear();
+	objRecords.clear();
+	objPolygons.clear();
+
+	unsigned int threads = threadCount;
+	if (threads == 0)
+		threads = size_t(end - begin) < PARALLEL_MIN_BYTES ? 1 : DX::DefaultThreadCount();
+
+	bool parsed = threads > 1 ?
+		parseParallel(begin, end, threads) :
+		parseRange(begin, end, temp_vertices, temp_uvs, temp_normals, vertexIndices, uvIndices, normalIndices, objPolygons, objRecords, 0);
+	if (!parsed)
+		return false;
+
+	// OBJ indices are one based and refer to the whole file. 0 means the corner had none.
+	for (size_t i = 0; i < vertexIndices.size(); ++i)
+	{
+		if (vertexIndices[i] - 1 >= temp_vertices.size() ||
+			(uvIndices[i] && uvIndices[i] - 1 >= temp_uvs.size()) ||
+			(normalIndices[i] && normalIndices[i] - 1 >= temp_normals.size()))
+		{
+			printf("File can't be read by our simple parser : ( Try exporting with other options\n");
+			return false;
+		}
+	}
+
+	triangulatePolygons(objPolygons.data(), objPolygons.size(), temp_vertices.data(), vertexIndices.data(), uvIndices.data(), normalIndices.data(), threads);
+	return true;
+}
+
+// Splits the file at line boundaries, parses the pieces on separate threads and then
+// concatenates them in file order. Each piece's offset into the combined arrays is the
+// prefix sum of the element counts of the pieces before it.
+bool ModelLoader::parseParallel(const char * begin, const char * end, unsigned int threads)
+{
+	// A few chunks per thread so one slow chunk doesn't leave the others idle.
+	size_t chunkCount = threads * 4;
+	size_t chunkSize = size_t(end - begin) / chunkCount + 1;
+
+	// The chunks are members so their arrays keep their capacity from the last file.
+	chunks.resize(chunkCount);
+	const char * p = begin;
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		OBJCHUNK &chunk = chunks[i];
+		chunk.begin = p;
+		p = (size_t(end - p) > chunkSize) ? skipLine(p + chunkSize - 1, end) : end;
+		chunk.end = p;
+		chunk.positions.clear();
+		chunk.uvs.clear();
+		chunk.normals.clear();
+		chunk.positionIndices.clear();
+		chunk.uvIndices.clear();
+		chunk.normalIndices.clear();
+		chunk.records.clear();
+		chunk.polygons.clear();
+	}
+
+	DX::ParallelFor(chunkCount, threads, [&](size_t i)
+	{
+		OBJCHUNK &chunk = chunks[i];
+		chunk.ok = parseRange(chunk.begin, chunk.end, chunk.positions, chunk.uvs, chunk.normals,
+			chunk.positionIndices, chunk.uvIndices, chunk.normalIndices, chunk.polygons, chunk.records, RELATIVE_INDEX);
+	});
+
+	size_t positions = 0, uvs = 0, normals = 0, corners = 0;
+	for (OBJCHUNK &chunk : chunks)
+	{
+		if (!chunk.ok)
+			return false;
+
+		chunk.positionOffset = positions;
+		chunk.uvOffset = uvs;
+		chunk.normalOffset = normals;
+		chunk.cornerOffset = corners;
+		positions += chunk.positions.size();
+		uvs += chunk.uvs.size();
+		normals += chunk.normals.size();
+		corners += chunk.positionIndices.size();
+
+		for (OBJRECORD &record : chunk.records)
+		{
+			record.corner += chunk.cornerOffset;
+			objRecords.push_back(record);
+		}
+
+		for (OBJPOLYGON polygon : chunk.polygons)
+		{
+			polygon.corner += chunk.cornerOffset;
+			objPolygons.push_back(polygon);
+		}
+	}
+
+	temp_vertices.resize(positions);
+	temp_uvs.resize(uvs);
+	temp_normals.resize(normals);
+	vertexIndices.resize(corners);
+	uvIndices.resize(corners);
+	normalIndices.resize(corners);
+
+	DX::ParallelFor(chunkCount, threads, [&](size_t i)
+	{
+		const OBJCHUNK &chunk = chunks[i];
+		copy(chunk.positions.begin(), chunk.positions.end(), temp_vertices.begin() + chunk.positionOffset);
+		copy(chunk.uvs.begin(), chunk.uvs.end(), temp_uvs.begin() + chunk.uvOffset);
+		copy(chunk.normals.begin(), chunk.normals.end(), temp_normals.begin() + chunk.normalOffset);
+		for (size_t corner = 0; corner < chunk.positionIndices.size(); ++corner)
+		{
+			vertexIndices[chunk.cornerOffset + corner] = offsetIndex(chunk.positionIndices[corner], chunk.positionOffset);
+			uvIndices[chunk.cornerOffset + corner] = offsetIndex(chunk.uvIndices[corner], chunk.uvOffset);
+			normalIndices[chunk.cornerOffset + corner] = offsetIndex(chunk.normalIndices[corner], chunk.normalOffset);
+		}
+	});
+
+	return true;
+}
+
+// Element counts of an OBJ file, found by countObj before anything is allocated.
+struct OBJCOUNTS
+{
+	size_t positions, uvs, normals, triangles, polygons;
+	size_t cornersWithoutNormals;	// face corners that end before a v/vt/vn or v//vn normal
+};
 
-	if (file == NULL)
+// Counts the v, vt, vn lines, and the triangles the f lines will be split into. Only looks at
+// the start of most lines, so it runs at about the speed of memchr.
+static void countObj(const char * p, const char * end, OBJCOUNTS &counts)
+{
+	memset(&counts, 0, sizeof(counts));
+	while (p < end)
+	{
+		p = skipBlanks(p, end);
+		if (p < end && (*p == 'v' || *p == 'f'))
+		{
+			if (isKeyword(p, end, "v"))
+				counts.positions++;
+			else if (isKeyword(p, end, "vt"))
+				counts.uvs++;
+			else if (isKeyword(p, end, "vn"))
+				counts.normals++;
+			else if (isKeyword(p, end, "f"))
+			{
+				// One corner per blank separated word; it has a normal if something follows its
+				// second slash.
+				size_t corners = 0;
+				for (const char * q = skipBlanks(p + 1, end); q < end && !isLineEnd(*q) && *q != '#'; q = skipBlanks(q, end))
+				{
+					corners++;
+					unsigned int slashes = 0;
+					const char * lastSlash = nullptr;
+					while (q < end && !isBlank(*q) && !isLineEnd(*q))
+					{
+						if (*q == '/')
+						{
+							slashes++;
+							lastSlash = q;
+						}
+						++q;
+					}
+					if (slashes < 2 || lastSlash + 1 == q)
+						counts.cornersWithoutNormals++;
+				}
+				if (corners >= 3)
+				{
+					counts.triangles += corners - 2;
+					counts.polygons += corners > 3;
+				}
+			}
+		}
+
+		const char * next = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+		p = next ? next + 1 : end;
+	}
+}
+
+// Blocks loadModelArena takes: three attribute arrays, three index arrays, the polygon list,
+// the weld table and the vertex and index output.
+static const size_t ARENA_BLOCKS = 10;
+
+bool ModelLoader::loadModelArena(const char * path, MESHARENA &arena, ARENAMESH &out_mesh)
+{
+	auto start = chrono::high_resolution_clock::now();
+	memset(&out_mesh, 0, sizeof(out_mesh));
+
+	DX::MappedFile file;
+#ifdef _WIN32
+	// MappedFile::open(const char *) converts through a wstring; a stack buffer keeps this
+	// path free of heap allocations.
+	wchar_t widePath[MAX_PATH];
+	bool opened = MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath, MAX_PATH) > 0 && file.open(widePath);
+#else
+	bool opened = file.open(path);
+#endif
+	if (!opened)
+	{
+		printf("Failed to open the file !\n");
+		return false;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&bounds, 0, sizeof(bounds));
+	stats.fileBytes = file.size();
+
+	const char * begin = reinterpret_cast<const char *>(file.data());
+	const char * end = begin + file.size();
+
+	OBJCOUNTS counts;
+	countObj(begin, end, counts);
+	size_t corners = counts.triangles * 3;
+	size_t tableSize = weldTableSize(corners);
+
+	// Every block sized once, with room for alignment padding.
+	stats.arenaBytes = (counts.positions + counts.uvs + counts.normals) * sizeof(XMFLOAT3) +
+		corners * 3 * sizeof(unsigned int) + counts.polygons * sizeof(OBJPOLYGON) + tableSize * sizeof(WELDSLOT) +
+		corners * (sizeof(VERTEX) + sizeof(unsigned int)) + ARENA_BLOCKS * 15;
+	if (arena.capacity - arena.used < stats.arenaBytes)
+	{
+		if (arena.capacity)
+			printf("%s: needs %zu bytes of arena, %zu are left\n", path, stats.arenaBytes, arena.capacity - arena.used);
+		return false;
+	}
+	size_t arenaMark = arena.used;
+	unsigned int allocationMark = arena.allocationCount;
+
+	FIXEDARRAY<XMFLOAT3> positions = { arena.allocate<XMFLOAT3>(counts.positions), 0, counts.positions };
+	FIXEDARRAY<XMFLOAT3> uvs = { arena.allocate<XMFLOAT3>(counts.uvs), 0, counts.uvs };
+	FIXEDARRAY<XMFLOAT3> normals = { arena.allocate<XMFLOAT3>(counts.normals), 0, counts.normals };
+	FIXEDARRAY<unsigned int> positionIndices = { arena.allocate<unsigned int>(corners), 0, corners };
+	FIXEDARRAY<unsigned int> uvIndices = { arena.allocate<unsigned int>(corners), 0, corners };
+	FIXEDARRAY<unsigned int> normalIndices = { arena.allocate<unsigned int>(corners), 0, corners };
+	FIXEDARRAY<OBJPOLYGON> polygons = { arena.allocate<OBJPOLYGON>(counts.polygons), 0, counts.polygons };
+	NORECORDS records;
+
+	if (!parseRange(begin, end, positions, uvs, normals, positionIndices, uvIndices, normalIndices, polygons, records, 0))
+	{
+		arena.rewind(arenaMark, allocationMark);
+		return false;
+	}
+
+	if (positions.overflowed() || uvs.overflowed() || normals.overflowed() || positionIndices.overflowed() || polygons.overflowed())
+	{
+		printf("%s: the counting pass and the parser disagree\n", path);
+		arena.rewind(arenaMark, allocationMark);
+		return false;
+	}
+
+	// OBJ indices are one based and refer to the whole file. Generating normals needs scratch
+	// memory of its own, so files with faces without them go through loadModel on the heap,
+	// and only its result goes in the arena, in place of the parser's blocks. It fits there:
+	// welding never makes more vertices than corners. loadModel runs on this thread too.
+	if (find(normalIndices.data, normalIndices.data + normalIndices.count, 0u) != normalIndices.data + normalIndices.count)
+	{
+		arena.rewind(arenaMark, allocationMark);
+		size_t arenaBytes = stats.arenaBytes;
+		unsigned int savedThreadCount = threadCount;
+		threadCount = 1;
+		vector<VERTEX> verts;
+		vector<unsigned int> indices;
+		bool loaded = loadModel(path, verts, indices);
+		threadCount = savedThreadCount;
+		if (!loaded)
+			return false;
+
+		out_mesh.vertices = arena.allocate<VERTEX>(verts.size());
+		out_mesh.indices = arena.allocate<unsigned int>(indices.size());
+		copy(verts.begin(), verts.end(), out_mesh.vertices);
+		copy(indices.begin(), indices.end(), out_mesh.indices);
+		out_mesh.vertexCount = static_cast<unsigned int>(verts.size());
+		out_mesh.indexCount = static_cast<unsigned int>(indices.size());
+
+		stats.arenaBytes = arenaBytes;
+		stats.usedLoadModel = true;
+		stats.parseSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		return true;
+	}
+
+	for (size_t i = 0; i < positionIndices.count; ++i)
+	{
+		if (positionIndices.data[i] - 1 >= positions.count ||
+			(uvIndices.data[i] && uvIndices.data[i] - 1 >= uvs.count) ||
+			normalIndices.data[i] - 1 >= normals.count)
+		{
+			printf("File can't be read by our simple parser : ( Try exporting with other options\n");
+			arena.rewind(arenaMark, allocationMark);
+			return false;
+		}
+	}
+
+	triangulatePolygons(polygons.data, polygons.count, positions.data, positionIndices.data, uvIndices.data, normalIndices.data, 1);
+	bounds = ComputeBounds(positions.data, positions.count);
+
+	// Weld exactly like weldVertices, with the table and the output in the arena too.
+	WELDSLOT * slots = arena.allocate<WELDSLOT>(tableSize);
+	WELDSLOT empty = { 0, 0, 0, EMPTY_SLOT };
+	fill(slots, slots + tableSize, empty);
+	size_t mask = tableSize - 1;
+
+	out_mesh.vertices = arena.allocate<VERTEX>(corners);
+	out_mesh.indices = arena.allocate<unsigned int>(corners);
+	for (size_t i = 0; i < corners; i++)
+	{
+		unsigned int position = positionIndices.data[i] - 1;
+		unsigned int uv = uvIndices.data[i] - 1;
+		unsigned int normal = normalIndices.data[i] - 1;
+
+		WELDSLOT &entry = findWeldSlot(slots, mask, position, uv, normal);
+		if (entry.vertex == EMPTY_SLOT)
+		{
+			entry.position = position;
+			entry.uv = uv;
+			entry.normal = normal;
+			entry.vertex = out_mesh.vertexCount++;
+
+			VERTEX &vertex = out_mesh.vertices[entry.vertex];
+			vertex.position = positions.data[position];
+			vertex.UV = uv < uvs.count ? uvs.data[uv] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+			vertex.normal = normals.data[normal];
+		}
+
+		out_mesh.indices[i] = entry.vertex;
+	}
+	out_mesh.indexCount = static_cast<unsigned int>(corners);
+
+	stats.positionCount = static_cast<unsigned int>(counts.positions);
+	stats.uvCount = static_cast<unsigned int>(counts.uvs);
+	stats.normalCount = static_cast<unsigned int>(counts.normals);
+	stats.triangleCount = static_cast<unsigned int>(counts.triangles);
+	stats.cornerCount = static_cast<unsigned int>(corners);
+	stats.uniqueVertexCount = out_mesh.vertexCount;
+	stats.parseSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	return true;
+}
+
+static inline unsigned int hashCorner(unsigned int position, unsigned int uv, unsigned int normal)
+{
+	unsigned int h = position * 0x9e3779b1u;
+	h ^= uv * 0x85ebca77u + (h << 6) + (h >> 2);
+	h ^= normal * 0xc2b2ae3du + (h << 6) + (h >> 2);
+	return h ^ (h >> 15);
+}
+
+// Power of two slot count for up to 'corners' distinct corners.
+size_t ModelLoader::weldTableSize(size_t corners)
+{
+	// Keep the table at most half full so probe chains stay short.
+	size_t tableSize = 16;
+	while (tableSize < corners * 2)
+		tableSize <<= 1;
+	return tableSize;
+}
+
+// Clears the weld table and sizes it for up to 'corners' distinct corners.
+void ModelLoader::resetWeldTable(size_t corners)
+{
+	size_t tableSize = weldTableSize(corners);
+	weldMask = tableSize - 1;
+
+	WELDSLOT empty = { 0, 0, 0, EMPTY_SLOT };
+	weldSlots.assign(tableSize, empty);
+}
+
+// Returns the slot holding this v/vt/vn triple, or the empty slot where it belongs.
+ModelLoader::WELDSLOT & ModelLoader::findWeldSlot(WELDSLOT * slots, size_t mask, unsigned int position, unsigned int uv, unsigned int normal)
+{
+	size_t slot = hashCorner(position, uv, normal) & mask;
+	while (slots[slot].vertex != EMPTY_SLOT &&
+		(slots[slot].position != position || slots[slot].uv != uv || slots[slot].normal != normal))
+	{
+		slot = (slot + 1) & mask;
+	}
+	return slots[slot];
+}
+
+// Gives every corner without a vn a generated normal. The normals are appended to
+// temp_normals, one per group of corners GenerateNormals found to share one, and the corners
+// point at them like any vn, so weldVertices merges them in the same pass as the file's own.
+void ModelLoader::generateNormals()
+{
+	size_t corners = vertexIndices.size();
+	size_t missing = count(normalIndices.begin(), normalIndices.end(), 0u);
+	if (missing == 0)
+		return;
+
+	size_t positionCount = temp_vertices.size();
+	positionColumns.resize(positionCount * 3);
+	float * x = positionColumns.data();
+	float * y = x + positionCount;
+	float * z = y + positionCount;
+	for (size_t i = 0; i < positionCount; ++i)
+	{
+		x[i] = temp_vertices[i].x;
+		y[i] = temp_vertices[i].y;
+		z[i] = temp_vertices[i].z;
+	}
+
+	cornerScratch.resize(corners);
+	for (size_t i = 0; i < corners; ++i)
+		cornerScratch[i] = vertexIndices[i] - 1;
+
+	cornerNormals.resize(corners);
+	sharedCorners.resize(corners);
+	GenerateNormals(cornerNormals.data(), sharedCorners.data(), cornerScratch.data(), corners, x, y, z, positionCount,
+		XMConvertToRadians(creaseAngle), threadCount);
+
+	// cornerScratch now maps a group's first corner to its one based index in temp_normals.
+	fill(cornerScratch.begin(), cornerScratch.end(), 0u);
+	size_t before = temp_normals.size();
+	for (size_t i = 0; i < corners; ++i)
+	{
+		if (normalIndices[i])
+			continue;
+
+		unsigned int first = sharedCorners[i];
+		if (cornerScratch[first] == 0)
+		{
+			temp_normals.push_back(cornerNormals[first]);
+			cornerScratch[first] = static_cast<unsigned int>(temp_normals.size());
+		}
+		normalIndices[i] = cornerScratch[first];
+	}
+
+	stats.generatedNormalCount = static_cast<unsigned int>(temp_normals.size() - before);
+}
+
+// Emits one VERTEX per distinct position/uv/normal triple and indexes every face corner into it,
+// so corners shared between triangles are stored once.
+void ModelLoader::weldVertices(vector<VERTEX> &out_verts, vector<unsigned int> &out_indices)
+{
+	size_t corners = vertexIndices.size();
+	resetWeldTable(corners);
+
+	size_t base = out_verts.size();
+	out_verts.reserve(base + corners);
+	out_indices.reserve(out_indices.size() + corners);
+
+	for (size_t i = 0; i < corners; i++)
+	{
+		unsigned int position = vertexIndices[i] - 1;
+		unsigned int uv = uvIndices[i] - 1;
+		unsigned int normal = normalIndices[i] - 1;
+
+		WELDSLOT &entry = findWeldSlot(position, uv, normal);
+		if (entry.vertex == EMPTY_SLOT)
+		{
+			entry.position = position;
+			entry.uv = uv;
+			entry.normal = normal;
+			entry.vertex = static_cast<unsigned int>(out_verts.size());
+
+			VERTEX tmp;
+			tmp.position = temp_vertices[position];
+			tmp.UV = uv < temp_uvs.size() ? temp_uvs[uv] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+			tmp.normal = temp_normals[normal];
+			out_verts.push_back(tmp);
+		}
+
+		out_indices.push_back(entry.vertex);
+	}
+
+	stats.uniqueVertexCount = static_cast<unsigned int>(out_verts.size() - base);
+}
+
+// Reads the floats of a v/vt/vn line recorded by loadModelStreaming. The line was
+// validated when it was first seen, so this can't fail.
+static XMFLOAT3 readAttribute(const char * begin, const char * end, uint32_t offset, int count)
+{
+	XMFLOAT3 value = { 0.0f, 0.0f, 0.0f };
+	const char * p = begin + offset;
+	p = parseFloat(p, end, value.x);
+	p = parseFloat(p, end, value.y);
+	if (count == 3)
+		parseFloat(p, end, value.z);
+	return value;
+}
+
+bool ModelLoader::loadModelStreaming(const char * path, size_t memoryBudget, const BATCHCALLBACK &onBatch)
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	DX::MappedFile file;
+	if (!file.open(path))
 	{
 		printf("Failed to open the file !\n");
 		return false;
 	}
 
+	// Attribute lines are remembered by 32 bit offset into the mapping.
+	if (file.size() > 0xffffffffull)
+	{
+		printf("File is too large to stream\n");
+		return false;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&bounds, 0, sizeof(bounds));
+	stats.fileBytes = file.size();
+
+	const char * begin = reinterpret_cast<const char *>(file.data());
+	const char * end = begin + file.size();
+
+	// The line offsets come out of the budget first, so count the lines to size them exactly.
+	OBJCOUNTS counts;
+	countObj(begin, end, counts);
+	size_t lineBytes = (counts.positions + counts.uvs + counts.normals) * sizeof(uint32_t);
+	size_t batchBudget = memoryBudget > lineBytes ? memoryBudget - lineBytes : 0;
+
+	// Each batch vertex costs the VERTEX itself and two indices; the weld table is a power of
+	// two at least twice the vertex count. Take the table size that leaves room for the most
+	// vertices, but never less than one polygon's worth.
+	const size_t bytesPerVertex = sizeof(VERTEX) + 2 * sizeof(unsigned int);
+	size_t batchVertices = 0;
+	for (size_t tableSize = weldTableSize(0); tableSize * sizeof(WELDSLOT) <= batchBudget; tableSize <<= 1)
+	{
+		size_t fit = min(tableSize / 2, (batchBudget - tableSize * sizeof(WELDSLOT)) / bytesPerVertex);
+		batchVertices = max(batchVertices, fit);
+	}
+	if (batchVertices < (MAX_POLYGON_CORNERS - 2) * 3)
+		batchVertices = (MAX_POLYGON_CORNERS - 2) * 3;
+	size_t batchIndices = batchVertices * 2;
+
+	vector<VERTEX> verts;
+	vector<unsigned int> indices;
+	verts.reserve(batchVertices);
+	indices.reserve(batchIndices);
+	resetWeldTable(batchVertices);
+
+	// v/vt/vn lines seen so far, so faces can refer back to any earlier one.
+	vector<uint32_t> positionLines, uvLines, normalLines;
+	positionLines.reserve(counts.positions);
+	uvLines.reserve(counts.uvs);
+	normalLines.reserve(counts.normals);
+	stats.streamingBytes = lineBytes + batchVertices * sizeof(VERTEX) + batchIndices * sizeof(unsigned int) +
+		weldTableSize(batchVertices) * sizeof(WELDSLOT);
+
+	// Only a budget too small for one polygon's batch, or the loadModel fallback, goes past it.
+	auto checkBudget = [&]()
+	{
+		stats.overBudget = stats.streamingBytes > memoryBudget;
+		if (stats.overBudget)
+			printf("Streaming %s holds %zu bytes, over its %zu byte budget\n", path, stats.streamingBytes, memoryBudget);
+	};
+
+	unsigned int batchNumber = 0;
+	auto flush = [&]() -> bool
+	{
+		if (indices.empty())
+			return true;
+
+		MESHBATCH batch;
+		batch.vertices = verts.data();
+		batch.vertexCount = static_cast<unsigned int>(verts.size());
+		batch.indices = indices.data();
+		batch.indexCount = static_cast<unsigned int>(indices.size());
+		batch.batchIndex = batchNumber++;
+
+		stats.uniqueVertexCount += batch.vertexCount;
+		bool keepGoing = onBatch(batch);
+
+		verts.clear();
+		indices.clear();
+		resetWeldTable(batchVertices);
+		return keepGoing;
+	};
+
+	if (counts.cornersWithoutNormals)
+	{
+		// Normals are generated from the whole mesh, so loadModel has to see all of it first;
+		// its result is then cut into batches the same way. That holds the whole mesh at once.
+		size_t budgetedBytes = stats.streamingBytes;
+		vector<VERTEX> allVerts;
+		vector<unsigned int> allIndices;
+		if (!loadModel(path, allVerts, allIndices))
+			return false;
+		resetWeldTable(batchVertices);
+		stats.uniqueVertexCount = 0;
+		stats.usedLoadModel = true;
+
+		// slot[v] is vertex v's place in the batch, valid while stamp[v] is the batch's number + 1.
+		vector<unsigned int> slot(allVerts.size()), stamp(allVerts.size(), 0);
+		stats.streamingBytes = budgetedBytes + allVerts.size() * sizeof(VERTEX) + allIndices.size() * sizeof(unsigned int) +
+			allVerts.size() * 2 * sizeof(unsigned int);
+		checkBudget();
+		for (size_t i = 0; i < allIndices.size(); i += 3)
+		{
+			if (verts.size() + 3 > batchVertices || indices.size() + 3 > batchIndices)
+			{
+				if (!flush())
+					return true;
+			}
+
+			for (size_t k = i; k < i + 3; ++k)
+			{
+				unsigned int v = allIndices[k];
+				if (stamp[v] != batchNumber + 1)
+				{
+					stamp[v] = batchNumber + 1;
+					slot[v] = static_cast<unsigned int>(verts.size());
+					verts.push_back(allVerts[v]);
+				}
+				indices.push_back(slot[v]);
+			}
+		}
+
+		if (!flush())
+			return true;
+
+		stats.batchCount = batchNumber;
+		stats.parseSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		return true;
+	}
+
+	checkBudget();
+
+	const char * p = begin;
+
+	while (p < end)
+	{
+		p = skipBlanks(p, end);
+		if (p >= end)
+			break;
+
+		vector<uint32_t> * lines = nullptr;
+		const char * q = p;
+		if (isKeyword(p, end, "v"))
+		{
+			lines = &positionLines;
+			q = p + 1;
+		}
+		else if (isKeyword(p, end, "vt"))
+		{
+			lines = &uvLines;
+			q = p + 2;
+		}
+		else if (isKeyword(p, end, "vn"))
+		{
+			lines = &normalLines;
+			q = p + 2;
+		}
+
+		if (lines)
+		{
+			uint32_t offset = uint32_t(q - begin);
+
+			XMFLOAT3 value;
+			q = parseFloat(q, end, value.x);
+			q = q ? parseFloat(q, end, value.y) : nullptr;
+			if (lines != &uvLines)
+				q = q ? parseFloat(q, end, value.z) : nullptr;
+			if (!q)
+			{
+				printf("Malformed vertex data in OBJ file\n");
+				return false;
+			}
+
+			lines->push_back(offset);
+		}
+		else if (isKeyword(p, end, "f"))
+		{
+			// Polygons are read whole, up to MAX_POLYGON_CORNERS, so concave ones can be split
+			// by ear clipping before any of their triangles are emitted.
+			const char * q = p + 1;
+			unsigned int corners[MAX_POLYGON_CORNERS][3];
+			unsigned int cornerCount = 0;
+			for (;;)
+			{
+				q = skipBlanks(q, end);
+				if (q >= end || isLineEnd(*q) || *q == '#')
+					break;
+
+				int vertexIndex, uvIndex, normalIndex;
+				unsigned int parts = 0;
+				unsigned int * corner = corners[cornerCount];
+				// countObj found a normal on every corner; a missing vt reads as 0 and gives zero UVs.
+				q = cornerCount < MAX_POLYGON_CORNERS ? parseCorner(q, end, vertexIndex, uvIndex, normalIndex, parts) : nullptr;
+				if (!q || !(parts & CORNER_NORMAL) ||
+					!resolveIndex(vertexIndex, positionLines.size(), 0, corner[0]) ||
+					!resolveIndex(uvIndex, uvLines.size(), 0, corner[1]) ||
+					!resolveIndex(normalIndex, normalLines.size(), 0, corner[2]) ||
+					corner[0] < 1 || corner[0] > positionLines.size() ||
+					corner[1] > uvLines.size() ||
+					corner[2] < 1 || corner[2] > normalLines.size())
+				{
+					q = nullptr;
+					break;
+				}
+				cornerCount++;
+			}
+
+			if (!q || cornerCount < 3)
+			{
+				printf("File can't be read by our simple parser : ( Try exporting with other options\n");
+				return false;
+			}
+
+			unsigned int triangles = cornerCount - 2;
+			unsigned char order[(MAX_POLYGON_CORNERS - 2) * 3];
+			bool clipped = false;
+			if (cornerCount > 3)
+			{
+				XMFLOAT3 points[MAX_POLYGON_CORNERS];
+				for (unsigned int k = 0; k < cornerCount; ++k)
+					points[k] = readAttribute(begin, end, positionLines[corners[k][0] - 1], 3);
+				clipped = TriangulatePolygon(order, points, cornerCount);
+			}
+			if (!clipped)
+			{
+				for (unsigned int t = 0; t < triangles; ++t)
+				{
+					order[t * 3] = 0;
+					order[t * 3 + 1] = static_cast<unsigned char>(t + 1);
+					order[t * 3 + 2] = static_cast<unsigned char>(t + 2);
+				}
+			}
+
+			// Start a new batch if this face might not fit.
+			if (verts.size() + triangles * 3 > batchVertices || indices.size() + triangles * 3 > batchIndices)
+			{
+				if (!flush())
+					return true;
+			}
+
+			for (unsigned int i = 0; i < triangles * 3; ++i)
+			{
+				const unsigned int * corner = corners[order[i]];
+				unsigned int position = corner[0] - 1;
+				unsigned int uv = corner[1] - 1;
+				unsigned int normal = corner[2] - 1;
+
+				WELDSLOT &entry = findWeldSlot(position, uv, normal);
+				if (entry.vertex == EMPTY_SLOT)
+				{
+					entry.position = position;
+					entry.uv = uv;
+					entry.normal = normal;
+					entry.vertex = static_cast<unsigned int>(verts.size());
+
+					VERTEX tmp;
+					tmp.position = readAttribute(begin, end, positionLines[position], 3);
+					tmp.UV = XMFLOAT3(0.0f, 0.0f, 0.0f);
+					if (uv < uvLines.size())
+					{
+						tmp.UV = readAttribute(begin, end, uvLines[uv], 2);
+						tmp.UV.y = 1 - tmp.UV.y;
+					}
+					tmp.normal = readAttribute(begin, end, normalLines[normal], 3);
+					verts.push_back(tmp);
+				}
+				indices.push_back(entry.vertex);
+			}
+
+			stats.triangleCount += triangles;
+			stats.cornerCount += triangles * 3;
+		}
+
+		p = skipLine(p, end);
+	}
+
+	if (!flush())
+		return true;
+
+	stats.positionCount = static_cast<unsigned int>(positionLines.size());
+	stats.uvCount = static_cast<unsigned int>(uvLines.size());
+	stats.normalCount = static_cast<unsigned int>(normalLines.size());
+	stats.batchCount = batchNumber;
+	stats.parseSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+// Number formats read the same through fscanf_s and fscanf; only %s needs a buffer size.
+#ifdef _WIN32
+#define SCAN_NUMBERS fscanf_s
+#else
+#define SCAN_NUMBERS fscanf
+#endif
+
+// The original fscanf_s based loader, kept only as the baseline for BenchmarkModelLoader.
+static bool loadModelScanf(const char * path, vector<VERTEX> &out_verts, vector<unsigned int> &out_indices)
+{
+	vector< unsigned int > vertexIndices, uvIndices, normalIndices;
+	vector< XMFLOAT3 > temp_vertices;
+	vector< XMFLOAT3 > temp_uvs;
+	vector< XMFLOAT3 > temp_normals;
+
+	FILE * file;
+	fopen_s(&file, path, "r");
+
+	if (file == NULL)
+		return false;
+
 	while (true)
 	{
 		char lineHeader[1024];
-		// read the first word of the line
-		int res = fscanf_s(file, "%s", lineHeader, int(sizeof(lineHeader)));
+#ifdef _WIN32
+		int res = fscanf_s(file, "%s", lineHeader, unsigned(sizeof(lineHeader)));
+#else
+		int res = fscanf(file, "%1023s", lineHeader);
+#endif
 
 		if (res == EOF)
-			break; // EOF = End Of File. Quit the loop.
-			// else : parse lineHeader
+			break;
 
-		if (strcmp(lineHeader, "v") == 0)  // if its a vertex
+		if (strcmp(lineHeader, "v") == 0)
 		{
 			XMFLOAT3 vertex;
-			fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
+			SCAN_NUMBERS(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
 			temp_vertices.push_back(vertex);
 		}
-		else if (strcmp(lineHeader, "vt") == 0) // if it is a UV
+		else if (strcmp(lineHeader, "vt") == 0)
 		{
-			XMFLOAT3 uv;
-			fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
+			XMFLOAT3 uv = { 0.0f, 0.0f, 0.0f };
+			SCAN_NUMBERS(file, "%f %f\n", &uv.x, &uv.y);
 			uv.y = 1 - uv.y;
 			temp_uvs.push_back(uv);
 		}
-		else if (strcmp(lineHeader, "vn") == 0) // if it is a normal
+		else if (strcmp(lineHeader, "vn") == 0)
 		{
 			XMFLOAT3 normal;
-			fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+			SCAN_NUMBERS(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
 			temp_normals.push_back(normal);
 		}
 		else if (strcmp(lineHeader, "f") == 0)
 		{
-			std::string vertex1, vertex2, vertex3;
 			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
+			int matches = SCAN_NUMBERS(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
 			if (matches != 9)
 			{
-				printf("File can't be read by our simple parser : ( Try exporting with other options\n");
+				fclose(file);
 				return false;
 			}
 
-			vertexIndices.push_back(vertexIndex[0]);
-			vertexIndices.push_back(vertexIndex[1]);
-			vertexIndices.push_back(vertexIndex[2]);
-			uvIndices.push_back(uvIndex[0]);
-			uvIndices.push_back(uvIndex[1]);
-			uvIndices.push_back(uvIndex[2]);
-			normalIndices.push_back(normalIndex[0]);
-			normalIndices.push_back(normalIndex[1]);
-			normalIndices.push_back(normalIndex[2]);
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				vertexIndices.push_back(vertexIndex[corner]);
+				uvIndices.push_back(uvIndex[corner]);
+				normalIndices.push_back(normalIndex[corner]);
+			}
 		}
 	}
 
-		// For each vertex of each triangle
-		for (unsigned int i = 0; i < vertexIndices.size(); i++)
+	fclose(file);
+
+	for (unsigned int i = 0; i < vertexIndices.size(); i++)
+	{
+		VERTEX tmp;
+		tmp.position = temp_vertices[vertexIndices[i] - 1];
+		tmp.UV = temp_uvs[uvIndices[i] - 1];
+		tmp.normal = temp_normals[normalIndices[i] - 1];
+		out_verts.push_back(tmp);
+		out_indices.push_back(i);
+	}
+
+	return true;
+}
+
+void BenchmarkModelLoader(const char * const * paths, size_t pathCount, unsigned int iterations)
+{
+	typedef chrono::high_resolution_clock Clock;
+
+	for (size_t i = 0; i < pathCount; ++i)
+	{
+		DX::MappedFile file;
+		if (!file.open(paths[i]))
 		{
-			VERTEX tmp;
-			tmp.position = temp_vertices[vertexIndices[i] - 1];
-			tmp.UV = temp_uvs[uvIndices[i] - 1];
-			tmp.normal = temp_normals[normalIndices[i] - 1];
-			out_verts.push_back(tmp);
-			out_indices.push_back(i);
+			printf("%s: failed to open\n", paths[i]);
+			continue;
 		}
+		double megabytes = iterations * file.size() / (1024.0 * 1024.0);
+		file.close();
 
-		return true;
+		vector<VERTEX> verts;
+		vector<unsigned int> indices;
+
+		auto start = Clock::now();
+		for (unsigned int n = 0; n < iterations; ++n)
+		{
+			verts.clear();
+			indices.clear();
+			loadModelScanf(paths[i], verts, indices);
+		}
+		double scanfSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+		ModelLoader loader;
+		start = Clock::now();
+		for (unsigned int n = 0; n < iterations; ++n)
+		{
+			verts.clear();
+			indices.clear();
+			loader.loadModel(paths[i], verts, indices);
+		}
+		double mappedSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+		printf("%s: fscanf_s %.2f MB/s, mapped %.2f MB/s (%.1fx), %u corners welded to %u vertices (%.2fx)\n", paths[i],
+			megabytes / scanfSeconds, megabytes / mappedSeconds, scanfSeconds / mappedSeconds,
+			loader.getStats().cornerCount, loader.getStats().uniqueVertexCount, loader.getStats().dedupeRatio());
+	}
+}
+
+void BenchmarkModelLoaderArena(const char * const * paths, size_t pathCount, unsigned int iterations)
+{
+	typedef chrono::high_resolution_clock Clock;
+
+	for (size_t i = 0; i < pathCount; ++i)
+	{
+		ModelLoader loader;
+		vector<VERTEX> verts;
+		vector<unsigned int> indices;
+		if (!loader.loadModel(paths[i], verts, indices))
+		{
+			printf("%s: failed to load\n", paths[i]);
+			continue;
+		}
+		double megabytes = iterations * loader.getStats().fileBytes / (1024.0 * 1024.0);
+
+		auto start = Clock::now();
+		for (unsigned int n = 0; n < iterations; ++n)
+		{
+			verts.clear();
+			indices.clear();
+			loader.loadModel(paths[i], verts, indices);
+		}
+		double vectorSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+		// The first call only measures; its failure reports the size the file needs.
+		MESHARENA probe(nullptr, 0);
+		ARENAMESH mesh;
+		loader.loadModelArena(paths[i], probe, mesh);
+		vector<char> memory(loader.getStats().arenaBytes);
+		MESHARENA arena(memory.data(), memory.size());
+
+		long long heapAllocations;
+		bool ok = true;
+		{
+			DX::HeapAllocationCounter counter;
+			start = Clock::now();
+			for (unsigned int n = 0; n < iterations && ok; ++n)
+			{
+				arena.reset();
+				ok = loader.loadModelArena(paths[i], arena, mesh);
+			}
+			heapAllocations = counter.Count();
+		}
+		double arenaSeconds = chrono::duration<double>(Clock::now() - start).count();
+		if (heapAllocations > 0)
+			heapAllocations /= iterations;
+
+		bool same = ok && mesh.vertexCount == verts.size() && mesh.indexCount == indices.size() &&
+			equal(indices.begin(), indices.end(), mesh.indices) &&
+			memcmp(mesh.vertices, verts.data(), verts.size() * sizeof(VERTEX)) == 0;
+
+		printf("%s: vectors %.2f MB/s, arena %.2f MB/s (%.2fx), %zu arena bytes in %u blocks, %lld heap allocations per load%s, %s\n",
+			paths[i], megabytes / vectorSeconds, megabytes / arenaSeconds, vectorSeconds / arenaSeconds,
+			arena.used, arena.allocationCount, heapAllocations, heapAllocations < 0 ? " (debug CRT only)" : "",
+			same ? "same mesh" : "MESHES DIFFER");
+	}
 }
 
+void BenchmarkModelLoaderPool(const char * const * paths, size_t pathCount, unsigned int iterations)
+{
+	typedef chrono::high_resolution_clock Clock;
+	size_t loads = pathCount * iterations;
+	unsigned int threads = DX::DefaultThreadCount();
+
+	for (int pooled = 0; pooled < 2; ++pooled)
+	{
+		ModelLoaderPool pool;
+		DX::HeapAllocationCounter counter;
+		auto start = Clock::now();
+		DX::ParallelFor(loads, threads, [&](size_t i)
+		{
+			vector<VERTEX> verts;
+			vector<unsigned int> indices;
+			if (pooled)
+			{
+				ModelLoaderPool::Handle loader = pool.acquire();
+				loader->setThreadCount(1);
+				loader->loadModel(paths[i % pathCount], verts, indices);
+			}
+			else
+			{
+				ModelLoader loader;
+				loader.setThreadCount(1);
+				loader.loadModel(paths[i % pathCount], verts, indices);
+			}
+		});
+		double seconds = chrono::duration<double>(Clock::now() - start).count();
+		long long heapAllocations = counter.Count();
+		if (heapAllocations > 0)
+			heapAllocations /= loads;
+
+		printf("%zu loads on %u threads, %s: %.2f ms, %lld heap allocations per load%s, %zu loaders created\n",
+			loads, threads, pooled ? "pooled loaders" : "fresh loaders", seconds * 1000.0,
+			heapAllocations, heapAllocations < 0 ? " (debug CRT only)" : "", pooled ? pool.idleCount() : loads);
+	}
+}
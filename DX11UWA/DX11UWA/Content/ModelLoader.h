@@ -1,5 +1,12 @@
 #include <vector>
+#include <string>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <stdint.h>
 #include <DirectXMath.h>
+#include "../Common/MappedFile.h"
 
 
 #pragma once
@@ -16,18 +23,444 @@ struct VERTEX
 	XMFLOAT3 normal;
 };
 
+// 16 byte vertex made by MESHPROCESS_QUANTIZE, decoded in LoadedVertexShader with VERTEXDECODE.
+struct PACKEDVERTEX
+{
+	uint16_t position[4];	// R16G16B16A16_UNORM inside the mesh bounds, w unused
+	uint16_t UV[2];			// R16G16_UNORM inside the mesh's UV range
+	int16_t normal[2];		// R16G16_SNORM octahedral encoded unit normal
+};
+
+// Constant buffer that turns PACKEDVERTEX attributes back into object space values.
+// Must match VertexDecodeConstantBuffer in LoadedVertexShader.hlsl.
+struct VERTEXDECODE
+{
+	XMFLOAT4 positionScale;		// position = packed * scale + offset
+	XMFLOAT4 positionOffset;
+	XMFLOAT4 uvScaleOffset;		// uv = packed * xy + zw
+};
+
+// Size and timing information about the last file handled by loadModel.
+struct LOADERSTATS
+{
+	size_t fileBytes;
+	unsigned int positionCount;
+	unsigned int uvCount;
+	unsigned int normalCount;
+	unsigned int triangleCount;
+	unsigned int cornerCount;		// face corners in the file, one per index
+	unsigned int uniqueVertexCount;	// vertices left after welding identical corners
+	double parseSeconds;
+	double weldSeconds;				// the part of parseSeconds spent welding corners into vertices
+	bool fromCache;					// loaded from a .meshbin file instead of parsing the OBJ
+	unsigned int batchCount;		// batches handed out by loadModelStreaming
+	float acmrBefore, acmrAfter;	// post-transform cache misses per triangle around MESHPROCESS_VERTEXCACHE
+	float atvrBefore, atvrAfter;	// post-transform cache misses per vertex around MESHPROCESS_VERTEXCACHE
+	float overdrawBefore, overdrawAfter;	// CPU estimated overdraw around MESHPROCESS_OVERDRAW
+	float positionError;			// largest MESHPROCESS_QUANTIZE round trip error, in object units
+	float uvError;					// same for texture coordinates
+	float normalError;				// largest angle between a normal and its decoded version, in degrees
+	size_t arenaBytes;				// arena space loadModelArena needs for this file, filled in even if it did not fit
+	unsigned int generatedNormalCount;	// normals made by GenerateNormals for corners without a vn
+	double normalSeconds;			// the part of parseSeconds spent generating them
+	size_t streamingBytes;			// what loadModelStreaming held at once: batch buffers, weld table and line offsets
+	unsigned int copiedVertexCount;	// vertices loadMesh copied so every subset fits 16 bit indices
+	bool usedLoadModel;				// faces without normals sent loadModelArena or loadModelStreaming to loadModel
+	bool overBudget;				// streamingBytes went past loadModelStreaming's memoryBudget
+
+	double megabytesPerSecond() const { return parseSeconds > 0.0 ? (fileBytes / (1024.0 * 1024.0)) / parseSeconds : 0.0; }
+	// How many corners share each emitted vertex on average (1.0 = nothing was welded).
+	double dedupeRatio() const { return uniqueVertexCount ? double(cornerCount) / uniqueVertexCount : 0.0; }
+};
+
+// A piece of the index buffer small enough for 16 bit indices. Its indices count from
+// baseVertex, which goes straight to DrawIndexed's BaseVertexLocation.
+struct MESHSUBSET
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	unsigned int baseVertex;
+};
+
+// One level of detail inside a mesh's index buffer. Every level indexes the same vertices.
+struct MESHLOD
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;				// how far, in object units, this level's surface strays from the full mesh
+	unsigned int subsetOffset;	// the MESHSUBSETs that draw this level
+	unsigned int subsetCount;
+};
+
+// The full mesh plus up to three simplified levels.
+static const unsigned int MESH_MAX_LODS = 4;
+
+// A small cluster of the full mesh's triangles with the bounds needed to cull it on the CPU.
+// Meshlets cover lods[0] in order, each one a contiguous range of the index buffer.
+struct MESHLET
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;	// at most MESHLET_MAX_TRIANGLES * 3
+	unsigned int vertexCount;	// distinct vertices used, at most MESHLET_MAX_VERTICES
+	XMFLOAT3 center;			// bounding sphere
+	float radius;
+	XMFLOAT3 coneAxis;			// average direction the triangles face
+	float coneCutoff;			// sine of the cone's half angle; 1 means the cone never culls
+	unsigned int baseVertex;	// of the MESHSUBSET holding the meshlet
+};
+
+static const unsigned int MESHLET_MAX_VERTICES = 64;
+static const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// Fixed sizes keep MATERIAL and SUBMESH plain data, so the cache can hold them as they are.
+static const unsigned int MESH_NAME_LENGTH = 64;
+static const unsigned int MESH_PATH_LENGTH = 260;
+
+// A material from the MTL libraries named by the OBJ's mtllib lines.
+// Strings are null terminated and cut short if they do not fit.
+struct MATERIAL
+{
+	char name[MESH_NAME_LENGTH];
+	XMFLOAT3 ambient;		// Ka
+	XMFLOAT3 diffuse;		// Kd
+	XMFLOAT3 specular;		// Ks
+	float specularPower;	// Ns
+	float opacity;			// d, or 1 - Tr
+	char diffuseMap[MESH_PATH_LENGTH];	// map_Kd joined to the MTL's folder, empty if there is none
+};
+
+static const unsigned int NO_MATERIAL = 0xffffffff;
+
+// The triangles of one OBJ group (g or o) that use one material (usemtl). Every submesh lives in
+// the mesh's shared vertex and index buffers, with its own range in each level of detail.
+struct SUBMESH
+{
+	char name[MESH_NAME_LENGTH];	// group name, empty for faces before the first g or o
+	unsigned int material;			// index into MESHDATA::materials, or NO_MATERIAL
+	XMFLOAT3 boundsMin;
+	XMFLOAT3 boundsMax;
+	MESHLOD lods[MESH_MAX_LODS];	// this submesh's part of each of the mesh's lodCount levels
+	unsigned int meshletOffset;		// its meshlets, which cover lods[0] in order
+	unsigned int meshletCount;
+};
+
+// How far a mesh reaches, in object units, for visibility tests, LOD selection and light
+// assignment without going back to the vertices.
+struct MESHBOUNDS
+{
+	XMFLOAT3 boundsMin;
+	XMFLOAT3 boundsMax;
+	XMFLOAT3 center;	// bounding sphere
+	float radius;
+};
+
+// Mesh ready to be handed to CreateBuffer. vertices and indices point either into the
+// memory mapped .meshbin cache or into the storage vectors, so nothing is copied on a
+// warm start. Keep the MESHDATA alive until the buffers have been created.
+// With MESHPROCESS_QUANTIZE, packedVertices and decode are filled in and vertices is null.
+// indexCount covers every level; lods[0] is the full mesh and draws the first lods[0].indexCount.
+// Indices are 16 bit and relative to their subset's baseVertex: meshes with more than 65536
+// vertices are split into several subsets, small ones get one subset per level and submesh.
+// Every mesh has at least one submesh; each level is its submeshes' ranges back to back.
+struct MESHDATA
+{
+	MESHDATA() : vertices(nullptr), packedVertices(nullptr), indices(nullptr), subsets(nullptr), meshlets(nullptr), submeshes(nullptr), materials(nullptr),
+		vertexCount(0), indexCount(0), subsetCount(0), meshletCount(0), submeshCount(0), materialCount(0), lodCount(0) {}
+
+	const VERTEX * vertices;
+	const PACKEDVERTEX * packedVertices;
+	const uint16_t * indices;
+	const MESHSUBSET * subsets;
+	const MESHLET * meshlets;
+	const SUBMESH * submeshes;
+	const MATERIAL * materials;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int subsetCount;
+	unsigned int meshletCount;
+	unsigned int submeshCount;
+	unsigned int materialCount;
+	MESHBOUNDS bounds;
+	VERTEXDECODE decode;
+	unsigned int lodCount;
+	MESHLOD lods[MESH_MAX_LODS];
+
+	vector<VERTEX> vertexStorage;
+	vector<PACKEDVERTEX> packedStorage;
+	vector<uint16_t> indexStorage;
+	vector<MESHSUBSET> subsetStorage;
+	vector<MESHLET> meshletStorage;
+	vector<SUBMESH> submeshStorage;
+	vector<MATERIAL> materialStorage;
+	DX::MappedFile cacheFile;
+};
+
+// Monotonic allocator for loadModelArena. Hands out aligned blocks from one caller owned buffer
+// and only gives them back all at once with reset, so a whole load costs no heap allocations.
+struct MESHARENA
+{
+	MESHARENA(void * memory, size_t size) : base(static_cast<char *>(memory)), capacity(size), used(0), allocationCount(0) {}
+
+	// Returns nullptr, and leaves the arena as it was, when the block doesn't fit.
+	void * allocate(size_t bytes, size_t alignment = 16)
+	{
+		size_t start = (reinterpret_cast<uintptr_t>(base) + used + alignment - 1) / alignment * alignment - reinterpret_cast<uintptr_t>(base);
+		if (start > capacity || bytes > capacity - start)
+			return nullptr;
+		used = start + bytes;
+		allocationCount++;
+		return base + start;
+	}
+
+	template <typename T>
+	T * allocate(size_t count) { return static_cast<T *>(allocate(count * sizeof(T))); }
+
+	void reset() { used = 0; allocationCount = 0; }
+	// Gives back every block handed out since used and allocationCount had these values.
+	void rewind(size_t usedMark, unsigned int allocationMark) { used = usedMark; allocationCount = allocationMark; }
+
+	char * base;
+	size_t capacity;
+	size_t used;
+	unsigned int allocationCount;	// blocks handed out since the last reset
+};
+
+// Mesh produced by loadModelArena. Both arrays live in the arena and stay valid until it is reset.
+struct ARENAMESH
+{
+	VERTEX * vertices;
+	unsigned int * indices;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+};
+
+// One finished piece of a mesh produced by loadModelStreaming. The indices refer to
+// this batch's vertices only, and both arrays are reused once the callback returns.
+struct MESHBATCH
+{
+	const VERTEX * vertices;
+	const unsigned int * indices;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int batchIndex;
+};
+
+// Receives each batch in file order. Return false to stop loading early.
+typedef function<bool(const MESHBATCH &batch)> BATCHCALLBACK;
+
+// A g, o, usemtl or mtllib line seen by the OBJ parser, with the face corner it came before.
+struct OBJRECORD
+{
+	enum { GROUP, MATERIAL, LIBRARY };
+	unsigned int kind;
+	size_t corner;
+	string name;
+};
+
+// A face with more than three corners. The parser fans it out from its first corner as it
+// reads it, so its cornerCount - 2 triangles start at 'corner'; concave ones are split again
+// once every position is known.
+struct OBJPOLYGON
+{
+	size_t corner;
+	unsigned int cornerCount;
+};
+
+// Optional passes loadMesh runs on a freshly parsed mesh before it is cached.
+enum MESHPROCESS
+{
+	MESHPROCESS_VERTEXCACHE	= 1,	// reorder triangles for the post-transform cache, then vertices by first use
+	MESHPROCESS_OVERDRAW	= 2,	// also sort triangle clusters to cut overdraw (implies MESHPROCESS_VERTEXCACHE)
+	MESHPROCESS_QUANTIZE	= 4,	// hand out 16 byte PACKEDVERTEX instead of 36 byte VERTEX
+	MESHPROCESS_LOD			= 8,	// append simplified levels of about 1/2, 1/4 and 1/8 the triangles
+	MESHPROCESS_MESHLETS	= 16,	// regroup the full mesh into meshlets that can be culled one by one
+};
 
 class ModelLoader
 {
 public:
+	ModelLoader() : weldMask(0), threadCount(0), processing(0), creaseAngle(DEFAULT_CREASE_ANGLE) { memset(&stats, 0, sizeof(stats)); memset(&bounds, 0, sizeof(bounds)); }
+
+	// Crease angle used when a file has faces without normals, in degrees.
+	static const float DEFAULT_CREASE_ANGLE;
+
 	bool loadModel(const char * path, vector<VERTEX> &out_verts, vector<unsigned int> &out_indices);
 
+	// Same result as loadModel, but counts the records of the mapped file first and takes every
+	// array from the arena at its final size, so parsing and welding never allocate. Fails when
+	// the arena is too small; getStats().arenaBytes then says how much the file needs, so an
+	// empty arena can be passed to measure a file first.
+	// Files with faces without normals are the exception: generating normals needs memory of
+	// its own, so they are loaded with loadModel and copied into the arena, which sets
+	// getStats().usedLoadModel.
+	// Always parses on the calling thread, loadModel included. On failure the arena is left
+	// as it was.
+	bool loadModelArena(const char * path, MESHARENA &arena, ARENAMESH &out_mesh);
+
+	// Loads from the cooked .meshbin next to the OBJ (or in the cache directory) when it is
+	// up to date, otherwise parses the OBJ and writes a fresh cache for the next run.
+	// On failure out_mesh is left empty, with no cache mapped.
+	bool loadMesh(const char * path, MESHDATA &out_mesh);
+
+	// What loadMesh does when the cache is stale: parses the OBJ and runs the setProcessing
+	// passes, leaving their results in getStats(), but neither reads nor writes a cache.
+	bool processModel(const char * path, MESHDATA &out_mesh);
+
+	// Walks the file and hands out welded triangle batches as they fill up, so a mesh can go to
+	// the GPU or to disk piece by piece. Only a 4 byte file offset per v/vt/vn line is kept, and
+	// attributes are re-read from the mapping when a face refers to them. memoryBudget covers
+	// those offsets, the batch buffers and the weld table, except that a batch always holds at
+	// least one polygon; a quick counting pass over the file sizes the offsets up front.
+	// Faces without vt get zero UVs. Normals for faces without vn are generated from the whole
+	// mesh, so such files are loaded with loadModel and then cut into batches; that holds the
+	// whole mesh in memory, whatever the budget, and sets getStats().usedLoadModel.
+	// Going past the budget either way is printed and sets getStats().overBudget.
+	bool loadModelStreaming(const char * path, size_t memoryBudget, const BATCHCALLBACK &onBatch);
+
+	// Where .meshbin files are written. Empty means next to the source file.
+	static void setCacheDirectory(const string &directory);
+	// The cache for path loaded with the given MESHPROCESS flags and crease angle: the file's
+	// stem plus a hash of the whole path, the flags and the angle, ending in .meshbin.
+	static string cachePathFor(const char * path, unsigned int processing, float creaseAngle);
+
+	// MESHPROCESS flags applied by loadMesh. The cache remembers them, so changing the flags
+	// rebuilds the cache instead of loading a mesh processed differently.
+	void setProcessing(unsigned int flags) { processing = flags; }
+
+	// Threads used to parse a file. 0 picks automatically: one thread for small files,
+	// every hardware thread for large ones.
+	void setThreadCount(unsigned int count) { threadCount = count; }
+
+	// Faces written as v or v/vt get smooth normals from GenerateNormals, kept hard across edges
+	// sharper than this many degrees. Like the processing flags, it is part of the cache key.
+	void setCreaseAngle(float degrees) { creaseAngle = degrees; }
+
+	const LOADERSTATS& getStats() const { return stats; }
+
+	// Box and sphere around every position of the last file, found by ComputeBounds right after
+	// parsing (or read from the cache by loadMesh). Not filled in by loadModelStreaming.
+	const MESHBOUNDS& getBounds() const { return bounds; }
+
+	// Forgets the last file and goes back to the default settings, but keeps the capacity of
+	// every scratch array so the next load of a similar mesh doesn't allocate them again.
+	void reset();
+
+	// Bytes held by the scratch arrays, used or not.
+	size_t scratchBytes() const;
+
+private:
+	// One slot of the open addressing table used to weld identical v/vt/vn triples.
+	struct WELDSLOT
+	{
+		unsigned int position, uv, normal;
+		unsigned int vertex;	// index of the emitted vertex, or EMPTY_SLOT
+	};
+	static const unsigned int EMPTY_SLOT = 0xffffffff;
+
+	// A line aligned piece of the file parsed on its own thread.
+	struct OBJCHUNK
+	{
+		const char * begin;
+		const char * end;
+		bool ok;
+		vector< XMFLOAT3 > positions, uvs, normals;
+		vector< unsigned int > positionIndices, uvIndices, normalIndices;
+		vector< OBJRECORD > records;
+		vector< OBJPOLYGON > polygons;
+		size_t positionOffset, uvOffset, normalOffset, cornerOffset;
+	};
+
+	bool parseObj(const char * begin, const char * end);
+	bool parseParallel(const char * begin, const char * end, unsigned int threads);
+	static size_t weldTableSize(size_t corners);
+	void resetWeldTable(size_t corners);
+	WELDSLOT & findWeldSlot(unsigned int position, unsigned int uv, unsigned int normal) { return findWeldSlot(weldSlots.data(), weldMask, position, uv, normal); }
+	static WELDSLOT & findWeldSlot(WELDSLOT * slots, size_t mask, unsigned int position, unsigned int uv, unsigned int normal);
+	void generateNormals();
+	void weldVertices(vector<VERTEX> &out_verts, vector<unsigned int> &out_indices);
+	void buildSubmeshes(const char * path, MESHDATA &mesh, vector<unsigned int> &indices);
+	void processMesh(MESHDATA &mesh, vector<unsigned int> &indices);
+	void buildLods(MESHDATA &mesh, vector<unsigned int> &indices, bool optimizeCache);
+	void splitMesh(MESHDATA &mesh, const vector<unsigned int> &indices);
+	void quantizeMesh(MESHDATA &mesh);
+
+	// Scratch kept between loads, see reset.
 	vector< unsigned int > vertexIndices, uvIndices, normalIndices;
 	vector< XMFLOAT3 > temp_vertices;
 	vector< XMFLOAT3 > temp_uvs;
 	vector< XMFLOAT3 > temp_normals;
-	
-	
+	vector< OBJRECORD > objRecords;
+	vector< OBJPOLYGON > objPolygons;
+	vector< OBJCHUNK > chunks;
+	vector< unsigned int > meshIndices;	// loadMesh's 32 bit index buffer before it is split
+	vector< WELDSLOT > weldSlots;
+	vector< float > positionColumns;		// temp_vertices as x, y and z arrays for GenerateNormals
+	vector< unsigned int > cornerScratch;	// zero based corner positions, then generated normal indices
+	vector< unsigned int > sharedCorners;
+	vector< XMFLOAT3 > cornerNormals;
+	size_t weldMask;
+	unsigned int threadCount;
+	unsigned int processing;
+	float creaseAngle;
+	LOADERSTATS stats;
+	MESHBOUNDS bounds;
+	string materialLibraries;	// resolved mtllib paths of the last loadMesh, one per line
+};
+
+// Hands out ModelLoaders to worker threads and takes them back, so the scratch arrays grown by
+// one load are already there for the next, whichever thread runs it. acquire and the handle's
+// destructor are thread safe; a loader itself is only ever used by the thread holding it.
+class ModelLoaderPool
+{
+public:
+	// Owns a loader while it is checked out and returns it, reset, when destroyed.
+	class Handle
+	{
+	public:
+		Handle(ModelLoaderPool * pool, unique_ptr<ModelLoader> loader) : pool(pool), loader(move(loader)) {}
+		Handle(Handle &&other) : pool(other.pool), loader(move(other.loader)) {}
+		~Handle() { if (loader) pool->release(move(loader)); }
 
+		Handle(const Handle &) = delete;
+		Handle& operator=(const Handle &) = delete;
+		Handle& operator=(Handle &&) = delete;
+
+		ModelLoader * operator->() const { return loader.get(); }
+		ModelLoader & operator*() const { return *loader; }
+
+	private:
+		ModelLoaderPool * pool;
+		unique_ptr<ModelLoader> loader;
+	};
+
+	// An idle loader if there is one, otherwise a new one. The pool must outlive the handle.
+	Handle acquire();
+
+	size_t idleCount() const;
+
+private:
+	void release(unique_ptr<ModelLoader> loader);
+
+	mutable mutex lock;
+	vector< unique_ptr<ModelLoader> > idle;
 };
 
+// Appends the materials of an MTL file. map_Kd paths are joined to the file's folder.
+bool LoadMaterialLibrary(const char * path, vector<MATERIAL> &materials);
+
+// Index of the coarsest level whose error is at most maxError, or 0 for the full mesh.
+// maxError is usually the size of a pixel at the mesh's distance from the camera.
+unsigned int SelectMeshLod(const MESHLOD * lods, unsigned int lodCount, float maxError);
+
+// Loads every file 'iterations' times with the original fscanf_s parser and with loadModel
+// and prints the throughput of both in MB/s.
+void BenchmarkModelLoader(const char * const * paths, size_t pathCount, unsigned int iterations);
+
+// Loads every file 'iterations' times with loadModel and loadModelArena, checks they agree and
+// prints MB/s for both next to the number of arena blocks and heap allocations per load.
+void BenchmarkModelLoaderArena(const char * const * paths, size_t pathCount, unsigned int iterations);
+
+// Loads every file 'iterations' times across the worker threads, once with a fresh ModelLoader
+// per load and once with loaders from a ModelLoaderPool, and prints the time of both.
+void BenchmarkModelLoaderPool(const char * const * paths, size_t pathCount, unsigned int iterations);
+
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <stdint.h>
+
+// Small hand written tokenizer used by ModelLoader to walk OBJ text in place.
+// Every function takes the current read pointer and the end of the buffer and
+// never reads past end, so it works directly on a memory mapped file that is
+// not null terminated. Parsing is locale independent.
+namespace ObjTokenizer
+{
+	inline bool isDigit(char c)		{ return c >= '0' && c <= '9'; }
+	inline bool isBlank(char c)		{ return c == ' ' || c == '\t' || c == '\r'; }
+	inline bool isLineEnd(char c)	{ return c == '\n'; }
+
+	// Skips spaces and tabs but stops at the end of the line.
+	inline const char* skipBlanks(const char* p, const char* end)
+	{
+		while (p < end && isBlank(*p))
+			++p;
+		return p;
+	}
+
+	// Moves to the first character of the next line.
+	inline const char* skipLine(const char* p, const char* end)
+	{
+		while (p < end && !isLineEnd(*p))
+			++p;
+		return p < end ? p + 1 : end;
+	}
+
+	// True if the keyword at p is exactly the given token (followed by a blank or the line end).
+	inline bool isKeyword(const char* p, const char* end, const char* keyword)
+	{
+		while (*keyword)
+		{
+			if (p >= end || *p != *keyword)
+				return false;
+			++p;
+			++keyword;
+		}
+		return p >= end || isBlank(*p) || isLineEnd(*p);
+	}
+
+	// Finds the rest of the line after p, without surrounding blanks or a trailing comment,
+	// for names that may contain spaces (g, usemtl, mtllib, newmtl). Returns the start of the
+	// name and sets nameEnd; the name is empty if both are equal.
+	inline const char* parseName(const char* p, const char* end, const char*& nameEnd)
+	{
+		p = skipBlanks(p, end);
+		nameEnd = p;
+		for (const char* q = p; q < end && !isLineEnd(*q) && *q != '#'; ++q)
+		{
+			if (!isBlank(*q))
+				nameEnd = q + 1;
+		}
+		return p;
+	}
+
+	inline double powerOfTen(int exponent)
+	{
+		static const double table[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		double result = 1.0;
+		while (exponent > 22)
+		{
+			result *= 1e22;
+			exponent -= 22;
+		}
+		return result * table[exponent];
+	}
+
+	// Parses a decimal float such as "-0.566811" or "1.5e-3".
+	// Returns the position after the number, or nullptr if there is no number at p.
+	inline const char* parseFloat(const char* p, const char* end, float& out)
+	{
+		p = skipBlanks(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+
+		// Up to 19 significant digits fit in the mantissa, the rest only move the exponent.
+		uint64_t mantissa = 0;
+		int significant = 0;
+		int exponent = 0;
+		bool anyDigits = false;
+
+		while (p < end && isDigit(*p))
+		{
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + uint64_t(*p - '0');
+				if (mantissa)
+					++significant;
+			}
+			else
+			{
+				++exponent;
+			}
+			anyDigits = true;
+			++p;
+		}
+
+		if (p < end && *p == '.')
+		{
+			++p;
+			while (p < end && isDigit(*p))
+			{
+				if (significant < 19)
+				{
+					mantissa = mantissa * 10 + uint64_t(*p - '0');
+					if (mantissa)
+						++significant;
+					--exponent;
+				}
+				anyDigits = true;
+				++p;
+			}
+		}
+
+		if (!anyDigits)
+			return nullptr;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negativeExponent = *e == '-';
+				++e;
+			}
+
+			if (e < end && isDigit(*e))
+			{
+				int value = 0;
+				while (e < end && isDigit(*e))
+				{
+					if (value < 1000)
+						value = value * 10 + (*e - '0');
+					++e;
+				}
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		double result = double(mantissa);
+		if (mantissa != 0)
+		{
+			if (exponent < -400)
+				result = 0.0;
+			else if (exponent < 0)
+				result /= powerOfTen(-exponent);
+			else if (exponent > 0)
+				result *= powerOfTen(exponent > 400 ? 400 : exponent);
+		}
+
+		out = float(negative ? -result : result);
+		return p;
+	}
+
+	// Parses an optionally signed decimal integer.
+	// Returns the position after the number, or nullptr if there is no number at p.
+	inline const char* parseInt(const char* p, const char* end, int& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+
+		if (p >= end || !isDigit(*p))
+			return nullptr;
+
+		int64_t value = 0;
+		while (p < end && isDigit(*p))
+		{
+			if (value < INT32_MAX)
+				value = value * 10 + (*p - '0');
+			++p;
+		}
+
+		if (value > INT32_MAX)
+			value = INT32_MAX;
+
+		out = int(negative ? -value : value);
+		return p;
+	}
+
+	// Which parts of a face corner were present.
+	enum CornerParts
+	{
+		CORNER_POSITION	= 1,
+		CORNER_UV		= 2,
+		CORNER_NORMAL	= 4,
+	};
+
+	// Parses one face corner in any of the forms "v", "v/vt", "v//vn" or "v/vt/vn".
+	// Indices are returned exactly as written (one based, possibly negative).
+	// Returns the position after the corner, or nullptr if there is no corner at p.
+	inline const char* parseCorner(const char* p, const char* end, int& v, int& vt, int& vn, unsigned int& parts)
+	{
+		p = skipBlanks(p, end);
+		p = parseInt(p, end, v);
+		if (!p)
+			return nullptr;
+
+		parts = CORNER_POSITION;
+		vt = 0;
+		vn = 0;
+
+		if (p < end && *p == '/')
+		{
+			++p;
+			if (p < end && *p != '/')
+			{
+				p = parseInt(p, end, vt);
+				if (!p)
+					return nullptr;
+				parts |= CORNER_UV;
+			}
+
+			if (p < end && *p == '/')
+			{
+				++p;
+				p = parseInt(p, end, vn);
+				if (!p)
+					return nullptr;
+				parts |= CORNER_NORMAL;
+			}
+		}
+
+		return p;
+	}
+}
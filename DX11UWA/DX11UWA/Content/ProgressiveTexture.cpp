@@ -0,0 +1,229 @@
+#include "pch.h"
+#include <algorithm>
+#include <mutex>
+#include <ppltasks.h>
+#include "ProgressiveTexture.h"
+#include "MipGenerator.h"
+#include "TextureCooker.h"
+#include "../Common/DDSTextureLoader.h"
+#include "../Common/MappedFile.h"
+
+using namespace Microsoft::WRL;
+
+// Shared between the texture and its background loads, so either can go away first. Every
+// load is numbered; a load only publishes its texture if nothing newer has already done so.
+// The file stays mapped, or its copy with generated mips in memory, until the last texture has
+// been created from it.
+struct ProgressiveTexture::SOURCE
+{
+	DX::MappedFile file;
+	vector<uint8_t> generated;				// the file with a mip chain, when it had none
+	DDS_TEXTURE dds;
+	mutex lock;
+	ComPtr<ID3D11ShaderResourceView> view;	// newest finished texture, until update() takes it
+	unsigned int requested;					// generation of the newest load started
+	unsigned int finished;					// generation of the newest load finished
+
+	const uint8_t * data() const { return generated.empty() ? file.data() : generated.data(); }
+	size_t size() const { return generated.empty() ? file.size() : generated.size(); }
+
+	void close()
+	{
+		file.close();
+		vector<uint8_t>().swap(generated);
+	}
+};
+
+ProgressiveTexture::ProgressiveTexture() : shown(0), topMip(0), streamed(false), complete(false), generating(false)
+{
+}
+
+// The first mip no larger than previewSize, the one CreateDDSTextureFromMemory starts from.
+static unsigned int previewMip(const DDS_TEXTURE &dds, size_t previewSize)
+{
+	unsigned int mip = 0;
+	size_t size = max(max(dds.width, dds.height), dds.depth);
+	while (previewSize > 0 && size > previewSize)
+	{
+		size = max<size_t>(size >> 1, 1);
+		++mip;
+	}
+	return mip;
+}
+
+HRESULT ProgressiveTexture::load(ID3D11Device * device, const wchar_t * path, size_t previewSize, bool streamed, const MIPOPTIONS * mips)
+{
+	reset();
+
+	shared_ptr<SOURCE> state = make_shared<SOURCE>();
+	state->requested = 0;
+	state->finished = 0;
+	if (!state->file.open(path))
+	{
+		HRESULT openError = HRESULT_FROM_WIN32(GetLastError());
+		return FAILED(openError) ? openError : E_FAIL;
+	}
+
+	// An invalid header also takes the synchronous path, which reports why it was rejected.
+	bool valid = ReadDDSHeader(state->data(), state->size(), state->dds) == DDS_OK;
+	const DDS_TEXTURE &dds = state->dds;
+
+	// Without mips a minified texture aliases, but making them reads and filters every texel, so
+	// the file's own mip 0 is drawn with until a background load has made them and created the
+	// texture again. Formats GenerateDDSMips can't read keep that first texture.
+	if (valid && mips && dds.mipCount == 1 && max(dds.width, dds.height) > 1)
+	{
+		HRESULT hr = CreateDDSTextureFromMemory(device, state->data(), state->size(), nullptr, &view);
+		if (FAILED(hr))
+			return hr;
+
+		source = state;
+		this->streamed = streamed;
+		generating = true;
+		// A streamed texture comes back at the preview size, where the streamer takes it from.
+		topMip = streamed ? previewMip(dds, previewSize) : 0;
+		startLoad(device, topMip, mips);
+		return S_OK;
+	}
+
+	bool progressive = previewSize > 0 && valid &&
+		dds.mipCount > 1 &&
+		max(max(dds.width, dds.height), dds.depth) > previewSize;
+
+	if (!progressive)
+	{
+		complete = true;
+		HRESULT hr = CreateDDSTextureFromMemory(device, state->data(), state->size(), nullptr, &view);
+		// Every mip is already in, but a streamer may still want to know about the texture.
+		if (streamed && valid && SUCCEEDED(hr))
+		{
+			source = state;
+			this->streamed = true;
+		}
+		return hr;
+	}
+
+	// The mip tail comes from the last pages of the mapping, so only those are read now.
+	HRESULT hr = CreateDDSTextureFromMemory(device, state->data(), state->size(), nullptr, &view, previewSize);
+	if (FAILED(hr))
+		return hr;
+
+	topMip = previewMip(dds, previewSize);
+	source = state;
+	this->streamed = streamed;
+	complete = true;
+	if (!streamed)
+		startLoad(device, 0);
+	return S_OK;
+}
+
+void ProgressiveTexture::request(ID3D11Device * device, unsigned int topMip)
+{
+	if (!source || !streamed || generating)
+		return;
+
+	topMip = min(topMip, unsigned(max<size_t>(source->dds.mipCount, 1) - 1));
+	if (topMip == this->topMip)
+		return;
+
+	this->topMip = topMip;
+	startLoad(device, topMip);
+}
+
+void ProgressiveTexture::startLoad(ID3D11Device * device, unsigned int topMip, const MIPOPTIONS * mips)
+{
+	// maxsize is the size of topMip along its largest side, so CreateDDSTextureFromMemory
+	// skips exactly the mips above it.
+	const DDS_TEXTURE &dds = source->dds;
+	size_t maxsize = 0;
+	if (topMip > 0)
+		maxsize = max(max(max<size_t>(dds.width >> topMip, 1), max<size_t>(dds.height >> topMip, 1)), max<size_t>(dds.depth >> topMip, 1));
+
+	unsigned int generation;
+	{
+		lock_guard<mutex> hold(source->lock);
+		generation = ++source->requested;
+	}
+	complete = false;
+
+	// The device is free threaded, so the texture is created on the task's thread too.
+	shared_ptr<SOURCE> state = source;
+	ComPtr<ID3D11Device> taskDevice(device);
+	bool closeFile = !streamed;
+	bool generate = mips != nullptr;
+	MIPOPTIONS options = generate ? *mips : MIPOPTIONS();
+	concurrency::create_task([state, taskDevice, maxsize, generation, closeFile, generate, options]()
+	{
+		// Until update() sees this load finish, nothing else reads the file or its headers, so
+		// they can be swapped for the generated ones here. The mapping isn't needed after that.
+		bool ready = true;
+		if (generate)
+		{
+			ready = GenerateDDSMips(state->dds, options, state->generated);
+			if (ready)
+			{
+				state->file.close();
+				ready = ReadDDSHeader(state->data(), state->size(), state->dds) == DDS_OK;
+			}
+		}
+
+		ComPtr<ID3D11ShaderResourceView> created;
+		if (ready)
+			CreateDDSTextureFromMemory(taskDevice.Get(), state->data(), state->size(), nullptr, &created, maxsize);
+		if (closeFile)
+			state->close();
+
+		lock_guard<mutex> hold(state->lock);
+		if (generation > state->finished)
+		{
+			state->view = created;
+			state->finished = generation;
+		}
+	});
+}
+
+bool ProgressiveTexture::update()
+{
+	if (!source || complete)
+		return false;
+
+	ComPtr<ID3D11ShaderResourceView> next;
+	{
+		lock_guard<mutex> hold(source->lock);
+		if (source->finished == shown)
+			return false;
+		next.Swap(source->view);
+		shown = source->finished;
+		complete = shown == source->requested;
+	}
+
+	// Mips made at load are in, or couldn't be made and the file stays as it is.
+	if (complete && generating)
+	{
+		generating = false;
+		topMip = min(topMip, unsigned(max<size_t>(source->dds.mipCount, 1) - 1));
+	}
+	if (complete && !streamed)
+		source.reset();
+	if (!next)
+		return false;
+
+	view = next;
+	return true;
+}
+
+const DDS_TEXTURE * ProgressiveTexture::info() const
+{
+	return streamed && source && !generating ? &source->dds : nullptr;
+}
+
+void ProgressiveTexture::reset()
+{
+	source.reset();
+	view.Reset();
+	shown = 0;
+	topMip = 0;
+	streamed = false;
+	complete = false;
+	generating = false;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <d3d11.h>
+#include <wrl/client.h>
+#include "../Common/DDSReader.h"
+
+using namespace std;
+
+struct MIPOPTIONS;
+
+// A DDS texture that can be drawn with as soon as its mip tail is in. load() creates the
+// texture from the mips no larger than the preview size on the calling thread and starts a
+// task that creates it again with every mip; update() swaps that one in once it's ready.
+//
+// A streamed texture keeps its file mapped and stops at the preview; request() then creates
+// it again with whichever mips a TextureStreamer asks for.
+class ProgressiveTexture
+{
+public:
+	// Largest mip created before load() returns. A 64x64 tail of a 2048 texture is 1/1000th
+	// of the bytes, so the first frame doesn't wait on texture uploads.
+	static const size_t DEFAULT_PREVIEW_SIZE = 64;
+
+	ProgressiveTexture();
+
+	// previewSize 0 creates every mip before returning, like CreateDDSTextureFromFile. So does
+	// a texture whose top mip already fits the preview size. Fails if the preview can't be made.
+	// With mips, a file saved with only mip 0 is created from that mip first, then gets a full
+	// chain in the background, see GenerateDDSMips; the texture is RGBA8 from then on. Streamed,
+	// it comes back at the preview size and is only handed to a streamer once that is done.
+	HRESULT load(ID3D11Device * device, const wchar_t * path, size_t previewSize = DEFAULT_PREVIEW_SIZE, bool streamed = false, const MIPOPTIONS * mips = nullptr);
+
+	// Streamed textures only: creates the texture again in the background with topMip as its
+	// largest mip. A newer request wins over an older one still running.
+	void request(ID3D11Device * device, unsigned int topMip);
+
+	// Call once a frame on the thread that renders. True when a new texture was swapped in.
+	// If a background load failed the old texture stays.
+	bool update();
+
+	// True once no background load is running. For a texture that isn't streamed, that means
+	// it has every mip it is going to get.
+	bool isComplete() const { return complete; }
+
+	// The headers of a streamed texture, for TextureStreamer::addTexture; nullptr otherwise,
+	// including while its mips are still being made.
+	const DDS_TEXTURE * info() const;
+
+	const Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> & srv() const { return view; }
+
+	// Drops the texture. A background load still running finishes and is thrown away.
+	void reset();
+
+private:
+	struct SOURCE;
+
+	void startLoad(ID3D11Device * device, unsigned int topMip, const MIPOPTIONS * mips = nullptr);
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+	shared_ptr<SOURCE> source;
+	unsigned int shown;			// generation of view
+	unsigned int topMip;		// largest mip of the newest request
+	bool streamed;
+	bool complete;
+	bool generating;			// a background load is making the mips load() was asked for
+};
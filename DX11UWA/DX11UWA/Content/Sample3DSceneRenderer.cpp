@@ -1,7 +1,10 @@
 ﻿#include "pch.h"
 #include "Sample3DSceneRenderer.h"
 #include "ModelLoader.h"
+#include "AssetBenchmarks.h"
+#include "MipGenerator.h"
 #include <thread>
+#include <algorithm>
 #include "..\Common\DirectXHelper.h"
 
 using namespace DX11UWA;
@@ -9,15 +12,36 @@ using namespace DX11UWA;
 using namespace DirectX;
 using namespace Windows::Foundation;
 
+// Stream id of a texture the streamer doesn't know about.
+static const unsigned int NO_STREAM = 0xffffffff;
+
+// Draws count subsets of a loaded mesh, starting at first. Each one has 16 bit indices
+// that count from its own base vertex.
+static void DrawMeshSubsets(ID3D11DeviceContext * context, const std::vector<MESHSUBSET> &subsets, size_t first, size_t count)
+{
+	for (size_t i = first; i < first + count; ++i)
+		context->DrawIndexed(subsets[i].indexCount, subsets[i].indexOffset, INT(subsets[i].baseVertex));
+}
+
 // Loads vertex and pixel shaders from files and instantiates the cube geometry.
 Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
 	m_loadingComplete(false),
 	m_degreesPerSecond(45),
 	m_indexCount(0),
+	load_lodCount(0),
+	load_radius(0.0f),
+	load_ready(false),
+	m_lodPixelSize(0.0f),
+	tree_streamId(NO_STREAM),
+	skyBox_streamId(NO_STREAM),
+	floor_streamId(NO_STREAM),
+	floor_ready(false),
 	m_tracking(false),
 	m_deviceResources(deviceResources)
 {
 	memset(m_kbuttons, 0, sizeof(m_kbuttons));
+	memset(load_lods, 0, sizeof(load_lods));
+	memset(&floor_bounds, 0, sizeof(floor_bounds));
 	m_currMousePos = nullptr;
 	m_prevMousePos = nullptr;
 	memset(&m_camera, 0, sizeof(XMFLOAT4X4));
@@ -49,6 +73,9 @@ void Sample3DSceneRenderer::CreateWindowSizeDependentResources(void)
 	// This sample makes use of a right-handed coordinate system using row-major matrices.
 	XMMATRIX perspectiveMatrix = XMMatrixPerspectiveFovLH(fovAngleY, aspectRatio, 0.01f, 100.0f);
 
+	// Height one pixel covers at distance 1, used to turn LOD errors into pixels.
+	m_lodPixelSize = 2.0f * tanf(fovAngleY * 0.5f) / outputSize.Height;
+
 	XMFLOAT4X4 orientation = m_deviceResources->GetOrientationTransform3D();
 
 	XMMATRIX orientationMatrix = XMLoadFloat4x4(&orientation);
@@ -78,116 +105,87 @@ void Sample3DSceneRenderer::Update(DX::StepTimer const& timer)
 		Rotate(radians);
 	}
 
-	//The AlienTree
-	m_loadedBufferData.view = m_constantBufferData.view;
-	m_loadedBufferData.projection = m_constantBufferData.projection;
-	XMStoreFloat4x4(&m_loadedBufferData.model, XMMatrixTranspose(XMMatrixTranslation(-5, -2, 0)));
+	UpdateModelTransforms(m_constantBufferData, m_camera, m_loadedBufferData, waterTower.loadedbufdata, m_skyBoxBufferData, m_instanceconstbufdata);
 
-	//waterTower_loadedBufferData
-	waterTower.loadedbufdata.view = m_constantBufferData.view;
-	waterTower.loadedbufdata.projection = m_constantBufferData.projection;
-	XMStoreFloat4x4(&waterTower.loadedbufdata.model, XMMatrixTranspose(XMMatrixTranslation(-10, -2, 8)));
+	//floor lights
+	AnimateLights(m_lightAnimation, m_camera, m_LightProperties);
 
-	//Sky Box 
-	m_skyBoxBufferData.view = m_constantBufferData.view;
-	m_skyBoxBufferData.projection = m_constantBufferData.projection;
-	XMStoreFloat4x4(&m_skyBoxBufferData.model, XMMatrixTranspose(XMMatrixTranslation(m_camera._41, m_camera._42, m_camera._43)));
+	//m_d3dDeviceContext->UpdateSubresource(m_d3dLightPropertiesConstantBuffer.Get(), 0, nullptr, &m_LightProperties, 0, 0);
+	m_deviceResources->GetD3DDeviceContext()->UpdateSubresource(lightbuffer.Get(), 0, NULL, &m_LightProperties, 0, 0);
 
-	//instancing
-	m_instanceconstbufdata.view = m_constantBufferData.view;
-	m_instanceconstbufdata.projection = m_constantBufferData.projection;
-	XMStoreFloat4x4(&m_instanceconstbufdata.model[0], XMMatrixTranspose(XMMatrixTranslation(2, 0, 0)));
-	XMStoreFloat4x4(&m_instanceconstbufdata.model[1], XMMatrixTranspose(XMMatrixTranslation(4, 0, 0)));
-	XMStoreFloat4x4(&m_instanceconstbufdata.model[2], XMMatrixTranspose(XMMatrixTranslation(6, 0, 0)));
 
-	
-	//floor lights
-	XMStoreFloat4(&m_LightProperties.EyePosition, XMVectorSet(m_camera._41, m_camera._42, m_camera._43, 1.0f));
-
-	for (int i = 0; i < numLights; ++i)
-	{
-		Light light;
-		XMFLOAT4 LightPosition;
-		memset(&light, 0, sizeof(Light));
-		light.LightTypeEnabled.y = LightEnabled[i];
-		light.LightTypeEnabled.x = i;
-		light.Color = XMFLOAT4(LightColors[i]);
-		light.AttenuationData.x = XMConvertToRadians(45.0f);
-		light.AttenuationData.y = 1.0f;
-		light.AttenuationData.z = 0.08f;
-		light.AttenuationData.w = 0.0f;
-		
-		//Directional light location
-		if (i == 0)
-		{
-			if ( dirLightSwitch)
-			{
-				directionalLightPos.x += 1;
-				if (directionalLightPos.x >= 20)
-				{
-					dirLightSwitch = false;
-				}
-			}
-			else
-			{
-				directionalLightPos.x -= 1;
-				if (directionalLightPos.x <= -20)
-				{
-					dirLightSwitch = true;
-				}
-			}
-
-			LightPosition = directionalLightPos;
-		}
+	// Update or move camera here
+	UpdateCamera(timer, 1.0f, 0.75f);
 
-		//point light location
-		if (i == 1)
-		{
-			if (pointLightSwitch)
-			{
-				pointLightPos.x += .25f;
-				if (pointLightPos.x >= 20)
-				{
-					pointLightSwitch = false;
-				}
-			}
-			else
-			{
-				pointLightPos.x -= .25f;
-				if (pointLightPos.x <= -20)
-				{
-					pointLightSwitch = true;
-				}
-			}
-			LightPosition = pointLightPos;
-		}
-		
-		//Spot Light Information
-		if (i == 2) // Spot light Location
-		{
-			LightPosition = spotPos;
-		}
+	// Ask for the mips the camera now needs, then swap in any texture that finished loading
+	// since the last frame.
+	UpdateTextureStreaming();
+	Alientree_texture.update();
+	SkyBox_texture.update();
+	grass_texture.update();
+	// Textures whose mips are made at load can only be streamed once those are in.
+	StreamTexture(Alientree_texture, tree_streamId);
+	StreamTexture(grass_texture, floor_streamId);
+
+}
 
-		light.radius.x = spotRad;
-		light.ConeRatio.x = innerConeRat;
-		light.ConeRatio.y = outterConeRat;
-		light.coneAngle = coneAng;
+// Hands a texture loaded for streaming on to m_textureStreamer, once, as soon as it has headers
+// to give. One that failed to load keeps NO_STREAM and is left alone.
+void Sample3DSceneRenderer::StreamTexture(ProgressiveTexture & texture, unsigned int & id)
+{
+	if (id != NO_STREAM)
+		return;
+	const DDS_TEXTURE * info = texture.info();
+	if (!info)
+		return;
 
-		light.Position = LightPosition;
-		XMVECTOR LightDirection = XMVectorSet(-LightPosition.x, -LightPosition.y, -LightPosition.z, 0.0f);
-		LightDirection = XMVector3Normalize(LightDirection);
-		XMStoreFloat4(&light.Direction, LightDirection);
+	id = m_textureStreamer.addTexture(*info, ProgressiveTexture::DEFAULT_PREVIEW_SIZE);
+	m_streamedTextures.push_back(&texture);
+}
 
-		m_LightProperties.Lights[i] = light;
-	}
+// Tells the streamer where the textured objects are and hands its requests on to the textures.
+// Everything is in world space. The tree and the floor are both drawn with m_loadedBufferData's
+// model matrix, which UpdateModelTransforms sets.
+void Sample3DSceneRenderer::UpdateTextureStreaming(void)
+{
+	// The constant buffer holds the transposed matrix, so undo that for the CPU.
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&m_loadedBufferData.model));
 
-	//m_d3dDeviceContext->UpdateSubresource(m_d3dLightPropertiesConstantBuffer.Get(), 0, nullptr, &m_LightProperties, 0, 0);
-	m_deviceResources->GetD3DDeviceContext()->UpdateSubresource(lightbuffer.Get(), 0, NULL, &m_LightProperties, 0, 0);
+	STREAMUSE uses[3];
+	size_t useCount = 0;
+	// The meshes load in the background; their bounds are only read once they are in.
+	if (tree_streamId != NO_STREAM && load_ready.load(std::memory_order_acquire))
+	{
+		STREAMUSE use = { tree_streamId, XMFLOAT3(), load_radius, 1.0f };
+		XMStoreFloat3(&use.center, XMVector3TransformCoord(XMLoadFloat3(&load_center), world));
+		uses[useCount++] = use;
+	}
+	if (floor_streamId != NO_STREAM && floor_ready.load(std::memory_order_acquire))
+	{
+		STREAMUSE use = { floor_streamId, XMFLOAT3(), floor_bounds.radius, 1.0f };
+		XMStoreFloat3(&use.center, XMVector3TransformCoord(XMLoadFloat3(&floor_bounds.center), world));
+		uses[useCount++] = use;
+	}
 
+	STREAMVIEW view;
+	view.eye = XMFLOAT3(m_camera._41, m_camera._42, m_camera._43);
+	view.pixelsPerUnit = 1.0f / m_lodPixelSize;
+	// The sky box is centered on the camera, so it always wants every mip.
+	if (skyBox_streamId != NO_STREAM)
+	{
+		STREAMUSE use = { skyBox_streamId, view.eye, 1.0f, 1.0f };
+		uses[useCount++] = use;
+	}
 
-	// Update or move camera here
-	UpdateCamera(timer, 1.0f, 0.75f);
+	// The constant buffer holds the transposed projection, so undo that for the CPU.
+	XMFLOAT4X4 viewProjection;
+	XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&m_constantBufferData.projection));
+	XMStoreFloat4x4(&viewProjection, XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera)) * projection);
+	ComputeFrustum(view.frustum, viewProjection);
 
+	const std::vector<STREAMREQUEST> &requests = m_textureStreamer.update(view, uses, useCount);
+	for (size_t i = 0; i < requests.size(); ++i)
+		m_streamedTextures[requests[i].texture]->request(m_deviceResources->GetD3DDevice(), requests[i].topMip);
 }
 
 // Rotate the 3D cube model a set amount of radians.
@@ -277,40 +275,40 @@ void Sample3DSceneRenderer::UpdateCamera(DX::StepTimer const& timer, float const
 	if (m_kbuttons[VK_NUMPAD8])
 	{
 		// increases the Z axis of spotlight position
-		spotPos.z += 1.0f;
+		m_lightAnimation.spotPos.z += 1.0f;
 
 	}
 	if (m_kbuttons[VK_NUMPAD5])
 	{
 		//decreases the Z axis of the spotlight position
-		spotPos.z -= 1.0f;
+		m_lightAnimation.spotPos.z -= 1.0f;
 
 	}
 	if (m_kbuttons[VK_NUMPAD4])
 	{
 		//decreases the x axis of the spotlight position
-		spotPos.x -= 1.0f;
+		m_lightAnimation.spotPos.x -= 1.0f;
 
 	}
 	if (m_kbuttons[VK_NUMPAD6])
 	{
 		//increases the x axis of the spotlight position
-		spotPos.x += 1.0f;
+		m_lightAnimation.spotPos.x += 1.0f;
 
 	}
 	if (m_kbuttons[VK_NUMPAD7])
 	{
 		// decrease angle
-		coneAng.z -= .1f;
+		m_lightAnimation.coneAng.z -= .1f;
 	}
 	if (m_kbuttons[VK_NUMPAD9])
 	{
 		// increase angle
-		coneAng.z += .1f;
+		m_lightAnimation.coneAng.z += .1f;
 	}
 	if (m_kbuttons['L'])
 	{
-		spotPos = { 0.0, 2.0f, 0.0f,1 };
+		m_lightAnimation.spotPos = { 0.0, 2.0f, 0.0f,1 };
 
 	}
 }
@@ -370,6 +368,7 @@ void Sample3DSceneRenderer::Render(void)
 	// Each vertex is one instance of the VertexPositionColor struct.
 	UINT stride = sizeof(VertexPositionColor);
 	UINT loadStride = sizeof(VERTEX);
+	UINT packedStride = sizeof(PACKEDVERTEX);
 	UINT offset = 0;
 
 
@@ -378,7 +377,7 @@ void Sample3DSceneRenderer::Render(void)
 	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_skyBoxBufferData, 0, 0, 0);
 	context->IASetVertexBuffers(0, 1, Skybox_vertexBuffer.GetAddressOf(), &loadStride, &offset);
 	// Each index is one 16-bit unsigned integer (short).
-	context->IASetIndexBuffer(Skybox_indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer(Skybox_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	context->IASetInputLayout(m_skyBoxInputLayout.Get());
 	// Attach our vertex shader.
@@ -387,10 +386,10 @@ void Sample3DSceneRenderer::Render(void)
 	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
 	// Attach our pixel shader.
 	context->PSSetShader(Skybox_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, SkyBox_srv.GetAddressOf());
+	context->PSSetShaderResources(0, 1, SkyBox_texture.srv().GetAddressOf());
 	context->PSSetSamplers(0, 1, sampState.GetAddressOf());
 	// Draw the objects.
-	context->DrawIndexed(skyBox_indexCount, 0, 0);
+	DrawMeshSubsets(context, skyBox_subsets, 0, skyBox_subsets.size());
 	//clear the Z-buffer
 	context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
@@ -431,22 +430,47 @@ void Sample3DSceneRenderer::Render(void)
 
 	//////////////////////////////////////////////////////////////
 	//Loaded obj file
-	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_loadedBufferData, 0, 0, 0);
-	context->IASetVertexBuffers(0, 1, load_vertexBuffer.GetAddressOf(), &loadStride, &offset);
-	// Each index is one 16-bit unsigned integer (short).
-	context->IASetIndexBuffer(load_indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	context->IASetInputLayout(m_loadedInputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(loadedvertexShader.Get(), nullptr, 0);
-	// Send the constant buffer to the graphics device.
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	// Attach our pixel shader.
-	context->PSSetShader(light_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, Alientree_srv.GetAddressOf());
-	context->PSSetSamplers(0, 1, sampState.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(load_indexCount, 0, 0);
+	// The tree's buffers and bounds are only read once its load task has published them.
+	if (load_ready.load(std::memory_order_acquire))
+	{
+		context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_loadedBufferData, 0, 0, 0);
+		context->IASetVertexBuffers(0, 1, load_vertexBuffer.GetAddressOf(), &packedStride, &offset);
+		// Each index is one 16-bit unsigned integer (short).
+		context->IASetIndexBuffer(load_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		context->IASetInputLayout(m_loadedInputLayout.Get());
+		// Attach our vertex shader.
+		context->VSSetShader(loadedvertexShader.Get(), nullptr, 0);
+		// Send the constant buffer to the graphics device.
+		context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
+		context->VSSetConstantBuffers1(1, 1, load_decodeBuffer.GetAddressOf(), nullptr, nullptr);
+		// Attach our pixel shader.
+		context->PSSetShader(light_pixelShader.Get(), nullptr, 0);
+		context->PSSetShaderResources(0, 1, Alientree_texture.srv().GetAddressOf());
+		context->PSSetSamplers(0, 1, sampState.GetAddressOf());
+		// Draw the coarsest level whose error stays under a pixel at the tree's distance.
+		// The constant buffer holds transposed matrices, so undo that for the CPU.
+		XMMATRIX treeWorld = XMMatrixTranspose(XMLoadFloat4x4(&m_loadedBufferData.model));
+		XMVECTOR treeCenter = XMVector3TransformCoord(XMLoadFloat3(&load_center), treeWorld);
+		XMVECTOR eyePosition = XMVectorSet(m_camera._41, m_camera._42, m_camera._43, 1.0f);
+		float treeDistance = XMVectorGetX(XMVector3Length(XMVectorSubtract(treeCenter, eyePosition)));
+		unsigned int treeLodIndex = SelectMeshLod(load_lods, load_lodCount, treeDistance * m_lodPixelSize);
+		if (treeLodIndex == 0 && !load_meshlets.empty())
+		{
+			// Up close, only draw the meshlets that are on screen and facing the camera.
+			XMFLOAT4X4 treeWorldViewProjection;
+			XMMATRIX treeView = XMMatrixTranspose(XMLoadFloat4x4(&m_loadedBufferData.view));
+			XMMATRIX treeProjection = XMMatrixTranspose(XMLoadFloat4x4(&m_loadedBufferData.projection));
+			XMStoreFloat4x4(&treeWorldViewProjection, treeWorld * treeView * treeProjection);
+			XMFLOAT3 treeEye;
+			XMStoreFloat3(&treeEye, XMVector3TransformCoord(eyePosition, XMMatrixInverse(nullptr, treeWorld)));
+			size_t rangeCount = CullMeshlets(load_drawRanges.data(), load_meshlets.data(), load_meshlets.size(), treeWorldViewProjection, treeEye);
+			for (size_t i = 0; i < rangeCount; ++i)
+				context->DrawIndexed(load_drawRanges[i].indexCount, load_drawRanges[i].indexOffset, INT(load_drawRanges[i].baseVertex));
+		}
+		else
+			DrawMeshSubsets(context, load_subsets, load_lods[treeLodIndex].subsetOffset, load_lods[treeLodIndex].subsetCount);
+	}
 
 
 
@@ -480,23 +504,27 @@ void Sample3DSceneRenderer::Render(void)
 	thread.join();
 
 	//Floor
-	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_loadedBufferData, 0, 0, 0);
-	context->IASetVertexBuffers(0, 1, floor_vertexBuffer.GetAddressOf(), &loadStride, &offset);
-	// Each index is one 16-bit unsigned integer (short).
-	context->IASetIndexBuffer(floor_indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	context->IASetInputLayout(m_loadedInputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(loadedvertexShader.Get(), nullptr, 0);
-	// Send the constant buffer to the graphics device.
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	// Attach our pixel shader.
-	context->PSSetShader(light_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, grass_srv.GetAddressOf());
-	//lighting 
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(floor_indexCount, 0, 0);
+	if (floor_ready.load(std::memory_order_acquire))
+	{
+		context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_loadedBufferData, 0, 0, 0);
+		context->IASetVertexBuffers(0, 1, floor_vertexBuffer.GetAddressOf(), &packedStride, &offset);
+		// Each index is one 16-bit unsigned integer (short).
+		context->IASetIndexBuffer(floor_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		context->IASetInputLayout(m_loadedInputLayout.Get());
+		// Attach our vertex shader.
+		context->VSSetShader(loadedvertexShader.Get(), nullptr, 0);
+		// Send the constant buffer to the graphics device.
+		context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
+		context->VSSetConstantBuffers1(1, 1, floor_decodeBuffer.GetAddressOf(), nullptr, nullptr);
+		// Attach our pixel shader.
+		context->PSSetShader(light_pixelShader.Get(), nullptr, 0);
+		context->PSSetShaderResources(0, 1, grass_texture.srv().GetAddressOf());
+		//lighting 
+		context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
+		// Draw the objects.
+		DrawMeshSubsets(context, floor_subsets, 0, floor_subsets.size());
+	}
 
 
 
@@ -525,6 +553,30 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 
 	m_deviceResources->GetD3DDevice()->CreateSamplerState(&sampDesc, sampState.GetAddressOf());
 
+	// The install folder is read-only, so cooked meshes go to the app's local folder.
+	ModelLoader::setCacheDirectory(DX::WideToUtf8(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data()));
+
+#ifdef MODELLOADER_BENCHMARK
+	// Compare the mapped OBJ parser against the old fscanf_s loader on the shipped meshes.
+	static const char * benchmarkModels[] =
+	{
+		"Assets/Alientree.obj", "Assets/WaterTower.obj", "Assets/SkyboxCube.obj", "Assets/FloorPlane.obj"
+	};
+	BenchmarkModelLoader(benchmarkModels, ARRAYSIZE(benchmarkModels), 20);
+	BenchmarkModelLoaderArena(benchmarkModels, ARRAYSIZE(benchmarkModels), 20);
+	BenchmarkModelLoaderPool(benchmarkModels, ARRAYSIZE(benchmarkModels), 50);
+	BenchmarkMeshletCulling(benchmarkModels, 2, 1000);
+
+	// The same numbers as JSON, to compare against other builds.
+	std::wstring benchmarkResults = std::wstring(Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data()) + L"\\asset_benchmarks.json";
+	FILE * benchmarkJson = nullptr;
+	if (_wfopen_s(&benchmarkJson, benchmarkResults.c_str(), L"w") == 0 && benchmarkJson)
+	{
+		RunAssetBenchmarks(benchmarkModels, ARRAYSIZE(benchmarkModels), 20, benchmarkJson);
+		fclose(benchmarkJson);
+	}
+#endif
+
 	auto loadVSTask = DX::ReadDataAsync(L"SampleVertexShader.cso");
 	auto loadPSTask = DX::ReadDataAsync(L"SamplePixelShader.cso");
 
@@ -557,11 +609,12 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 	{
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateVertexShader(&fileData[0], fileData.size(), nullptr, &loadedvertexShader));
 
+		// PACKEDVERTEX, decoded in the shader with the mesh's VERTEXDECODE constants.
 		static const D3D11_INPUT_ELEMENT_DESC vertexDesc[] =
 		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "UV", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "UV", 0, DXGI_FORMAT_R16G16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
 		};
 
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateInputLayout(vertexDesc, ARRAYSIZE(vertexDesc), &fileData[0], fileData.size(), &m_loadedInputLayout));
@@ -734,30 +787,50 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 
 	auto createAlienTreeTask = (createPSTask && createVSTask).then([this]()
 	{
-		vector<VERTEX> testModelVerts;
-		vector<unsigned int> testModelIndices;
-		ModelLoader mloader;
+		MESHDATA mesh;
+		ModelLoaderPool::Handle mloader = m_loaderPool.acquire();
+		// The tree's pixel shader samples and discards, so draw order matters as much as the vertex cache.
+		mloader->setProcessing(MESHPROCESS_VERTEXCACHE | MESHPROCESS_OVERDRAW | MESHPROCESS_QUANTIZE | MESHPROCESS_LOD | MESHPROCESS_MESHLETS);
 
-		mloader.loadModel("Assets/Alientree.obj", testModelVerts, testModelIndices);
+		// Without the mesh there is nothing to draw; its counts stay 0.
+		if (!mloader->loadMesh("Assets/Alientree.obj", mesh))
+			return;
 
 		D3D11_SUBRESOURCE_DATA vertexBufferData;
-		vertexBufferData.pSysMem = testModelVerts.data();
+		vertexBufferData.pSysMem = mesh.packedVertices;
 		vertexBufferData.SysMemPitch = 0;
 		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(VERTEX)*testModelVerts.size()), D3D11_BIND_VERTEX_BUFFER);
+		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(PACKEDVERTEX) * mesh.vertexCount), D3D11_BIND_VERTEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &load_vertexBuffer));
 
-		load_indexCount = unsigned int(testModelIndices.size());
+		D3D11_SUBRESOURCE_DATA decodeBufferData = { 0 };
+		decodeBufferData.pSysMem = &mesh.decode;
+		CD3D11_BUFFER_DESC decodeBufferDesc(sizeof(VERTEXDECODE), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&decodeBufferDesc, &decodeBufferData, &load_decodeBuffer));
+
+		load_indexCount = mesh.indexCount;
+		load_lodCount = mesh.lodCount;
+		memcpy(load_lods, mesh.lods, sizeof(load_lods));
+		load_subsets.assign(mesh.subsets, mesh.subsets + mesh.subsetCount);
+		load_meshlets.assign(mesh.meshlets, mesh.meshlets + mesh.meshletCount);
+		load_drawRanges.resize(mesh.meshletCount);
+		load_center = mesh.bounds.center;
+		load_radius = mesh.bounds.radius;
 
 		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = testModelIndices.data();
+		indexBufferData.pSysMem = mesh.indices;
 		indexBufferData.SysMemPitch = 0;
 		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(unsigned int) * testModelIndices.size()), D3D11_BIND_INDEX_BUFFER);
+		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(uint16_t) * mesh.indexCount), D3D11_BIND_INDEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &load_indexBuffer));
+		load_ready.store(true, std::memory_order_release);
 	});
 
-	CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/AlienTree.dds", nullptr, &Alientree_srv);
+	// The pixel shaders discard the leaves' texels with alpha below 1, so if the file has no mips the
+	// generated ones keep as many texels opaque as mip 0 has, or the tree goes bald with distance.
+	const MIPOPTIONS treeMips = { MIP_FILTER_KAISER, false, false, 1.0f };
+	Alientree_texture.load(m_deviceResources->GetD3DDevice(), L"Assets/AlienTree.dds", ProgressiveTexture::DEFAULT_PREVIEW_SIZE, true, &treeMips);
+	StreamTexture(Alientree_texture, tree_streamId);
 
 	createAlienTreeTask.then([this]()
 	{
@@ -770,30 +843,33 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 
 	auto createSkyBoxTask = (createPSTask && createVSTask).then([this]()
 	{
-		vector<VERTEX> SkyBoxVerts;
-		vector<unsigned int> SkyBoxIndices;
-		ModelLoader mloader;
+		MESHDATA mesh;
+		ModelLoaderPool::Handle mloader = m_loaderPool.acquire();
+		mloader->setProcessing(MESHPROCESS_VERTEXCACHE);
 
-		mloader.loadModel("Assets/SkyboxCube.obj", SkyBoxVerts, SkyBoxIndices);
+		if (!mloader->loadMesh("Assets/SkyboxCube.obj", mesh))
+			return;
 
 		D3D11_SUBRESOURCE_DATA vertexBufferData;
-		vertexBufferData.pSysMem = SkyBoxVerts.data();
+		vertexBufferData.pSysMem = mesh.vertices;
 		vertexBufferData.SysMemPitch = 0;
 		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(VERTEX)*SkyBoxVerts.size()), D3D11_BIND_VERTEX_BUFFER);
+		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(VERTEX) * mesh.vertexCount), D3D11_BIND_VERTEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &Skybox_vertexBuffer));
 
-		skyBox_indexCount = unsigned int(SkyBoxIndices.size());
+		skyBox_indexCount = mesh.indexCount;
+		skyBox_subsets.assign(mesh.subsets, mesh.subsets + mesh.subsetCount);
 
 		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = SkyBoxIndices.data();
+		indexBufferData.pSysMem = mesh.indices;
 		indexBufferData.SysMemPitch = 0;
 		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(unsigned int) * SkyBoxIndices.size()), D3D11_BIND_INDEX_BUFFER);
+		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(uint16_t) * mesh.indexCount), D3D11_BIND_INDEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &Skybox_indexBuffer));
 	});
 
-	CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/OutputCube.dds", nullptr, &SkyBox_srv);
+	SkyBox_texture.load(m_deviceResources->GetD3DDevice(), L"Assets/OutputCube.dds", ProgressiveTexture::DEFAULT_PREVIEW_SIZE, true);
+	StreamTexture(SkyBox_texture, skyBox_streamId);
 
 	createSkyBoxTask.then([this]()
 	{
@@ -806,30 +882,42 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 #pragma region Floor
 	auto createFloorTask = (createPSTask && createVSTask).then([this]()
 	{
-		vector<VERTEX> testModelVerts;
-		vector<unsigned int> testModelIndices;
-		ModelLoader mloader;
+		MESHDATA mesh;
+		ModelLoaderPool::Handle mloader = m_loaderPool.acquire();
+		mloader->setProcessing(MESHPROCESS_VERTEXCACHE | MESHPROCESS_QUANTIZE);
 
-		mloader.loadModel("Assets/FloorPlane.obj", testModelVerts, testModelIndices);
+		if (!mloader->loadMesh("Assets/FloorPlane.obj", mesh))
+			return;
 
 		D3D11_SUBRESOURCE_DATA vertexBufferData;
-		vertexBufferData.pSysMem = testModelVerts.data();
+		vertexBufferData.pSysMem = mesh.packedVertices;
 		vertexBufferData.SysMemPitch = 0;
 		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(VERTEX)*testModelVerts.size()), D3D11_BIND_VERTEX_BUFFER);
+		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(PACKEDVERTEX) * mesh.vertexCount), D3D11_BIND_VERTEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &floor_vertexBuffer));
 
-		floor_indexCount = unsigned int(testModelIndices.size());
+		D3D11_SUBRESOURCE_DATA decodeBufferData = { 0 };
+		decodeBufferData.pSysMem = &mesh.decode;
+		CD3D11_BUFFER_DESC decodeBufferDesc(sizeof(VERTEXDECODE), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&decodeBufferDesc, &decodeBufferData, &floor_decodeBuffer));
+
+		floor_indexCount = mesh.indexCount;
+		floor_subsets.assign(mesh.subsets, mesh.subsets + mesh.subsetCount);
+		floor_bounds = mesh.bounds;
 
 		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = testModelIndices.data();
+		indexBufferData.pSysMem = mesh.indices;
 		indexBufferData.SysMemPitch = 0;
 		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(unsigned int) * testModelIndices.size()), D3D11_BIND_INDEX_BUFFER);
+		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(uint16_t) * mesh.indexCount), D3D11_BIND_INDEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &floor_indexBuffer));
+		floor_ready.store(true, std::memory_order_release);
 	});
 
-	CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/grass_seamless.dds", nullptr, &grass_srv);
+	// The grass file has no mips and tiles across the floor, so its mips wrap around the edges.
+	const MIPOPTIONS grassMips = { MIP_FILTER_KAISER, false, true, 0.0f };
+	grass_texture.load(m_deviceResources->GetD3DDevice(), L"Assets/grass_seamless.dds", ProgressiveTexture::DEFAULT_PREVIEW_SIZE, true, &grassMips);
+	StreamTexture(grass_texture, floor_streamId);
 
 	// Once the cube is loaded, the object is ready to be rendered.
 	createFloorTask.then([this]()
@@ -842,25 +930,31 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 
 	auto createWaterTowerTask = (createPSTask && createVSTask).then([this]()
 	{
-		vector<VERTEX> ModelVerts;
-		vector<unsigned int> ModelIndices;
-		ModelLoader mloader;
-		mloader.loadModel("Assets/WaterTower.obj", ModelVerts, ModelIndices); 
+		MESHDATA mesh;
+		ModelLoaderPool::Handle mloader = m_loaderPool.acquire();
+		mloader->setProcessing(MESHPROCESS_VERTEXCACHE | MESHPROCESS_QUANTIZE);
+		if (!mloader->loadMesh("Assets/WaterTower.obj", mesh))
+			return;
 
 		D3D11_SUBRESOURCE_DATA vertexBufferData;
-		vertexBufferData.pSysMem = ModelVerts.data();
+		vertexBufferData.pSysMem = mesh.packedVertices;
 		vertexBufferData.SysMemPitch = 0;
 		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(VERTEX)*ModelVerts.size()), D3D11_BIND_VERTEX_BUFFER);
+		CD3D11_BUFFER_DESC vertexBufferDesc(unsigned int(sizeof(PACKEDVERTEX) * mesh.vertexCount), D3D11_BIND_VERTEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &waterTower_vertexBuffer));
 
-		waterTower_indexCount = unsigned int(ModelIndices.size());
+		D3D11_SUBRESOURCE_DATA decodeBufferData = { 0 };
+		decodeBufferData.pSysMem = &mesh.decode;
+		CD3D11_BUFFER_DESC decodeBufferDesc(sizeof(VERTEXDECODE), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&decodeBufferDesc, &decodeBufferData, &waterTower_decodeBuffer));
+
+		waterTower_indexCount = mesh.indexCount;
 
 		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = ModelIndices.data();
+		indexBufferData.pSysMem = mesh.indices;
 		indexBufferData.SysMemPitch = 0;
 		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(unsigned int) * ModelIndices.size()), D3D11_BIND_INDEX_BUFFER);
+		CD3D11_BUFFER_DESC indexBufferDesc(unsigned int(sizeof(uint16_t) * mesh.indexCount), D3D11_BIND_INDEX_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &waterTower_indexBuffer));
 
 		CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/watertower_diffuse.dds", nullptr, &waterTower_srv);
@@ -868,7 +962,26 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 	//set up the model struct for deferred context
 		waterTower.indexBuffer = waterTower_indexBuffer;
 		waterTower.vertexBuffer = waterTower_vertexBuffer;
+		waterTower.decodeBuffer = waterTower_decodeBuffer;
 		waterTower.indexCount = waterTower_indexCount;
+		waterTower.subsets.assign(mesh.subsets, mesh.subsets + mesh.subsetCount);
+		// Sort the groups by material so setContextDraw only rebinds a texture when it changes.
+		waterTower.submeshes.assign(mesh.submeshes, mesh.submeshes + mesh.submeshCount);
+		waterTower.bounds = mesh.bounds;
+		std::stable_sort(waterTower.submeshes.begin(), waterTower.submeshes.end(), [](const SUBMESH &a, const SUBMESH &b) { return a.material < b.material; });
+		waterTower.materialSrvs.resize(mesh.materialCount);
+		for (unsigned int i = 0; i < mesh.materialCount; ++i)
+		{
+			// The MTL names the source image, the converted texture sits next to it as a .dds.
+			std::string map = mesh.materials[i].diffuseMap;
+			if (map.empty())
+				continue;
+			size_t dot = map.find_last_of('.');
+			if (dot != std::string::npos && map.find_first_of("/\\", dot) == std::string::npos)
+				map.erase(dot);
+			map += ".dds";
+			CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), DX::Utf8ToWide(map.c_str()).c_str(), nullptr, &waterTower.materialSrvs[i]);
+		}
 		waterTower.srv = waterTower_srv;
 		waterTower.inputLayout = m_loadedInputLayout;
 		waterTower.ps_shader = light_pixelShader;
@@ -890,6 +1003,8 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 void Sample3DSceneRenderer::ReleaseDeviceDependentResources(void)
 {
 	m_loadingComplete = false;
+	load_ready = false;
+	floor_ready = false;
 	m_vertexShader.Reset();
 	m_inputLayout.Reset();
 	m_pixelShader.Reset();
@@ -905,12 +1020,23 @@ void Sample3DSceneRenderer::ReleaseDeviceDependentResources(void)
 	Skybox_indexBuffer.Reset();
 	floor_indexBuffer.Reset();
 	floor_vertexBuffer.Reset();
+	load_decodeBuffer.Reset();
+	floor_decodeBuffer.Reset();
+	waterTower_decodeBuffer.Reset();
+	Alientree_texture.reset();
+	SkyBox_texture.reset();
+	grass_texture.reset();
+	m_textureStreamer = TextureStreamer();
+	m_streamedTextures.clear();
+	tree_streamId = NO_STREAM;
+	skyBox_streamId = NO_STREAM;
+	floor_streamId = NO_STREAM;
 
 }
 
 void Sample3DSceneRenderer::setContextDraw(MODEL * model, ModelViewProjectionConstantBuffer * data)
 {
-	UINT loadStride = sizeof(VERTEX);
+	UINT loadStride = sizeof(PACKEDVERTEX);
 	UINT offset = 0;
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv = m_deviceResources->GetBackBufferRenderTargetView();
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv = m_deviceResources->GetDepthStencilView();
@@ -919,18 +1045,48 @@ void Sample3DSceneRenderer::setContextDraw(MODEL * model, ModelViewProjectionCon
 	defCon->OMSetRenderTargets(1, rtv.GetAddressOf(), dsv.Get());
 
 	defCon->VSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
+	defCon->VSSetConstantBuffers(1, 1, model->decodeBuffer.GetAddressOf());
 	defCon->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
 
 	defCon->UpdateSubresource(m_constantBuffer.Get(), 0, NULL, data, 0, 0);
 	defCon->IASetVertexBuffers(0, 1, model->vertexBuffer.GetAddressOf(), &loadStride, &offset);
-	defCon->IASetIndexBuffer(model->indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	defCon->IASetIndexBuffer(model->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
 	defCon->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	defCon->IASetInputLayout(model->inputLayout.Get());
 	defCon->VSSetShader(model->vs_shader.Get(), nullptr, 0);
 	defCon->PSSetShader(model->ps_shader.Get(), nullptr, 0);
-	defCon->PSSetShaderResources(0, 1, model->srv.GetAddressOf());
 	defCon->PSSetSamplers(0, 1, sampState.GetAddressOf());
-	defCon->DrawIndexed(waterTower_indexCount, 0, 0);
+
+	// Skip the groups that are off screen. The constant buffer holds transposed matrices,
+	// so undo that for the CPU.
+	FRUSTUM frustum;
+	XMFLOAT4X4 worldViewProjection;
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&data->model));
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&data->view));
+	XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&data->projection));
+	XMStoreFloat4x4(&worldViewProjection, world * view * projection);
+	ComputeFrustum(frustum, worldViewProjection);
+
+	ID3D11ShaderResourceView * bound = nullptr;
+	bool anyBound = false;
+	// The whole model first, so an off screen model costs one test instead of one per group.
+	size_t groups = BoxOutsideFrustum(frustum, model->bounds.boundsMin, model->bounds.boundsMax) ? 0 : model->submeshes.size();
+	for (size_t i = 0; i < groups; ++i)
+	{
+		const SUBMESH &submesh = model->submeshes[i];
+		if (BoxOutsideFrustum(frustum, submesh.boundsMin, submesh.boundsMax))
+			continue;
+		ID3D11ShaderResourceView * srv = model->srv.Get();
+		if (submesh.material < model->materialSrvs.size() && model->materialSrvs[submesh.material])
+			srv = model->materialSrvs[submesh.material].Get();
+		if (!anyBound || srv != bound)
+		{
+			defCon->PSSetShaderResources(0, 1, &srv);
+			bound = srv;
+			anyBound = true;
+		}
+		DrawMeshSubsets(defCon.Get(), model->subsets, submesh.lods[0].subsetOffset, submesh.lods[0].subsetCount);
+	}
 	defCon->FinishCommandList(true,&model->commandList);
 
 	model->threadComplete = true;
@@ -4,6 +4,12 @@
 #include "ShaderStructures.h"
 #include "..\Common\StepTimer.h"
 #include "Common\DDSTextureLoader.h"
+#include "ModelLoader.h"
+#include "MeshletCulling.h"
+#include "SceneAnimation.h"
+#include "ProgressiveTexture.h"
+#include "TextureStreaming.h"
+#include <atomic>
 #include <DirectXColors.h>
 #include <DirectXMath.h>
 
@@ -21,8 +27,14 @@ namespace DX11UWA
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		constantBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		vertexBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		indexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer>		decodeBuffer;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
 		uint32 indexCount;
+		std::vector<MESHSUBSET> subsets;
+		// Groups of the OBJ sorted by material, and one texture per material (null falls back to srv).
+		std::vector<SUBMESH> submeshes;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> materialSrvs;
+		MESHBOUNDS bounds;
 		ModelViewProjectionConstantBuffer loadedbufdata;
 
 		Microsoft::WRL::ComPtr<ID3D11VertexShader> vs_shader;
@@ -57,6 +69,8 @@ namespace DX11UWA
 	private:
 		void Rotate(float radians);
 		void UpdateCamera(DX::StepTimer const& timer, float const moveSpd, float const rotSpd);
+		void StreamTexture(ProgressiveTexture & texture, unsigned int & id);
+		void UpdateTextureStreaming(void);
 
 	private:
 
@@ -83,71 +97,20 @@ namespace DX11UWA
 		//Floor resources
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		floor_vertexBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		floor_indexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> grass_srv;
+		Microsoft::WRL::ComPtr<ID3D11Buffer>		floor_decodeBuffer;
+		ProgressiveTexture grass_texture;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader> light_pixelShader;
 
 		uint32	floor_indexCount;
+		std::vector<MESHSUBSET> floor_subsets;
+		MESHBOUNDS floor_bounds;
+		// Set, with release, by the floor's load task once the floor_ fields are filled in.
+		std::atomic<bool> floor_ready;
 		ModelViewProjectionConstantBuffer floor_BufData;
 
 		//lighting
-		struct Light
-		{
-			XMFLOAT4    Position;    //16
-			XMFLOAT4    Direction;   //16
-			XMFLOAT4    radius;    
-			XMFLOAT4    Color; //16
-
-			XMFLOAT4    AttenuationData; 
-		// x =  SpotAngle;
-		// y =  ConstantAttenuation;
-		// z =  LinearAttenuation;
-		// w =  QuadraticAttenuation; 
-
-			XMFLOAT4 LightTypeEnabled;
-			// x  = type
-			// y = Enabled;
-			
-			XMFLOAT4   ConeRatio; // x = inner ratio,  y = outerratio
-		
-			XMFLOAT4    coneAngle;
-			
-		};
-
-		struct LightProperties 
-		{
-			XMFLOAT4 EyePosition;
-			XMFLOAT4 GlobalAmbient;
-			Light  Lights[3];
-		};
 		LightProperties m_LightProperties;
-
-		XMVECTORF32 LightColors[3] = 
-		{
-			// Directional light;      Point Light;    Spot Light;
-			 Colors::DarkOliveGreen, Colors::Yellow, Colors::DarkOrange
-		};
-
-		 bool LightEnabled[3] = 
-		{
-			true, true, true
-		};
-
-		 //Dynamic Variables
-		 bool dirLightSwitch = false; // false = negative direction true = positive direction
-		 bool pointLightSwitch = false; // false = negative direction true = positive direction
-		 float spotRad = 10.0f;
-		 float innerConeRat = .8f;
-		 float outterConeRat = .45f;
-		 XMFLOAT4 coneAng = { 0,-1.0f, -1.0f, 0 };
-
-		 XMFLOAT4 pointLightPos = { 2.0f,1.0f, 5.0f,1 };
-		 XMFLOAT4 directionalLightPos = { 2.0f,1.0f, 5.0f,1 };
-		 XMFLOAT4 spotPos = { 0.0, 2.0f, 0.0f,1 };
-
-		 int numLights = 3;
-		 float radius = 8.0f;
-		 float offset = 2.0f * XM_PI / numLights;
-
+		LIGHTANIMATION m_lightAnimation;
 
 		 Microsoft::WRL::ComPtr<ID3D11Buffer> lightbuffer;
 
@@ -163,15 +126,35 @@ namespace DX11UWA
 		//Model Loading
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		load_vertexBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		load_indexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer>		load_decodeBuffer;
 		uint32 load_indexCount;
+		MESHLOD load_lods[MESH_MAX_LODS];
+		unsigned int load_lodCount;
+		std::vector<MESHSUBSET> load_subsets;
+		XMFLOAT3 load_center;
+		float load_radius;
+		// Set, with release, by the tree's load task once the load_ fields are filled in.
+		std::atomic<bool> load_ready;
+		float m_lodPixelSize;
+		std::vector<MESHLET> load_meshlets;
+		std::vector<DRAWRANGE> load_drawRanges;
 		Microsoft::WRL::ComPtr<ID3D11InputLayout>	m_loadedInputLayout;
 		Microsoft::WRL::ComPtr<ID3D11VertexShader>	loadedvertexShader;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader>	m_loadedpixelShader;
 		ModelViewProjectionConstantBuffer			m_loadedBufferData;
 
 		//Texture Variables
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Alientree_srv;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SkyBox_srv;
+		// Drawn from their mip tails, then streamed in as far as the camera needs their mips.
+		ProgressiveTexture Alientree_texture;
+		ProgressiveTexture SkyBox_texture;
+
+		// Decides which mips of the textures above and grass_texture stay resident. Stream ids
+		// index m_streamedTextures.
+		TextureStreamer m_textureStreamer;
+		std::vector<ProgressiveTexture *> m_streamedTextures;
+		unsigned int tree_streamId;
+		unsigned int skyBox_streamId;
+		unsigned int floor_streamId;
 
 		//SkyBox Variables
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		Skybox_vertexBuffer;
@@ -179,17 +162,22 @@ namespace DX11UWA
 		Microsoft::WRL::ComPtr<ID3D11VertexShader>	Skybox_vertexShader;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader>	Skybox_pixelShader;
 		uint32	skyBox_indexCount;
+		std::vector<MESHSUBSET> skyBox_subsets;
 		ModelViewProjectionConstantBuffer			m_skyBoxBufferData;
 		Microsoft::WRL::ComPtr<ID3D11InputLayout>	m_skyBoxInputLayout;
 
 		// Water tower variables 
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		waterTower_vertexBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer>		waterTower_indexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer>		waterTower_decodeBuffer;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> waterTower_srv;
 		uint32 waterTower_indexCount;
 		ModelViewProjectionConstantBuffer			waterTower_loadedBufferData;
 		MODEL waterTower;
 
+		// Loaders shared by the create*Task continuations, so their scratch arrays are reused.
+		ModelLoaderPool m_loaderPool;
+
 		// Variables used with the rendering loop.
 		bool	m_loadingComplete;
 		float	m_degreesPerSecond;
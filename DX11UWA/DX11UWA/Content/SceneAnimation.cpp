@@ -0,0 +1,115 @@
+#include "pch.h"
+#include <string.h>
+#include "SceneAnimation.h"
+
+using namespace DirectX;
+using namespace DX11UWA;
+
+void AnimateLights(LIGHTANIMATION &animation, const XMFLOAT4X4 &camera, LightProperties &properties)
+{
+	XMStoreFloat4(&properties.EyePosition, XMVectorSet(camera._41, camera._42, camera._43, 1.0f));
+
+	for (int i = 0; i < 3; ++i)
+	{
+		Light light;
+		XMFLOAT4 LightPosition;
+		memset(&light, 0, sizeof(Light));
+		light.LightTypeEnabled.y = animation.enabled[i];
+		light.LightTypeEnabled.x = float(i);
+		light.Color = XMFLOAT4(animation.colors[i]);
+		light.AttenuationData.x = XMConvertToRadians(45.0f);
+		light.AttenuationData.y = 1.0f;
+		light.AttenuationData.z = 0.08f;
+		light.AttenuationData.w = 0.0f;
+
+		//Directional light location
+		if (i == 0)
+		{
+			if (animation.dirLightSwitch)
+			{
+				animation.directionalLightPos.x += 1;
+				if (animation.directionalLightPos.x >= 20)
+				{
+					animation.dirLightSwitch = false;
+				}
+			}
+			else
+			{
+				animation.directionalLightPos.x -= 1;
+				if (animation.directionalLightPos.x <= -20)
+				{
+					animation.dirLightSwitch = true;
+				}
+			}
+
+			LightPosition = animation.directionalLightPos;
+		}
+
+		//point light location
+		if (i == 1)
+		{
+			if (animation.pointLightSwitch)
+			{
+				animation.pointLightPos.x += .25f;
+				if (animation.pointLightPos.x >= 20)
+				{
+					animation.pointLightSwitch = false;
+				}
+			}
+			else
+			{
+				animation.pointLightPos.x -= .25f;
+				if (animation.pointLightPos.x <= -20)
+				{
+					animation.pointLightSwitch = true;
+				}
+			}
+			LightPosition = animation.pointLightPos;
+		}
+
+		//Spot Light Information
+		if (i == 2) // Spot light Location
+		{
+			LightPosition = animation.spotPos;
+		}
+
+		light.radius.x = animation.spotRad;
+		light.ConeRatio.x = animation.innerConeRat;
+		light.ConeRatio.y = animation.outterConeRat;
+		light.coneAngle = animation.coneAng;
+
+		light.Position = LightPosition;
+		XMVECTOR LightDirection = XMVectorSet(-LightPosition.x, -LightPosition.y, -LightPosition.z, 0.0f);
+		LightDirection = XMVector3Normalize(LightDirection);
+		XMStoreFloat4(&light.Direction, LightDirection);
+
+		properties.Lights[i] = light;
+	}
+}
+
+void UpdateModelTransforms(const ModelViewProjectionConstantBuffer &scene, const XMFLOAT4X4 &camera,
+	ModelViewProjectionConstantBuffer &tree, ModelViewProjectionConstantBuffer &waterTower,
+	ModelViewProjectionConstantBuffer &skyBox, ModelViewProjectionConstantBufferInstanced &instances)
+{
+	//The AlienTree
+	tree.view = scene.view;
+	tree.projection = scene.projection;
+	XMStoreFloat4x4(&tree.model, XMMatrixTranspose(XMMatrixTranslation(-5, -2, 0)));
+
+	//waterTower_loadedBufferData
+	waterTower.view = scene.view;
+	waterTower.projection = scene.projection;
+	XMStoreFloat4x4(&waterTower.model, XMMatrixTranspose(XMMatrixTranslation(-10, -2, 8)));
+
+	//Sky Box
+	skyBox.view = scene.view;
+	skyBox.projection = scene.projection;
+	XMStoreFloat4x4(&skyBox.model, XMMatrixTranspose(XMMatrixTranslation(camera._41, camera._42, camera._43)));
+
+	//instancing
+	instances.view = scene.view;
+	instances.projection = scene.projection;
+	XMStoreFloat4x4(&instances.model[0], XMMatrixTranspose(XMMatrixTranslation(2, 0, 0)));
+	XMStoreFloat4x4(&instances.model[1], XMMatrixTranspose(XMMatrixTranslation(4, 0, 0)));
+	XMStoreFloat4x4(&instances.model[2], XMMatrixTranspose(XMMatrixTranslation(6, 0, 0)));
+}
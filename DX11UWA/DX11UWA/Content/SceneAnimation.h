@@ -0,0 +1,41 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXColors.h>
+#include "ShaderStructures.h"
+
+// The per frame CPU work of Sample3DSceneRenderer::Update, kept apart from Direct3D so it can
+// be timed off-line by the asset benchmarks.
+
+// Light settings Update animates, plus the ones the number pad moves around.
+struct LIGHTANIMATION
+{
+	DirectX::XMVECTORF32 colors[3] =
+	{
+		// Directional light;      Point Light;    Spot Light;
+		DirectX::Colors::DarkOliveGreen, DirectX::Colors::Yellow, DirectX::Colors::DarkOrange
+	};
+	bool enabled[3] = { true, true, true };
+
+	//Dynamic Variables
+	bool dirLightSwitch = false; // false = negative direction true = positive direction
+	bool pointLightSwitch = false; // false = negative direction true = positive direction
+	float spotRad = 10.0f;
+	float innerConeRat = .8f;
+	float outterConeRat = .45f;
+	DirectX::XMFLOAT4 coneAng = { 0, -1.0f, -1.0f, 0 };
+
+	DirectX::XMFLOAT4 pointLightPos = { 2.0f, 1.0f, 5.0f, 1 };
+	DirectX::XMFLOAT4 directionalLightPos = { 2.0f, 1.0f, 5.0f, 1 };
+	DirectX::XMFLOAT4 spotPos = { 0.0, 2.0f, 0.0f, 1 };
+};
+
+// Steps the directional and point lights one frame along their paths and fills in the light
+// constant buffer as seen from camera (the camera's world matrix, not the view matrix).
+void AnimateLights(LIGHTANIMATION &animation, const DirectX::XMFLOAT4X4 &camera, DX11UWA::LightProperties &properties);
+
+// Copies the scene's view and projection into the constant buffers of the loaded meshes and
+// sets their fixed model transforms; the sky box follows the camera.
+void UpdateModelTransforms(const DX11UWA::ModelViewProjectionConstantBuffer &scene, const DirectX::XMFLOAT4X4 &camera,
+	DX11UWA::ModelViewProjectionConstantBuffer &tree, DX11UWA::ModelViewProjectionConstantBuffer &waterTower,
+	DX11UWA::ModelViewProjectionConstantBuffer &skyBox, DX11UWA::ModelViewProjectionConstantBufferInstanced &instances);
@@ -30,4 +30,35 @@ namespace DX11UWA
 		DirectX::XMFLOAT3 uv;
 		DirectX::XMFLOAT3 normal;
 	};
+
+	//lighting
+	struct Light
+	{
+		DirectX::XMFLOAT4    Position;    //16
+		DirectX::XMFLOAT4    Direction;   //16
+		DirectX::XMFLOAT4    radius;
+		DirectX::XMFLOAT4    Color; //16
+
+		DirectX::XMFLOAT4    AttenuationData;
+	// x =  SpotAngle;
+	// y =  ConstantAttenuation;
+	// z =  LinearAttenuation;
+	// w =  QuadraticAttenuation;
+
+		DirectX::XMFLOAT4 LightTypeEnabled;
+		// x  = type
+		// y = Enabled;
+
+		DirectX::XMFLOAT4   ConeRatio; // x = inner ratio,  y = outerratio
+
+		DirectX::XMFLOAT4    coneAngle;
+
+	};
+
+	struct LightProperties
+	{
+		DirectX::XMFLOAT4 EyePosition;
+		DirectX::XMFLOAT4 GlobalAmbient;
+		Light  Lights[3];
+	};
 }
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include "pch.h"
+#include "TextureCooker.h"
+#include "MipGenerator.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "../Common/MappedFile.h"
+
+#ifndef _WIN32
+#define fopen_s(file, path, mode) (*(file) = fopen(path, mode))
+#endif
+
+// DDS_HEADER_DXT10::miscFlag of a cube map, D3D11_RESOURCE_MISC_TEXTURECUBE.
+static const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+static bool isSRGB(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// The UNORM or UNORM_SRGB variant of an output format. R16G16B16A16_FLOAT has no sRGB variant;
+// its values are already linear.
+static DXGI_FORMAT withSRGB(DXGI_FORMAT format, bool srgb)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		return srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	default:
+		return format;
+	}
+}
+
+bool ReadRGBASurfaces(const DDS_TEXTURE &dds, vector<RGBASURFACE> &surfaces, DXGI_FORMAT format, unsigned int threadCount)
+{
+	bool toHalf = format == DXGI_FORMAT_R16G16B16A16_FLOAT;
+	if (!toHalf && format != DXGI_FORMAT_R8G8B8A8_UNORM)
+	{
+		printf("Can only unpack textures to RGBA8 or RGBA16F, not DXGI format %d\n", int(format));
+		return false;
+	}
+
+	// Offsets of red, green, blue and alpha in a texel; alpha 4 means the texel has none.
+	bool compressed = IsBCFormat(dds.format);
+	unsigned int order[4] = { 0, 1, 2, 3 };
+	switch (dds.format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		break;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		order[0] = 2; order[1] = 1; order[2] = 0; order[3] = 3;
+		break;
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		order[0] = 2; order[1] = 1; order[2] = 0; order[3] = 4;
+		break;
+	default:
+		if (compressed)
+			break;
+		printf("Can only read 8 bit RGBA, BGRA and BGRX textures and BC textures, not DXGI format %d\n", int(dds.format));
+		return false;
+	}
+	if (dds.dimension == DDS_DIMENSION_TEXTURE3D)
+	{
+		printf("Volume textures can't be unpacked\n");
+		return false;
+	}
+
+	vector<DDS_SUBRESOURCE> subresources(dds.mipCount * dds.arraySize);
+	size_t skipMip = 0;
+	if (GetDDSSubresources(dds, 0, subresources.data(), skipMip) != DDS_OK)
+		return false;
+
+	size_t texelBytes = toHalf ? 8 : 4;
+	bool srgb = isSRGB(dds.format);
+	vector<uint8_t> row;
+	surfaces.resize(subresources.size());
+	for (size_t i = 0; i < subresources.size(); ++i)
+	{
+		const DDS_SUBRESOURCE &source = subresources[i];
+		RGBASURFACE &surface = surfaces[i];
+		surface.width = source.width;
+		surface.height = source.height;
+		surface.format = format;
+		surface.texels.resize(source.width * source.height * texelBytes);
+		size_t pitch = source.width * texelBytes;
+
+		if (compressed)
+		{
+			DecodeBCSurface(dds.format, format, surface.texels.data(), pitch, source.data, source.rowPitch, source.width, source.height, threadCount);
+			continue;
+		}
+
+		row.resize(source.width * 4);
+		for (size_t y = 0; y < source.height; ++y)
+		{
+			const uint8_t * in = source.data + y * source.rowPitch;
+			uint8_t * out = toHalf ? row.data() : surface.texels.data() + y * pitch;
+			for (size_t x = 0; x < source.width; ++x, in += 4)
+			{
+				out[x * 4] = in[order[0]];
+				out[x * 4 + 1] = in[order[1]];
+				out[x * 4 + 2] = in[order[2]];
+				out[x * 4 + 3] = order[3] < 4 ? in[order[3]] : 255;
+			}
+			if (toHalf)
+				ConvertRGBA8ToRGBA16F(reinterpret_cast<uint16_t *>(surface.texels.data() + y * pitch), row.data(), source.width, srgb);
+		}
+	}
+	return true;
+}
+
+// Replaces the lone mip of every array slice in surfaces, as ReadRGBASurfaces lists them for a
+// texture with one mip, with a full chain.
+static bool addMipChains(vector<RGBASURFACE> &surfaces, const DDS_TEXTURE &dds, const MIPOPTIONS &options, unsigned int threadCount)
+{
+	MIPOPTIONS sliceOptions = options;
+	sliceOptions.srgb = isSRGB(dds.format);
+	size_t mipCount = MipCount(dds.width, dds.height);
+
+	vector<RGBASURFACE> chains;
+	chains.reserve(surfaces.size() * mipCount);
+	for (RGBASURFACE &surface : surfaces)
+	{
+		vector<RGBASURFACE> chain(1);
+		chain[0] = move(surface);
+		if (!GenerateMips(chain, mipCount, sliceOptions, threadCount))
+			return false;
+		for (RGBASURFACE &mip : chain)
+			chains.push_back(move(mip));
+	}
+	surfaces.swap(chains);
+	return true;
+}
+
+// Lays out in file a DDS with the dimensions, array slices and cube faces of dds, mipCount mips
+// and surfaces as its subresources. surfaces are in format already or, for BC formats, RGBA8 to
+// be encoded, in which case error, if given, collects the difference.
+static void buildDDS(vector<uint8_t> &file, const DDS_TEXTURE &dds, size_t mipCount, DXGI_FORMAT format,
+	const vector<RGBASURFACE> &surfaces, SURFACEERROR * error, unsigned int threadCount)
+{
+	bool compress = IsBCFormat(format);
+
+	size_t headerBytes = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+	vector<size_t> offsets(surfaces.size() + 1, headerBytes);
+	for (size_t i = 0; i < surfaces.size(); ++i)
+	{
+		size_t bytes = 0;
+		DDSSurfaceInfo(surfaces[i].width, surfaces[i].height, format, &bytes, nullptr, nullptr);
+		offsets[i + 1] = offsets[i] + bytes;
+	}
+
+	file.assign(offsets.back(), 0);
+	vector<uint8_t> decoded;
+	for (size_t i = 0; i < surfaces.size(); ++i)
+	{
+		const RGBASURFACE &surface = surfaces[i];
+		if (!compress)
+		{
+			memcpy(file.data() + offsets[i], surface.texels.data(), surface.texels.size());
+			continue;
+		}
+
+		size_t blockPitch = 0;
+		DDSSurfaceInfo(surface.width, surface.height, format, nullptr, &blockPitch, nullptr);
+		EncodeBCSurface(format, file.data() + offsets[i], blockPitch, surface.texels.data(), surface.width, surface.height, surface.width * 4, threadCount);
+
+		if (error)
+		{
+			decoded.resize(surface.texels.size());
+			DecodeBCSurface(format, DXGI_FORMAT_R8G8B8A8_UNORM, decoded.data(), surface.width * 4, file.data() + offsets[i], blockPitch, surface.width, surface.height, threadCount);
+			AddSurfaceError(*error, surface.texels.data(), surface.width * 4, decoded.data(), surface.width * 4, surface.width, surface.height);
+		}
+	}
+
+	size_t topPitch = 0;
+	DDSSurfaceInfo(dds.width, dds.height, format, nullptr, &topPitch, nullptr);
+
+	DDS_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(DDS_HEADER);
+	header.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP | (compress ? DDS_HEADER_FLAGS_LINEARSIZE : DDS_HEADER_FLAGS_PITCH);
+	header.height = uint32_t(dds.height);
+	header.width = uint32_t(dds.width);
+	header.pitchOrLinearSize = uint32_t(compress ? offsets[1] - offsets[0] : topPitch);
+	header.mipMapCount = uint32_t(mipCount);
+	header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+	header.ddspf.flags = DDS_FOURCC;
+	header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+	header.caps = DDS_SURFACE_FLAGS_TEXTURE | (mipCount > 1 ? DDS_SURFACE_FLAGS_MIPMAP : 0);
+	if (dds.isCubeMap)
+	{
+		header.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+		header.caps2 = DDS_CUBEMAP_ALLFACES;
+	}
+
+	DDS_HEADER_DXT10 extension;
+	memset(&extension, 0, sizeof(extension));
+	extension.dxgiFormat = format;
+	extension.resourceDimension = uint32_t(dds.dimension);
+	extension.miscFlag = dds.isCubeMap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+	extension.arraySize = uint32_t(dds.isCubeMap ? dds.arraySize / 6 : dds.arraySize);
+
+	uint32_t magic = DDS_MAGIC;
+	memcpy(file.data(), &magic, sizeof(magic));
+	memcpy(file.data() + sizeof(magic), &header, sizeof(header));
+	memcpy(file.data() + sizeof(magic) + sizeof(header), &extension, sizeof(extension));
+}
+
+bool CookTexture(const char * inputPath, const char * outputPath, DXGI_FORMAT format, COOKSTATS * stats, unsigned int threadCount, const MIPOPTIONS * mips)
+{
+	auto start = chrono::steady_clock::now();
+	bool compress = IsBCEncodeFormat(format);
+	bool toHalf = format == DXGI_FORMAT_R16G16B16A16_FLOAT;
+	if (!compress && !toHalf && format != DXGI_FORMAT_R8G8B8A8_UNORM)
+	{
+		printf("Can't cook to DXGI format %d\n", int(format));
+		return false;
+	}
+
+	DX::MappedFile file;
+	DDS_TEXTURE dds;
+	if (!file.open(inputPath) || ReadDDSHeader(file.data(), file.size(), dds) != DDS_OK)
+	{
+		printf("Could not read %s\n", inputPath);
+		return false;
+	}
+
+	// The encoders and the mip generator take RGBA8.
+	bool generate = mips && dds.mipCount == 1 && (dds.width > 1 || dds.height > 1);
+	vector<RGBASURFACE> surfaces;
+	if (!ReadRGBASurfaces(dds, surfaces, compress || generate ? DXGI_FORMAT_R8G8B8A8_UNORM : format, threadCount))
+		return false;
+
+	size_t mipCount = dds.mipCount;
+	if (generate)
+	{
+		if (!addMipChains(surfaces, dds, *mips, threadCount))
+			return false;
+		mipCount = MipCount(dds.width, dds.height);
+		if (toHalf)
+		{
+			for (RGBASURFACE &surface : surfaces)
+			{
+				vector<uint8_t> halves(surface.texels.size() * 2);
+				ConvertRGBA8ToRGBA16F(reinterpret_cast<uint16_t *>(halves.data()), surface.texels.data(), surface.width * surface.height, isSRGB(dds.format));
+				surface.texels.swap(halves);
+				surface.format = format;
+			}
+		}
+	}
+	format = withSRGB(format, isSRGB(dds.format));
+
+	// The whole file is built in memory, so it is written in one go.
+	vector<uint8_t> cooked;
+	SURFACEERROR error;
+	memset(&error, 0, sizeof(error));
+	buildDDS(cooked, dds, mipCount, format, surfaces, stats ? &error : nullptr, threadCount);
+
+	FILE * out = nullptr;
+	fopen_s(&out, outputPath, "wb");
+	if (!out)
+	{
+		printf("Could not write %s\n", outputPath);
+		return false;
+	}
+	bool written = fwrite(cooked.data(), 1, cooked.size(), out) == cooked.size();
+	written = fclose(out) == 0 && written;
+	if (!written)
+	{
+		printf("Could not write %s\n", outputPath);
+		return false;
+	}
+
+	if (stats)
+	{
+		stats->rgbPSNR = SurfacePSNR(error, 0, 3);
+		stats->alphaPSNR = SurfacePSNR(error, 3, 1);
+		stats->inputBytes = file.size();
+		stats->outputBytes = cooked.size();
+		stats->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	return true;
+}
+
+bool GenerateDDSMips(const DDS_TEXTURE &dds, const MIPOPTIONS &options, vector<uint8_t> &file, unsigned int threadCount)
+{
+	if (dds.mipCount != 1)
+	{
+		printf("The texture has mips already\n");
+		return false;
+	}
+
+	vector<RGBASURFACE> surfaces;
+	if (!ReadRGBASurfaces(dds, surfaces, DXGI_FORMAT_R8G8B8A8_UNORM, threadCount) || !addMipChains(surfaces, dds, options, threadCount))
+		return false;
+
+	buildDDS(file, dds, MipCount(dds.width, dds.height), withSRGB(DXGI_FORMAT_R8G8B8A8_UNORM, isSRGB(dds.format)), surfaces, nullptr, threadCount);
+	return true;
+}
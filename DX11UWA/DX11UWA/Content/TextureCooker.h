@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "BlockCompression.h"
+
+using namespace std;
+
+struct MIPOPTIONS;
+
+// Turns uncompressed DDS textures into block compressed ones at build time, so the app ships
+// BC textures without a GPU on the build box, and turns block compressed ones back into plain
+// RGBA to check them. Also builds as a command line tool, see TextureCookerMain.cpp.
+
+// One subresource of a texture, uncompressed: R8G8B8A8_UNORM or R16G16B16A16_FLOAT, rows packed.
+struct RGBASURFACE
+{
+	size_t width;
+	size_t height;
+	DXGI_FORMAT format;
+	vector<uint8_t> texels;
+};
+
+// Unpacks every subresource of a texture to format, R8G8B8A8_UNORM or R16G16B16A16_FLOAT, in the
+// order GetDDSSubresources lists them. Takes 8 bit per channel RGBA, BGRA and BGRX textures and
+// every BC format, see DecodeBCSurface for what each becomes; BC surfaces are decoded on
+// threadCount threads. Volume textures and other formats are turned down.
+bool ReadRGBASurfaces(const DDS_TEXTURE &dds, vector<RGBASURFACE> &surfaces, DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM, unsigned int threadCount = 0);
+
+// How a cook went. PSNR compares the decoded blocks with the input over every subresource;
+// uncompressed outputs are the input as it is and report PSNR_IDENTICAL.
+struct COOKSTATS
+{
+	double rgbPSNR;
+	double alphaPSNR;
+	size_t inputBytes;
+	size_t outputBytes;
+	double seconds;
+};
+
+// Writes inputPath as format to outputPath with a DX10 header keeping the mips, array slices
+// and cube faces of the input. format is BC1, BC3 or BC7, compressing the input, or
+// R8G8B8A8_UNORM or R16G16B16A16_FLOAT, decoding it. The sRGB variant is used when the input is
+// sRGB and format has one. With mips, an input with only mip 0 gets a full chain made with them,
+// their srgb taken from the input format. stats, if given, is filled in on success.
+bool CookTexture(const char * inputPath, const char * outputPath, DXGI_FORMAT format, COOKSTATS * stats = nullptr, unsigned int threadCount = 0, const MIPOPTIONS * mips = nullptr);
+
+// Builds in file a DDS of dds as R8G8B8A8_UNORM, or its sRGB variant, with a full mip chain made
+// with options, their srgb taken from dds. For loading a texture saved with only mip 0 as if it
+// had been cooked with mips; fails if dds has mips already or can't be read by ReadRGBASurfaces.
+bool GenerateDDSMips(const DDS_TEXTURE &dds, const MIPOPTIONS &options, vector<uint8_t> &file, unsigned int threadCount = 0);
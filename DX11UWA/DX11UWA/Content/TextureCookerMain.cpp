@@ -0,0 +1,80 @@
+#include "pch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "TextureCooker.h"
+#include "MipGenerator.h"
+
+// TextureCooker [-f bc1|bc3|bc7|rgba8|rgba16f] [-m box|kaiser|lanczos] [-a alpha] [-w] [-j threads] input.dds output.dds
+// -m generates mips for an input without them, -a keeps the alpha test coverage of mip 0 at that
+// reference and -w filters across the edges of a tiling texture.
+// Not part of the app: the top-level CMakeLists.txt builds it against the rest of the cooker,
+// MipGenerator.cpp, BlockCompression.cpp and Common/DDSReader.cpp with an empty pch.h.
+int main(int argc, char ** argv)
+{
+	DXGI_FORMAT format = DXGI_FORMAT_BC7_UNORM;
+	MIPOPTIONS mips = { MIP_FILTER_BOX, false, false, 0.0f };
+	bool generate = false;
+	unsigned int threadCount = 0;
+	const char * paths[2] = { nullptr, nullptr };
+	size_t pathCount = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+		{
+			const char * name = argv[++i];
+			if (strcmp(name, "bc1") == 0)
+				format = DXGI_FORMAT_BC1_UNORM;
+			else if (strcmp(name, "bc3") == 0)
+				format = DXGI_FORMAT_BC3_UNORM;
+			else if (strcmp(name, "bc7") == 0)
+				format = DXGI_FORMAT_BC7_UNORM;
+			else if (strcmp(name, "rgba8") == 0)
+				format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			else if (strcmp(name, "rgba16f") == 0)
+				format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+			else
+			{
+				printf("Unknown format %s\n", name);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+		{
+			const char * name = argv[++i];
+			generate = true;
+			if (strcmp(name, "box") == 0)
+				mips.filter = MIP_FILTER_BOX;
+			else if (strcmp(name, "kaiser") == 0)
+				mips.filter = MIP_FILTER_KAISER;
+			else if (strcmp(name, "lanczos") == 0)
+				mips.filter = MIP_FILTER_LANCZOS;
+			else
+			{
+				printf("Unknown mip filter %s\n", name);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+			mips.alphaReference = float(atof(argv[++i]));
+		else if (strcmp(argv[i], "-w") == 0)
+			mips.wrap = true;
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			threadCount = unsigned(atoi(argv[++i]));
+		else if (pathCount < 2)
+			paths[pathCount++] = argv[i];
+	}
+	if (pathCount != 2)
+	{
+		printf("TextureCooker [-f bc1|bc3|bc7|rgba8|rgba16f] [-m box|kaiser|lanczos] [-a alpha] [-w] [-j threads] input.dds output.dds\n");
+		return 1;
+	}
+
+	COOKSTATS stats;
+	if (!CookTexture(paths[0], paths[1], format, &stats, threadCount, generate ? &mips : nullptr))
+		return 1;
+
+	printf("%s: %zu -> %zu bytes in %.2f s, PSNR rgb %.2f dB, alpha %.2f dB\n",
+		paths[1], stats.inputBytes, stats.outputBytes, stats.seconds, stats.rgbPSNR, stats.alphaPSNR);
+	return 0;
+}
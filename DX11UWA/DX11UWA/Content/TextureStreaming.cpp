@@ -0,0 +1,266 @@
+#include "pch.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "TextureStreaming.h"
+
+static const unsigned int NO_TEXTURE = 0xffffffff;
+
+// Spheres are tested against the planes one at a time, like BoxOutsideFrustum.
+static bool sphereOutsideFrustum(const FRUSTUM &frustum, const XMFLOAT3 &center, float radius)
+{
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		const XMFLOAT4 &plane = frustum.planes[i];
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			return true;
+	}
+	return false;
+}
+
+TextureStreamer::TextureStreamer(size_t budgetBytes, size_t bytesPerUpdate) :
+	budget(budgetBytes),
+	bytesPerUpdate(bytesPerUpdate),
+	residentBytes(0)
+{
+	memset(&current, 0, sizeof(current));
+}
+
+unsigned int TextureStreamer::addTexture(const DDS_TEXTURE &dds, size_t previewSize)
+{
+	STREAMTEXTURE texture;
+	memset(&texture, 0, sizeof(texture));
+	texture.width = unsigned(dds.width);
+	texture.height = unsigned(dds.height);
+	texture.mipCount = unsigned(min<size_t>(max<size_t>(dds.mipCount, 1), STREAM_MAX_MIPS));
+	texture.tailMip = previewSize ? texture.mipCount - 1 : 0;
+
+	size_t mipBytes[STREAM_MAX_MIPS];
+	size_t width = dds.width, height = dds.height, depth = dds.depth;
+	for (unsigned int i = 0; i < texture.mipCount; ++i)
+	{
+		size_t surfaceBytes = 0;
+		DDSSurfaceInfo(width, height, dds.format, &surfaceBytes, nullptr, nullptr);
+		mipBytes[i] = surfaceBytes * depth * dds.arraySize;
+
+		if (previewSize && i < texture.tailMip && width <= previewSize && height <= previewSize && depth <= previewSize)
+			texture.tailMip = i;
+
+		width = max<size_t>(width >> 1, 1);
+		height = max<size_t>(height >> 1, 1);
+		depth = max<size_t>(depth >> 1, 1);
+	}
+
+	size_t chain = 0;
+	for (unsigned int i = texture.mipCount; i-- > 0;)
+	{
+		chain += mipBytes[i];
+		texture.chainBytes[i] = chain;
+	}
+
+	texture.residentMip = texture.tailMip;
+	texture.wantedMip = texture.tailMip;
+	residentBytes += texture.chainBytes[texture.tailMip];
+	textures.push_back(texture);
+	return unsigned(textures.size() - 1);
+}
+
+// Moves the texture's largest resident mip, folding it into any request already made for it
+// this update so the renderer only creates the texture once.
+void TextureStreamer::setResident(unsigned int index, unsigned int topMip)
+{
+	STREAMTEXTURE &texture = textures[index];
+	if (topMip == texture.residentMip)
+		return;
+
+	unsigned int from = texture.residentMip;
+	residentBytes = residentBytes - texture.chainBytes[from] + texture.chainBytes[topMip];
+	texture.residentMip = topMip;
+
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		if (requests[i].texture != index)
+			continue;
+
+		// Back where the update started: nothing to do after all.
+		if (requests[i].fromMip == topMip)
+			requests.erase(requests.begin() + i);
+		else
+			requests[i].topMip = topMip;
+		return;
+	}
+
+	STREAMREQUEST request = { index, from, topMip };
+	requests.push_back(request);
+}
+
+// Drops mips, down to their tails, from the textures with a priority below the given one,
+// least important first, until bytes are free. Returns the bytes freed. Unless partial, when
+// they can't free that much nothing is dropped, as a load that still won't fit would only
+// have them loaded again on the next update.
+size_t TextureStreamer::makeRoom(size_t bytes, float priority, unsigned int keep, bool partial)
+{
+	victims.clear();
+	size_t droppable = 0;
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		if (i != keep && textures[i].priority < priority && textures[i].residentMip < textures[i].tailMip)
+		{
+			victims.push_back(i);
+			droppable += textures[i].chainBytes[textures[i].residentMip] - textures[i].chainBytes[textures[i].tailMip];
+		}
+	}
+	if (!partial && droppable < bytes)
+		return 0;
+	// Least important first; of those, the biggest first so fewer textures are touched.
+	sort(victims.begin(), victims.end(), [this](unsigned int a, unsigned int b)
+	{
+		const STREAMTEXTURE &ta = textures[a], &tb = textures[b];
+		if (ta.priority != tb.priority)
+			return ta.priority < tb.priority;
+		return ta.chainBytes[ta.residentMip] > tb.chainBytes[tb.residentMip];
+	});
+
+	victimMips.resize(victims.size());
+	size_t freed = 0, dropped = 0;
+	for (; dropped < victims.size() && freed < bytes; ++dropped)
+	{
+		const STREAMTEXTURE &texture = textures[victims[dropped]];
+		unsigned int top = texture.residentMip;
+		size_t resident = texture.chainBytes[top];
+		while (top < texture.tailMip && freed + resident - texture.chainBytes[top] < bytes)
+			++top;
+
+		freed += resident - texture.chainBytes[top];
+		victimMips[dropped] = top;
+	}
+
+	// A later victim can free more than the ones before it needed to: give mips back, most
+	// important first, so they aren't loaded again on the next update.
+	for (size_t i = dropped; i-- > 0;)
+	{
+		const STREAMTEXTURE &texture = textures[victims[i]];
+		unsigned int &top = victimMips[i];
+		while (top > texture.residentMip && freed - (texture.chainBytes[top - 1] - texture.chainBytes[top]) >= bytes)
+		{
+			freed -= texture.chainBytes[top - 1] - texture.chainBytes[top];
+			--top;
+		}
+	}
+
+	for (size_t i = 0; i < dropped; ++i)
+	{
+		current.evictedBytes += textures[victims[i]].chainBytes[textures[victims[i]].residentMip] - textures[victims[i]].chainBytes[victimMips[i]];
+		setResident(victims[i], victimMips[i]);
+	}
+	return freed;
+}
+
+const vector<STREAMREQUEST> & TextureStreamer::update(const STREAMVIEW &view, const STREAMUSE * uses, size_t useCount, STREAMSTATS * stats)
+{
+	requests.clear();
+	memset(&current, 0, sizeof(current));
+
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		textures[i].wantedMip = textures[i].tailMip;
+		textures[i].priority = 0.0f;
+	}
+
+	// The mip whose texels come closest to one per pixel, for the nearest point of the sphere.
+	for (size_t i = 0; i < useCount; ++i)
+	{
+		const STREAMUSE &use = uses[i];
+		if (use.texture >= textures.size() || sphereOutsideFrustum(view.frustum, use.center, use.radius))
+			continue;
+
+		STREAMTEXTURE &texture = textures[use.texture];
+		float dx = use.center.x - view.eye.x, dy = use.center.y - view.eye.y, dz = use.center.z - view.eye.z;
+		float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+		unsigned int mip = 0;
+		float pixels = FLT_MAX;
+		if (distance > use.radius)
+		{
+			pixels = 2.0f * use.radius * view.pixelsPerUnit / (distance - use.radius);
+			float texelsPerPixel = float(max(texture.width, texture.height)) * use.repeat / pixels;
+			if (texelsPerPixel > 1.0f)
+				mip = unsigned(min(floorf(log2f(texelsPerPixel)), float(STREAM_MAX_MIPS)));
+		}
+
+		texture.wantedMip = min(texture.wantedMip, min(mip, texture.tailMip));
+		texture.priority = max(texture.priority, pixels);
+	}
+
+	// Mips nobody has wanted for a while go, whether or not the room is needed.
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		STREAMTEXTURE &texture = textures[i];
+		if (texture.wantedMip <= texture.residentMip)
+		{
+			texture.coarserUpdates = 0;
+			continue;
+		}
+
+		if (++texture.coarserUpdates >= EVICT_DELAY)
+		{
+			current.evictedBytes += texture.chainBytes[texture.residentMip] - texture.chainBytes[texture.wantedMip];
+			setResident(i, texture.wantedMip);
+			texture.coarserUpdates = 0;
+		}
+	}
+
+	// Loads, biggest on screen first.
+	loads.clear();
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		if (textures[i].wantedMip < textures[i].residentMip)
+			loads.push_back(i);
+	}
+	sort(loads.begin(), loads.end(), [this](unsigned int a, unsigned int b) { return textures[a].priority > textures[b].priority; });
+
+	for (size_t i = 0; i < loads.size(); ++i)
+	{
+		STREAMTEXTURE &texture = textures[loads[i]];
+		unsigned int resident = texture.residentMip;
+
+		// Stay within the bandwidth, but always let the first load of an update through so a
+		// texture bigger than bytesPerUpdate still gets its mips.
+		unsigned int top = texture.wantedMip;
+		while (top < resident && current.loadedBytes > 0 && current.loadedBytes + texture.chainBytes[top] > bytesPerUpdate)
+			++top;
+
+		// Settle for fewer mips until textures that matter less can make room for them.
+		while (top < resident && residentBytes + texture.chainBytes[top] - texture.chainBytes[resident] > budget &&
+			!makeRoom(residentBytes + texture.chainBytes[top] - texture.chainBytes[resident] - budget, texture.priority, loads[i], false))
+			++top;
+		if (top == resident)
+			continue;
+
+		current.loadedBytes += texture.chainBytes[top];
+		setResident(loads[i], top);
+	}
+
+	// A lowered budget, or tails that alone don't fit.
+	if (residentBytes > budget)
+		makeRoom(residentBytes - budget, FLT_MAX, NO_TEXTURE, true);
+
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		if (textures[i].residentMip > textures[i].wantedMip)
+			current.missingMips += textures[i].residentMip - textures[i].wantedMip;
+	}
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		if (requests[i].topMip < requests[i].fromMip)
+			++current.loads;
+		else
+			++current.evictions;
+	}
+	current.residentBytes = residentBytes;
+	current.overBudget = residentBytes > budget;
+	if (stats)
+		*stats = current;
+	return requests;
+}
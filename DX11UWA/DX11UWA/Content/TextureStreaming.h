@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "MeshletCulling.h"
+#include "../Common/DDSReader.h"
+
+using namespace std;
+
+// Decides which mips of each texture should be resident. Like MeshletCulling, nothing in here
+// touches Direct3D: update() only hands back requests, and the renderer carries them out by
+// creating the texture again from its top mip down (see ProgressiveTexture::request).
+
+static const unsigned int STREAM_MAX_MIPS = 15;
+
+// What the streamer keeps per texture.
+struct STREAMTEXTURE
+{
+	unsigned int width;					// of mip 0
+	unsigned int height;
+	unsigned int mipCount;
+	unsigned int tailMip;				// largest mip that is always resident
+	size_t chainBytes[STREAM_MAX_MIPS];	// bytes of mip i and every smaller one, all array slices
+
+	unsigned int residentMip;			// largest mip resident
+	unsigned int wantedMip;				// largest mip the last update asked for
+	float priority;						// largest on screen size, in pixels, of an object using it
+	unsigned int coarserUpdates;		// updates in a row that wanted fewer mips than are resident
+};
+
+// An object drawn with a texture: its world space bounding sphere and how many times the
+// texture repeats across the sphere's diameter.
+struct STREAMUSE
+{
+	unsigned int texture;
+	XMFLOAT3 center;
+	float radius;
+	float repeat;
+};
+
+// Where the camera is. pixelsPerUnit is the size in pixels of one unit at distance 1, i.e.
+// viewport height / (2 tan(fovY / 2)); the frustum planes are in world space.
+struct STREAMVIEW
+{
+	XMFLOAT3 eye;
+	FRUSTUM frustum;
+	float pixelsPerUnit;
+};
+
+// Make texture's largest resident mip topMip, down from (load) or up from fromMip.
+struct STREAMREQUEST
+{
+	unsigned int texture;
+	unsigned int fromMip;
+	unsigned int topMip;
+};
+
+// What one update did. loadedBytes is what the renderer has to upload for the loads, which
+// is the whole new mip chain since textures are created again.
+struct STREAMSTATS
+{
+	size_t residentBytes;
+	size_t loadedBytes;
+	size_t evictedBytes;
+	unsigned int loads;
+	unsigned int evictions;
+	unsigned int missingMips;			// summed over textures resident short of what they want
+	bool overBudget;
+};
+
+class TextureStreamer
+{
+public:
+	static const size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+	static const size_t DEFAULT_BYTES_PER_UPDATE = 4 * 1024 * 1024;
+	// Updates a texture must want fewer mips for before they are dropped, unless the budget
+	// needs the room. Keeps mips from flickering in and out as the camera moves back and forth.
+	static const unsigned int EVICT_DELAY = 30;
+
+	TextureStreamer(size_t budgetBytes = DEFAULT_BUDGET, size_t bytesPerUpdate = DEFAULT_BYTES_PER_UPDATE);
+
+	// Registers a texture with the mips no larger than previewSize resident (all of them for
+	// 0), which is what ProgressiveTexture::load creates. Returns its index.
+	unsigned int addTexture(const DDS_TEXTURE &dds, size_t previewSize);
+
+	// Works out the mip each texture wants from the uses seen by view, then loads mips in order
+	// of on screen size within the budget and bytesPerUpdate, dropping mips of textures that
+	// matter less to make room. At most one request per texture.
+	const vector<STREAMREQUEST> & update(const STREAMVIEW &view, const STREAMUSE * uses, size_t useCount, STREAMSTATS * stats = nullptr);
+
+	void setBudget(size_t bytes) { budget = bytes; }
+	size_t getBudget() const { return budget; }
+	size_t getResidentBytes() const { return residentBytes; }
+	const STREAMTEXTURE & getTexture(unsigned int index) const { return textures[index]; }
+	size_t textureCount() const { return textures.size(); }
+
+private:
+	void setResident(unsigned int index, unsigned int topMip);
+	size_t makeRoom(size_t bytes, float priority, unsigned int keep, bool partial);
+
+	vector<STREAMTEXTURE> textures;
+	vector<STREAMREQUEST> requests;
+	vector<unsigned int> loads;
+	vector<unsigned int> victims;
+	vector<unsigned int> victimMips;
+	size_t budget;
+	size_t bytesPerUpdate;
+	size_t residentBytes;
+	STREAMSTATS current;
+};
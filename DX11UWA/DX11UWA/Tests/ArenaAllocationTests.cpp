@@ -0,0 +1,118 @@
+#include <string.h>
+#include <vector>
+#include "TestCheck.h"
+#include "../Content/ModelLoader.h"
+#define DX_REPLACE_GLOBAL_NEW
+#include "../Common/AllocationCounter.h"
+
+using namespace std;
+
+// loadModelArena has to take everything it needs from the arena once countObj has sized it,
+// so a load into a big enough arena makes no heap allocations at all.
+
+// The shipped meshes that give every face a normal; faces without one go through loadModel.
+static const char * PATHS[] = { "Assets/Alientree.obj", "Assets/WaterTower.obj", "Assets/SkyboxCube.obj", "Assets/FloorPlane.obj" };
+
+static void testPath(const char * path)
+{
+	ModelLoader loader;
+	MESHARENA probe(nullptr, 0);
+	ARENAMESH mesh;
+	CHECK(!loader.loadModelArena(path, probe, mesh));
+	size_t arenaBytes = loader.getStats().arenaBytes;
+	CHECK(arenaBytes > 0);
+
+	vector<char> memory(arenaBytes);
+	MESHARENA arena(memory.data(), memory.size());
+	long long allocations;
+	bool loaded;
+	{
+		DX::HeapAllocationCounter counter;
+		loaded = loader.loadModelArena(path, arena, mesh);
+		allocations = counter.Count();
+	}
+	printf("%s: %zu arena bytes, %lld heap allocations\n", path, arenaBytes, allocations);
+	CHECK(loaded);
+	CHECK(allocations == 0);
+	CHECK(!loader.getStats().usedLoadModel);
+	CHECK(arena.used <= arena.capacity);
+
+	// Loading again after a reset reuses the same memory, still without the heap.
+	{
+		DX::HeapAllocationCounter counter;
+		arena.reset();
+		loaded = loader.loadModelArena(path, arena, mesh);
+		allocations = counter.Count();
+	}
+	CHECK(loaded);
+	CHECK(allocations == 0);
+
+	// The same mesh loadModel builds.
+	vector<VERTEX> verts;
+	vector<unsigned int> indices;
+	CHECK(loader.loadModel(path, verts, indices));
+	CHECK(mesh.vertexCount == verts.size());
+	CHECK(mesh.indexCount == indices.size());
+	if (mesh.vertexCount == verts.size() && mesh.indexCount == indices.size())
+	{
+		CHECK(memcmp(mesh.vertices, verts.data(), verts.size() * sizeof(VERTEX)) == 0);
+		CHECK(memcmp(mesh.indices, indices.data(), indices.size() * sizeof(unsigned int)) == 0);
+	}
+}
+
+// Without normals the file goes through loadModel, but still comes back in the arena.
+static void testNoNormals()
+{
+	static const char * PATH = "Tests/Data/NoNormals.obj";
+	ModelLoader loader;
+	MESHARENA probe(nullptr, 0);
+	ARENAMESH mesh;
+	CHECK(!loader.loadModelArena(PATH, probe, mesh));
+
+	vector<char> memory(loader.getStats().arenaBytes);
+	MESHARENA arena(memory.data(), memory.size());
+	CHECK(loader.loadModelArena(PATH, arena, mesh));
+	CHECK(loader.getStats().usedLoadModel);
+	CHECK(loader.getStats().generatedNormalCount > 0);
+	CHECK(mesh.vertices >= reinterpret_cast<VERTEX *>(memory.data()) && mesh.indices + mesh.indexCount <= reinterpret_cast<unsigned int *>(memory.data() + memory.size()));
+
+	vector<VERTEX> verts;
+	vector<unsigned int> indices;
+	CHECK(loader.loadModel(PATH, verts, indices));
+	CHECK(mesh.vertexCount == verts.size());
+	CHECK(mesh.indexCount == indices.size());
+	if (mesh.vertexCount == verts.size() && mesh.indexCount == indices.size())
+	{
+		CHECK(memcmp(mesh.vertices, verts.data(), verts.size() * sizeof(VERTEX)) == 0);
+		CHECK(memcmp(mesh.indices, indices.data(), indices.size() * sizeof(unsigned int)) == 0);
+	}
+}
+
+// A file the parser turns down gives back everything it took, however far it got.
+static void testFailureRewinds()
+{
+	static const char * PATH = "Tests/Data/BadIndex.obj";
+	ModelLoader loader;
+	MESHARENA probe(nullptr, 0);
+	ARENAMESH mesh;
+	CHECK(!loader.loadModelArena(PATH, probe, mesh));
+
+	vector<char> memory(loader.getStats().arenaBytes + 64);
+	MESHARENA arena(memory.data(), memory.size());
+	CHECK(arena.allocate(48) != nullptr);
+	size_t used = arena.used;
+	unsigned int allocationCount = arena.allocationCount;
+	CHECK(!loader.loadModelArena(PATH, arena, mesh));
+	CHECK(arena.used == used);
+	CHECK(arena.allocationCount == allocationCount);
+}
+
+int main()
+{
+	DX::EnableHeapAllocationCount();
+	for (const char * path : PATHS)
+		testPath(path);
+	testNoNormals();
+	testFailureRewinds();
+	return TestsFailed() ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "TestCheck.h"
+#include "../Content/BlockCompression.h"
+#include "../Content/TextureCooker.h"
+#include "../Common/MappedFile.h"
+
+using namespace std;
+
+// The BC encoders and decoders on blocks whose results are known exactly, and BC7 on opaque
+// textures, which have to stay opaque for the pixel shaders' alpha test.
+
+static bool near(int a, int b, int tolerance)
+{
+	return abs(a - b) <= tolerance;
+}
+
+static void fillBlock(uint8_t texels[64], uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	for (unsigned int t = 0; t < 16; ++t)
+	{
+		texels[t * 4] = r;
+		texels[t * 4 + 1] = g;
+		texels[t * 4 + 2] = b;
+		texels[t * 4 + 3] = a;
+	}
+}
+
+// Colors BC1 stores exactly: 5 and 6 bit values widened by repeating their top bits.
+static void testBC1()
+{
+	uint8_t texels[64], decoded[64], block[8];
+	fillBlock(texels, 255, 0, 0, 255);
+	EncodeBC1Block(block, texels);
+	DecodeBC1Block(decoded, block);
+	CHECK(memcmp(decoded, texels, 64) == 0);
+
+	// Two colors on alternate texels are the two ends.
+	for (unsigned int t = 0; t < 16; t += 2)
+	{
+		texels[t * 4] = 0;
+		texels[t * 4 + 2] = 255;
+	}
+	EncodeBC1Block(block, texels);
+	DecodeBC1Block(decoded, block);
+	CHECK(memcmp(decoded, texels, 64) == 0);
+
+	// Alpha below 128 makes a texel transparent black and leaves the others opaque.
+	fillBlock(texels, 255, 255, 255, 255);
+	texels[3] = 0;
+	EncodeBC1Block(block, texels);
+	DecodeBC1Block(decoded, block);
+	CHECK(decoded[0] == 0 && decoded[1] == 0 && decoded[2] == 0 && decoded[3] == 0);
+	CHECK(memcmp(decoded + 4, texels + 4, 60) == 0);
+
+	// Red and blue ends with every texel on the color a third of the way to blue.
+	const uint8_t known[8] = { 0x00, 0xf8, 0x1f, 0x00, 0xaa, 0xaa, 0xaa, 0xaa };
+	DecodeBC1Block(decoded, known);
+	for (unsigned int t = 0; t < 16; ++t)
+		CHECK(near(decoded[t * 4], 170, 1) && decoded[t * 4 + 1] == 0 && near(decoded[t * 4 + 2], 85, 1) && decoded[t * 4 + 3] == 255);
+}
+
+// BC3's alpha ends are 8 bits, so two alpha values come back exactly.
+static void testBC3()
+{
+	uint8_t texels[64], decoded[64], block[16];
+	fillBlock(texels, 0, 255, 0, 255);
+	for (unsigned int t = 0; t < 16; t += 3)
+		texels[t * 4 + 3] = 17;
+	EncodeBC3Block(block, texels);
+	DecodeBC3Block(decoded, block);
+	CHECK(memcmp(decoded, texels, 64) == 0);
+
+	// Explicit 4 bit alpha: 0xf is 255 and 0x8 is 136.
+	const uint8_t known[16] = { 0x8f, 0x8f, 0x8f, 0x8f, 0x8f, 0x8f, 0x8f, 0x8f, 0xff, 0xff, 0xff, 0xff, 0, 0, 0, 0 };
+	DecodeBC2Block(decoded, known);
+	for (unsigned int t = 0; t < 16; ++t)
+		CHECK(decoded[t * 4] == 255 && decoded[t * 4 + 1] == 255 && decoded[t * 4 + 2] == 255 && decoded[t * 4 + 3] == (t & 1 ? 136 : 255));
+}
+
+// Mode 6 ends are 7 bits and a p-bit shared by their four channels, so a solid block is exact
+// when its channels are all even or all odd and within one otherwise.
+static void testBC7()
+{
+	uint8_t texels[64], decoded[64], block[16];
+	const uint8_t exact[][4] = { { 255, 255, 255, 255 }, { 0, 0, 0, 0 }, { 12, 200, 98, 254 }, { 1, 3, 99, 255 } };
+	for (const uint8_t * color : exact)
+	{
+		fillBlock(texels, color[0], color[1], color[2], color[3]);
+		EncodeBC7Block(block, texels);
+		DecodeBC7Block(decoded, block);
+		CHECK(memcmp(decoded, texels, 64) == 0);
+	}
+	const uint8_t mixed[][4] = { { 12, 200, 99, 255 }, { 1, 2, 3, 128 }, { 254, 127, 64, 1 } };
+	for (const uint8_t * color : mixed)
+	{
+		fillBlock(texels, color[0], color[1], color[2], color[3]);
+		EncodeBC7Block(block, texels);
+		DecodeBC7Block(decoded, block);
+		for (unsigned int i = 0; i < 64; ++i)
+			CHECK(near(decoded[i], texels[i], 1));
+		CHECK(color[3] != 255 || decoded[3] == 255);
+	}
+
+	// Opaque noise: whatever the color error, alpha stays 255.
+	unsigned int seed = 1;
+	for (unsigned int n = 0; n < 256; ++n)
+	{
+		for (unsigned int t = 0; t < 16; ++t)
+		{
+			for (unsigned int c = 0; c < 3; ++c)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				texels[t * 4 + c] = uint8_t(seed >> 24);
+			}
+			texels[t * 4 + 3] = 255;
+		}
+		EncodeBC7Block(block, texels);
+		DecodeBC7Block(decoded, block);
+		bool opaque = true;
+		for (unsigned int t = 0; t < 16; ++t)
+			opaque = opaque && decoded[t * 4 + 3] == 255;
+		CHECK(opaque);
+	}
+}
+
+// Red at 1 and green at 0 from two BC4 blocks with ends 255 and 0.
+static void testBC4BC5()
+{
+	const uint8_t known[16] = { 255, 0, 0, 0, 0, 0, 0, 0, 0, 255, 0x49, 0x92, 0x24, 0x49, 0x92, 0x24 };
+	float decoded[64];
+	DecodeBC4Block(decoded, known, false);
+	for (unsigned int t = 0; t < 16; ++t)
+		CHECK(decoded[t * 4] == 1.0f && decoded[t * 4 + 1] == 0.0f && decoded[t * 4 + 2] == 0.0f && decoded[t * 4 + 3] == 1.0f);
+
+	// The second block's indices are all 1, its second end.
+	DecodeBC5Block(decoded, known, false);
+	for (unsigned int t = 0; t < 16; ++t)
+		CHECK(decoded[t * 4] == 1.0f && decoded[t * 4 + 1] == 1.0f);
+}
+
+// Mode 11 with every 10 bit end at its largest: the largest finite half, 65504.
+static void testBC6H()
+{
+	const uint8_t known[16] = { 0xe3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01, 0, 0, 0, 0, 0, 0, 0 };
+	uint16_t decoded[64];
+	DecodeBC6HBlock(decoded, known, false);
+	for (unsigned int t = 0; t < 16; ++t)
+		CHECK(decoded[t * 4] == 0x7bff && decoded[t * 4 + 1] == 0x7bff && decoded[t * 4 + 2] == 0x7bff && decoded[t * 4 + 3] == 0x3c00);
+
+	// Reserved modes are black.
+	const uint8_t reserved[16] = { 0x13 };
+	DecodeBC6HBlock(decoded, reserved, false);
+	for (unsigned int t = 0; t < 16; ++t)
+		CHECK(decoded[t * 4] == 0 && decoded[t * 4 + 1] == 0 && decoded[t * 4 + 2] == 0);
+}
+
+// The shipped grass is opaque; cooked to BC7 it has to decode that way.
+static void testOpaqueSurface()
+{
+	DX::MappedFile file;
+	DDS_TEXTURE dds;
+	vector<RGBASURFACE> surfaces;
+	CHECK(file.open("Assets/grass_seamless.dds") && ReadDDSHeader(file.data(), file.size(), dds) == DDS_OK);
+	CHECK(ReadRGBASurfaces(dds, surfaces));
+	if (surfaces.empty())
+		return;
+
+	const RGBASURFACE &surface = surfaces[0];
+	bool opaque = true;
+	for (size_t i = 3; i < surface.texels.size(); i += 4)
+		opaque = opaque && surface.texels[i] == 255;
+	CHECK(opaque);
+
+	size_t blocksWide = (surface.width + 3) / 4, blocksHigh = (surface.height + 3) / 4;
+	vector<uint8_t> blocks(blocksWide * blocksHigh * 16), decoded(surface.texels.size());
+	CHECK(EncodeBCSurface(DXGI_FORMAT_BC7_UNORM, blocks.data(), blocksWide * 16, surface.texels.data(), surface.width, surface.height, surface.width * 4));
+	CHECK(DecodeBCSurface(DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM, decoded.data(), surface.width * 4, blocks.data(), blocksWide * 16, surface.width, surface.height));
+
+	size_t translucent = 0;
+	for (size_t i = 3; i < decoded.size(); i += 4)
+		translucent += decoded[i] != 255 ? 1 : 0;
+	printf("grass_seamless.dds as BC7: %zu of %zu texels below alpha 255\n", translucent, decoded.size() / 4);
+	CHECK(translucent == 0);
+}
+
+int main()
+{
+	testBC1();
+	testBC3();
+	testBC7();
+	testBC4BC5();
+	testBC6H();
+	testOpaqueSurface();
+	return TestsFailed() ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include "TestCheck.h"
+#include "../Content/ModelLoader.h"
+
+using namespace std;
+
+// loadMesh on a .meshbin someone has tampered with: a meshlet or subset range past the buffers,
+// or a name with no terminator, has to send it back to the OBJ instead of reaching the GPU.
+
+static const char * PATH = "Assets/FloorPlane.obj";
+static const unsigned int PROCESSING = MESHPROCESS_VERTEXCACHE | MESHPROCESS_MESHLETS;
+
+static vector<uint8_t> readFile(const string &path)
+{
+	vector<uint8_t> bytes;
+	FILE * file = fopen(path.c_str(), "rb");
+	if (!file)
+		return bytes;
+	fseek(file, 0, SEEK_END);
+	bytes.resize(size_t(ftell(file)));
+	fseek(file, 0, SEEK_SET);
+	if (fread(bytes.data(), 1, bytes.size(), file) != bytes.size())
+		bytes.clear();
+	fclose(file);
+	return bytes;
+}
+
+static void writeFile(const string &path, const vector<uint8_t> &bytes)
+{
+	FILE * file = fopen(path.c_str(), "wb");
+	CHECK(file != nullptr);
+	if (!file)
+		return;
+	CHECK(fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+	fclose(file);
+}
+
+// Where each part the cache holds starts, as an offset into the file.
+struct CACHELAYOUT
+{
+	size_t subsets, meshlets, submeshes, materials;
+	unsigned int vertexCount, indexCount;
+};
+
+// Writes a fresh cache, then breaks it with corrupt and checks the next load parses the OBJ.
+static void testCorrupt(const char * what, const function<void (vector<uint8_t> &bytes, const CACHELAYOUT &layout)> &corrupt)
+{
+	ModelLoader loader;
+	loader.setProcessing(PROCESSING);
+	string cachePath = ModelLoader::cachePathFor(PATH, PROCESSING, ModelLoader::DEFAULT_CREASE_ANGLE);
+	remove(cachePath.c_str());
+
+	CACHELAYOUT layout;
+	{
+		MESHDATA mesh;
+		CHECK(loader.loadMesh(PATH, mesh) && !loader.getStats().fromCache);
+		CHECK(loader.loadMesh(PATH, mesh) && loader.getStats().fromCache);
+		if (!loader.getStats().fromCache || !mesh.meshletCount || !mesh.materialCount)
+			return;
+		const uint8_t * base = mesh.cacheFile.data();
+		layout.subsets = reinterpret_cast<const uint8_t *>(mesh.subsets) - base;
+		layout.meshlets = reinterpret_cast<const uint8_t *>(mesh.meshlets) - base;
+		layout.submeshes = reinterpret_cast<const uint8_t *>(mesh.submeshes) - base;
+		layout.materials = reinterpret_cast<const uint8_t *>(mesh.materials) - base;
+		layout.vertexCount = mesh.vertexCount;
+		layout.indexCount = mesh.indexCount;
+	}
+
+	vector<uint8_t> bytes = readFile(cachePath);
+	CHECK(!bytes.empty());
+	corrupt(bytes, layout);
+	writeFile(cachePath, bytes);
+
+	MESHDATA mesh;
+	bool loaded = loader.loadMesh(PATH, mesh);
+	printf("%s: %s\n", what, loader.getStats().fromCache ? "cache used" : "cache rejected");
+	CHECK(loaded);
+	CHECK(!loader.getStats().fromCache);
+	remove(cachePath.c_str());
+}
+
+template <typename T> static T * at(vector<uint8_t> &bytes, size_t offset)
+{
+	return reinterpret_cast<T *>(bytes.data() + offset);
+}
+
+int main()
+{
+	ModelLoader::setCacheDirectory(filesystem::temp_directory_path().string());
+
+	testCorrupt("meshlet past the indices", [](vector<uint8_t> &bytes, const CACHELAYOUT &layout)
+	{
+		at<MESHLET>(bytes, layout.meshlets)->indexOffset = layout.indexCount;
+	});
+	testCorrupt("meshlet past the vertices", [](vector<uint8_t> &bytes, const CACHELAYOUT &layout)
+	{
+		at<MESHLET>(bytes, layout.meshlets)->baseVertex = layout.vertexCount;
+	});
+	testCorrupt("subset past the vertices", [](vector<uint8_t> &bytes, const CACHELAYOUT &layout)
+	{
+		at<MESHSUBSET>(bytes, layout.subsets)->baseVertex = layout.vertexCount;
+	});
+	testCorrupt("material name", [](vector<uint8_t> &bytes, const CACHELAYOUT &layout)
+	{
+		MATERIAL * material = at<MATERIAL>(bytes, layout.materials);
+		memset(material->name, 'x', sizeof(material->name));
+	});
+	testCorrupt("diffuse map", [](vector<uint8_t> &bytes, const CACHELAYOUT &layout)
+	{
+		MATERIAL * material = at<MATERIAL>(bytes, layout.materials);
+		memset(material->diffuseMap, 'x', sizeof(material->diffuseMap));
+	});
+	testCorrupt("submesh name", [](vector<uint8_t> &bytes, const CACHELAYOUT &layout)
+	{
+		SUBMESH * submesh = at<SUBMESH>(bytes, layout.submeshes);
+		memset(submesh->name, 'x', sizeof(submesh->name));
+	});
+	return TestsFailed() ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+#include <string.h>
+#include <vector>
+#include "TestCheck.h"
+#include "../Content/ModelLoader.h"
+
+using namespace std;
+
+// loadModelStreaming against loadModel: the batches, with their indices expanded, have to give
+// the same corners in the same order, and the loader has to stay inside its memory budget or
+// say it did not. Only the loadModel fallback for faces without normals may go past it.
+
+// Every corner of the mesh as its vertex, in index order.
+static vector<VERTEX> expand(const VERTEX * vertices, const unsigned int * indices, size_t indexCount)
+{
+	vector<VERTEX> corners;
+	for (size_t i = 0; i < indexCount; ++i)
+		corners.push_back(vertices[indices[i]]);
+	return corners;
+}
+
+static void testPath(const char * path, size_t budget, bool expectLoadModel)
+{
+	ModelLoader loader;
+	vector<VERTEX> verts;
+	vector<unsigned int> indices;
+	CHECK(loader.loadModel(path, verts, indices));
+	vector<VERTEX> expected = expand(verts.data(), indices.data(), indices.size());
+
+	vector<VERTEX> streamed;
+	unsigned int batches = 0;
+	bool ordered = true;
+	bool loaded = loader.loadModelStreaming(path, budget, [&](const MESHBATCH &batch)
+	{
+		ordered = ordered && batch.batchIndex == batches++;
+		vector<VERTEX> corners = expand(batch.vertices, batch.indices, batch.indexCount);
+		streamed.insert(streamed.end(), corners.begin(), corners.end());
+		return true;
+	});
+
+	const LOADERSTATS &stats = loader.getStats();
+	printf("%s: %u batches, %zu of %zu budget bytes%s%s\n", path, batches, stats.streamingBytes, budget,
+		stats.usedLoadModel ? ", through loadModel" : "", stats.overBudget ? ", over budget" : "");
+	CHECK(loaded);
+	CHECK(ordered);
+	CHECK(stats.batchCount == batches);
+	CHECK(stats.usedLoadModel == expectLoadModel);
+	CHECK(stats.overBudget == (stats.streamingBytes > budget));
+	CHECK(expectLoadModel || !stats.overBudget);
+	CHECK(streamed.size() == expected.size());
+	if (streamed.size() == expected.size())
+		CHECK(memcmp(streamed.data(), expected.data(), expected.size() * sizeof(VERTEX)) == 0);
+}
+
+int main()
+{
+	// Big enough for the whole tower in one batch, then small enough to need several.
+	testPath("Assets/WaterTower.obj", 1024 * 1024, false);
+	testPath("Assets/WaterTower.obj", 64 * 1024, false);
+	testPath("Assets/Alientree.obj", 128 * 1024, false);
+	testPath("Tests/Data/NoUVs.obj", 64 * 1024, false);
+	testPath("Tests/Data/NoNormals.obj", 64 * 1024, true);
+	testPath("Tests/Data/MissingNormal.obj", 64 * 1024, true);
+	return TestsFailed() ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdio.h>
+
+// Minimal checks for the programs in this folder, which CMakeLists.txt registers with ctest.
+// A failed CHECK prints where it was and makes TestsFailed() true; the test keeps going so
+// one run reports every failure.
+
+inline int &FailedCheckCount()
+{
+	static int count = 0;
+	return count;
+}
+
+inline bool TestsFailed()
+{
+	return FailedCheckCount() != 0;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			FailedCheckCount()++; \
+		} \
+	} while (0)
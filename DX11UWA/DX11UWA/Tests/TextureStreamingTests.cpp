@@ -0,0 +1,192 @@
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "TestCheck.h"
+#include "../Content/TextureStreaming.h"
+
+using namespace std;
+
+// TextureStreamer on the texture_streaming benchmark's camera path: it has to keep what is
+// resident within the budget on every update, and its eviction delay has to keep mips from
+// going in and out as the camera moves back and forth.
+
+static const unsigned int GRID_SIZE = 8, FRAMES = 1200;
+static const float SPACING = 12.0f, RADIUS = 5.0f, REPEAT = 4.0f;
+static const float FOV_Y = 70.0f * XM_PI / 180.0f;
+
+// A 2048x2048 BC1 texture with its full mip chain.
+static DDS_TEXTURE textureInfo()
+{
+	DDS_TEXTURE dds;
+	memset(&dds, 0, sizeof(dds));
+	dds.dimension = DDS_DIMENSION_TEXTURE2D;
+	dds.format = DXGI_FORMAT_BC1_UNORM;
+	dds.width = dds.height = 2048;
+	dds.depth = dds.arraySize = 1;
+	dds.mipCount = 12;
+	return dds;
+}
+
+static void lookAt(STREAMVIEW &view, const XMFLOAT3 &eye, const XMFLOAT3 &target)
+{
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(FOV_Y, 16.0f / 9.0f, 0.01f, 100.0f);
+	XMMATRIX camera = XMMatrixLookAtLH(XMLoadFloat3(&eye), XMLoadFloat3(&target), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, camera * projection);
+	ComputeFrustum(view.frustum, viewProjection);
+	view.eye = eye;
+	view.pixelsPerUnit = 1080.0f / (2.0f * tanf(FOV_Y * 0.5f));
+}
+
+// The benchmark's path: loops around the field, dipping low over it and climbing away again.
+static void pathView(STREAMVIEW &view, unsigned int frame)
+{
+	float middle = (GRID_SIZE - 1) * SPACING * 0.5f;
+	float angle = XM_2PI * (frame % FRAMES) / FRAMES;
+	float reach = middle * (0.6f + 0.5f * sinf(angle * 3.0f));
+	XMFLOAT3 eye(middle + reach * cosf(angle), 1.5f + 6.0f * (0.5f + 0.5f * cosf(angle * 2.0f)), middle + reach * sinf(angle));
+	lookAt(view, eye, XMFLOAT3(middle + reach * cosf(angle + 0.6f), 0.0f, middle + reach * sinf(angle + 0.6f)));
+}
+
+static vector<STREAMUSE> addGrid(TextureStreamer &streamer)
+{
+	DDS_TEXTURE dds = textureInfo();
+	vector<STREAMUSE> uses;
+	for (unsigned int row = 0; row < GRID_SIZE; ++row)
+	{
+		for (unsigned int column = 0; column < GRID_SIZE; ++column)
+		{
+			STREAMUSE use = { streamer.addTexture(dds, 64), XMFLOAT3(column * SPACING, 0.0f, row * SPACING), RADIUS, REPEAT };
+			uses.push_back(use);
+		}
+	}
+	return uses;
+}
+
+// A texture put back to where it was this few updates after a request is bouncing: mips
+// dropped to make room for a load and loaded again, or loaded and dropped again.
+static const unsigned int BOUNCE_UPDATES = 2;
+
+// Runs the path twice against budget and checks every update: the resident bytes stay within
+// the budget and match the requests handed back, and, when the budget is big enough to never
+// need room, mips only go once nothing has been asked of their texture for EVICT_DELAY updates.
+// Returns how many times a texture bounced.
+static unsigned int runPath(size_t budget, bool checkDelay)
+{
+	TextureStreamer streamer(budget, TextureStreamer::DEFAULT_BYTES_PER_UPDATE);
+	vector<STREAMUSE> uses = addGrid(streamer);
+
+	// What the renderer would have resident after carrying out the requests.
+	vector<unsigned int> resident(streamer.textureCount());
+	vector<unsigned int> lastRequest(streamer.textureCount(), 0), lastFrom(streamer.textureCount(), 0);
+	vector<bool> requested(streamer.textureCount(), false);
+	for (unsigned int i = 0; i < resident.size(); ++i)
+		resident[i] = streamer.getTexture(i).residentMip;
+
+	unsigned int bounces = 0, overBudget = 0, loads = 0, evictions = 0;
+	size_t peakResident = 0;
+	STREAMVIEW view;
+	for (unsigned int frame = 0; frame < 2 * FRAMES; ++frame)
+	{
+		pathView(view, frame);
+		STREAMSTATS stats;
+		const vector<STREAMREQUEST> &requests = streamer.update(view, uses.data(), uses.size(), &stats);
+
+		for (const STREAMREQUEST &request : requests)
+		{
+			CHECK(request.fromMip == resident[request.texture]);
+			CHECK(request.topMip != request.fromMip);
+			bool load = request.topMip < request.fromMip;
+			loads += load ? 1 : 0;
+			evictions += load ? 0 : 1;
+			if (!load && checkDelay && requested[request.texture])
+				CHECK(frame - lastRequest[request.texture] >= TextureStreamer::EVICT_DELAY);
+			if (requested[request.texture] && frame - lastRequest[request.texture] <= BOUNCE_UPDATES && request.topMip == lastFrom[request.texture])
+				++bounces;
+
+			resident[request.texture] = request.topMip;
+			lastRequest[request.texture] = frame;
+			lastFrom[request.texture] = request.fromMip;
+			requested[request.texture] = true;
+		}
+
+		size_t bytes = 0;
+		for (unsigned int i = 0; i < resident.size(); ++i)
+		{
+			const STREAMTEXTURE &texture = streamer.getTexture(i);
+			CHECK(texture.residentMip == resident[i]);
+			CHECK(texture.residentMip <= texture.tailMip);
+			bytes += texture.chainBytes[texture.residentMip];
+		}
+		CHECK(bytes == streamer.getResidentBytes());
+		CHECK(stats.residentBytes == bytes);
+		CHECK(stats.residentBytes <= budget);
+		CHECK(!stats.overBudget);
+		overBudget += stats.overBudget ? 1 : 0;
+		peakResident = max(peakResident, stats.residentBytes);
+	}
+
+	printf("%.0f MB budget: peak resident %.2f MB, %u loads, %u evictions, %u bounces, %u updates over budget\n",
+		budget / 1048576.0, peakResident / 1048576.0, loads, evictions, bounces, overBudget);
+	return bounces;
+}
+
+static void testPath()
+{
+	// Tight enough that the low parts of the path need room made; mips still must not bounce.
+	CHECK(runPath(4 * 1024 * 1024, false) == 0);
+
+	// Bigger than every mip of every texture, so only the eviction delay drops anything.
+	CHECK(runPath(256 * 1024 * 1024, true) == 0);
+}
+
+// One object with the camera hovering either side of the distance where it wants one mip
+// more, faster than EVICT_DELAY: the mip is loaded once and kept. Once the camera stays away
+// it goes after exactly EVICT_DELAY updates.
+static void testHover()
+{
+	TextureStreamer streamer;
+	DDS_TEXTURE dds = textureInfo();
+	STREAMUSE use = { streamer.addTexture(dds, 64), XMFLOAT3(0.0f, 0.0f, 0.0f), RADIUS, REPEAT };
+
+	// The distance at which a texel of the given mip covers one pixel.
+	STREAMVIEW view;
+	lookAt(view, XMFLOAT3(0.0f, 0.0f, -10.0f), use.center);
+	float mip2 = RADIUS + 2.0f * RADIUS * view.pixelsPerUnit * 4.0f / (dds.width * REPEAT);
+	float nearer = mip2 * 0.95f, farther = mip2 * 1.05f;
+
+	unsigned int loads = 0, evictions = 0;
+	for (unsigned int frame = 0; frame < 20 * TextureStreamer::EVICT_DELAY; ++frame)
+	{
+		float distance = (frame / 5) % 2 ? farther : nearer;
+		lookAt(view, XMFLOAT3(0.0f, 0.0f, -distance), use.center);
+		STREAMSTATS stats;
+		streamer.update(view, &use, 1, &stats);
+		loads += stats.loads;
+		evictions += stats.evictions;
+	}
+	CHECK(loads == 1);
+	CHECK(evictions == 0);
+	CHECK(streamer.getTexture(use.texture).residentMip == 1);
+
+	// From an update that wants the mip, so the count starts again.
+	lookAt(view, XMFLOAT3(0.0f, 0.0f, -nearer), use.center);
+	streamer.update(view, &use, 1);
+	lookAt(view, XMFLOAT3(0.0f, 0.0f, -farther), use.center);
+	for (unsigned int frame = 1; frame <= TextureStreamer::EVICT_DELAY; ++frame)
+	{
+		STREAMSTATS stats;
+		streamer.update(view, &use, 1, &stats);
+		CHECK(stats.loads == 0);
+		CHECK(stats.evictions == (frame == TextureStreamer::EVICT_DELAY ? 1u : 0u));
+	}
+	CHECK(streamer.getTexture(use.texture).residentMip == 2);
+	printf("hover: %u loads, %u evictions over %u updates\n", loads, evictions, 20 * TextureStreamer::EVICT_DELAY);
+}
+
+int main()
+{
+	testPath();
+	testHover();
+	return TestsFailed() ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <vector>
+#include "TestCheck.h"
+#include "../Content/MeshOptimizer.h"
+#include "../Content/ModelLoader.h"
+
+using namespace std;
+
+// OptimizeVertexCache on a grid, whose best possible numbers are known, and on a shipped mesh.
+
+// Two triangles per cell of a size x size grid of quads, row by row.
+static vector<unsigned int> gridIndices(unsigned int size)
+{
+	vector<unsigned int> indices;
+	for (unsigned int y = 0; y < size; ++y)
+	{
+		for (unsigned int x = 0; x < size; ++x)
+		{
+			unsigned int v = y * (size + 1) + x;
+			unsigned int quad[6] = { v, v + size + 1, v + 1, v + 1, v + size + 1, v + size + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	return indices;
+}
+
+// The same triangles in a fixed pseudo random order.
+static vector<unsigned int> shuffleTriangles(const vector<unsigned int> &indices)
+{
+	size_t triangles = indices.size() / 3;
+	vector<unsigned int> order(triangles);
+	for (size_t t = 0; t < triangles; ++t)
+		order[t] = static_cast<unsigned int>(t);
+	unsigned int seed = 12345;
+	for (size_t t = triangles - 1; t > 0; --t)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		swap(order[t], order[seed % (t + 1)]);
+	}
+
+	vector<unsigned int> shuffled;
+	for (unsigned int t : order)
+		shuffled.insert(shuffled.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+	return shuffled;
+}
+
+// Triangles rotated to start at their smallest index, which keeps the winding, then sorted.
+static vector<unsigned int> canonicalTriangles(const vector<unsigned int> &indices)
+{
+	vector<unsigned long long> keys;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		size_t first = i;
+		if (indices[i + 1] < indices[first])
+			first = i + 1;
+		if (indices[i + 2] < indices[first])
+			first = i + 2;
+		unsigned long long a = indices[first];
+		unsigned long long b = indices[i + (first - i + 1) % 3];
+		unsigned long long c = indices[i + (first - i + 2) % 3];
+		keys.push_back((a << 42) | (b << 21) | c);
+	}
+	sort(keys.begin(), keys.end());
+
+	vector<unsigned int> triangles;
+	for (unsigned long long key : keys)
+	{
+		triangles.push_back(static_cast<unsigned int>(key >> 42));
+		triangles.push_back(static_cast<unsigned int>((key >> 21) & 0x1fffff));
+		triangles.push_back(static_cast<unsigned int>(key & 0x1fffff));
+	}
+	return triangles;
+}
+
+// Optimizes indices and checks the result against the input: the same triangles with the same
+// winding, and no more cache misses.
+static VCACHESTATS checkOptimize(const vector<unsigned int> &indices, size_t vertexCount)
+{
+	vector<unsigned int> optimized(indices.size());
+	OptimizeVertexCache(optimized.data(), indices.data(), indices.size(), vertexCount);
+
+	VCACHESTATS before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	VCACHESTATS after = AnalyzeVertexCache(optimized.data(), optimized.size(), vertexCount);
+	CHECK(after.acmr <= before.acmr);
+	CHECK(canonicalTriangles(optimized) == canonicalTriangles(indices));
+	return after;
+}
+
+static void testGrid()
+{
+	static const unsigned int SIZE = 64;
+	size_t vertexCount = (SIZE + 1) * (SIZE + 1);
+	vector<unsigned int> rows = gridIndices(SIZE);
+	vector<unsigned int> shuffled = shuffleTriangles(rows);
+
+	// Every vertex of the grid has to be transformed at least once, and a 16 entry FIFO cache
+	// can't keep a whole 65 vertex row, so row order transforms most of them twice.
+	VCACHESTATS rowStats = AnalyzeVertexCache(rows.data(), rows.size(), vertexCount);
+	CHECK(rowStats.atvr > 1.9f && rowStats.atvr < 2.1f);
+
+	// Tipsify should get well under row order whatever order it is given.
+	VCACHESTATS fromRows = checkOptimize(rows, vertexCount);
+	VCACHESTATS fromShuffled = checkOptimize(shuffled, vertexCount);
+	printf("grid: row order ATVR %.3f, optimized from rows %.3f, from shuffled %.3f\n", rowStats.atvr, fromRows.atvr, fromShuffled.atvr);
+	CHECK(fromRows.atvr >= 1.0f && fromRows.atvr < 1.3f);
+	CHECK(fromShuffled.atvr >= 1.0f && fromShuffled.atvr < 1.3f);
+	CHECK(fromRows.acmr >= 0.5f && fromRows.acmr < 0.7f);
+}
+
+static void testShippedMesh()
+{
+	ModelLoader loader;
+	vector<VERTEX> verts;
+	vector<unsigned int> indices;
+	CHECK(loader.loadModel("Assets/WaterTower.obj", verts, indices));
+	if (indices.empty())
+		return;
+
+	VCACHESTATS after = checkOptimize(indices, verts.size());
+	VCACHESTATS shuffled = checkOptimize(shuffleTriangles(indices), verts.size());
+	printf("WaterTower.obj: optimized ATVR %.3f, from shuffled %.3f\n", after.atvr, shuffled.atvr);
+	CHECK(after.atvr >= 1.0f && after.atvr < 1.25f);
+	CHECK(shuffled.atvr >= 1.0f && shuffled.atvr < 1.25f);
+}
+
+int main()
+{
+	testGrid();
+	testShippedMesh();
+	return TestsFailed() ? 1 : 0;
+}